@@ -25,6 +25,7 @@
 #include "editcommands.h"
 
 #include <avogadro/atom.h>
+#include <avogadro/residue.h>
 
 #include <QMimeData>
 #include <QApplication>
@@ -39,7 +40,6 @@ namespace Avogadro {
     m_molecule(molecule),
     m_copiedData(copyData), m_selectedList(selectedList)
   {
-    m_originalMolecule = *molecule;
     if (selectedList.size() == 0)
       setText(QObject::tr("Cut Molecule"));
     else
@@ -53,41 +53,18 @@ namespace Avogadro {
     if (QApplication::clipboard()->supportsSelection()) {
       QApplication::clipboard()->setMimeData(m_copiedData, QClipboard::Selection);
     }
-    if (m_selectedList.size() == 0) {
-      m_molecule->clear();
-    }
-    else {
-      // Make sure any selection is an atom
-      // FIXME: Do we need to do bonds or other primitives?
-      foreach(unsigned long atomid, m_selectedList.subList(Primitive::AtomType)) {
-        Atom *atom = m_molecule->atomById(atomid);
-        if(atom)
-        {
-          m_molecule->removeAtom(atom);
-        }
-      }
-      foreach(unsigned long bondid, m_selectedList.subList(Primitive::BondType)) {
-        Bond *bond = m_molecule->bondById(bondid);
-        if(bond)
-        {
-          m_molecule->removeBond(bond);
-        }
-      }
-      foreach(unsigned long residueid, m_selectedList.subList(Primitive::ResidueType)) {
-        Residue *residue = m_molecule->residueById(residueid);
-        if(residue)
-        {
-          m_molecule->removeResidue(residue);
-        }
-      }
-    }
+    // Only what is removed is recorded, not the whole molecule
+    if (m_selectedList.size() == 0)
+      m_removed.removeAll(m_molecule);
+    else
+      m_removed.remove(m_molecule, m_selectedList);
     m_molecule->update();
   }
 
   void CutCommand::undo()
   {
-    // restore the molecule
-    *m_molecule = m_originalMolecule;
+    // restore the removed atoms, bonds and residues
+    m_removed.restore(m_molecule);
     m_molecule->update();
   }
 
@@ -95,7 +72,6 @@ namespace Avogadro {
                              GLWidget *widget) :
     m_molecule(molecule),
     m_pastedMolecule(pastedMolecule),
-    m_originalMolecule(*molecule),
     m_widget(widget)
   {
     setText(QObject::tr("Paste"));
@@ -104,15 +80,30 @@ namespace Avogadro {
   void PasteCommand::redo()
   {
     m_widget->clearSelected();
-    // save the current number of atoms -- we'll select all new ones
-    unsigned int currentNumAtoms = m_molecule->numAtoms() - 1;
-    *m_molecule += m_pastedMolecule;
-
     QList<Primitive*> newSelection;
-    QList<Atom*> atoms = m_widget->molecule()->atoms();
-    foreach (Atom *atom, atoms) {
-      if (atom->index() > currentNumAtoms)
-        newSelection.append(const_cast<Atom *>(atom));
+    if (m_pasted.isEmpty()) {
+      // save the current number of atoms -- we'll select all new ones
+      unsigned int currentNumAtoms = m_molecule->numAtoms();
+      unsigned int currentNumResidues = m_molecule->numResidues();
+      *m_molecule += m_pastedMolecule;
+
+      m_pastedList.clear();
+      foreach (Atom *atom, m_molecule->atoms()) {
+        if (atom->index() >= currentNumAtoms) {
+          newSelection.append(atom);
+          m_pastedList.append(atom);
+        }
+      }
+      foreach (Residue *residue, m_molecule->residues())
+        if (residue->index() >= currentNumResidues)
+          m_pastedList.append(residue);
+    }
+    else {
+      // Put back the atoms removed by undo, with the same ids
+      m_pasted.restore(m_molecule);
+      foreach (unsigned long id, m_pastedList.subList(Primitive::AtomType))
+        if (Atom *atom = m_molecule->atomById(id))
+          newSelection.append(atom);
     }
     m_widget->setSelected(newSelection, true);
     m_molecule->update();
@@ -122,15 +113,14 @@ namespace Avogadro {
   {
     // We can't easily save the previous selection, but it would be nice
     m_widget->clearSelected();
-    *m_molecule = m_originalMolecule;
+    m_pasted.remove(m_molecule, m_pastedList);
     m_molecule->update();
   }
 
   ClearCommand::ClearCommand(Molecule *molecule,
                              PrimitiveList selectedList):
     m_molecule(molecule),
-    m_selectedList(selectedList),
-    m_originalMolecule(*molecule)
+    m_selectedList(selectedList)
   {
     if (selectedList.size() == 0)
       setText(QObject::tr("Clear Molecule"));
@@ -140,41 +130,18 @@ namespace Avogadro {
 
   void ClearCommand::redo()
   {
-    if (m_selectedList.size() == 0) {
-      m_molecule->clear();
-    }
-    else {
-      // Make sure any selection is an atom
-      // FIXME: Do we need to do bonds or other primitives?
-      foreach(unsigned long atomid, m_selectedList.subList(Primitive::AtomType)) {
-        Atom *atom = m_molecule->atomById(atomid);
-        if(atom)
-        {
-          m_molecule->removeAtom(atom);
-        }
-      }
-      foreach(unsigned long bondid, m_selectedList.subList(Primitive::BondType)) {
-        Bond *bond = m_molecule->bondById(bondid);
-        if(bond)
-        {
-          m_molecule->removeBond(bond);
-        }
-      }
-      foreach(unsigned long residueid, m_selectedList.subList(Primitive::ResidueType)) {
-        Residue *residue = m_molecule->residueById(residueid);
-        if(residue)
-        {
-          m_molecule->removeResidue(residue);
-        }
-      }
-    }
+    // Only what is removed is recorded, not the whole molecule
+    if (m_selectedList.size() == 0)
+      m_removed.removeAll(m_molecule);
+    else
+      m_removed.remove(m_molecule, m_selectedList);
     m_molecule->update();
   }
 
   void ClearCommand::undo()
   {
     // we should restore the selectedPrimitives when we undo
-    *m_molecule = m_originalMolecule;
+    m_removed.restore(m_molecule);
     m_molecule->update();
   }
 
@@ -30,6 +30,7 @@
 #include <avogadro/glwidget.h>
 #include <avogadro/idlist.h>
 #include <avogadro/molecule.h>
+#include <avogadro/topologyrecord.h>
 
 // forward declaratin
 class QMimeData;
@@ -47,7 +48,7 @@ namespace Avogadro {
 
   private:
     Molecule *m_molecule;         //!< parent (active molecule in widget)
-    Molecule  m_originalMolecule; //!< original (unmodified molecule)
+    TopologyRecord m_removed;     //!< what was cut, to restore on undo
     QMimeData *m_copiedData;      //!< fragment to be copied to the clipboard
     IDList m_selectedList; //!< any selected atoms
   };
@@ -63,7 +64,8 @@ namespace Avogadro {
   private:
     Molecule *m_molecule;
     Molecule m_pastedMolecule;   //!< pasted fragment from the clipboard
-    Molecule m_originalMolecule;
+    TopologyRecord m_pasted;     //!< the pasted atoms after an undo
+    IDList m_pastedList;         //!< the pasted atoms and residues
     GLWidget *m_widget;
   };
 
@@ -78,7 +80,7 @@ namespace Avogadro {
   private:
     Molecule *m_molecule;             //!< active widget molecule
     IDList m_selectedList; //!< any selected atoms
-    Molecule  m_originalMolecule;     //!< save original molecule
+    TopologyRecord m_removed;         //!< what was cleared, to restore on undo
   };
 
 }
@@ -3109,6 +3109,8 @@ protected:
              this, SLOT(documentWasModified() ) );
     connect(d->molecule, SIGNAL(primitiveRemoved(Primitive *)),
              this, SLOT(documentWasModified()));
+    connect(d->molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+             this, SLOT(documentWasModified()));
     connect(d->molecule, SIGNAL(updated()), this, SLOT(documentWasModified()));
 
     setWindowModified(false);
@@ -33,6 +33,7 @@
 #include <avogadro/residue.h>
 #include <avogadro/molecule.h>
 #include <avogadro/engine.h>
+#include <avogadro/changeset.h>
 
 #include <openbabel/mol.h>
 
@@ -101,6 +102,8 @@ namespace Avogadro {
         this, SLOT(updatePrimitive(Primitive *)));
     connect(molecule, SIGNAL(primitiveRemoved(Primitive *)),
         this, SLOT(removePrimitive(Primitive *)));
+    connect(molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+        this, SLOT(moleculeChanged(Avogadro::ChangeSet)));
   }
 
   PrimitiveItemModel::~PrimitiveItemModel()
@@ -156,6 +159,27 @@ namespace Avogadro {
     }
   }
 
+  void PrimitiveItemModel::moleculeChanged(const ChangeSet &changes)
+  {
+    if (!d->molecule || changes.isEmpty())
+      return;
+
+    // Rebuild the cache once instead of inserting and removing rows one at a
+    // time, a change set can touch thousands of primitives
+    beginResetModel();
+    for (int i = 0; i < d->moleculeCache.size(); ++i)
+      d->moleculeCache[i].clear();
+    foreach (Atom *atom, d->molecule->atoms())
+      d->moleculeCache[0].append(atom);
+    foreach (Bond *bond, d->molecule->bonds())
+      d->moleculeCache[1].append(bond);
+    foreach (Residue *residue, d->molecule->residues())
+      d->moleculeCache[2].append(residue);
+    for (int i = 0; i < d->size.size(); ++i)
+      d->size[i] = d->moleculeCache[i].size();
+    endResetModel();
+  }
+
   int PrimitiveItemModel::primitiveIndex(Primitive *primitive)
   {
     if(d->molecule) {
@@ -32,6 +32,7 @@ namespace Avogadro {
   class Engine;
   class Primitive;
   class Molecule;
+  class ChangeSet;
   class PrimitiveItemModelPrivate;
   class PrimitiveItemModel : public QAbstractItemModel
   {
@@ -61,6 +62,7 @@ namespace Avogadro {
       void addPrimitive(Primitive *primitive);
       void updatePrimitive(Primitive *primitive);
       void removePrimitive(Primitive *primitive);
+      void moleculeChanged(const Avogadro::ChangeSet &changes);
 
     private:
       PrimitiveItemModelPrivate * const d;
@@ -64,6 +64,9 @@ namespace Avogadro
     connect(molecule, SIGNAL(primitiveAdded(Primitive*)), this, SLOT(primitiveAdded(Primitive*)));
     connect(molecule, SIGNAL(primitiveUpdated(Primitive*)), this, SLOT(primitiveUpdated(Primitive*)));
     connect(molecule, SIGNAL(primitiveRemoved(Primitive*)), this, SLOT(primitiveRemoved(Primitive*)));
+    // Edits inside a change set are only reported here
+    connect(molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+            this, SLOT(moleculeChanged(Avogadro::ChangeSet)));
 
     initialize();
   }
@@ -136,6 +139,22 @@ namespace Avogadro
     }
   }
  
+  void BondDelegate::moleculeChanged(const ChangeSet &changes)
+  {
+    // The rows are rebuilt in one pass, the ids of removed primitives no
+    // longer give their rows
+    if (changes.contains(Primitive::BondType, ChangeSet::Added)
+        || changes.contains(Primitive::BondType, ChangeSet::Removed)) {
+      initialize();
+      return;
+    }
+
+    Molecule *molecule = m_widget->molecule();
+    foreach (unsigned long id, changes.ids(Primitive::BondType, ChangeSet::Updated))
+      if (Primitive *primitive = molecule->bondById(id))
+        primitiveUpdated(primitive);
+  }
+
   void BondDelegate::writeSettings(QSettings &settings) const
   {
     ProjectTreeModelDelegate::writeSettings(settings);
@@ -30,6 +30,7 @@
 
 namespace Avogadro {
 
+  class ChangeSet;
   class Primitive;
 
   class BondDelegate : public ProjectTreeModelDelegate
@@ -53,6 +54,7 @@ namespace Avogadro {
       void primitiveAdded(Primitive*);
       void primitiveUpdated(Primitive*);
       void primitiveRemoved(Primitive*);
+      void moleculeChanged(const Avogadro::ChangeSet &changes);
 
     private:
       void initialize();
@@ -67,6 +67,9 @@ namespace Avogadro
     connect(molecule, SIGNAL(primitiveAdded(Primitive*)), this, SLOT(primitiveAdded(Primitive*)));
     connect(molecule, SIGNAL(primitiveUpdated(Primitive*)), this, SLOT(primitiveUpdated(Primitive*)));
     connect(molecule, SIGNAL(primitiveRemoved(Primitive*)), this, SLOT(primitiveRemoved(Primitive*)));
+    // Edits inside a change set are only reported here
+    connect(molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+            this, SLOT(moleculeChanged(Avogadro::ChangeSet)));
 
     initialize();
   }
@@ -188,6 +191,22 @@ namespace Avogadro
     }
   }
  
+  void ResidueDelegate::moleculeChanged(const ChangeSet &changes)
+  {
+    // The rows are rebuilt in one pass, the ids of removed primitives no
+    // longer give their rows
+    if (changes.contains(Primitive::ResidueType, ChangeSet::Added)
+        || changes.contains(Primitive::ResidueType, ChangeSet::Removed)) {
+      initialize();
+      return;
+    }
+
+    Molecule *molecule = m_widget->molecule();
+    foreach (unsigned long id, changes.ids(Primitive::ResidueType, ChangeSet::Updated))
+      if (Primitive *primitive = molecule->residueById(id))
+        primitiveUpdated(primitive);
+  }
+
   void ResidueDelegate::writeSettings(QSettings &settings) const
   {
     ProjectTreeModelDelegate::writeSettings(settings);
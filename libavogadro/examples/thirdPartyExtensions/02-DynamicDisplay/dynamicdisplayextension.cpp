@@ -71,6 +71,8 @@ namespace DynamicDisplay {
                 this, SLOT(moleculeUpdated()));
         connect(m_molecule, SIGNAL(atomUpdated(Atom*)),
                 this, SLOT(moleculeUpdated()));
+        connect(m_molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+                this, SLOT(moleculeUpdated()));
       }
     }
 
@@ -25,24 +25,75 @@
 #include <avogadro/molecule.h>
 #include <avogadro/atom.h>
 #include <avogadro/bond.h>
-#include <openbabel/mol.h>
+#include <avogadro/moleculefile.h>
+#include <avogadro/bondperceiver.h>
 #include <Eigen/Core>
 
 #include <QTimeLine>
+#include <QPointer>
+#include <QFuture>
+#include <QtConcurrentRun>
 
-using namespace OpenBabel;
 using Eigen::Vector3d;
 
 namespace Avogadro {
 
+  namespace {
+
+    // The next frame, decoded and with its bonds perceived by prepare()
+    struct PreparedFrame
+    {
+      PreparedFrame() : valid(false) {}
+      bool valid;
+      // The coordinates of a trajectory frame, one per atom in index order
+      std::vector<Vector3d> trajectoryFrame;
+      std::vector<BondPerceiver::AtomPair> bonds;
+    };
+
+    // Decode frame i of the trajectory, whose atoms have the unique ids
+    // ids, or take the positions of a conformer. The bonds are perceived if
+    // radii are given. Runs in a worker thread and only uses copies of the
+    // molecule's data.
+    PreparedFrame prepare(MoleculeFile *trajectory, int i,
+                          const std::vector<unsigned long> &ids,
+                          const std::vector<double> &radii,
+                          std::vector<Vector3d> positions)
+    {
+      PreparedFrame prepared;
+      if (trajectory) {
+        if (!trajectory->frame(i, prepared.trajectoryFrame)
+            || prepared.trajectoryFrame.size() != ids.size())
+          return prepared;
+        positions.assign(radii.size(), Vector3d::Zero());
+        for (unsigned int j = 0; j < ids.size(); ++j)
+          if (ids[j] < positions.size())
+            positions[ids[j]] = prepared.trajectoryFrame[j];
+      }
+      if (!radii.empty())
+        prepared.bonds = BondPerceiver::perceive(radii, positions);
+      prepared.valid = true;
+      return prepared;
+    }
+
+  } // End anonymous namespace
+
   class AnimationPrivate
   {
     public:
-      AnimationPrivate() : fps(25), framesSet(false), dynamicBonds(false) {}
+      AnimationPrivate() : fps(25), framesSet(false), dynamicBonds(false),
+                           pendingFrame(0) {}
 
       int fps;
       bool framesSet;
       bool dynamicBonds;
+      QPointer<MoleculeFile> trajectory;
+      std::vector<Vector3d> trajectoryFrame;
+
+      // Covalent radii of the atoms indexed by id, for dynamic bonds
+      std::vector<double> radii;
+      // The frame being decoded and perceived in the background, or 0
+      int pendingFrame;
+      QFuture<PreparedFrame> pending;
   };
 
   Animation::Animation(QObject *parent) : QObject(parent), d(new AnimationPrivate),
@@ -54,6 +105,8 @@ namespace Avogadro {
 
   Animation::~Animation()
   {
+    d->pending.waitForFinished();
+
     if (m_timeLine) {
       delete m_timeLine;
       m_timeLine = 0;
@@ -65,6 +118,7 @@ namespace Avogadro {
   void Animation::setMolecule(Molecule *molecule)
   {
     m_molecule = molecule;
+    d->pendingFrame = 0;
     if (molecule == NULL)
       return; // we can't save the current conformers
 
@@ -74,12 +128,14 @@ namespace Avogadro {
         m_originalConformers.push_back(molecule->conformer(i));
       }
     } else {
-      m_timeLine->setFrameRange( 1, m_molecule->numConformers() );
+      m_timeLine->setFrameRange( 1, numFrames() );
     }
   }
 
   int Animation::numFrames() const
   {
+    if (d->trajectory)
+      return d->trajectory->numFrames();
     if (d->framesSet)
       return m_frames.size();
     if (m_molecule)
@@ -109,42 +165,89 @@ namespace Avogadro {
 
   void Animation::setFrame(int i)
   {
-    if (i <= 0 || !m_molecule || i > (int)m_molecule->numConformers())
+    // The coordinates of trajectories and the bonds may have been prepared
+    // while the previous frame was shown
+    PreparedFrame next;
+    if (d->pendingFrame == i)
+      next = d->pending.result();
+    d->pendingFrame = 0;
+
+    if (d->trajectory) {
+      if (i <= 0 || !m_molecule || i > numFrames())
+        return; // nothing to do
+      // decode the frame, atoms in the file are in the same order as atoms()
+      if (next.valid)
+        d->trajectoryFrame.swap(next.trajectoryFrame);
+      else if (!d->trajectory->frame(i-1, d->trajectoryFrame))
+        return;
+      if (d->trajectoryFrame.size() != m_molecule->numAtoms())
+        return;
+    }
+    else if (i <= 0 || !m_molecule || i > (int)m_molecule->numConformers())
       return; // nothing to do
 
     m_molecule->lock()->lockForWrite();
-    m_molecule->setConformer(i-1); // Frame counting starts from 1
+    if (d->trajectory) {
+      std::vector<Vector3d> *pos = m_molecule->conformer(m_molecule->currentConformer());
+      QList<Atom *> atoms = m_molecule->atoms();
+      for (int j = 0; j < atoms.size(); ++j)
+        (*pos)[atoms[j]->id()] = d->trajectoryFrame[j];
+      m_molecule->positionsChanged();
+    }
+    else
+      m_molecule->setConformer(i-1); // Frame counting starts from 1
 
     if (d->dynamicBonds) {
-      // construct minimal OBMol
-      OpenBabel::OBMol obmol;
-      obmol.BeginModify();
-      foreach(Atom *atom, m_molecule->atoms()) {
-        OpenBabel::OBAtom *a = obmol.NewAtom();
-        OpenBabel::OBAtom obatom = atom->OBAtom();
-        *a = obatom;
-      }
-      obmol.EndModify();
-
-      // connect the dots
-      obmol.ConnectTheDots();
-
-      QList<Bond*> bonds(m_molecule->bonds());
-      foreach(Bond *bond, bonds)
-        m_molecule->removeBond(bond->id());
-
-      FOR_BONDS_OF_MOL (obbond, obmol) {
-        Bond *bond = m_molecule->addBond();
-        bond->setBegin(m_molecule->atom(obbond->GetBeginAtomIdx()-1));
-        bond->setEnd(m_molecule->atom(obbond->GetEndAtomIdx()-1));
-        bond->setOrder(obbond->GetBondOrder());
+      // Only the bonds that changed since the last frame are replaced
+      std::vector<BondPerceiver::AtomPair> bonds;
+      if (next.valid)
+        bonds.swap(next.bonds);
+      else {
+        d->radii = BondPerceiver::covalentRadii(m_molecule);
+        bonds = BondPerceiver::perceive(d->radii,
+          *m_molecule->conformer(m_molecule->currentConformer()));
       }
+      BondPerceiver::setBonds(m_molecule, bonds);
     }
     m_molecule->lock()->unlock();
     m_molecule->update();
     emit frameChanged(i);
+
+    if ((d->dynamicBonds || d->trajectory)
+        && m_timeLine->state() == QTimeLine::Running)
+      prepareFrame(i < numFrames() ? i + 1 : 1);
   }
- 
+
+  void Animation::prepareFrame(int i)
+  {
+    if (i <= 0 || !m_molecule || (d->dynamicBonds && d->radii.empty()))
+      return;
+
+    // Copy what the worker needs, it must not touch the molecule
+    std::vector<unsigned long> ids;
+    std::vector<Vector3d> positions;
+    if (d->trajectory) {
+      if (i > numFrames())
+        return;
+      QList<Atom *> atoms = m_molecule->atoms();
+      ids.reserve(atoms.size());
+      foreach (Atom *atom, atoms)
+        ids.push_back(atom->id());
+    }
+    else if (d->dynamicBonds && i <= (int)m_molecule->numConformers())
+      positions = *m_molecule->conformer(i-1);
+    else
+      return;
+
+    std::vector<double> radii;
+    if (d->dynamicBonds)
+      radii = d->radii;
+    MoleculeFile *trajectory = d->trajectory;
+    d->pending = QtConcurrent::run(prepare, trajectory, i-1, ids, radii,
+                                   positions);
+    d->pendingFrame = i;
+  }
+
   bool Animation::dynamicBonds() const
   {
     return d->dynamicBonds;
@@ -153,6 +256,7 @@ namespace Avogadro {
   void Animation::setDynamicBonds(bool enable)
   {
     d->dynamicBonds = enable;
+    d->pendingFrame = 0;
   }
 
   void Animation::setFrames(std::vector< std::vector< Eigen::Vector3d> *> frames)
@@ -169,10 +273,34 @@ namespace Avogadro {
     }
  
     d->framesSet = true;
+    d->pendingFrame = 0;
     m_frames = frames;
     m_timeLine->setFrameRange(1, numFrames() );
   }
 
+  void Animation::setTrajectory(MoleculeFile *file)
+  {
+    if (d->trajectory)
+      disconnect(d->trajectory, SIGNAL(framesIndexed(int)),
+                 this, SLOT(trajectoryIndexed(int)));
+
+    // The worker may still be reading the old trajectory
+    d->pending.waitForFinished();
+    d->trajectory = file;
+    d->pendingFrame = 0;
+    if (file)
+      connect(file, SIGNAL(framesIndexed(int)),
+              this, SLOT(trajectoryIndexed(int)));
+    m_timeLine->setFrameRange(1, numFrames());
+  }
+
+  void Animation::trajectoryIndexed(int frames)
+  {
+    m_timeLine->setFrameRange(1, frames);
+    if (m_timeLine->state() == QTimeLine::Running)
+      m_timeLine->setDuration(m_timeLine->updateInterval() * frames);
+  }
+
   void Animation::stop()
   {
     if(!m_molecule)
@@ -182,6 +310,7 @@ namespace Avogadro {
     m_timeLine->setCurrentTime(0);
     disconnect(m_timeLine, SIGNAL(frameChanged(int)),
             this, SLOT(setFrame(int)));
+    d->pendingFrame = 0;
 
     // restore original conformers
     if (d->framesSet) {
@@ -37,6 +37,7 @@ class QTimeLine;
 namespace Avogadro {
 
   class Molecule;
+  class MoleculeFile;
 
   /**
    * @class Animation animation.h <avogadro/animation.h>
@@ -85,6 +86,14 @@ namespace Avogadro {
        * be used to call setFrames() later.
        */
       void setFrames(std::vector< std::vector< Eigen::Vector3d> *> frames);
+      /**
+       * Use the frames of a trajectory opened with
+       * MoleculeFile::readTrajectory(). Frames are decoded when they are
+       * shown, so playback can start while the file is still being indexed.
+       * The Animation does not take ownership of @p file. Pass 0 to use the
+       * conformers of the molecule again.
+       */
+      void setTrajectory(MoleculeFile *file);
 
       /**
        * @return The number of frames per second.
@@ -125,6 +134,9 @@ namespace Avogadro {
 
       /**
        * Enable/disable dynamic bond detection. For QM reactions for example.
+       * While the animation is running the bonds of the next frame are
+       * found in the background, and only the bonds that change between
+       * frames are replaced.
        */
       void setDynamicBonds(bool enable);
 
@@ -141,7 +153,19 @@ namespace Avogadro {
        */
       void stop();
 
+    private Q_SLOTS:
+      /**
+       * Extend the animation as more trajectory frames are indexed.
+       */
+      void trajectoryIndexed(int numFrames);
+
     private:
+      /**
+       * Start decoding trajectory frame @p i and finding its bonds on a
+       * worker thread.
+       */
+      void prepareFrame(int i);
+
       AnimationPrivate * const d;
       
       Molecule *m_molecule;
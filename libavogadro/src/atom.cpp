@@ -42,16 +42,13 @@ namespace Avogadro {
 
   class AtomPrivate {
   public:
-    AtomPrivate(): assignedFormalCharge(false), groupIndex(0), residue(FALSE_ID),
-      partialCharge(0.0), formalCharge(0), forceVector(0.0, 0.0, 0.0),
-      customRadius(0.0)
+    AtomPrivate(): groupIndex(0), residue(FALSE_ID),
+      forceVector(0.0, 0.0, 0.0), customRadius(0.0)
     {}
 
-    bool assignedFormalCharge;
+    // The atomic number and charges are kept by the Molecule
     unsigned int groupIndex;
     unsigned long residue;
-    mutable double partialCharge;
-    int formalCharge;
     Eigen::Vector3d forceVector;
     QString customLabel;
     QString customColorName;
@@ -59,8 +56,7 @@ namespace Avogadro {
   };
 
   Atom::Atom(QObject *parent) : Primitive(AtomType, parent),
-                                d_ptr(new AtomPrivate),
-                                m_atomicNumber(0)
+                                d_ptr(new AtomPrivate)
   {
     if (!parent) {
       qDebug() << "I am an orphaned atom! I feel so invalid...";
@@ -83,12 +79,29 @@ namespace Avogadro {
      m_molecule->setAtomPos(m_id, vec);
    }
 
+   int Atom::atomicNumber() const
+   {
+     if (m_molecule && m_id < m_molecule->m_atomicNumbers.size())
+       return m_molecule->m_atomicNumbers[m_id];
+     return 0;
+   }
+
    void Atom::setAtomicNumber(int num)
    {
-     m_atomicNumber = num;
+     if (m_molecule->m_atomicNumbers[m_id] != num) {
+       m_molecule->m_atomicNumbers[m_id] = num;
+       m_molecule->invalidateOBMol(Molecule::OBMolChemistry);
+     }
      update(); // signal that the element has changed, to update residues
    }
 
+   void Atom::update()
+   {
+     if (m_molecule)
+       m_molecule->updateAtom(this);
+     emit updated();
+   }
+
    void Atom::addBond(Bond* bond)
    {
      if (bond)
@@ -139,10 +152,9 @@ namespace Avogadro {
 
    double Atom::partialCharge() const
    {
-     if (m_molecule && m_atomicNumber) {
-       Q_D(const Atom);
+     if (m_molecule && atomicNumber()) {
        m_molecule->calculatePartialCharges();
-       return d->partialCharge;
+       return m_molecule->m_partialCharges[m_id];
      }
      else
        return 0.0;
@@ -150,22 +162,28 @@ namespace Avogadro {
 
    void Atom::setPartialCharge(double charge) const
    {
-     Q_D(const Atom);
-     d->partialCharge = charge;
+     if (m_molecule->m_partialCharges[m_id] == charge)
+       return;
+     m_molecule->m_partialCharges[m_id] = charge;
+     m_molecule->invalidateOBMol(Molecule::OBMolChemistry);
    }
 
    void Atom::setFormalCharge(int charge)
    {
-     Q_D(Atom);
-     d->assignedFormalCharge = true;
-     d->formalCharge = charge;
+     // Unassigned charges are guessed, see formalCharge()
+     unsigned char &flags = m_molecule->m_atomFlags[m_id];
+     if ((flags & Molecule::AtomFormalChargeAssigned)
+         && m_molecule->m_formalCharges[m_id] == charge)
+       return;
+     flags |= Molecule::AtomFormalChargeAssigned;
+     m_molecule->m_formalCharges[m_id] = charge;
+     m_molecule->invalidateOBMol(Molecule::OBMolChemistry);
    }
 
    int Atom::formalCharge() const
    {
-     Q_D(const Atom);
-     if (d->assignedFormalCharge)
-       return d->formalCharge;
+     if (m_molecule->m_atomFlags[m_id] & Molecule::AtomFormalChargeAssigned)
+       return m_molecule->m_formalCharges[m_id];
 
      // gotta guess it from bonding
      int valenceE = 0;
@@ -269,18 +287,23 @@ namespace Avogadro {
    {
      Q_D(Atom);
      d->customLabel = label;
+     m_molecule->invalidateOBMol(Molecule::OBMolProperties);
    }
 
    void Atom::setCustomColorName(const QString &name)
    {
      Q_D(Atom);
+     if (d->customColorName == name)
+       return;
      d->customColorName = name;
+     m_molecule->invalidateOBMol(Molecule::OBMolChemistry);
    }
 
    void Atom::setCustomRadius(const double radius)
    {
      Q_D(Atom);
      d->customRadius = radius;
+     m_molecule->invalidateOBMol(Molecule::OBMolProperties);
    }
 
    QString Atom::customLabel() const
@@ -321,23 +344,32 @@ namespace Avogadro {
 
    OpenBabel::OBAtom Atom::OBAtom()
    {
-     Q_D(Atom);
      // Need to copy all relevant data over to the OBAtom
      OpenBabel::OBAtom obatom;
+     copyToOBAtom(&obatom);
+     return obatom;
+   }
+
+   void Atom::copyToOBAtom(OpenBabel::OBAtom *obatom)
+   {
+     Q_D(Atom);
      OpenBabel::OBPairData *obproperty;
      const Vector3d *v = m_molecule->atomPos(m_id);
-     obatom.SetVector(v->x(), v->y(), v->z());
-     obatom.SetAtomicNum(m_atomicNumber);
-     obatom.SetPartialCharge(d->partialCharge);
-     obatom.SetFormalCharge(d->formalCharge);
-     obatom.SetId(m_id);
+     obatom->SetVector(v->x(), v->y(), v->z());
+     obatom->SetAtomicNum(m_molecule->m_atomicNumbers[m_id]);
+     obatom->SetPartialCharge(m_molecule->m_partialCharges[m_id]);
+     obatom->SetFormalCharge(m_molecule->m_formalCharges[m_id]);
+     obatom->SetId(m_id);
+
+     // The OBAtom may be a cached one holding an older copy of the data
+     obatom->DeleteData(OpenBabel::OBGenericDataType::PairData);
 
      // Save custom label
      if (!d->customLabel.isEmpty()) {
        obproperty = new OpenBabel::OBPairData;
        obproperty->SetAttribute("label");
        obproperty->SetValue(d->customLabel.toAscii().data());
-       obatom.SetData(obproperty);
+       obatom->SetData(obproperty);
      }
 
      // Save custom color
@@ -345,7 +377,7 @@ namespace Avogadro {
        obproperty = new OpenBabel::OBPairData;
        obproperty->SetAttribute("color");
        obproperty->SetValue(d->customColorName.toAscii().data());
-       obatom.SetData(obproperty);
+       obatom->SetData(obproperty);
      }
 
      // Save custom radius
@@ -353,7 +385,7 @@ namespace Avogadro {
        obproperty = new OpenBabel::OBPairData;
        obproperty->SetAttribute("radius");
        obproperty->SetValue(QString::number(d->customRadius).toAscii().data());
-       obatom.SetData(obproperty);
+       obatom->SetData(obproperty);
      }
 
      // Add dynamic properties as OBPairData
@@ -361,10 +393,8 @@ namespace Avogadro {
        obproperty = new OpenBabel::OBPairData;
        obproperty->SetAttribute(propertyName.data());
        obproperty->SetValue(property(propertyName).toByteArray().data());
-       obatom.SetData(obproperty);
+       obatom->SetData(obproperty);
      }
-
-     return obatom;
    }
 
 /*   const OpenBabel::OBAtom Atom::OBAtom() const
@@ -409,14 +439,15 @@ namespace Avogadro {
      Q_D(Atom);
      // Copy all needed OBAtom data to our atom
      m_molecule->setAtomPos(m_id, Vector3d(obatom->x(), obatom->y(), obatom->z()));
-     m_atomicNumber = obatom->GetAtomicNum();
-     d->partialCharge = obatom->GetPartialCharge();
+     m_molecule->m_atomicNumbers[m_id] = obatom->GetAtomicNum();
+     m_molecule->m_partialCharges[m_id] = obatom->GetPartialCharge();
 
      // #ifdef OPENBABEL_IS_NEWER_THAN_2_2_99
      // m_customLabel = obatom->GetCustomLabel();
      // #endif
      if (obatom->GetFormalCharge() != 0)
-       d->formalCharge = obatom->GetFormalCharge();
+       m_molecule->m_formalCharges[m_id] = obatom->GetFormalCharge();
+     m_molecule->invalidateOBMol(Molecule::OBMolChemistry);
 
      // And add any generic data as QObject properties
      std::vector<OpenBabel::OBGenericData*> data;
@@ -446,21 +477,26 @@ namespace Avogadro {
 
    Atom& Atom::operator=(const Atom& other)
    {
-     Q_D(Atom);
      // Virtually everything here is invariant apart from the index and possibly id
      if (other.pos())
        m_molecule->setAtomPos(m_id, *other.pos());
      else
        qDebug() << "Atom position returned null.";
 
-     // Check first, because this will invalidate residue info
-     if (m_atomicNumber != other.m_atomicNumber)
-       m_atomicNumber = other.m_atomicNumber;
-     d->formalCharge = other.formalCharge();
-     d->customLabel = other.customLabel();
-     d->customColorName = other.customColorName();
-     d->customRadius = other.customRadius();
+     m_molecule->m_atomicNumbers[m_id] = other.atomicNumber();
+     m_molecule->m_formalCharges[m_id] = other.formalCharge();
+     m_molecule->invalidateOBMol(Molecule::OBMolChemistry);
+     copyCustomData(other);
      return *this;
    }
 
+   void Atom::copyCustomData(const Atom &other)
+   {
+     Q_D(Atom);
+     const AtomPrivate *e = other.d_func();
+     d->customLabel = e->customLabel;
+     d->customColorName = e->customColorName;
+     d->customRadius = e->customRadius;
+   }
+
  } // End namespace Avogadro
@@ -46,6 +46,11 @@ namespace Avogadro {
    * The Atom class is a Primitive subclass that provides an Atom object. All
    * atoms must be owned by a Molecule. It should also be removed by the
    * Molecule that owns it.
+   *
+   * The position, atomic number and charges of the atom are stored in arrays
+   * of the Molecule indexed by the unique id of the atom, code working on
+   * many atoms at once can use those directly, e.g.
+   * Molecule::atomicNumbers().
    */
   class Bond;
   class Residue;
@@ -145,7 +150,7 @@ namespace Avogadro {
      * @return Atomic number of the atom.
      * @note Replaces GetAtomicNum()
      */
-    int atomicNumber() const { return m_atomicNumber; }
+    int atomicNumber() const;
 
     /**
      * @return List of bond ids to the atom.
@@ -177,7 +182,7 @@ namespace Avogadro {
     /**
      * @return True if the atom is a hydrogen.
      */
-    bool isHydrogen() const { return m_atomicNumber == 1; }
+    bool isHydrogen() const { return atomicNumber() == 1; }
 
     /**
      * @return Partial charge of the atom.
@@ -212,6 +217,12 @@ namespace Avogadro {
     /** @} */
 
 
+    /**
+     * Function used to push changes to the atom to the rest of the system,
+     * notifies the Molecule and emits updated().
+     */
+    void update();
+
     /** @name OpenBabel conversion functions
      * These functions are used convert between Avogadro and OpenBabel atoms.
      * @{
@@ -271,9 +282,20 @@ namespace Avogadro {
      */
     void setResidue(const Residue *residue);
 
+    /**
+     * Copy the position, element, charges and custom data of the atom to
+     * @p obatom, replacing any custom data it had before.
+     */
+    void copyToOBAtom(OpenBabel::OBAtom *obatom);
+
+    /**
+     * Copy the custom label, color and radius of @p other, the data kept by
+     * the atom itself rather than by the Molecule.
+     */
+    void copyCustomData(const Atom &other);
+
     AtomPrivate * const d_ptr;
     Molecule *m_molecule; /** Parent molecule - should always be valid. **/
-    int m_atomicNumber;
     QList<unsigned long> m_bonds;
 
     Q_DECLARE_PRIVATE(Atom)
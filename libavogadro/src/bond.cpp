@@ -59,6 +59,7 @@
     }
     m_beginAtomId = atom->id();
     atom->addBond(this);
+    m_molecule->invalidateOBMol(Molecule::OBMolTopology);
   }
 
   Atom * Bond::beginAtom() const
@@ -74,6 +75,7 @@
     }
     m_endAtomId = atom->id();
     atom->addBond(this);
+    m_molecule->invalidateOBMol(Molecule::OBMolTopology);
   }
 
   Atom * Bond::endAtom() const
@@ -101,6 +103,28 @@
       qDebug() << "Non-existent atom:" << atom2;
     }
     m_order = order;
+    m_molecule->invalidateOBMol(Molecule::OBMolTopology);
+  }
+
+  void Bond::setOrder(short order)
+  {
+    if (m_order == order)
+      return;
+    m_order = order;
+    m_molecule->invalidateOBMol(Molecule::OBMolChemistry);
+  }
+
+  void Bond::setCustomLabel(const QString &label)
+  {
+    m_customLabel = label;
+    m_molecule->invalidateOBMol(Molecule::OBMolProperties);
+  }
+
+  void Bond::update()
+  {
+    if (m_molecule)
+      m_molecule->updateBond(this);
+    emit updated();
   }
 
   const Eigen::Vector3d * Bond::beginPos() const
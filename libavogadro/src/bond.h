@@ -87,7 +87,7 @@ namespace Avogadro {
     /**
      * Set the order of the bond.
      */
-    void setOrder(short order) { m_order = order; }
+    void setOrder(short order);
 
     /**
      * Set the aromaticity of the bond.
@@ -97,7 +97,7 @@ namespace Avogadro {
     /**
      * Set the custom label for the bond
      */
-    void setCustomLabel(const QString &label) {  m_customLabel = label; }
+    void setCustomLabel(const QString &label);
     /** @} */
 
     /** @name Get bonding information
@@ -170,6 +170,12 @@ namespace Avogadro {
     QString customLabel() const { return m_customLabel; }
     /** @} */
 
+    /**
+     * Function used to push changes to the bond to the rest of the system,
+     * notifies the Molecule and emits updated().
+     */
+    void update();
+
     /** @name OpenBabel conversion functions
      * These functions are used convert between Avogadro and OpenBabel bonds.
      * @{
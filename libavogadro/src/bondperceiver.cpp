@@ -0,0 +1,204 @@
+/**********************************************************************
+  BondPerceiver - bonds from interatomic distances using a cell list
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include "bondperceiver.h"
+
+#include "atom.h"
+#include "bond.h"
+#include "molecule.h"
+
+#include <openbabel/mol.h>
+
+#include <QtCore/QList>
+
+#include <algorithm>
+
+using Eigen::Vector3d;
+using std::vector;
+
+namespace Avogadro {
+
+  namespace {
+
+    // Added to the sum of the covalent radii, as in ConnectTheDots()
+    const double bondTolerance = 0.45;
+    // Atoms closer than this (squared) are overlapping, not bonded
+    const double minimumDistance2 = 0.16;
+
+  } // End anonymous namespace
+
+  vector<double> BondPerceiver::covalentRadii(const Molecule *molecule)
+  {
+    vector<double> radii;
+    foreach (Atom *atom, molecule->atoms()) {
+      if (atom->id() >= radii.size())
+        radii.resize(atom->id() + 1, -1.0);
+      radii[atom->id()] = OpenBabel::etab.GetCovalentRad(atom->atomicNumber());
+    }
+    return radii;
+  }
+
+  vector<BondPerceiver::AtomPair> BondPerceiver::perceive(const vector<double> &radii,
+                                                          const vector<Vector3d> &positions)
+  {
+    vector<AtomPair> bonds;
+
+    // The atoms in ascending id order and their bounding box
+    unsigned long numIds = std::min(radii.size(), positions.size());
+    vector<unsigned long> atoms;
+    double maxRadius = 0.0;
+    Vector3d min(0.0, 0.0, 0.0), max(0.0, 0.0, 0.0);
+    for (unsigned long id = 0; id < numIds; ++id) {
+      if (radii[id] < 0.0)
+        continue;
+      const Vector3d &pos = positions[id];
+      if (atoms.empty())
+        min = max = pos;
+      for (int k = 0; k < 3; ++k) {
+        min[k] = std::min(min[k], pos[k]);
+        max[k] = std::max(max[k], pos[k]);
+      }
+      maxRadius = std::max(maxRadius, radii[id]);
+      atoms.push_back(id);
+    }
+    if (atoms.size() < 2)
+      return bonds;
+
+    // Cells as large as the longest bond, made larger for sparse coordinates
+    // so there are never many more cells than atoms
+    double cellSize = 2.0 * maxRadius + bondTolerance;
+    Vector3d extent = max - min;
+    int dims[3];
+    for (;;) {
+      double numCells = 1.0;
+      for (int k = 0; k < 3; ++k) {
+        dims[k] = static_cast<int>(extent[k] / cellSize) + 1;
+        numCells *= dims[k];
+      }
+      if (numCells <= 8.0 * atoms.size() + 64.0)
+        break;
+      cellSize *= 2.0;
+    }
+
+    // Sort the atoms by cell, cellAtoms[cellStart[c]] to
+    // cellAtoms[cellStart[c + 1] - 1] are the atoms of cell c in id order
+    int numAtoms = atoms.size();
+    int numCells = dims[0] * dims[1] * dims[2];
+    vector<int> cellOf(numAtoms);
+    vector<int> cellStart(numCells + 1, 0);
+    for (int a = 0; a < numAtoms; ++a) {
+      Vector3d p = (positions[atoms[a]] - min) / cellSize;
+      int cell[3];
+      for (int k = 0; k < 3; ++k)
+        cell[k] = std::min(static_cast<int>(p[k]), dims[k] - 1);
+      cellOf[a] = (cell[2] * dims[1] + cell[1]) * dims[0] + cell[0];
+      ++cellStart[cellOf[a] + 1];
+    }
+    for (int c = 0; c < numCells; ++c)
+      cellStart[c + 1] += cellStart[c];
+    vector<int> cellAtoms(numAtoms);
+    vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+    for (int a = 0; a < numAtoms; ++a)
+      cellAtoms[fill[cellOf[a]]++] = a;
+
+    // Compare each atom with the later atoms of its own and neighboring cells
+    for (int a = 0; a < numAtoms; ++a) {
+      unsigned long id = atoms[a];
+      const Vector3d &pos = positions[id];
+      int x = cellOf[a] % dims[0];
+      int y = (cellOf[a] / dims[0]) % dims[1];
+      int z = cellOf[a] / (dims[0] * dims[1]);
+      for (int nz = std::max(z - 1, 0); nz <= std::min(z + 1, dims[2] - 1); ++nz) {
+        for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, dims[1] - 1); ++ny) {
+          for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, dims[0] - 1); ++nx) {
+            int c = (nz * dims[1] + ny) * dims[0] + nx;
+            for (int i = cellStart[c]; i < cellStart[c + 1]; ++i) {
+              int b = cellAtoms[i];
+              if (b <= a)
+                continue;
+              unsigned long other = atoms[b];
+              double cutoff = radii[id] + radii[other] + bondTolerance;
+              double d2 = (positions[other] - pos).squaredNorm();
+              if (d2 >= minimumDistance2 && d2 <= cutoff * cutoff)
+                bonds.push_back(AtomPair(id, other));
+            }
+          }
+        }
+      }
+    }
+
+    std::sort(bonds.begin(), bonds.end());
+    return bonds;
+  }
+
+  void BondPerceiver::setBonds(Molecule *molecule, const vector<AtomPair> &bonds)
+  {
+    // The current bonds, sorted the same way as the new ones. The rows of
+    // the adjacency arrays are in id order, so only the neighbors within a
+    // row need sorting.
+    const vector<unsigned int> &offsets = molecule->adjacencyOffsets();
+    const vector<unsigned long> &neighbors = molecule->adjacentAtoms();
+    const vector<unsigned long> &bondIds = molecule->adjacentBonds();
+    vector< std::pair<AtomPair, Bond *> > current;
+    current.reserve(molecule->numBonds());
+    for (unsigned long id = 0; id + 1 < offsets.size(); ++id) {
+      unsigned int row = current.size();
+      for (unsigned int i = offsets[id]; i < offsets[id + 1]; ++i)
+        if (neighbors[i] >= id)
+          current.push_back(std::make_pair(AtomPair(id, neighbors[i]),
+                                           molecule->bondById(bondIds[i])));
+      std::sort(current.begin() + row, current.end());
+    }
+
+    // Walk both lists, repeated bonds between the same atoms are removed
+    QList<Bond *> removed;
+    vector<AtomPair> added;
+    vector< std::pair<AtomPair, Bond *> >::const_iterator i = current.begin();
+    vector<AtomPair>::const_iterator j = bonds.begin();
+    while (i != current.end() || j != bonds.end()) {
+      if (j == bonds.end() || (i != current.end() && i->first < *j)) {
+        removed.append(i->second);
+        ++i;
+      }
+      else if (i == current.end() || *j < i->first) {
+        added.push_back(*j);
+        ++j;
+      }
+      else {
+        ++i;
+        ++j;
+      }
+    }
+    if (removed.isEmpty() && added.empty())
+      return;
+
+    molecule->beginChangeSet();
+    molecule->removeBonds(removed);
+    for (vector<AtomPair>::const_iterator it = added.begin(); it != added.end(); ++it)
+      if (molecule->atomById(it->first) && molecule->atomById(it->second))
+        molecule->addBond(it->first, it->second, 1);
+    molecule->commitChangeSet();
+  }
+
+} // End namespace Avogadro
@@ -0,0 +1,91 @@
+/**********************************************************************
+  BondPerceiver - bonds from interatomic distances using a cell list
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#ifndef BONDPERCEIVER_H
+#define BONDPERCEIVER_H
+
+#include <avogadro/global.h>
+
+#include <Eigen/Core>
+
+#include <utility>
+#include <vector>
+
+namespace Avogadro {
+
+  class Molecule;
+
+  /**
+   * @class BondPerceiver bondperceiver.h <avogadro/bondperceiver.h>
+   * @brief Bond perception from the coordinates of a Molecule.
+   *
+   * Two atoms are bonded when their distance is more than 0.4 Angstrom and
+   * less than the sum of their covalent radii plus 0.45 Angstrom, the
+   * distance criterion of OpenBabel::OBMol::ConnectTheDots(). The atoms are
+   * sorted into a grid of cells as large as the longest possible bond, so
+   * only atoms in neighboring cells are compared and the cost grows
+   * linearly with the number of atoms.
+   *
+   * Everything is indexed by atom id, as the conformers of the Molecule
+   * are. perceive() only works on its arguments and may be run on a worker
+   * thread, e.g. to find the bonds of the next frame of an Animation.
+   */
+  class A_EXPORT BondPerceiver
+  {
+  public:
+    /**
+     * A bond between two atom ids, the lower id first.
+     */
+    typedef std::pair<unsigned long, unsigned long> AtomPair;
+
+    /**
+     * @return The covalent radius of each atom of @p molecule indexed by
+     * atom id. Unused ids have a negative radius.
+     */
+    static std::vector<double> covalentRadii(const Molecule *molecule);
+
+    /**
+     * Find the bonds between atoms.
+     * @param radii The covalent radii indexed by atom id, as returned by
+     * covalentRadii(). Ids with a negative radius are skipped.
+     * @param positions The atom positions indexed by atom id, e.g. a
+     * conformer of the molecule.
+     * @return The bonded pairs of atom ids in ascending order.
+     */
+    static std::vector<AtomPair> perceive(const std::vector<double> &radii,
+                                          const std::vector<Eigen::Vector3d> &positions);
+
+    /**
+     * Change the bonds of @p molecule to @p bonds. Bonds that are already
+     * present are kept along with their order, only the missing bonds are
+     * added and the others removed, all in one change set.
+     * @param bonds Pairs of atom ids in ascending order, as returned by
+     * perceive().
+     */
+    static void setBonds(Molecule *molecule, const std::vector<AtomPair> &bonds);
+  };
+
+} // End namespace Avogadro
+
+#endif // BONDPERCEIVER_H
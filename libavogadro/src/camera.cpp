@@ -332,6 +332,19 @@ namespace Avogadro
     return d->modelview.linear().col(2).normalized();
   }
 
+  void Camera::frustumPlanes(Eigen::Vector4d planes[6]) const
+  {
+    // Each plane is the sum or difference of the last row and one of the
+    // other rows of the matrix taking molecule to clip coordinates
+    const Matrix4d t (d->projection.matrix() * d->modelview.matrix());
+    for (int i = 0; i < 3; ++i) {
+      planes[2 * i] = (t.row(3) + t.row(i)).transpose();
+      planes[2 * i + 1] = (t.row(3) - t.row(i)).transpose();
+    }
+    for (int i = 0; i < 6; ++i)
+      planes[i] /= Vector3d(planes[i].x(), planes[i].y(), planes[i].z()).norm();
+  }
+
   bool Camera::nearClippingPlane(Vector3d *normal, Vector3d *point)
   {
     // Determine near plane from three coplanar points:
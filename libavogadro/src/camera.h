@@ -311,6 +311,16 @@ namespace Avogadro {
        */
       bool nearClippingPlane(Eigen::Vector3d *normal, Eigen::Vector3d *point);
 
+      /**
+       * Obtain the six planes bounding the view, in molecule coordinates.
+       *
+       * @param planes Overwritten with the left, right, bottom, top, near
+       * and far planes. For each plane (a, b, c, d), (a, b, c) is the unit
+       * normal pointing into the viewing volume and a*x + b*y + c*z + d is
+       * the signed distance of the point (x, y, z) from the plane.
+       */
+      void frustumPlanes(Eigen::Vector4d planes[6]) const;
+
       /** The linear component (ie the 3x3 topleft block) of the camera matrix must
         * always be a rotation. But after several hundreds of operations on it,
         * it can drift farther and farther away from being a rotation. This method
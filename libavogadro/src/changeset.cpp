@@ -0,0 +1,138 @@
+/**********************************************************************
+  ChangeSet - the primitives changed by a batch of molecule edits
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include "changeset.h"
+
+#include <QtCore/QSet>
+#include <QtCore/QVector>
+#include <QtAlgorithms>
+
+namespace Avogadro {
+
+  class ChangeSetPrivate
+  {
+  public:
+    ChangeSetPrivate() : added(Primitive::LastType),
+      updated(Primitive::LastType), removed(Primitive::LastType) {}
+
+    // The ids of each kind of change, indexed by Primitive::Type
+    QVector< QSet<unsigned long> > added;
+    QVector< QSet<unsigned long> > updated;
+    QVector< QSet<unsigned long> > removed;
+
+    const QSet<unsigned long> & ids(Primitive::Type type,
+                                    ChangeSet::Change change) const
+    {
+      switch (change) {
+      case ChangeSet::Added:
+        return added.at(type);
+      case ChangeSet::Updated:
+        return updated.at(type);
+      default:
+        return removed.at(type);
+      }
+    }
+  };
+
+  ChangeSet::ChangeSet() : d(new ChangeSetPrivate)
+  {
+  }
+
+  ChangeSet::ChangeSet(const ChangeSet &other) : d(new ChangeSetPrivate)
+  {
+    *d = *other.d;
+  }
+
+  ChangeSet::~ChangeSet()
+  {
+    delete d;
+  }
+
+  ChangeSet &ChangeSet::operator=(const ChangeSet &other)
+  {
+    *d = *other.d;
+    return *this;
+  }
+
+  void ChangeSet::append(Primitive::Type type, unsigned long id,
+                         Change change)
+  {
+    if (type < 0 || type >= Primitive::LastType)
+      return;
+
+    switch (change) {
+    case Added:
+      d->added[type].insert(id);
+      break;
+    case Updated:
+      // Listeners read new primitives in full anyway
+      if (!d->added.at(type).contains(id))
+        d->updated[type].insert(id);
+      break;
+    case Removed:
+      d->updated[type].remove(id);
+      // A primitive added in this change set was never seen by listeners
+      if (!d->added[type].remove(id))
+        d->removed[type].insert(id);
+      break;
+    }
+  }
+
+  QList<unsigned long> ChangeSet::ids(Primitive::Type type,
+                                      Change change) const
+  {
+    if (type < 0 || type >= Primitive::LastType)
+      return QList<unsigned long>();
+
+    QList<unsigned long> list = d->ids(type, change).toList();
+    qSort(list);
+    return list;
+  }
+
+  bool ChangeSet::contains(Primitive::Type type, Change change) const
+  {
+    if (type < 0 || type >= Primitive::LastType)
+      return false;
+    return !d->ids(type, change).isEmpty();
+  }
+
+  bool ChangeSet::isEmpty() const
+  {
+    for (int i = 0; i < Primitive::LastType; ++i)
+      if (!d->added.at(i).isEmpty() || !d->updated.at(i).isEmpty()
+          || !d->removed.at(i).isEmpty())
+        return false;
+    return true;
+  }
+
+  void ChangeSet::clear()
+  {
+    for (int i = 0; i < Primitive::LastType; ++i) {
+      d->added[i].clear();
+      d->updated[i].clear();
+      d->removed[i].clear();
+    }
+  }
+
+} // End namespace Avogadro
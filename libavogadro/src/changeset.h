@@ -0,0 +1,103 @@
+/**********************************************************************
+  ChangeSet - the primitives changed by a batch of molecule edits
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#ifndef CHANGESET_H
+#define CHANGESET_H
+
+#include <avogadro/global.h>
+#include <avogadro/primitive.h>
+
+#include <QList>
+
+namespace Avogadro {
+
+  /**
+   * @class ChangeSet changeset.h <avogadro/changeset.h>
+   * @brief The unique ids of the primitives added, updated and removed by a
+   * batch of changes to a Molecule.
+   *
+   * Between Molecule::beginChangeSet() and Molecule::commitChangeSet() the
+   * molecule does not emit a signal for each primitive, it records the
+   * changes in a ChangeSet and emits Molecule::moleculeChanged(ChangeSet)
+   * once at the end.
+   *
+   * Changes are merged as they are recorded: a primitive added and removed
+   * again does not appear at all, and updates are not listed for primitives
+   * that were added or removed. An id can be both removed and added when it
+   * was reused, listeners should handle the removals first.
+   */
+  class ChangeSetPrivate;
+  class A_EXPORT ChangeSet
+  {
+  public:
+    /**
+     * The kinds of change recorded for a primitive.
+     */
+    enum Change {
+      Added,
+      Updated,
+      Removed
+    };
+
+    ChangeSet();
+    ChangeSet(const ChangeSet &other);
+    ~ChangeSet();
+
+    ChangeSet &operator=(const ChangeSet &other);
+
+    /**
+     * Record a change to the primitive of @p type with unique id @p id.
+     */
+    void append(Primitive::Type type, unsigned long id, Change change);
+
+    /**
+     * @return The unique ids of the primitives of @p type that had
+     * @p change, in ascending order.
+     */
+    QList<unsigned long> ids(Primitive::Type type, Change change) const;
+
+    /**
+     * @return True if any primitive of @p type had @p change.
+     */
+    bool contains(Primitive::Type type, Change change) const;
+
+    /**
+     * @return True if no change was recorded.
+     */
+    bool isEmpty() const;
+
+    /**
+     * Forget all recorded changes.
+     */
+    void clear();
+
+  private:
+    ChangeSetPrivate * const d;
+  };
+
+} // End namespace Avogadro
+
+Q_DECLARE_METATYPE(Avogadro::ChangeSet)
+
+#endif // CHANGESET_H
@@ -24,6 +24,8 @@
  **********************************************************************/
 
 #include "color.h"
+#include <avogadro/molecule.h>
+#include <avogadro/atom.h>
 #include <cmath> // for fabs()
 
 #ifdef ENABLE_GLSL
@@ -37,20 +39,28 @@ namespace Avogadro {
 
   using std::fabs;
 
+  // Only allocated once atomColors() is used, plenty of colors are
+  // temporaries that never need it
   class ColorPrivate {
   public:
-    ColorPrivate()
+    ColorPrivate() : valid(false), topologyVersion(0), positionsVersion(0)
     {    }
 
     ~ColorPrivate()
     {    }
+
+    QVector<float> atomColors;
+    bool valid;
+    // The versions of the molecule atomColors was evaluated for
+    unsigned int topologyVersion;
+    unsigned int positionsVersion;
   };
 
   Color::Color(): d(0) {
   }
 
   Color::~Color() {
-      //delete d;
+    delete d;
   }
 
   Color::Color(float red, float green, float blue, float alpha ) : d(0)
@@ -124,6 +134,63 @@ namespace Avogadro {
     return;
   }
 
+  const QVector<float> & Color::atomColors(const Molecule *molecule)
+  {
+    if (!d) {
+      d = new ColorPrivate;
+      connect(this, SIGNAL(changed()), this, SLOT(invalidateAtomColors()));
+    }
+
+    if (!molecule) {
+      d->atomColors.clear();
+      d->valid = false;
+      return d->atomColors;
+    }
+
+    unsigned int positions = dependsOnPositions() ? molecule->positionsVersion()
+                                                  : 0;
+    if (d->valid && d->topologyVersion == molecule->topologyVersion()
+        && d->positionsVersion == positions)
+      return d->atomColors;
+
+    // Plugins evaluate through m_channels, which callers may rely on
+    float channels[4] = { m_channels[0], m_channels[1], m_channels[2],
+                          m_channels[3] };
+    evaluateAtomColors(molecule, d->atomColors);
+    for (int i = 0; i < 4; ++i)
+      m_channels[i] = channels[i];
+
+    // Read the versions afterwards, evaluating may compute partial charges
+    d->valid = true;
+    d->topologyVersion = molecule->topologyVersion();
+    d->positionsVersion = dependsOnPositions() ? molecule->positionsVersion()
+                                               : 0;
+    return d->atomColors;
+  }
+
+  void Color::invalidateAtomColors()
+  {
+    if (d)
+      d->valid = false;
+  }
+
+  void Color::evaluateAtomColors(const Molecule *molecule,
+                                 QVector<float> &colors)
+  {
+    colors.resize(4 * molecule->numAtoms());
+    float *rgba = colors.data();
+    foreach (const Atom *atom, molecule->atoms()) {
+      setFromPrimitive(atom);
+      for (int i = 0; i < 4; ++i)
+        rgba[4 * atom->index() + i] = m_channels[i];
+    }
+  }
+
+  bool Color::dependsOnPositions() const
+  {
+    return false;
+  }
+
   void Color::setAlpha(double alpha)
   {
     m_channels[3] = alpha;
@@ -33,6 +33,7 @@
 #include <avogadro/plugin.h>
 
 #include <QtGui/QColor> // for returning QColor
+#include <QtCore/QVector>
 
 #define AVOGADRO_COLOR(i, t, d)                 \
   public: \
@@ -54,7 +55,8 @@
 namespace Avogadro {
 
   class Primitive;
-  class ColorPrivate; // for future expansion
+  class Molecule;
+  class ColorPrivate;
 
   /**
    * @class Color color.h <avogadro/color.h>
@@ -138,6 +140,16 @@ namespace Avogadro {
      */
     virtual void setFromGradient(const double value, const double lo,
                                  const double mid, const double hi);
+
+    /**
+     * Evaluate the colors of all atoms of @p molecule at once, so engines
+     * do not need to call setFromPrimitive() for every atom on every frame.
+     * @return Four floats per atom, the red, green, blue and alpha
+     * components in the order of Atom::index(). The array is kept until
+     * this color emits changed() or the molecule changes in a way the
+     * colors depend on, see dependsOnPositions().
+     */
+    const QVector<float> & atomColors(const Molecule *molecule);
     //@}
 
    /** @name Explicit Color Methods
@@ -250,7 +262,30 @@ namespace Avogadro {
        */
       void changed();
 
+  protected Q_SLOTS:
+    /**
+     * Drop the colors kept by atomColors(). This is connected to changed(),
+     * call it when the settings change without emitting changed().
+     */
+    void invalidateAtomColors();
+
   protected:
+    /**
+     * Fill @p colors with the colors of all atoms of @p molecule as returned
+     * by atomColors(). The default calls setFromPrimitive() for each atom,
+     * reimplement it when the colors can be evaluated faster in bulk.
+     */
+    virtual void evaluateAtomColors(const Molecule *molecule,
+                                    QVector<float> &colors);
+
+    /**
+     * @return True if the colors depend on the positions of the atoms, in
+     * which case atomColors() evaluates them again whenever atoms move.
+     * Otherwise they only follow Molecule::topologyVersion(). The default
+     * returns false.
+     */
+    virtual bool dependsOnPositions() const;
+
     /**
      * \var m_channels
      * The components of the color ranging from 0 to 1.
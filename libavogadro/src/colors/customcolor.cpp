@@ -90,6 +90,7 @@ namespace Avogadro {
   void CustomColor::readSettings(QSettings &settings)
   {
     Color::setFromQColor(settings.value("customcolor", QColor(Qt::white)).value<QColor>());
+    invalidateAtomColors();
   }
 
 }
@@ -88,6 +88,11 @@ namespace Avogadro {
     m_channels[3] = 1.0;
   }
 
+  bool DistanceColor::dependsOnPositions() const
+  {
+    return true;
+  }
+
 }
 
 Q_EXPORT_PLUGIN2(distancecolor, Avogadro::DistanceColorFactory)
@@ -52,6 +52,9 @@ namespace Avogadro {
      * Set the color based on the supplied Primitive
      * If NULL is passed, do nothing */
     void setFromPrimitive(const Primitive *);
+
+  protected:
+    bool dependsOnPositions() const;
   };
 
   class DistanceColorFactory : public QObject, public PluginFactory
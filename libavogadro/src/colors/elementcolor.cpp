@@ -26,6 +26,7 @@
 
 #include <avogadro/primitive.h>
 #include <avogadro/atom.h>
+#include <avogadro/molecule.h>
 #include <QtPlugin>
 
 #include <openbabel/mol.h>
@@ -61,6 +62,36 @@ namespace Avogadro {
     m_channels[3] = 1.0;
   }
 
+  void ElementColor::evaluateAtomColors(const Molecule *molecule,
+                                        QVector<float> &colors)
+  {
+    // The colors of the elements seen so far, four floats each
+    const int numElements = 128;
+    QVector<float> elements(4 * numElements, -1.0f);
+
+    colors.resize(4 * molecule->numAtoms());
+    float *rgba = colors.data();
+    foreach (const Atom *atom, molecule->atoms()) {
+      float *color = rgba + 4 * atom->index();
+      int element = atom->atomicNumber();
+      if (element < 0 || element >= numElements) {
+        setFromPrimitive(atom);
+        for (int i = 0; i < 4; ++i)
+          color[i] = m_channels[i];
+        continue;
+      }
+
+      float *elementColor = elements.data() + 4 * element;
+      if (elementColor[0] < 0.0f) {
+        setFromPrimitive(atom);
+        for (int i = 0; i < 4; ++i)
+          elementColor[i] = m_channels[i];
+      }
+      for (int i = 0; i < 4; ++i)
+        color[i] = elementColor[i];
+    }
+  }
+
 }
 
 Q_EXPORT_PLUGIN2(elementcolor, Avogadro::ElementColorFactory)
@@ -53,6 +53,12 @@ namespace Avogadro {
      * Set the color based on the supplied Primitive
      * If NULL is passed, do nothing */
     void setFromPrimitive(const Primitive *);
+
+  protected:
+    /**
+     * Looks up each element in the OpenBabel element table only once.
+     */
+    void evaluateAtomColors(const Molecule *molecule, QVector<float> &colors);
   };
 
   class ElementColorFactory : public QObject, public PluginFactory
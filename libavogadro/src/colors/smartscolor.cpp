@@ -28,10 +28,9 @@
 #include <avogadro/molecule.h>
 #include <avogadro/atom.h>
 #include <avogadro/colorbutton.h>
+#include <avogadro/smartsmatcher.h>
 
 #include <openbabel/mol.h>
-#include <openbabel/atom.h>
-#include <openbabel/parsmart.h>
 
 #include <QtPlugin>
 #include <QHBoxLayout>
@@ -44,20 +43,16 @@ using namespace OpenBabel;
 namespace Avogadro {
 
   /// Constructor
-  SmartsColor::SmartsColor() : _highlightColor(255, 0, 128), _settingsWidget(NULL)
+  SmartsColor::SmartsColor() : _validPattern(false),
+    _highlightColor(255, 0, 128), _settingsWidget(NULL), _matchesVersion(0)
   { 
-    _pattern = new OBSmartsPattern;
     _smartsString.clear();
+    connect(&_watcher, SIGNAL(finished()), this, SLOT(matchingFinished()));
   }
 
   /// Destructor
   SmartsColor::~SmartsColor()
   { 
-    if (_pattern) {
-      delete _pattern;
-      _pattern = NULL;
-    }
-
     if (_settingsWidget)
       _settingsWidget->deleteLater();
   }
@@ -105,7 +100,8 @@ namespace Avogadro {
   void SmartsColor::smartsChanged(QString newPattern)
   {
     _smartsString = newPattern;
-    _pattern->Init(_smartsString.toAscii());
+    _validPattern = SmartsMatcher::isValid(_smartsString);
+    _matchesVersion = 0;
     emit changed();
   }
 
@@ -139,30 +135,16 @@ namespace Avogadro {
     }
 
     Molecule *molecule = atom->molecule();
-    if (!molecule || !_pattern)
+    if (!molecule)
       return;
 
     bool matched = false;
-    if (!_smartsString.isEmpty() && _pattern->IsValid()) { // finite, valid SMARTS, so let's go for it!
-      OBMol obmol = molecule->OBMol();
-      bool moleculeMatched = _pattern->Match(obmol);
-
-      if (moleculeMatched) {
-        std::vector<std::vector<int> > mlist = _pattern->GetUMapList();
-        std::vector<std::vector<int> >::iterator match;
-        for (match = mlist.begin(); match != mlist.end(); ++match) { // iterate through matches
-          for (unsigned idx = 0; idx < (*match).size(); ++idx) { // iterate through atoms in match
-            if (static_cast<int>(atom->index()) == ((*match)[idx] - 1)) { // TODO: OB uses index from 1
-              matched = true;
-              break;
-            }
-          } // atoms in match
-          if (matched)
-            break; // no need to check other matches
-        } // matches
-        
-      } // matched molecule
-    } // finite, valid SMARTS
+    if (_validPattern) { // finite, valid SMARTS, so let's go for it!
+      if (_matchesVersion != molecule->topologyVersion())
+        updateMatches(molecule);
+      int index = static_cast<int>(atom->index());
+      matched = index < _matches.size() && _matches.testBit(index);
+    }
 
     // OK, now highlight the SMARTS match
     if (matched)
@@ -172,6 +154,31 @@ namespace Avogadro {
     m_channels[3] = 1.0;
   }
 
+  void SmartsColor::updateMatches(const Molecule *molecule)
+  {
+    _matchesVersion = molecule->topologyVersion();
+    if (SmartsMatcher::cachedMatch(molecule, _smartsString, &_matches))
+      return;
+
+    if (molecule->numAtoms() < SmartsMatcher::BackgroundAtomCount) {
+      _matches = SmartsMatcher::match(molecule, _smartsString);
+      return;
+    }
+
+    // Only one match runs at a time, the cache is checked again when it is
+    // done in case the pattern or molecule changed in the meantime
+    _matches.clear();
+    if (!_watcher.isRunning())
+      _watcher.setFuture(SmartsMatcher::matchInBackground(molecule,
+                                                          _smartsString));
+  }
+
+  void SmartsColor::matchingFinished()
+  {
+    _matchesVersion = 0;
+    emit changed();
+  }
+
 }
 
 Q_EXPORT_PLUGIN2(smartscolor, Avogadro::SmartsColorFactory)
@@ -30,14 +30,13 @@
 #include <avogadro/color.h>
 
 #include <QString>
-
-// forward declaration
-namespace OpenBabel {
-  class OBSmartsPattern;
-}
+#include <QBitArray>
+#include <QFutureWatcher>
 
 namespace Avogadro {
 
+  class Molecule;
+
   /**
    * @class Smartscolor 
    * @brief Color by highlighting a SMARTS pattern match
@@ -66,12 +65,23 @@ namespace Avogadro {
       void settingsWidgetDestroyed();
       void smartsChanged(QString);
       void colorChanged(QColor);
+      void matchingFinished();
 
   private:
-    OpenBabel::OBSmartsPattern *_pattern;
+    /**
+     * Bring _matches up to date with the topology of @p molecule. Large
+     * molecules are matched in the background and nothing is highlighted
+     * until the matching has finished.
+     */
+    void updateMatches(const Molecule *molecule);
+
     QString                     _smartsString;
+    bool                        _validPattern;
     QColor                      _highlightColor;
     QWidget                    *_settingsWidget;
+    QBitArray                   _matches;
+    unsigned int                _matchesVersion;
+    QFutureWatcher<QBitArray>   _watcher;
   };
 
   class SmartsColorFactory : public QObject, public PluginFactory
@@ -0,0 +1,161 @@
+/**********************************************************************
+  CoordinateRecord - compact undo record for geometry edits
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include "coordinaterecord.h"
+#include "molecule.h"
+
+#include <algorithm>
+
+using std::vector;
+using Eigen::Vector3d;
+
+namespace Avogadro {
+
+  class CoordinateRecordPrivate
+  {
+  public:
+    CoordinateRecordPrivate() : stored(false), sparse(false), current(0) {}
+
+    bool stored;
+    // True when only the atoms in ids are stored, false for every atom
+    bool sparse;
+    vector<unsigned long> ids;
+    // Positions for each conformer, indexed by atom id or by ids when sparse
+    vector< vector<Vector3d> > conformers;
+    unsigned int current;
+    vector<double> energies;
+  };
+
+  CoordinateRecord::CoordinateRecord() : d(new CoordinateRecordPrivate)
+  {
+  }
+
+  CoordinateRecord::~CoordinateRecord()
+  {
+    delete d;
+  }
+
+  void CoordinateRecord::store(const Molecule *molecule)
+  {
+    const vector<vector<Vector3d> *> &conformers = molecule->conformers();
+    d->conformers.resize(conformers.size());
+    for (unsigned int i = 0; i < conformers.size(); ++i)
+      d->conformers[i] = *conformers[i];
+    d->ids.clear();
+    d->current = molecule->currentConformer();
+    d->energies = molecule->energies();
+    d->sparse = false;
+    d->stored = true;
+  }
+
+  void CoordinateRecord::swap(Molecule *molecule)
+  {
+    if (!d->stored)
+      return;
+
+    const vector<vector<Vector3d> *> &conformers = molecule->conformers();
+    vector<double> energies = molecule->energies();
+    molecule->setEnergies(d->energies);
+
+    if (d->sparse) {
+      for (unsigned int c = 0; c < d->conformers.size()
+           && c < conformers.size(); ++c) {
+        vector<Vector3d> &positions = *conformers[c];
+        vector<Vector3d> &stored = d->conformers[c];
+        for (unsigned int k = 0; k < d->ids.size(); ++k)
+          if (d->ids[k] < positions.size())
+            std::swap(positions[d->ids[k]], stored[k]);
+      }
+      d->energies = energies;
+      molecule->positionsChanged();
+      return;
+    }
+
+    bool sameLayout = conformers.size() == d->conformers.size()
+        && molecule->currentConformer() == d->current;
+    for (unsigned int c = 0; sameLayout && c < conformers.size(); ++c)
+      sameLayout = conformers[c]->size() == d->conformers[c].size();
+
+    if (sameLayout) {
+      // Keep only the atoms that moved in any of the conformers
+      unsigned long numIds = conformers.size() ? conformers[0]->size() : 0;
+      vector<unsigned long> moved;
+      for (unsigned long id = 0; id < numIds; ++id) {
+        for (unsigned int c = 0; c < conformers.size(); ++c) {
+          if ((*conformers[c])[id] != d->conformers[c][id]) {
+            moved.push_back(id);
+            break;
+          }
+        }
+      }
+
+      vector< vector<Vector3d> > sparse(conformers.size());
+      for (unsigned int c = 0; c < conformers.size(); ++c) {
+        vector<Vector3d> &positions = *conformers[c];
+        sparse[c].reserve(moved.size());
+        for (unsigned int k = 0; k < moved.size(); ++k) {
+          sparse[c].push_back(positions[moved[k]]);
+          positions[moved[k]] = d->conformers[c][moved[k]];
+        }
+      }
+      d->conformers.swap(sparse);
+      d->ids.swap(moved);
+      d->sparse = true;
+      d->energies = energies;
+      molecule->positionsChanged();
+    }
+    else if (conformers.size()) {
+      // The conformers themselves changed, e.g. in a conformer search
+      unsigned long size = molecule->conformerSize();
+      vector<vector<Vector3d> *> restored(d->conformers.size());
+      for (unsigned int c = 0; c < d->conformers.size(); ++c) {
+        restored[c] = new vector<Vector3d>;
+        restored[c]->swap(d->conformers[c]);
+        restored[c]->resize(size, Vector3d::Zero());
+      }
+      unsigned int current = d->current;
+
+      store(molecule);
+      d->energies = energies;
+      molecule->setAllConformers(restored);
+      molecule->setConformer(current);
+    }
+  }
+
+  bool CoordinateRecord::isEmpty() const
+  {
+    return !d->stored;
+  }
+
+  unsigned long CoordinateRecord::memoryUsage() const
+  {
+    unsigned long bytes = sizeof(CoordinateRecordPrivate)
+        + d->ids.capacity() * sizeof(unsigned long)
+        + d->energies.capacity() * sizeof(double);
+    for (unsigned int c = 0; c < d->conformers.size(); ++c)
+      bytes += d->conformers[c].capacity() * sizeof(Vector3d);
+    return bytes;
+  }
+
+} // End namespace Avogadro
@@ -0,0 +1,84 @@
+/**********************************************************************
+  CoordinateRecord - compact undo record for geometry edits
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#ifndef COORDINATERECORD_H
+#define COORDINATERECORD_H
+
+#include <avogadro/global.h>
+
+namespace Avogadro {
+
+  class Molecule;
+
+  /**
+   * @class CoordinateRecord coordinaterecord.h <avogadro/coordinaterecord.h>
+   * @brief Stores the coordinates of a Molecule for undoing geometry edits.
+   *
+   * Undo commands that only move atoms (manipulation, optimization, conformer
+   * searches) use a CoordinateRecord instead of a copy of the whole Molecule.
+   * store() takes the atom positions of every conformer, and swap() exchanges
+   * them with those of the molecule, so calling swap() again redoes the edit.
+   *
+   * On the first swap only the atoms that actually moved are kept, so the
+   * record of a small edit to a large molecule shrinks to a few positions.
+   * The atoms and bonds of the molecule must be the same when swapping as
+   * when storing, which is always the case on an undo stack.
+   */
+  class CoordinateRecordPrivate;
+  class A_EXPORT CoordinateRecord
+  {
+  public:
+    CoordinateRecord();
+    ~CoordinateRecord();
+
+    /**
+     * Store the coordinates of all the conformers of @p molecule, replacing
+     * anything stored before.
+     */
+    void store(const Molecule *molecule);
+
+    /**
+     * Exchange the stored coordinates with those of @p molecule. Call
+     * Molecule::updateMolecule() afterwards to redraw the molecule.
+     */
+    void swap(Molecule *molecule);
+
+    /**
+     * @return True if nothing has been stored.
+     */
+    bool isEmpty() const;
+
+    /**
+     * @return The approximate number of bytes used by the record.
+     */
+    unsigned long memoryUsage() const;
+
+  private:
+    CoordinateRecordPrivate * const d;
+    Q_DISABLE_COPY(CoordinateRecord)
+  };
+
+} // End namespace Avogadro
+
+#endif // COORDINATERECORD_H
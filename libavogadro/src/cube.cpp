@@ -145,6 +145,11 @@ namespace Avogadro {
     return &m_data;
   }
 
+  const std::vector<double> * Cube::data() const
+  {
+    return &m_data;
+  }
+
   bool Cube::setData(const std::vector<double> &values)
   {
     if (!values.size()) {
@@ -135,6 +135,11 @@ namespace Avogadro {
      */
     std::vector<double> * data();
 
+    /**
+     * @return Vector containing all the data in a one-dimensional array.
+     */
+    const std::vector<double> * data() const;
+
     /**
      * Set the values in the cube to those passed in the vector.
      */
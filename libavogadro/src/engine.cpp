@@ -31,6 +31,8 @@
 #include <avogadro/bond.h>
 #include <avogadro/residue.h>
 #include <avogadro/color.h>
+#include <avogadro/changeset.h>
+#include <avogadro/primitiveculler.h>
 
 #include <QDebug>
 
@@ -222,6 +224,48 @@ namespace Avogadro {
     emit changed();
   }
 
+  void Engine::moleculeChanged(const ChangeSet &changes)
+  {
+    if (!m_customPrims || !m_molecule)
+      return;
+
+    bool atomsChanged = changes.contains(Primitive::AtomType, ChangeSet::Added)
+      || changes.contains(Primitive::AtomType, ChangeSet::Removed);
+    bool bondsChanged = changes.contains(Primitive::BondType, ChangeSet::Added)
+      || changes.contains(Primitive::BondType, ChangeSet::Removed);
+    if (!atomsChanged && !bondsChanged)
+      return;
+
+    // Keep the primitives still in the molecule, then append the new ones.
+    // Primitives added inside a change set were never signalled one by one,
+    // so they cannot already be in the lists.
+    if (atomsChanged) {
+      QList<Atom *> atoms;
+      foreach (Atom *a, m_atoms)
+        if (m_molecule->atomById(a->id()) == a)
+          atoms.append(a);
+      foreach (unsigned long id, changes.ids(Primitive::AtomType, ChangeSet::Added)) {
+        Atom *a = m_molecule->atomById(id);
+        if (a)
+          atoms.append(a);
+      }
+      m_atoms = atoms;
+    }
+    if (bondsChanged) {
+      QList<Bond *> bonds;
+      foreach (Bond *b, m_bonds)
+        if (m_molecule->bondById(b->id()) == b)
+          bonds.append(b);
+      foreach (unsigned long id, changes.ids(Primitive::BondType, ChangeSet::Added)) {
+        Bond *b = m_molecule->bondById(id);
+        if (b)
+          bonds.append(b);
+      }
+      m_bonds = bonds;
+    }
+    emit changed();
+  }
+
   void Engine::setColorMap(Color *map)
   {
     m_colorMap->disconnect(this);
@@ -353,6 +397,8 @@ namespace Avogadro {
             this, SLOT(addBond(Bond*)));
     connect(m_molecule, SIGNAL(bondRemoved(Bond*)),
             this, SLOT(removeBond(Bond*)));
+    connect(m_molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+            this, SLOT(moleculeChanged(Avogadro::ChangeSet)));
   }
 
   const PrimitiveList Engine::primitives() const
@@ -362,17 +408,29 @@ namespace Avogadro {
 
   const QList<Atom *> Engine::atoms() const
   {
+    const PrimitiveCuller *culler = m_pd ? m_pd->culler() : 0;
     if (m_customPrims)
-      return m_atoms;
+      return culler ? culler->visibleAtoms(m_atoms) : m_atoms;
     else
-      return m_molecule->atoms();
+      return culler ? culler->visibleAtoms() : m_molecule->atoms();
   }
 
   const QList<Bond *> Engine::bonds() const
   {
+    const PrimitiveCuller *culler = m_pd ? m_pd->culler() : 0;
     if (m_customPrims)
-      return m_bonds;
+      return culler ? culler->visibleBonds(m_bonds) : m_bonds;
     else
-      return m_molecule->bonds();
+      return culler ? culler->visibleBonds() : m_molecule->bonds();
+  }
+
+  const QList<Atom *> Engine::allAtoms() const
+  {
+    return m_customPrims ? m_atoms : m_molecule->atoms();
+  }
+
+  const QList<Bond *> Engine::allBonds() const
+  {
+    return m_customPrims ? m_bonds : m_molecule->bonds();
   }
 }
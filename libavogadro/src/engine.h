@@ -67,6 +67,7 @@ namespace Avogadro {
   class Bond;
   class Molecule;
   class Color;
+  class ChangeSet;
 
   /**
    * @class Engine engine.h <avogadro/engine.h>
@@ -318,16 +319,32 @@ namespace Avogadro {
 
       /**
        * @return the engine's Atom list containing all atoms the engine
-       * can render.
+       * can render. While the painter device culls the primitives, only
+       * those in view are returned.
        */
       virtual const QList<Atom *> atoms() const;
 
       /**
        * @return the engine's Bond list containing all bonds the engine
-       * can render.
+       * can render. While the painter device culls the primitives, only
+       * those in view are returned.
        */
       virtual const QList<Bond *> bonds() const;
 
+      /**
+       * @return All the atoms the engine can render, whether they are in view
+       * or not. Engines that cache data derived from their atoms between
+       * renders must build it from this list, not atoms().
+       */
+      const QList<Atom *> allAtoms() const;
+
+      /**
+       * @return All the bonds the engine can render, whether they are in view
+       * or not. Engines that cache data derived from their bonds between
+       * renders must build it from this list, not bonds().
+       */
+      const QList<Bond *> allBonds() const;
+
       /**
        * Set the primitives that the engine instance can render.
        * @param primitives the PrimitiveList the engine can render from.
@@ -467,6 +484,13 @@ namespace Avogadro {
        */
       virtual void removeBond(Bond *bond);
 
+      /**
+       * Update the engines atom and bond lists for all of the changes
+       * committed to the molecule at once.
+       * @param changes the primitives added and removed.
+       */
+      virtual void moleculeChanged(const Avogadro::ChangeSet &changes);
+
       /** Set the color map to be used for this engine.
        * The default is to color each atom by element.
        * @param map is the new colors to be used
@@ -28,12 +28,14 @@
 #include <avogadro/painter.h>
 #include <avogadro/painterdevice.h>
 #include <avogadro/color.h>
+#include <avogadro/color3f.h>
 
 #include <avogadro/atom.h>
 #include <avogadro/bond.h>
 #include <avogadro/molecule.h>
 
 #include <QGLWidget> // for OpenGL bits
+#include <QColor>
 #include <QDebug>
 
 #include <openbabel/mol.h>
@@ -128,6 +130,20 @@ namespace Avogadro
     }
   }
 
+  // The color of an atom from the colors of a color map, see
+  // Color::atomColors(), or its custom color if set
+  static Color3f atomColor(const QVector<float> &rgba, const Atom *a)
+  {
+    if (!a->customColorName().isEmpty()) {
+      QColor color(a->customColorName());
+      return Color3f(static_cast<float>(color.redF()),
+                     static_cast<float>(color.greenF()),
+                     static_cast<float>(color.blueF()));
+    }
+    const float *color = rgba.constData() + 4 * a->index();
+    return Color3f(color[0], color[1], color[2]);
+  }
+
   bool BSDYEngine::renderOpaque( PainterDevice *pd )
   {
 //    glPushAttrib( GL_TRANSFORM_BIT );
@@ -139,6 +155,12 @@ namespace Avogadro
     Color *map = colorMap(); // possible custom color map
     if (!map) map = pd->colorMap(); // fall back to global color map
 
+    // Single bonds and atoms are collected and drawn in one call each
+    QVector<Vector3d> ends1, ends2, centers;
+    QVector<double> bondRadii, radii;
+    QVector<Color3f> bondColors, colors;
+    const QVector<float> &rgba = map->atomColors(pd->molecule());
+
     // Render the bonds
     foreach(const Bond *b, bonds()) {
       Atom* atom1 = pd->molecule()->atomById(b->beginAtomId());
@@ -159,6 +181,18 @@ namespace Avogadro
       int order = 1;
       if (m_showMulti) order = b->order();
 
+      if (order == 1) {
+        ends1.append(v1);
+        ends2.append(v3);
+        bondRadii.append(m_bondRadius);
+        bondColors.append(atomColor(rgba, atom1));
+        ends1.append(v3);
+        ends2.append(v2);
+        bondRadii.append(m_bondRadius);
+        bondColors.append(atomColor(rgba, atom2));
+        continue;
+      }
+
       map->setFromPrimitive(atom1);
       if (atom1->customColorName().isEmpty())
         pd->painter()->setColor( map );
@@ -173,19 +207,18 @@ namespace Avogadro
         pd->painter()->setColor(atom2->customColorName());
       pd->painter()->drawMultiCylinder( v3, v2, m_bondRadius, order, shift );
     }
+    pd->painter()->drawCylinders(ends1, ends2, bondRadii, bondColors);
 
     glDisable( GL_NORMALIZE );
     glEnable( GL_RESCALE_NORMAL );
 
     // Render the atoms
     foreach(const Atom *a, atoms()) {
-      map->setFromPrimitive(a);
-      if (a->customColorName().isEmpty())
-        pd->painter()->setColor( map );
-      else
-        pd->painter()->setColor(a->customColorName());
-      pd->painter()->drawSphere(a->pos(), radius(a));
+      centers.append(*a->pos());
+      radii.append(radius(a));
+      colors.append(atomColor(rgba, a));
     }
+    pd->painter()->drawSpheres(centers, radii, colors);
 
     // normalize normal vectors of bonds
     glDisable( GL_RESCALE_NORMAL );
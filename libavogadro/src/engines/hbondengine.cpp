@@ -31,7 +31,6 @@
 #include <avogadro/color.h>
 #include <avogadro/glwidget.h>
 #include <avogadro/painterdevice.h>
-#include <avogadro/neighborlist.h>
 
 #include <openbabel/mol.h>
 #include <openbabel/obiter.h>
@@ -47,7 +46,9 @@ using namespace Eigen;
 namespace Avogadro {
 
   HBondEngine::HBondEngine(QObject *parent) : Engine(parent), m_settingsWidget(0),
-                                              m_width(2), m_radius(2.0), m_angle(120)
+                                              m_width(2), m_radius(2.0), m_angle(120),
+                                              m_topologyDirty(true),
+                                              m_positionsDirty(true)
   {
   }
 
@@ -67,73 +68,264 @@ namespace Avogadro {
   {
   }
 
-  unsigned long createUniqueHbondId(Atom *donorH, Atom *acceptor)
-  {
-    return acceptor->index() * static_cast<Molecule*>(acceptor->parent())->numAtoms() + donorH->index();
-  }
-
   bool HBondEngine::renderOpaque(PainterDevice *pd)
   {
     Molecule *molecule = const_cast<Molecule *>(pd->molecule());
     if (!molecule->numAtoms())
       return false;
 
+    updateHBonds(molecule);
+
     pd->painter()->setColor(1.0, 1.0, 0.3);
     int stipple = 0xF0F0; // pattern for lines
 
-    QList<unsigned long> rendered;
+    // Only the cached hydrogen bonds are drawn, camera changes cost nothing
+    QSet<QPair<unsigned long, unsigned long> >::const_iterator it;
+    for (it = m_hbonds.constBegin(); it != m_hbonds.constEnd(); ++it) {
+      const Eigen::Vector3d *hydrogen = molecule->atomPos(it->first);
+      const Eigen::Vector3d *acceptor = molecule->atomPos(it->second);
+      if (hydrogen && acceptor)
+        pd->painter()->drawMultiLine(*hydrogen, *acceptor, m_width, 1, stipple);
+    }
+
+    return true;
+  }
+
+  void HBondEngine::updateHBonds(Molecule *molecule)
+  {
+    if (m_hbondMolecule != molecule) {
+      if (m_hbondMolecule)
+        disconnect(m_hbondMolecule, 0, this, 0);
+      m_hbondMolecule = molecule;
+      connect(molecule, SIGNAL(moleculeChanged()),
+              this, SLOT(invalidateTopology()));
+      connect(molecule, SIGNAL(atomAdded(Atom*)),
+              this, SLOT(invalidateTopology()));
+      connect(molecule, SIGNAL(atomRemoved(Atom*)),
+              this, SLOT(invalidateTopology()));
+      connect(molecule, SIGNAL(bondAdded(Bond*)),
+              this, SLOT(invalidateTopology()));
+      connect(molecule, SIGNAL(bondRemoved(Bond*)),
+              this, SLOT(invalidateTopology()));
+      connect(molecule, SIGNAL(bondUpdated(Bond*)),
+              this, SLOT(invalidateTopology()));
+      connect(molecule, SIGNAL(atomUpdated(Atom*)),
+              this, SLOT(atomUpdated(Atom*)));
+      connect(molecule, SIGNAL(updated()),
+              this, SLOT(invalidatePositions()));
+      m_topologyDirty = true;
+    }
+
+    if (m_topologyDirty) {
+      rebuildCandidates(molecule);
+      return;
+    }
+    if (!m_positionsDirty)
+      return;
+    m_positionsDirty = false;
+
+    // Find the candidates that moved since they were put in the cell list
+    QList<unsigned long> moved;
+    QHash<unsigned long, Candidate>::iterator i;
+    for (i = m_candidates.begin(); i != m_candidates.end(); ++i) {
+      const Eigen::Vector3d *pos = molecule->atomPos(i.key());
+      const Eigen::Vector3d *donorPos = i->donorH ? molecule->atomPos(i->donor) : 0;
+      if (!pos || (i->donorH && !donorPos)) {
+        rebuildCandidates(molecule);
+        return;
+      }
+      if (*pos == i->pos && (!donorPos || *donorPos == i->donorPos))
+        continue;
+
+      qint64 cell = cellKey(*pos);
+      if (cell != i->cell) {
+        m_cells[i->cell].removeOne(i.key());
+        m_cells[cell].append(i.key());
+        i->cell = cell;
+      }
+      i->pos = *pos;
+      if (donorPos)
+        i->donorPos = *donorPos;
+      moved.append(i.key());
+    }
+    if (moved.isEmpty())
+      return;
+
+    // When most atoms moved (e.g. a new animation frame) start from scratch
+    if (moved.size() > m_candidates.size() / 4) {
+      rebuildCandidates(molecule);
+      return;
+    }
 
-    NeighborList *nbrList = new NeighborList(molecule, m_radius);
-    //for (unsigned int i = 0; i < molecule->numAtoms(); ++i) {
-    foreach(Atom *atom, atoms()) {
-      bool atomIsH = atom->isHydrogen() ? true : false;
+    QSet<unsigned long> movedSet = moved.toSet();
+    QSet<QPair<unsigned long, unsigned long> >::iterator it = m_hbonds.begin();
+    while (it != m_hbonds.end()) {
+      if (movedSet.contains(it->first) || movedSet.contains(it->second))
+        it = m_hbonds.erase(it);
+      else
+        ++it;
+    }
+    foreach (unsigned long id, moved)
+      findHBonds(id);
+  }
 
-      if (!atomIsH && !isHbondAcceptor(atom))
+  void HBondEngine::rebuildCandidates(Molecule *molecule)
+  {
+    m_candidates.clear();
+    m_cells.clear();
+    m_donorElements.clear();
+    m_hbonds.clear();
+    m_topologyDirty = false;
+    m_positionsDirty = false;
+    if (m_radius <= 0.0)
+      return;
+
+    const vector<int> &elements = molecule->atomicNumbers();
+    const vector<unsigned int> &offsets = molecule->adjacencyOffsets();
+    const vector<unsigned long> &neighbors = molecule->adjacentAtoms();
+
+    // Off screen atoms are cached too, the cache outlives the camera
+    foreach (Atom *atom, allAtoms()) {
+      unsigned long id = atom->id();
+      Candidate candidate;
+      candidate.element = elements[id];
+      candidate.donorH = elements[id] == 1;
+      candidate.donor = FALSE_ID;
+      if (candidate.donorH) {
+        if (!isHbondDonorH(molecule, id))
           continue;
+        // Atoms in 1-2 and 1-3 positions are not considered
+        for (unsigned int i = offsets[id]; i < offsets[id + 1]; ++i) {
+          unsigned long nbr = neighbors[i];
+          candidate.donor = nbr;
+          candidate.excluded.append(nbr);
+          m_donorElements.insert(nbr, elements[nbr]);
+          for (unsigned int j = offsets[nbr]; j < offsets[nbr + 1]; ++j)
+            if (neighbors[j] != id)
+              candidate.excluded.append(neighbors[j]);
+        }
+        candidate.donorPos = *molecule->atomPos(candidate.donor);
+      }
+      else if (!isHbondAcceptor(molecule, id))
+        continue;
 
-      // get ALL possible pairs for atom (uniqueOnly = false)
-      QList<Atom*> nbrs = nbrList->nbrs(atom, false);
-      foreach(Atom *nbr, nbrs) {
-        double angle = 180.0;
-        Atom *hydrogen, *acceptor, *donor = 0;
+      candidate.pos = *atom->pos();
+      candidate.cell = cellKey(candidate.pos);
+      m_candidates.insert(id, candidate);
+      m_cells[candidate.cell].append(id);
+    }
 
-        if (atomIsH) {
-          if (!isHbondDonorH(atom) || !isHbondAcceptor(nbr))
-            continue;
+    // Every hydrogen bond has exactly one donor hydrogen
+    QHash<unsigned long, Candidate>::const_iterator i;
+    for (i = m_candidates.constBegin(); i != m_candidates.constEnd(); ++i)
+      if (i->donorH)
+        findHBonds(i.key());
+  }
 
-          hydrogen = atom;
-          acceptor = nbr;
-          foreach (unsigned long id, atom->neighbors())
-            donor = static_cast<Molecule*>(atom->parent())->atomById(id);
-        } else {
-           if (!isHbondDonorH(nbr) || !isHbondAcceptor(atom))
+  void HBondEngine::findHBonds(unsigned long id)
+  {
+    const Candidate &candidate = *m_candidates.constFind(id);
+    const Eigen::Vector3d &pos = candidate.pos;
+    const double radius2 = m_radius * m_radius;
+    const int ci = static_cast<int>(floor(pos.x() / m_radius));
+    const int cj = static_cast<int>(floor(pos.y() / m_radius));
+    const int ck = static_cast<int>(floor(pos.z() / m_radius));
+
+    // The cell edge is the cut-off radius, so only adjacent cells are searched
+    for (int i = ci - 1; i <= ci + 1; ++i)
+      for (int j = cj - 1; j <= cj + 1; ++j)
+        for (int k = ck - 1; k <= ck + 1; ++k) {
+          QHash<qint64, QList<unsigned long> >::const_iterator cell =
+            m_cells.constFind(cellKey(i, j, k));
+          if (cell == m_cells.constEnd())
             continue;
 
-          hydrogen = nbr;
-          acceptor = atom;
-          foreach (unsigned long id, nbr->neighbors())
-            donor = static_cast<Molecule*>(atom->parent())->atomById(id);
+          foreach (unsigned long nbrId, *cell) {
+            const Candidate &nbr = *m_candidates.constFind(nbrId);
+            if (nbr.donorH == candidate.donorH)
+              continue;
+            if ((nbr.pos - pos).squaredNorm() > radius2)
+              continue;
+
+            const Candidate &hydrogen = candidate.donorH ? candidate : nbr;
+            const Candidate &acceptor = candidate.donorH ? nbr : candidate;
+            unsigned long hydrogenId = candidate.donorH ? id : nbrId;
+            unsigned long acceptorId = candidate.donorH ? nbrId : id;
+            if (hydrogen.excluded.contains(acceptorId))
+              continue;
+
+            Eigen::Vector3d ab = hydrogen.donorPos - hydrogen.pos;
+            Eigen::Vector3d bc = acceptor.pos - hydrogen.pos;
+            double angle = 180. * acos( ab.dot(bc) / (ab.norm() * bc.norm()) ) / M_PI;
+            if (angle < m_angle)
+              continue;
+
+            m_hbonds.insert(qMakePair(hydrogenId, acceptorId));
+          }
         }
+  }
 
-        if (donor) {
-          Eigen::Vector3d ab = *donor->pos() - *hydrogen->pos();
-          Eigen::Vector3d bc = *acceptor->pos() - *hydrogen->pos();
-          angle = 180. * acos( ab.dot(bc) / (ab.norm() * bc.norm()) ) / M_PI;
-        }
+  qint64 HBondEngine::cellKey(const Eigen::Vector3d &pos) const
+  {
+    return cellKey(static_cast<int>(floor(pos.x() / m_radius)),
+                   static_cast<int>(floor(pos.y() / m_radius)),
+                   static_cast<int>(floor(pos.z() / m_radius)));
+  }
 
-        if (angle < m_angle)
-          continue;
+  qint64 HBondEngine::cellKey(int i, int j, int k) const
+  {
+    // 21 bits per dimension is plenty for any sensible cut-off radius
+    return (static_cast<qint64>(i & 0x1FFFFF) << 42)
+      | (static_cast<qint64>(j & 0x1FFFFF) << 21)
+      | static_cast<qint64>(k & 0x1FFFFF);
+  }
 
-        unsigned long HbondId = createUniqueHbondId(hydrogen, acceptor);
-        if (rendered.contains(HbondId))
-          continue;
-        rendered.append(HbondId);
+  void HBondEngine::setPrimitives(const PrimitiveList &primitives)
+  {
+    Engine::setPrimitives(primitives);
+    m_topologyDirty = true;
+  }
+
+  void HBondEngine::invalidateTopology()
+  {
+    m_topologyDirty = true;
+  }
 
-        pd->painter()->drawMultiLine(*atom->pos(), *nbr->pos(), m_width, 1, stipple);
-      } // for each nbr
-    } // for each atom
+  void HBondEngine::invalidatePositions()
+  {
+    m_positionsDirty = true;
+  }
 
-    return true;
+  void HBondEngine::atomUpdated(Atom *atom)
+  {
+    // A changed element can turn an atom into a donor or acceptor or back,
+    // and changing a donor atom can do the same to its hydrogens
+    QHash<unsigned long, Candidate>::const_iterator i =
+      m_candidates.constFind(atom->id());
+    if (i == m_candidates.constEnd()) {
+      switch (atom->atomicNumber()) {
+        case 1:
+        case 7:
+        case 8:
+        case 9:
+          m_topologyDirty = true;
+          return;
+        default:
+          break;
+      }
+    }
+    else if (i->element != atom->atomicNumber()) {
+      m_topologyDirty = true;
+      return;
+    }
+    QHash<unsigned long, int>::const_iterator donor =
+      m_donorElements.constFind(atom->id());
+    if (donor != m_donorElements.constEnd()
+        && *donor != atom->atomicNumber()) {
+      m_topologyDirty = true;
+      return;
+    }
+    m_positionsDirty = true;
   }
 
   double HBondEngine::radius(const PainterDevice *, const Primitive *) const
@@ -166,12 +358,14 @@ namespace Avogadro {
   void HBondEngine::setRadius(double value)
   {
     m_radius = value;
+    m_topologyDirty = true;
     emit changed();
   }
 
   void HBondEngine::setAngle(double value)
   {
     m_angle = value;
+    m_topologyDirty = true;
     emit changed();
   }
 
@@ -202,26 +396,29 @@ namespace Avogadro {
     }
   }
 
-  bool HBondEngine::isHbondAcceptor(Atom *atom)
+  bool HBondEngine::isHbondAcceptor(const Molecule *molecule,
+                                    unsigned long id) const
   {
-    if (atom->atomicNumber() == 8 || atom->atomicNumber() == 9)
+    int element = molecule->atomicNumbers()[id];
+    if (element == 8 || element == 9)
       return true;
-    if (atom->atomicNumber() == 7) {
+    if (element == 7) {
+      const vector<unsigned int> &offsets = molecule->adjacencyOffsets();
+      const vector<unsigned long> &bonds = molecule->adjacentBonds();
       int boSum = 0;
-      Molecule *mol = atom->molecule();
-      if (mol) {
-        foreach (unsigned long id, atom->bonds())
-          boSum += mol->bondById(id)->order();
-        if (boSum != 4)
-          return true;
-      }
+      for (unsigned int i = offsets[id]; i < offsets[id + 1]; ++i)
+        boSum += molecule->bondById(bonds[i])->order();
+      if (boSum != 4)
+        return true;
     }
     return false;
   }
 
-  bool HBondEngine::isHbondDonor(Atom *atom)
+  bool HBondEngine::isHbondDonor(const Molecule *molecule,
+                                 unsigned long id) const
   {
-    switch (atom->atomicNumber()) {
+    const vector<int> &elements = molecule->atomicNumbers();
+    switch (elements[id]) {
       case 7:
       case 8:
       case 9:
@@ -230,25 +427,26 @@ namespace Avogadro {
         return false;
     }
 
-    foreach (unsigned long id, atom->neighbors()) {
-      Atom *nbr = static_cast<Molecule*>(atom->parent())->atomById(id);
-      if (nbr->isHydrogen())
+    const vector<unsigned int> &offsets = molecule->adjacencyOffsets();
+    const vector<unsigned long> &neighbors = molecule->adjacentAtoms();
+    for (unsigned int i = offsets[id]; i < offsets[id + 1]; ++i)
+      if (elements[neighbors[i]] == 1)
         return true;
-    }
 
     return false;
   }
 
-  bool HBondEngine::isHbondDonorH(Atom *atom)
+  bool HBondEngine::isHbondDonorH(const Molecule *molecule,
+                                  unsigned long id) const
   {
-    if (!atom->isHydrogen())
+    if (molecule->atomicNumbers()[id] != 1)
       return false;
 
-    foreach (unsigned long id, atom->neighbors()) {
-      Atom *nbr = static_cast<Molecule*>(atom->parent())->atomById(id);
-      if (isHbondDonor(nbr))
+    const vector<unsigned int> &offsets = molecule->adjacencyOffsets();
+    const vector<unsigned long> &neighbors = molecule->adjacentAtoms();
+    for (unsigned int i = offsets[id]; i < offsets[id + 1]; ++i)
+      if (isHbondDonor(molecule, neighbors[i]))
         return true;
-    }
 
     return false;
   }
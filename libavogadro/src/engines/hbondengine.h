@@ -29,6 +29,12 @@
 #include <avogadro/global.h>
 #include <avogadro/engine.h>
 
+#include <Eigen/Core>
+
+#include <QHash>
+#include <QPair>
+#include <QPointer>
+#include <QSet>
 
 #include "ui_hbondsettingswidget.h"
 
@@ -72,20 +78,69 @@ namespace Avogadro {
        */
       void readSettings(QSettings &settings);
 
-
+      void setPrimitives(const PrimitiveList &primitives);
 
     private:
+      /**
+       * A donor hydrogen or acceptor atom which may take part in a hydrogen
+       * bond. The position is the one used to place it in the cell list.
+       */
+      struct Candidate
+      {
+        Eigen::Vector3d pos;
+        qint64 cell;
+        int element;
+        bool donorH;
+        // For donor hydrogens: the donor atom and its position (angle test)
+        unsigned long donor;
+        Eigen::Vector3d donorPos;
+        // Atoms in a 1-2 or 1-3 relationship, never hydrogen bonded
+        QList<unsigned long> excluded;
+      };
+
       HBondSettingsWidget *m_settingsWidget;
       int    m_width;
       double m_radius;
       double m_angle;
-  
-      bool isHbondAcceptor(Atom *atom);
-      bool isHbondDonor(Atom *atom);
-      bool isHbondDonorH(Atom *atom);
-    
+
+      QPointer<Molecule> m_hbondMolecule;
+      bool m_topologyDirty;
+      bool m_positionsDirty;
+      QHash<unsigned long, Candidate> m_candidates;
+      QHash<qint64, QList<unsigned long> > m_cells;
+      // Element of each donor atom bonded to a donor hydrogen
+      QHash<unsigned long, int> m_donorElements;
+      // (hydrogen id, acceptor id) of each hydrogen bond found
+      QSet<QPair<unsigned long, unsigned long> > m_hbonds;
+
+      // Read the elements and bonded neighbors from the molecule's arrays
+      bool isHbondAcceptor(const Molecule *molecule, unsigned long id) const;
+      bool isHbondDonor(const Molecule *molecule, unsigned long id) const;
+      bool isHbondDonorH(const Molecule *molecule, unsigned long id) const;
+
+      /**
+       * Make sure the cached hydrogen bonds are in sync with @p molecule,
+       * rebuilding or incrementally updating them only if needed.
+       */
+      void updateHBonds(Molecule *molecule);
+      void rebuildCandidates(Molecule *molecule);
+      void findHBonds(unsigned long id);
+      qint64 cellKey(const Eigen::Vector3d &pos) const;
+      qint64 cellKey(int i, int j, int k) const;
+
     private Q_SLOTS:
       void settingsWidgetDestroyed();
+
+      /**
+       * Atoms or bonds were added/removed: rebuild the candidate list.
+       */
+      void invalidateTopology();
+
+      /**
+       * The molecule was updated: atoms may have moved.
+       */
+      void invalidatePositions();
+      void atomUpdated(Atom *atom);
     
      /**
        * @param value width of the hydrogen bonds
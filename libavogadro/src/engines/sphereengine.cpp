@@ -30,6 +30,7 @@
 #include <avogadro/molecule.h>
 #include <avogadro/atom.h>
 #include <avogadro/color.h>
+#include <avogadro/color3f.h>
 #include <avogadro/glwidget.h>
 #include <avogadro/painterdevice.h>
 
@@ -72,8 +73,7 @@ namespace Avogadro {
       // Render the atoms as VdW spheres
       glDisable(GL_NORMALIZE);
       glEnable(GL_RESCALE_NORMAL);
-      foreach(Atom *a, atoms())
-        render(pd, a);
+      renderSpheres(pd);
       glDisable(GL_RESCALE_NORMAL);
       glEnable(GL_NORMALIZE);
     }
@@ -107,8 +107,7 @@ namespace Avogadro {
       glDisable(GL_NORMALIZE);
       glEnable(GL_RESCALE_NORMAL);
 
-      foreach(Atom *a, atoms())
-        render(pd, a);
+      renderSpheres(pd);
 
       glDisable(GL_RESCALE_NORMAL);
       glEnable(GL_NORMALIZE);
@@ -149,19 +148,23 @@ namespace Avogadro {
     return true;
   }
 
-  bool SphereEngine::render(PainterDevice *pd, const Atom *a)
+  void SphereEngine::renderSpheres(PainterDevice *pd)
   {
-    // Render the atoms as Van der Waals spheres
     Color *map = colorMap(); // possible custom color map
     if (!map) map = pd->colorMap(); // fall back to global color map
 
-    map->setFromPrimitive(a);
-    map->setAlpha(m_alpha);
-    pd->painter()->setColor(map);
-    pd->painter()->setName(a);
-    pd->painter()->drawSphere(a->pos(), radius(a));
-
-    return true;
+    // Pass all of the atoms to the painter at once
+    QVector<Vector3d> centers;
+    QVector<double> radii;
+    QVector<Color3f> colors;
+    const QVector<float> &rgba = map->atomColors(pd->molecule());
+    foreach(Atom *a, atoms()) {
+      const float *color = rgba.constData() + 4 * a->index();
+      centers.append(*a->pos());
+      radii.append(radius(a));
+      colors.append(Color3f(color[0], color[1], color[2]));
+    }
+    pd->painter()->drawSpheres(centers, radii, colors, m_alpha);
   }
 
   inline double SphereEngine::radius(const Atom *a) const
@@ -82,8 +82,8 @@ namespace Avogadro {
 
     private:
       double radius(const Atom *a) const;
-      //! Render an Atom.
-      bool render(PainterDevice *pd, const Atom *a);
+      //! Render all of the atoms with the current alpha.
+      void renderSpheres(PainterDevice *pd);
 
       SphereSettingsWidget *m_settingsWidget;
 
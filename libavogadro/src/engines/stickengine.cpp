@@ -30,6 +30,7 @@
 #include <avogadro/bond.h>
 #include <avogadro/molecule.h>
 #include <avogadro/color.h>
+#include <avogadro/color3f.h>
 #include <avogadro/glwidget.h>
 #include <avogadro/painterdevice.h>
 #include <avogadro/camera.h>
@@ -75,15 +76,48 @@ namespace Avogadro {
     glDisable( GL_NORMALIZE );
     glEnable( GL_RESCALE_NORMAL );
 
-    // Render the atoms
-    foreach(Atom *a, atoms())
-      renderOpaque(pd, a);
+    Color *map = colorMap(); // possible custom color map
+    if (!map) map = pd->colorMap(); // fall back to global color map
 
-    // render bonds (sticks)
+    // Render the atoms, passing them to the painter in one call
+    QVector<Vector3d> centers;
+    QVector<double> radii;
+    QVector<Color3f> colors;
+    const QVector<float> &rgba = map->atomColors(pd->molecule());
+    foreach(Atom *a, atoms()) {
+      const float *color = rgba.constData() + 4 * a->index();
+      centers.append(*a->pos());
+      radii.append(radius(a));
+      colors.append(Color3f(color[0], color[1], color[2]));
+    }
+    pd->painter()->drawSpheres(centers, radii, colors);
+
+    // render bonds (sticks), each half in the color of its atom
     glDisable( GL_RESCALE_NORMAL );
     glEnable( GL_NORMALIZE );
-    foreach(Bond *b, bonds())
-      renderOpaque(pd, b);
+    QVector<Vector3d> ends1, ends2;
+    radii.clear();
+    colors.clear();
+    foreach(Bond *b, bonds()) {
+      Atom* atom1 = pd->molecule()->atomById(b->beginAtomId());
+      Atom* atom2 = pd->molecule()->atomById(b->endAtomId());
+      Vector3d v1 (*atom1->pos());
+      Vector3d v2 (*atom2->pos());
+      Vector3d v3 (( v1 + v2 ) / 2);
+
+      const float *color1 = rgba.constData() + 4 * atom1->index();
+      ends1.append(v1);
+      ends2.append(v3);
+      radii.append(radius(atom1));
+      colors.append(Color3f(color1[0], color1[1], color1[2]));
+
+      const float *color2 = rgba.constData() + 4 * atom2->index();
+      ends1.append(v3);
+      ends2.append(v2);
+      radii.append(radius(atom1));
+      colors.append(Color3f(color2[0], color2[1], color2[2]));
+    }
+    pd->painter()->drawCylinders(ends1, ends2, radii, colors);
 
 //    glPopAttrib();
 
@@ -128,16 +162,11 @@ namespace Avogadro {
   
   bool StickEngine::renderPick(PainterDevice *pd)
   {
-    glDisable( GL_NORMALIZE );
-    glEnable( GL_RESCALE_NORMAL );
-
     // Render the atoms
     foreach(Atom *a, atoms())
       renderPick(pd, a);
 
     // render bonds (sticks)
-    glDisable( GL_RESCALE_NORMAL );
-    glEnable( GL_NORMALIZE );
     foreach(Bond *b, bonds())
       renderOpaque(pd, b);
 
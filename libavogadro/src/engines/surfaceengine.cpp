@@ -419,6 +419,14 @@ namespace Avogadro {
       updateOrbitalCombo();
   }
 
+  void SurfaceEngine::meshesChanged(const ChangeSet &changes)
+  {
+    if (changes.contains(Primitive::MeshType, ChangeSet::Added)
+        || changes.contains(Primitive::MeshType, ChangeSet::Updated)
+        || changes.contains(Primitive::MeshType, ChangeSet::Removed))
+      updateOrbitalCombo();
+  }
+
   void SurfaceEngine::setMolecule(const Molecule *molecule)
   {
     Engine::setMolecule(molecule);
@@ -429,6 +437,8 @@ namespace Avogadro {
             this, SLOT(updatePrimitive(Primitive*)));
       connect(m_molecule, SIGNAL(primitiveRemoved(Primitive*)),
             this, SLOT(removePrimitive(Primitive*)));
+      connect(m_molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+            this, SLOT(meshesChanged(Avogadro::ChangeSet)));
     }
 
     updateOrbitalCombo();
@@ -444,6 +454,8 @@ namespace Avogadro {
             this, SLOT(updatePrimitive(Primitive*)));
       connect(m_molecule, SIGNAL(primitiveRemoved(Primitive*)),
             this, SLOT(removePrimitive(Primitive*)));
+      connect(m_molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+            this, SLOT(meshesChanged(Avogadro::ChangeSet)));
     }
 
     updateOrbitalCombo();
@@ -103,6 +103,11 @@ namespace Avogadro {
        */
       void updateOrbitalCombo();
 
+      /**
+       * Update the orbital combo when meshes changed inside a change set
+       */
+      void meshesChanged(const Avogadro::ChangeSet &changes);
+
       void settingsWidgetDestroyed();
       /**
        * @param value orbital index
@@ -22,6 +22,7 @@
 #include "animationextension.h"
 #include "trajvideomaker.h"
 #include <avogadro/molecule.h>
+#include <avogadro/moleculefile.h>
 #include <avogadro/color.h>
 #include <avogadro/animation.h>
 #include <avogadro/glwidget.h>
@@ -42,7 +43,8 @@ using Eigen::Vector3d;
 namespace Avogadro {
 
   AnimationExtension::AnimationExtension(QObject *parent) : Extension(parent),
-    m_molecule(0), m_animationDialog(0), m_animation(0), m_widget(0)
+    m_molecule(0), m_animationDialog(0), m_animation(0), m_trajectory(0),
+    m_widget(0)
   {
     QAction *action = new QAction(this);
     action->setText(tr("Animation..."));
@@ -60,6 +62,11 @@ namespace Avogadro {
       m_animation = 0;
     }
 
+    if (m_trajectory) {
+      delete m_trajectory;
+      m_trajectory = 0;
+    }
+
     if (m_animationDialog) {
       m_animationDialog->deleteLater();
     }
@@ -122,9 +129,40 @@ namespace Avogadro {
     if (file.isEmpty())
       return;
 
-    if (file.endsWith(QLatin1String(".xyz")) || file.endsWith(QLatin1String("HISTORY")) ) {
+    if (m_trajectory) {
+      m_animation->setTrajectory(0);
+      delete m_trajectory;
+      m_trajectory = 0;
+    }
+
+    if (file.endsWith(QLatin1String("HISTORY")) ) {
       readTrajFromFile(file);
     }
+    else if (file.endsWith(QLatin1String(".xyz"), Qt::CaseInsensitive)
+             || file.endsWith(QLatin1String(".pdb"), Qt::CaseInsensitive)) {
+      // PDB files provide the topology from their first model
+      if (file.endsWith(QLatin1String(".pdb"), Qt::CaseInsensitive)) {
+        Molecule *mol = MoleculeFile::readMolecule(file);
+        if (!mol) {
+          QMessageBox::warning( NULL, tr( "Avogadro" ),
+                                tr( "Read trajectory file %1 failed." )
+                                .arg( file ) );
+          return;
+        }
+        OpenBabel::OBMol obmol = mol->OBMol();
+        m_molecule->setOBMol(&obmol);
+        delete mol;
+      }
+      m_molecule->clearConformers();
+
+      // Only the frame offsets are read up front, the frames are decoded as
+      // they are played and become available as the file is indexed
+      m_trajectory = MoleculeFile::readTrajectory(file);
+      connect(m_trajectory, SIGNAL(firstMolReady()), this, SLOT(trajectoryReady()));
+      connect(m_trajectory, SIGNAL(framesIndexed(int)),
+              m_animationDialog, SLOT(setFrameCount(int)));
+      m_animation->setTrajectory(m_trajectory);
+    }
     else { //non xyz
 
       OBConversion conv;
@@ -153,6 +191,18 @@ namespace Avogadro {
     m_animation->setFps(m_animationDialog->fps());
   }
 
+  void AnimationExtension::trajectoryReady()
+  {
+    std::vector<Eigen::Vector3d> coords;
+    if (m_trajectory && m_trajectory->frame(0, coords)
+        && coords.size() != m_molecule->numAtoms()) {
+      QMessageBox::warning( NULL, tr( "Avogadro" ),
+        tr( "Trajectory file %1 disagrees on the number of atoms in the present molecule").arg(m_trajectory->fileName()));
+      return;
+    }
+    m_animationDialog->setFrame(1);
+  }
+
   void AnimationExtension::setLoop(int state)
   {
     if (state == Qt::Checked) {
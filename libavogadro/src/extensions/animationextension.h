@@ -32,6 +32,7 @@
 namespace Avogadro {
 
   class Animation;
+  class MoleculeFile;
 
   class AnimationExtension : public Extension
   {
@@ -58,6 +59,7 @@ namespace Avogadro {
       Molecule *m_molecule;
       AnimationDialog *m_animationDialog;
       Animation *m_animation;
+      MoleculeFile *m_trajectory;
 
       //only needed for rendering a video
       GLWidget* m_widget;
@@ -67,6 +69,7 @@ namespace Avogadro {
       void setLoop(int state);
       void setDynamicBonds(int state);
       void saveVideo(QString videoFileName);
+      void trajectoryReady();
 
   private:
       //!support to read a trajectory from xyz as described here:
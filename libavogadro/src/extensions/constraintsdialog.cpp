@@ -196,6 +196,8 @@ namespace Avogadro {
   {
     m_molecule = molecule;
     connect(m_molecule, SIGNAL( primitiveRemoved(Primitive *) ), m_constraints, SLOT( primitiveRemoved(Primitive *) ));
+    connect(m_molecule, SIGNAL( moleculeChanged(Avogadro::ChangeSet) ),
+            m_constraints, SLOT( primitivesRemoved(Avogadro::ChangeSet) ));
   }
   
   void ConstraintsDialog::comboTypeChanged(int index)
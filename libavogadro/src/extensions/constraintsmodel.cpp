@@ -24,6 +24,7 @@
 #include <avogadro/atom.h>
 #include <avogadro/color.h>
 #include <avogadro/glwidget.h>
+#include <avogadro/changeset.h>
 
 #include <openbabel/forcefield.h>
 
@@ -220,5 +221,13 @@ namespace Avogadro
       }
     }
   }
+
+  void ConstraintsModel::primitivesRemoved(const ChangeSet &changes)
+  {
+    // Only the ids of atoms removed in a change set are known, the atom
+    // indices the constraints refer to can not be matched any more
+    if (changes.contains(Primitive::AtomType, ChangeSet::Removed))
+      clear();
+  }
 } // end namespace Avogadro
 
@@ -45,6 +45,7 @@ namespace Avogadro {
      
      public slots:
        void primitiveRemoved(Primitive *primitive);
+       void primitivesRemoved(const Avogadro::ChangeSet &changes);
 
      public:
        ConstraintsModel(QObject *parent = 0) : QAbstractTableModel(parent) {}
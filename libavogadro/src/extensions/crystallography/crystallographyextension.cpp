@@ -32,6 +32,7 @@
 #include "avospglib.h"
 #include "crystalpastedialog.h"
 #include "ceundo.h"
+#include "fractionalgrid.h"
 #include "stablecomparison.h"
 #include "ui/ceabstracteditor.h"
 #include "ui/cecoordinateeditor.h"
@@ -1086,14 +1087,7 @@ namespace Avogadro
   {
     // Remove old atoms
     QWriteLocker locker (mol->lock());
-    QList<Avogadro::Atom*> atoms = mol->atoms();
-    for (QList<Avogadro::Atom*>::iterator
-           it = atoms.begin(),
-           it_end = atoms.end();
-         it != it_end;
-         ++it) {
-      mol->removeAtom(*it);
-    }
+    mol->removeAtoms(mol->atoms());
 
     // Add new atoms
     for (int i = 0; i < ids.size(); ++i) {
@@ -1178,23 +1172,22 @@ namespace Avogadro
     QList<QString> origIds = currentAtomicSymbols();
     QList<QString> newIds;
 
-    // Duplicate tolerance squared
-    const double dupTolSquared = m_spgTolerance*m_spgTolerance;
-
     // Non-fatal assert -- if the number of atoms has
     // changed, just tail-recurse and try again.
     if (origIds.size() != origFCoords.size()) {
       return fillUnitCell();
     }
 
+    // Grid hash of the coordinates accepted so far, so each transformed
+    // coordinate is only compared against its spatial neighbors. The size
+    // hint only affects the bin size, assume a handful of images per atom.
+    FractionalGrid acceptedGrid (m_spgTolerance, origFCoords.size() * 8);
+
     const QString *curId;
     const Eigen::Vector3d *curVec;
     std::list<OpenBabel::vector3> obxformed;
     std::list<OpenBabel::vector3>::const_iterator obxit;
     std::list<OpenBabel::vector3>::const_iterator obxit_end;
-    QList<Eigen::Vector3d> xformed;
-    QList<Eigen::Vector3d>::const_iterator xit, xit_end;
-    QList<Eigen::Vector3d>::const_iterator newit, newit_end;
     for (int i = 0; i < origIds.size(); ++i) {
       curId = &origIds[i];
       curVec = &origFCoords[i];
@@ -1207,51 +1200,22 @@ namespace Avogadro
       // Get tranformed OB vectors
       obxformed = sg->Transform(OpenBabel::vector3(x,y,z));
 
-      // Convert to Eigen, wrap to cell
-      xformed.clear();
+      // Convert to Eigen, wrap to cell, and add it unless an equivalent
+      // coordinate has already been added.
       Eigen::Vector3d tmp;
       obxit_end = obxformed.end();
       for (obxit = obxformed.begin();
            obxit != obxit_end; ++obxit) {
         tmp = OB2Eigen(*obxit);
-        // Pseudo-modulus
-        tmp.x() -= static_cast<int>(tmp.x());
-        tmp.y() -= static_cast<int>(tmp.y());
-        tmp.z() -= static_cast<int>(tmp.z());
-        // Correct negative values
-        if (tmp.x() < 0.0) ++tmp.x();
-        if (tmp.y() < 0.0) ++tmp.y();
-        if (tmp.z() < 0.0) ++tmp.z();
-        // Add a fudge factor for cell edges
-        if (tmp.x() >= 1.0 - 1e-6) tmp.x() = 0.0;
-        if (tmp.y() >= 1.0 - 1e-6) tmp.y() = 0.0;
-        if (tmp.z() >= 1.0 - 1e-6) tmp.z() = 0.0;
-        xformed.append(tmp);
-      }
+        FractionalGrid::wrap(tmp);
 
-      // Check all xformed vectors against the coords
-      // already added. if they match, skip this atom.
-      bool duplicate;
-      xit_end = xformed.constEnd();
-      for (xit = xformed.constBegin();
-           xit != xit_end; ++xit) {
-        newit_end = newFCoords.constEnd();
-        duplicate = false;
-        for (newit = newFCoords.constBegin();
-             newit != newit_end; ++newit) {
-          if (fabs((*newit - *xit).squaredNorm())
-              < dupTolSquared) {
-            duplicate = true;
-            break;
-          }
-        }
-
-        if (duplicate) {
+        if (acceptedGrid.contains(tmp)) {
           continue;
         }
 
         // Add transformed atom
-        newFCoords.append(*xit);
+        acceptedGrid.insert(tmp, newFCoords.size());
+        newFCoords.append(tmp);
         newIds.append(*curId);
       }
     }
@@ -1275,66 +1239,58 @@ namespace Avogadro
       currentFractionalCoords();
     QList<QString> Ids = currentAtomicSymbols();
 
-    // Duplicate tolerance squared
-    const double dupTolSquared = m_spgTolerance*m_spgTolerance;
-
     // Non-fatal assert -- if the number of atoms has
     // changed, just tail-recurse and try again.
     if (Ids.size() != FCoords.size()) {
       return reduceToAsymmetricUnit();
     }
 
-    const Eigen::Vector3d *curVec;
+    // Hash all coordinates once, equivalent atoms are then looked up in the
+    // neighborhood of each transformed coordinate.
+    FractionalGrid grid (m_spgTolerance, FCoords.size());
+    for (int i = 0; i < FCoords.size(); ++i) {
+      grid.insert(FCoords[i], i);
+    }
+    QVector<bool> removed (FCoords.size(), false);
+
     std::list<OpenBabel::vector3> obxformed;
     std::list<OpenBabel::vector3>::const_iterator obxit;
     std::list<OpenBabel::vector3>::const_iterator obxit_end;
-    QList<Eigen::Vector3d> xformed;
-    QList<Eigen::Vector3d>::const_iterator xit, xit_end;
 
-    // This loop modifies Ids and Fcoords, but only by removing
-    // atoms for j > i.
-    for (int i = 0; i < Ids.size(); ++i) {
+    for (int i = 0; i < FCoords.size(); ++i) {
+      if (removed[i]) {
+        continue;
+      }
+
       // Get tranformed OB vectors
-      curVec = &FCoords[i];
-      obxformed = sg->Transform(Eigen2OB(*curVec));
+      obxformed = sg->Transform(Eigen2OB(FCoords[i]));
 
-      // Convert to Eigen, wrap to cell
-      xformed.clear();
+      // Convert to Eigen, wrap to cell, and mark the remaining atoms that
+      // are equivalent to the current atom.
       Eigen::Vector3d tmp;
       obxit_end = obxformed.end();
       for (obxit = obxformed.begin();
            obxit != obxit_end; ++obxit) {
         tmp = OB2Eigen(*obxit);
-        // Pseudo-modulus
-        tmp.x() -= static_cast<int>(tmp.x());
-        tmp.y() -= static_cast<int>(tmp.y());
-        tmp.z() -= static_cast<int>(tmp.z());
-        // Correct negative values
-        if (tmp.x() < 0.0) ++tmp.x();
-        if (tmp.y() < 0.0) ++tmp.y();
-        if (tmp.z() < 0.0) ++tmp.z();
-        // Add a fudge factor for cell edges
-        if (tmp.x() >= 1.0 - 1e-6) tmp.x() = 0.0;
-        if (tmp.y() >= 1.0 - 1e-6) tmp.y() = 0.0;
-        if (tmp.z() >= 1.0 - 1e-6) tmp.z() = 0.0;
-        xformed.append(tmp);
-      }
-
-      // Check which of the remaining atoms are equivalent to the current
-      // atom and remove them.
-      xit_end = xformed.constEnd();
-      for (xit = xformed.constBegin();
-           xit != xit_end; ++xit) {
-        for (int j = i + 1; j < Ids.size(); j++) {
-          if ((FCoords[j] - *xit).squaredNorm() < dupTolSquared) {
-            FCoords.removeAt(j);
-            Ids.removeAt(j);
+        FractionalGrid::wrap(tmp);
+        foreach (int j, grid.duplicates(tmp)) {
+          if (j > i) {
+            removed[j] = true;
           }
         }
       }
     }
 
-    setCurrentFractionalCoords(Ids, FCoords);
+    QList<Eigen::Vector3d> newFCoords;
+    QList<QString> newIds;
+    for (int i = 0; i < FCoords.size(); ++i) {
+      if (!removed[i]) {
+        newFCoords.append(FCoords[i]);
+        newIds.append(Ids[i]);
+      }
+    }
+
+    setCurrentFractionalCoords(newIds, newFCoords);
   }
 
   void CrystallographyExtension::wrapAtomsToCell()
@@ -1346,18 +1302,7 @@ namespace Avogadro
            it = fcoords.begin(),
            it_end = fcoords.end();
          it != it_end; ++it) {
-      // Pseudo-modulus
-      it->x() -= static_cast<int>(it->x());
-      it->y() -= static_cast<int>(it->y());
-      it->z() -= static_cast<int>(it->z());
-      // Correct negative values
-      if (it->x() < 0) ++(it->x());
-      if (it->y() < 0) ++(it->y());
-      if (it->z() < 0) ++(it->z());
-      // Add a fudge factor for cell edges
-      if (it->x() >= 1.0 - 1e-6) it->x() = 0.0;
-      if (it->y() >= 1.0 - 1e-6) it->y() = 0.0;
-      if (it->z() >= 1.0 - 1e-6) it->z() = 0.0;
+      FractionalGrid::wrap(*it);
     }
     setCurrentFractionalCoords(currentAtomicSymbols(),
                                fcoords);
@@ -1465,7 +1410,7 @@ namespace Avogadro
     const Eigen::Vector3d u3 (cellMatrix.col(2));
     Eigen::Vector3d displacement;
 
-    m_molecule->blockSignals(true);
+    m_molecule->beginChangeSet();
     const QList<Atom*> orig = m_molecule->atoms();
     for (unsigned int a = 0; a < v1; ++a) {
       for (unsigned int b = 0; b < v2; ++b)  {
@@ -1488,8 +1433,7 @@ namespace Avogadro
         QCoreApplication::processEvents();
       }
     } // end of for loops
-    m_molecule->blockSignals(false);
-    m_molecule->updateMolecule();
+    m_molecule->commitChangeSet();
 
     // Update the length of the unit cell
     cellMatrix.col(0) = Eigen::Vector3d(v1 * u1);
@@ -1502,10 +1446,9 @@ namespace Avogadro
 
   void CrystallographyExtension::rebuildBonds()
   {
-    m_molecule->blockSignals(true);
+    m_molecule->beginChangeSet();
     // Remove any bonds
-    foreach(Bond *b, m_molecule->bonds())
-      m_molecule->removeBond(b);
+    m_molecule->removeBonds(m_molecule->bonds());
 
     // Migrated from supercellextension
     // Add single bonds between all atoms closer than their combined atomic
@@ -1539,8 +1482,7 @@ namespace Avogadro
       }
     }
 
-    m_molecule->blockSignals(false);
-    m_molecule->updateMolecule();
+    m_molecule->commitChangeSet();
   }
 
   void CrystallographyExtension::orientStandard()
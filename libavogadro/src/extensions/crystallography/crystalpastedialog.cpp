@@ -437,14 +437,7 @@ namespace Avogadro {
     }
 
     // Remove old atoms
-    QList<Avogadro::Atom*> oldAtoms = m_molecule->atoms();
-    for (QList<Avogadro::Atom*>::iterator
-           it = oldAtoms.begin(),
-           it_end = oldAtoms.end();
-         it != it_end;
-         ++it) {
-      m_molecule->removeAtom(*it);
-    }
+    m_molecule->removeAtoms(m_molecule->atoms());
 
     // Add new atoms
     for (int i = 0; i < positions.size(); ++i) {
@@ -0,0 +1,171 @@
+/**********************************************************************
+  FractionalGrid - Spatial hash of fractional coordinates for fast
+                   duplicate detection in periodic cells
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ ***********************************************************************/
+
+#ifndef CE_FRACTIONALGRID_H
+#define CE_FRACTIONALGRID_H
+
+#include <Eigen/Core>
+
+#include <QtCore/QList>
+#include <QtCore/QMultiHash>
+#include <QtCore/QVector>
+
+#include <cmath>
+
+namespace Avogadro
+{
+  /**
+   * @class FractionalGrid fractionalgrid.h
+   * @brief Grid hash of fractional coordinates in a periodic cell.
+   *
+   * The unit cell is divided into n x n x n bins no smaller than the
+   * duplicate tolerance, so that all points within the tolerance of a query
+   * point are found in the 27 surrounding bins. Bins wrap around the cell
+   * boundaries and distances use the minimum image, so points on opposite
+   * faces of the cell are recognised as duplicates.
+   */
+  class FractionalGrid
+  {
+  public:
+    /**
+     * @param tolerance Points closer than this (in fractional units) are
+     * considered duplicates.
+     * @param expectedSize Approximate number of points that will be
+     * inserted, used to pick the bin size.
+     */
+    FractionalGrid(double tolerance, int expectedSize)
+      : m_tolSquared(tolerance * tolerance)
+    {
+      // Aim for about one point per bin, but never make a bin smaller than
+      // the tolerance.
+      m_n = static_cast<int>(std::ceil(std::pow(
+          static_cast<double>(expectedSize > 1 ? expectedSize : 1), 1.0/3.0)));
+      if (tolerance > 0.0 && m_n > static_cast<int>(1.0 / tolerance))
+        m_n = static_cast<int>(1.0 / tolerance);
+      if (m_n < 1)
+        m_n = 1;
+      m_points.reserve(expectedSize);
+      m_indices.reserve(expectedSize);
+    }
+
+    /**
+     * Add @p fcoord to the grid, tagged with @p index.
+     */
+    void insert(const Eigen::Vector3d &fcoord, int index)
+    {
+      m_bins.insert(binKey(bin(fcoord.x()), bin(fcoord.y()), bin(fcoord.z())),
+                    m_points.size());
+      m_points.append(fcoord);
+      m_indices.append(index);
+    }
+
+    /**
+     * @return True if a point within the tolerance of @p fcoord has been
+     * inserted.
+     */
+    bool contains(const Eigen::Vector3d &fcoord) const
+    {
+      return !duplicates(fcoord, true).isEmpty();
+    }
+
+    /**
+     * @return The indices of all inserted points within the tolerance of
+     * @p fcoord. If @p firstOnly is true at most one index is returned.
+     */
+    QList<int> duplicates(const Eigen::Vector3d &fcoord,
+                          bool firstOnly = false) const
+    {
+      QList<int> result;
+      const int bi = bin(fcoord.x());
+      const int bj = bin(fcoord.y());
+      const int bk = bin(fcoord.z());
+      // With fewer than three bins per side neighbors would repeat
+      const int lo = m_n < 3 ? 0 : -1;
+      const int hi = m_n < 3 ? m_n - 1 : 1;
+      for (int i = lo; i <= hi; ++i) {
+        for (int j = lo; j <= hi; ++j) {
+          for (int k = lo; k <= hi; ++k) {
+            const qint64 key = m_n < 3 ? binKey(i, j, k)
+              : binKey(wrapBin(bi + i), wrapBin(bj + j), wrapBin(bk + k));
+            QMultiHash<qint64, int>::const_iterator it = m_bins.constFind(key);
+            for (; it != m_bins.constEnd() && it.key() == key; ++it) {
+              const int slot = it.value();
+              if (squaredDistance(m_points[slot], fcoord) < m_tolSquared) {
+                result.append(m_indices[slot]);
+                if (firstOnly)
+                  return result;
+              }
+            }
+          }
+        }
+      }
+      return result;
+    }
+
+    /**
+     * Wrap @p fcoord into the [0, 1) range, snapping values very close to 1
+     * back to 0.
+     */
+    static void wrap(Eigen::Vector3d &fcoord)
+    {
+      for (int i = 0; i < 3; ++i) {
+        // Pseudo-modulus
+        fcoord[i] -= static_cast<int>(fcoord[i]);
+        // Correct negative values
+        if (fcoord[i] < 0.0) ++fcoord[i];
+        // Add a fudge factor for cell edges
+        if (fcoord[i] >= 1.0 - 1e-6) fcoord[i] = 0.0;
+      }
+    }
+
+  private:
+    int bin(double f) const
+    {
+      return wrapBin(static_cast<int>(std::floor(f * m_n)));
+    }
+
+    int wrapBin(int i) const
+    {
+      i %= m_n;
+      return i < 0 ? i + m_n : i;
+    }
+
+    qint64 binKey(int i, int j, int k) const
+    {
+      return i + static_cast<qint64>(m_n) * (j + static_cast<qint64>(m_n) * k);
+    }
+
+    /// Squared minimum image distance between two fractional coordinates
+    static double squaredDistance(const Eigen::Vector3d &a,
+                                  const Eigen::Vector3d &b)
+    {
+      Eigen::Vector3d d = a - b;
+      for (int i = 0; i < 3; ++i)
+        d[i] -= std::floor(d[i] + 0.5);
+      return d.squaredNorm();
+    }
+
+    double m_tolSquared;
+    int m_n;
+    QMultiHash<qint64, int> m_bins;
+    QVector<Eigen::Vector3d> m_points;
+    QVector<int> m_indices;
+  };
+}
+
+#endif
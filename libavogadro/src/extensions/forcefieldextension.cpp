@@ -610,8 +610,6 @@ namespace Avogadro
                                      convergence, task );
 
     connect(m_thread, SIGNAL(message(QString)), this, SIGNAL(message(QString)));
-
-    m_moleculeCopy = *molecule;
   }
 
   ForceFieldCommand::~ForceFieldCommand()
@@ -692,6 +690,8 @@ namespace Avogadro
     m_thread->setMutability(m_mutability);
     m_thread->setConvergence(m_convergence);
     m_thread->setMethod(m_method);
+    // Only the coordinates change, store them before every run
+    m_coordinates.store(m_molecule);
     m_thread->start();
   }
 
@@ -700,8 +700,8 @@ namespace Avogadro
     m_thread->stop();
     m_thread->wait();
 
-    *m_molecule = m_moleculeCopy;
-    m_molecule->update();
+    m_coordinates.swap(m_molecule);
+    m_molecule->updateMolecule();
   }
 
   bool ForceFieldCommand::mergeWith( const QUndoCommand *command )
@@ -31,6 +31,7 @@
 #include <openbabel/forcefield.h>
 
 #include <avogadro/molecule.h>
+#include <avogadro/coordinaterecord.h>
 #include <avogadro/glwidget.h>
 #include <avogadro/extension.h>
 
@@ -167,7 +168,7 @@ namespace Avogadro {
      void message(const QString &m);
 
    private:
-     Molecule m_moleculeCopy;
+     CoordinateRecord m_coordinates;
 
      int m_nSteps;
      int m_task;
@@ -217,8 +217,10 @@ namespace Avogadro
     }
 
     // Render the triangles of the mesh
-    std::vector<Eigen::Vector3f> t = mesh.vertices();
-    std::vector<Eigen::Vector3f> n = mesh.normals();
+    const std::vector<Eigen::Vector3f> &t = mesh.vertices();
+    const std::vector<Eigen::Vector3f> &n = mesh.normals();
+    const std::vector<unsigned int> &indices = mesh.indices();
+    unsigned int numIndices = indices.empty() ? t.size() : indices.size();
 
     // If there are no triangles then don't bother doing anything
     if (t.size() == 0)
@@ -228,7 +230,7 @@ namespace Avogadro
     QTextStream verts(&vertsStr);
     verts << "vertex_vectors{" << t.size() << ",\n";
     QTextStream iverts(&ivertsStr);
-    iverts << "face_indices{" << t.size() / 3 << ",\n";
+    iverts << "face_indices{" << numIndices / 3 << ",\n";
     QTextStream norms(&normsStr);
     norms << "normal_vectors{" << n.size() << ",\n";
     for(unsigned int i = 0; i < t.size(); ++i) {
@@ -243,10 +245,14 @@ namespace Avogadro
         norms << '\n';
       }
     }
-    // Now to write out the indices
-    for (unsigned int i = 0; i < t.size(); i += 3) {
-      iverts << "<" << i << "," << i+1 << "," << i+2 << ">";
-      if (i != t.size()-3) {
+    // Now to write out the indices, shared vertices if the mesh has them
+    for (unsigned int i = 0; i < numIndices; i += 3) {
+      if (indices.empty())
+        iverts << "<" << i << "," << i+1 << "," << i+2 << ">";
+      else
+        iverts << "<" << indices[i] << "," << indices[i+1] << ","
+               << indices[i+2] << ">";
+      if (i != numIndices-3) {
         iverts << ", ";
       }
       if (i != 0 && ((i+1)/3)%3 == 0) {
@@ -283,9 +289,11 @@ namespace Avogadro
     }
 
     // Render the triangles of the mesh
-    std::vector<Eigen::Vector3f> v = mesh.vertices();
-    std::vector<Eigen::Vector3f> n = mesh.normals();
-    std::vector<Color3f> c = mesh.colors();
+    const std::vector<Eigen::Vector3f> &v = mesh.vertices();
+    const std::vector<Eigen::Vector3f> &n = mesh.normals();
+    const std::vector<Color3f> &c = mesh.colors();
+    const std::vector<unsigned int> &indices = mesh.indices();
+    unsigned int numIndices = indices.empty() ? v.size() : indices.size();
 
     // If there are no triangles then don't bother doing anything
     if (v.size() == 0 || v.size() != c.size())
@@ -295,7 +303,7 @@ namespace Avogadro
     QTextStream verts(&vertsStr);
     verts << "vertex_vectors{" << v.size() << ",\n";
     QTextStream iverts(&ivertsStr);
-    iverts << "face_indices{" << v.size() / 3 << ",\n";
+    iverts << "face_indices{" << numIndices / 3 << ",\n";
     QTextStream norms(&normsStr);
     norms << "normal_vectors{" << n.size() << ",\n";
     QTextStream textures(&texturesStr);
@@ -316,11 +324,17 @@ namespace Avogadro
         norms << '\n';
       }
     }
-    // Now to write out the indices
-    for (unsigned int i = 0; i < v.size(); i += 3) {
-      iverts << "<" << i << "," << i+1 << "," << i+2 << ">";
-      iverts << "," << i << "," << i+1 << "," << i+2;
-      if (i != v.size()-3)
+    // Now to write out the indices, shared vertices if the mesh has them
+    for (unsigned int i = 0; i < numIndices; i += 3) {
+      unsigned int i0 = i, i1 = i+1, i2 = i+2;
+      if (!indices.empty()) {
+        i0 = indices[i];
+        i1 = indices[i+1];
+        i2 = indices[i+2];
+      }
+      iverts << "<" << i0 << "," << i1 << "," << i2 << ">";
+      iverts << "," << i0 << "," << i1 << "," << i2;
+      if (i != numIndices-3)
         iverts << ", ";
       if (i != 0 && ((i+1)/3)%3 == 0)
         iverts << '\n';
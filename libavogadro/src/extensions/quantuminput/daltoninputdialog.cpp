@@ -132,6 +132,8 @@ namespace Avogadro
             this, SLOT(updatePreviewText()));
     connect(m_molecule, SIGNAL(atomUpdated(Atom *)),
             this, SLOT(updatePreviewText()));
+    connect(m_molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+            this, SLOT(updatePreviewText()));
     // Add atom coordinates
     updatePreviewText();
   }
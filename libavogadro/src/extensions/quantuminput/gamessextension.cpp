@@ -28,6 +28,7 @@
 #include <avogadro/color.h>
 #include <avogadro/glwidget.h>
 #include <avogadro/primitivelist.h>
+#include <avogadro/changeset.h>
 
 #include <openbabel/mol.h>
 #include <openbabel/obiter.h>
@@ -147,6 +148,8 @@ namespace Avogadro
 
     connect(molecule, SIGNAL(primitiveRemoved(Primitive *)),
             this, SLOT(removePrimitive(Primitive *)));
+    connect(molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+            this, SLOT(removePrimitives(Avogadro::ChangeSet)));
   }
 
 
@@ -626,6 +629,30 @@ namespace Avogadro
     }
   }
 
+  void GamessExtension::removePrimitives(const ChangeSet &changes)
+  {
+    if (!changes.contains(Primitive::AtomType, ChangeSet::Removed))
+      return;
+
+    // Atoms removed in a change set are only deleted later, find the ones
+    // the groups still point to which are no longer in the molecule
+    QList<Atom *> removed;
+    for (int parentNum = 0; parentNum < m_efpModel->rowCount(); ++parentNum) {
+      QStandardItem *parentItem = m_efpModel->item(parentNum);
+      for (int childNum = 0; childNum < parentItem->rowCount(); ++childNum) {
+        QVector<Atom *> atoms =
+          parentItem->child(childNum)->data().value<QVector<Atom *> >();
+        foreach (Atom *atom, atoms)
+          if (m_molecule->atomById(atom->id()) != atom
+              && !removed.contains(atom))
+            removed.append(atom);
+      }
+    }
+
+    foreach (Atom *atom, removed)
+      removePrimitive(atom);
+  }
+
 }
 
 Q_EXPORT_PLUGIN2(gamessextension, Avogadro::GamessExtensionFactory)
@@ -38,6 +38,8 @@
 class QStandardItemModel;
 namespace Avogadro {
 
+  class ChangeSet;
+
   class GamessExtension : public Extension
   {
     Q_OBJECT
@@ -101,6 +103,7 @@ namespace Avogadro {
       void efpWidgetDone();
 
       void removePrimitive(Primitive *primitive);
+      void removePrimitives(const Avogadro::ChangeSet &changes);
 
   };
 
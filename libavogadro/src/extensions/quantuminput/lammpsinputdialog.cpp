@@ -359,6 +359,8 @@ namespace Avogadro
         this, SLOT(updatePreviewText()));
     connect(m_molecule, SIGNAL(atomUpdated(Atom *)),
         this, SLOT(updatePreviewText()));
+    connect(m_molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+        this, SLOT(updatePreviewText()));
     updatePreviewText();
   }
 
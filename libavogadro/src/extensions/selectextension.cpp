@@ -30,9 +30,7 @@
 #include <avogadro/residue.h>
 #include <avogadro/color.h>
 #include <avogadro/primitivelist.h>
-
-#include <openbabel/mol.h>
-#include <openbabel/parsmart.h>
+#include <avogadro/smartsmatcher.h>
 
 #include <QLineEdit>
 #include <QInputDialog>
@@ -43,7 +41,6 @@
 #include <QDebug>
 
 using namespace std;
-using namespace OpenBabel;
 
 namespace Avogadro {
 
@@ -58,8 +55,10 @@ namespace Avogadro {
       SeparatorIndex
     };
 
-  SelectExtension::SelectExtension(QObject *parent) : Extension(parent)
+  SelectExtension::SelectExtension(QObject *parent) : Extension(parent),
+    m_smartsVersion(0)
   {
+    connect(&m_smartsWatcher, SIGNAL(finished()), this, SLOT(smartsMatched()));
     m_periodicTable = new PeriodicTableView(qobject_cast<QWidget*>(parent));
     connect( m_periodicTable, SIGNAL( elementChanged(int) ),
         this, SLOT( selectElement(int) ));
@@ -173,32 +172,52 @@ namespace Avogadro {
         QLineEdit::Normal,
         "", &ok);
     if (ok && !pattern.isEmpty()) {
-      OBSmartsPattern smarts;
-      smarts.Init(pattern.toStdString());
-      OpenBabel::OBMol obmol = m_molecule->OBMol();
-      smarts.Match(obmol);
-
-      // if we have matches, select them
-      if(smarts.NumMatches() != 0) {
-        QList<Primitive *> matchedAtoms;
-
-        vector< vector <int> > mapList = smarts.GetUMapList();
-        vector< vector <int> >::iterator i; // a set of matching atoms
-        vector<int>::iterator j; // atom ids in each match
-        for (i = mapList.begin(); i != mapList.end(); ++i) {
-          for (j = i->begin(); j != i->end(); ++j) {
-            matchedAtoms.append(m_molecule->atom(obmol.GetAtom(*j)->GetIdx()-1));
-          }
-        }
+      // Large molecules are matched in the background, see smartsMatched()
+      if (m_molecule->numAtoms() >= SmartsMatcher::BackgroundAtomCount
+          && !SmartsMatcher::cachedMatch(m_molecule, pattern, 0)) {
+        m_smartsWidget = widget;
+        m_smartsVersion = m_molecule->topologyVersion();
+        m_smartsWatcher.setFuture(SmartsMatcher::matchInBackground(m_molecule,
+                                                                   pattern));
+        return;
+      }
 
-        widget->clearSelected();
-        widget->setSelected(matchedAtoms, true);
-        widget->update();
-      } // end matches
+      selectMatches(widget, SmartsMatcher::match(m_molecule, pattern));
     }
     return;
   }
 
+  // Called when a background SMARTS match started by selectSMARTS() is done
+  void SelectExtension::smartsMatched()
+  {
+    // The atom indices are only meaningful if the molecule did not change
+    if (!m_smartsWidget || !m_molecule
+        || m_molecule->topologyVersion() != m_smartsVersion)
+      return;
+    selectMatches(m_smartsWidget, m_smartsWatcher.result());
+  }
+
+  // Helper function -- select the atoms matched by a SMARTS pattern
+  void SelectExtension::selectMatches(GLWidget *widget, const QBitArray &matches)
+  {
+    // if we have matches, select them
+    if (matches.count(true) == 0)
+      return;
+
+    QList<Primitive *> matchedAtoms;
+    for (int i = 0; i < matches.size(); ++i) {
+      if (matches.testBit(i)) {
+        Atom *atom = m_molecule->atom(i);
+        if (atom)
+          matchedAtoms.append(atom);
+      }
+    }
+
+    widget->clearSelected();
+    widget->setSelected(matchedAtoms, true);
+    widget->update();
+  }
+
   // Helper function -- handle element selections
   // Connected to signal from PeriodicTableView
   void SelectExtension::selectElement(int element)
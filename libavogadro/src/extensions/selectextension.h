@@ -28,6 +28,9 @@
 
 #include <QObject>
 #include <QList>
+#include <QBitArray>
+#include <QFutureWatcher>
+#include <QPointer>
 #include <QString>
 #include <QUndoCommand>
 #include <QListView>
@@ -57,14 +60,21 @@ namespace Avogadro {
     public Q_SLOTS:
       void selectElement(int element);
 
+    private Q_SLOTS:
+      void smartsMatched();
+
     private:
       QList<QAction *> m_actions;
       Molecule *m_molecule;
       GLWidget *m_widget;
       PeriodicTableView *m_periodicTable;
+      QFutureWatcher<QBitArray> m_smartsWatcher;
+      QPointer<GLWidget> m_smartsWidget;
+      unsigned int m_smartsVersion;
 
       void invertSelection(GLWidget *widget);
       void selectSMARTS(GLWidget *widget);
+      void selectMatches(GLWidget *widget, const QBitArray &matches);
       void selectResidue(GLWidget *widget);
       void selectSolvent(GLWidget *widget);
       void addNamedSelection(GLWidget *widget);
@@ -228,10 +228,10 @@ namespace Avogadro {
     m_molecule->update();
     QCoreApplication::processEvents();
 
-    m_molecule->blockSignals(true);
+    // Notify listeners once, when everything is done
+    m_molecule->beginChangeSet();
     // Remove any bonds that may have snook in
-    foreach(Bond *b, m_molecule->bonds())
-      m_molecule->removeBond(b);
+    m_molecule->removeBonds(m_molecule->bonds());
 
     // Now duplicate the entire cell so that inter-cell bonding can be done
     duplicateUnitCell();
@@ -241,8 +241,7 @@ namespace Avogadro {
     // Simpler version of connect the dots
     connectTheDots();
     qDebug() << "Dots connected...";
-    m_molecule->blockSignals(false);
-    m_molecule->updateMolecule();
+    m_molecule->commitChangeSet();
   }
 
   void SuperCellExtension::connectTheDots()
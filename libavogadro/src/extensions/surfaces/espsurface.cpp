@@ -0,0 +1,308 @@
+/**********************************************************************
+  ESPSurface - Class to map the electrostatic potential onto meshes
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Library General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include "espsurface.h"
+
+#include <avogadro/molecule.h>
+#include <avogadro/atom.h>
+#include <avogadro/mesh.h>
+#include <avogadro/color3f.h>
+
+#include <cmath>
+
+#include <QtConcurrentMap>
+#include <QColor>
+#include <QDebug>
+
+using std::vector;
+using Eigen::Vector3d;
+using Eigen::Vector3f;
+using Eigen::Vector3i;
+
+namespace Avogadro
+{
+  struct ESPBlock
+  {
+    ESPSurface *surface;           // The surface with the binned charges
+    const vector<Vector3f> *vertices; // The vertices of the mesh
+    vector<double> *potentials;    // The potentials to write the results into
+    unsigned int begin;            // First vertex of the block
+    unsigned int end;              // One past the last vertex of the block
+  };
+
+  // Atoms closer than this to a block of vertices are always summed exactly
+  static const double ESP_CUTOFF = 7.0;
+  // Edge length of the cells the atoms are binned into
+  static const double ESP_CELL_SIZE = 4.0;
+  // Number of vertices processed together
+  static const unsigned int ESP_BLOCK_SIZE = 256;
+  // Smallest potential (e/Angstrom) given full color, so the surfaces of
+  // nearly neutral molecules stay pale instead of amplifying noise
+  static const double ESP_MIN_RANGE = 0.02;
+
+  ESPSurface::ESPSurface() : m_cellSize(ESP_CELL_SIZE), m_farField(true)
+  {
+  }
+
+  ESPSurface::~ESPSurface()
+  {
+  }
+
+  void ESPSurface::setAtoms(Molecule *mol)
+  {
+    QList<Atom *> atoms = mol->atoms();
+
+    // Include formal charges when there are hydrogens
+    bool hasHydrogens = false;
+    foreach (Atom *atom, atoms)
+      if (atom->atomicNumber() == 1) {
+        hasHydrogens = true;
+        break;
+      }
+
+    // Bin the atoms into cells covering their bounding box
+    Vector3d max = atoms.size() ? *atoms[0]->pos() : Vector3d(0.0, 0.0, 0.0);
+    m_cellMin = max;
+    foreach (Atom *atom, atoms) {
+      const Vector3d &pos = *atom->pos();
+      for (int j = 0; j < 3; ++j) {
+        if (pos[j] < m_cellMin[j])
+          m_cellMin[j] = pos[j];
+        if (pos[j] > max[j])
+          max[j] = pos[j];
+      }
+    }
+    for (int j = 0; j < 3; ++j)
+      m_cellDim[j] = static_cast<int>((max[j] - m_cellMin[j]) / m_cellSize) + 1;
+    unsigned int numCells = m_cellDim.x() * m_cellDim.y() * m_cellDim.z();
+
+    vector<unsigned int> atomCell(atoms.size());
+    m_cellStart.assign(numCells + 1, 0);
+    for (int i = 0; i < atoms.size(); ++i) {
+      Vector3i c;
+      for (int j = 0; j < 3; ++j) {
+        c[j] = static_cast<int>(((*atoms[i]->pos())[j] - m_cellMin[j])
+                                / m_cellSize);
+        if (c[j] >= m_cellDim[j])
+          c[j] = m_cellDim[j] - 1;
+      }
+      atomCell[i] = (c.x() * m_cellDim.y() + c.y()) * m_cellDim.z() + c.z();
+      ++m_cellStart[atomCell[i] + 1];
+    }
+    for (unsigned int i = 0; i < numCells; ++i)
+      m_cellStart[i + 1] += m_cellStart[i];
+
+    // Copy the charges and positions into flat arrays sorted by cell
+    m_x.resize(atoms.size());
+    m_y.resize(atoms.size());
+    m_z.resize(atoms.size());
+    m_charge.resize(atoms.size());
+    vector<unsigned int> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (int i = 0; i < atoms.size(); ++i) {
+      unsigned int n = fill[atomCell[i]]++;
+      const Vector3d &pos = *atoms[i]->pos();
+      m_x[n] = pos.x();
+      m_y[n] = pos.y();
+      m_z[n] = pos.z();
+      m_charge[n] = atoms[i]->partialCharge();
+      if (hasHydrogens)
+        m_charge[n] += atoms[i]->formalCharge();
+    }
+
+    // Monopole and dipole moments of each cell about its center
+    m_cellCharge.assign(numCells, 0.0);
+    m_cellCenter.resize(numCells);
+    m_cellDipole.resize(numCells);
+    for (unsigned int c = 0; c < numCells; ++c) {
+      Vector3d center(0.0, 0.0, 0.0);
+      unsigned int size = m_cellStart[c + 1] - m_cellStart[c];
+      for (unsigned int n = m_cellStart[c]; n < m_cellStart[c + 1]; ++n)
+        center += Vector3d(m_x[n], m_y[n], m_z[n]);
+      if (size)
+        center /= size;
+      Vector3d dipole(0.0, 0.0, 0.0);
+      for (unsigned int n = m_cellStart[c]; n < m_cellStart[c + 1]; ++n) {
+        m_cellCharge[c] += m_charge[n];
+        dipole += m_charge[n] * (Vector3d(m_x[n], m_y[n], m_z[n]) - center);
+      }
+      m_cellCenter[c] = center;
+      m_cellDipole[c] = dipole;
+    }
+  }
+
+  void ESPSurface::calculateColors(const QList<Mesh *> &meshes)
+  {
+    m_meshes = meshes;
+    m_potentials.resize(meshes.size());
+    m_blocks.clear();
+
+    // Split the vertices of each mesh into blocks, the mesh generators emit
+    // vertices in spatial order so neighboring vertices are close together
+    for (int i = 0; i < meshes.size(); ++i) {
+      const vector<Vector3f> &vertices = meshes[i]->vertices();
+      m_potentials[i].resize(vertices.size());
+      for (unsigned int begin = 0; begin < vertices.size();
+           begin += ESP_BLOCK_SIZE) {
+        ESPBlock block;
+        block.surface = this;
+        block.vertices = &vertices;
+        block.potentials = &m_potentials[i];
+        block.begin = begin;
+        block.end = qMin(begin + ESP_BLOCK_SIZE,
+                         static_cast<unsigned int>(vertices.size()));
+        m_blocks.push_back(block);
+      }
+    }
+
+    // Watch for the future
+    connect(&m_watcher, SIGNAL(finished()), this, SLOT(calculationComplete()));
+
+    // The main part of the mapped reduced function...
+    m_future = QtConcurrent::map(m_blocks, ESPSurface::processBlock);
+    // Connect our watcher to our future
+    m_watcher.setFuture(m_future);
+  }
+
+  void ESPSurface::calculationComplete()
+  {
+    disconnect(&m_watcher, SIGNAL(finished()), this, SLOT(calculationComplete()));
+
+    // The color scale spans the largest magnitude of the potential found on
+    // any of the meshes, keeping zero white
+    double range = ESP_MIN_RANGE;
+    for (int i = 0; i < m_potentials.size(); ++i)
+      for (unsigned int j = 0; j < m_potentials[i].size(); ++j)
+        range = qMax(range, fabs(m_potentials[i][j]));
+
+    for (int i = 0; i < m_meshes.size(); ++i) {
+      const vector<double> &potentials = m_potentials[i];
+      vector<Color3f> colors(potentials.size());
+      for (unsigned int j = 0; j < potentials.size(); ++j) {
+        // Chemistry convention: red = negative, blue = positive
+        //
+        // Use HSV color model for smooth transitions
+        int red_hue = 0;
+        int blue_hue = 240;
+        int hue = potentials[j] < 0.0 ? red_hue : blue_hue;
+        // 0 = white, 0-40 = grayish, 40-255 colors from hue
+        int saturation = static_cast<int>(qMin(255.0 * fabs(potentials[j])
+                                               / range, 255.0));
+        int value = 255; // lightness or brightness (0 = black, 255 = white)
+
+        QColor qcolor(QColor::fromHsv(hue, saturation, value));
+        colors[j] = Color3f(qcolor.red(), qcolor.green(), qcolor.blue());
+      }
+      m_meshes[i]->setColors(colors);
+    }
+    m_meshes.clear();
+    m_potentials.clear();
+    m_blocks.clear();
+    emit finished();
+  }
+
+  void ESPSurface::processBlock(ESPBlock &block)
+  {
+    const ESPSurface *surface = block.surface;
+    const vector<Vector3f> &vertices = *block.vertices;
+    unsigned int size = block.end - block.begin;
+    const double cutoff2 = ESP_CUTOFF * ESP_CUTOFF;
+
+    // Copy the block into flat arrays, and find its bounding box
+    vector<double> vx(size), vy(size), vz(size), energy(size, 0.0);
+    Vector3d min = vertices[block.begin].cast<double>();
+    Vector3d max = min;
+    for (unsigned int i = 0; i < size; ++i) {
+      const Vector3f &v = vertices[block.begin + i];
+      vx[i] = v.x();
+      vy[i] = v.y();
+      vz[i] = v.z();
+      for (int j = 0; j < 3; ++j) {
+        if (v[j] < min[j])
+          min[j] = v[j];
+        if (v[j] > max[j])
+          max[j] = v[j];
+      }
+    }
+
+    const Vector3i &dim = surface->m_cellDim;
+    for (int ci = 0; ci < dim.x(); ++ci) {
+      for (int cj = 0; cj < dim.y(); ++cj) {
+        for (int ck = 0; ck < dim.z(); ++ck) {
+          unsigned int c = (ci * dim.y() + cj) * dim.z() + ck;
+          unsigned int first = surface->m_cellStart[c];
+          unsigned int last = surface->m_cellStart[c + 1];
+          if (first == last)
+            continue;
+
+          // Closest approach of the cell to the bounding box of the block
+          Vector3d cellMin = surface->m_cellMin
+              + surface->m_cellSize * Vector3d(ci, cj, ck);
+          double gap2 = 0.0;
+          for (int j = 0; j < 3; ++j) {
+            double gap = qMax(cellMin[j] - max[j],
+                              min[j] - (cellMin[j] + surface->m_cellSize));
+            if (gap > 0.0)
+              gap2 += gap * gap;
+          }
+
+          if (gap2 <= cutoff2) {
+            // Near field - sum the charges in the cell exactly
+            for (unsigned int n = first; n < last; ++n) {
+              const double ax = surface->m_x[n];
+              const double ay = surface->m_y[n];
+              const double az = surface->m_z[n];
+              const double q = surface->m_charge[n];
+              for (unsigned int i = 0; i < size; ++i) {
+                double dx = vx[i] - ax, dy = vy[i] - ay, dz = vz[i] - az;
+                double r2 = dx * dx + dy * dy + dz * dz;
+                // Without the far field atoms beyond the cutoff are ignored
+                if (r2 > 0.0 && (surface->m_farField || r2 <= cutoff2))
+                  energy[i] += q / sqrt(r2);
+              }
+            }
+          }
+          else if (surface->m_farField) {
+            // Far field - use the monopole and dipole of the cell
+            const Vector3d &center = surface->m_cellCenter[c];
+            const Vector3d &dipole = surface->m_cellDipole[c];
+            const double q = surface->m_cellCharge[c];
+            for (unsigned int i = 0; i < size; ++i) {
+              double dx = vx[i] - center.x();
+              double dy = vy[i] - center.y();
+              double dz = vz[i] - center.z();
+              double r2 = dx * dx + dy * dy + dz * dz;
+              double r = sqrt(r2);
+              energy[i] += q / r + (dipole.x() * dx + dipole.y() * dy
+                                    + dipole.z() * dz) / (r2 * r);
+            }
+          }
+        }
+      }
+    }
+
+    for (unsigned int i = 0; i < size; ++i)
+      (*block.potentials)[block.begin + i] = energy[i];
+  }
+
+}
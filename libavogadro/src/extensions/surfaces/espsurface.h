@@ -0,0 +1,143 @@
+/**********************************************************************
+  ESPSurface - Class to map the electrostatic potential onto meshes
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  This library is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Library General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#ifndef ESPSURFACE_H
+#define ESPSURFACE_H
+
+#include <QObject>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QList>
+#include <QVector>
+
+#include <Eigen/Core>
+#include <vector>
+
+/**
+ * @class ESPSurface espsurface.h
+ * @brief ESPSurface Class
+ *
+ * This class maps an approximate electrostatic potential, calculated from the
+ * atomic charges, onto the vertices of one or more meshes as colors. The
+ * charges and positions are copied into flat arrays once, and blocks of
+ * vertices are processed in parallel using QtConcurrent::map.
+ *
+ * The atoms are binned into cells. Cells close to a block of vertices are
+ * summed exactly, distant cells are either approximated by their monopole and
+ * dipole moments or ignored if the far field is disabled.
+ */
+
+namespace Avogadro
+{
+
+  class Molecule;
+  class Mesh;
+  struct ESPBlock;
+
+  class ESPSurface : public QObject
+  {
+  Q_OBJECT
+
+  public:
+    /**
+     * Constructor.
+     */
+    ESPSurface();
+
+    /**
+     * Destructor.
+     */
+    ~ESPSurface();
+
+    /**
+     * Copy the positions and charges of the atoms in the Molecule.
+     * @param mol Molecule to copy atoms across from.
+     */
+    void setAtoms(Molecule *mol);
+
+    /**
+     * Use a multipole approximation for distant atoms rather than ignoring
+     * atoms beyond the cutoff. Defaults to true.
+     */
+    void setFarField(bool farField) { m_farField = farField; }
+
+    /**
+     * @return True if distant atoms are included using a multipole expansion.
+     */
+    bool farField() const { return m_farField; }
+
+    /**
+     * Calculate the ESP colors of the supplied meshes. The colors are set on
+     * the meshes and finished() is emitted once the calculation is complete.
+     * The color scale is symmetric about zero and spans the largest
+     * magnitude of the potential on the meshes.
+     * @param meshes The meshes to color.
+     */
+    void calculateColors(const QList<Mesh *> &meshes);
+
+    /**
+     * When performing a calculation the QFutureWatcher is useful if you want
+     * to update a progress bar.
+     */
+    QFutureWatcher<void> & watcher() { return m_watcher; }
+
+  private Q_SLOTS:
+    /**
+     * Slot to set the mesh colors once Qt Concurrent is done
+     */
+    void calculationComplete();
+
+  Q_SIGNALS:
+    /**
+     * Emitted when the calculation is complete.
+     */
+    void finished();
+
+  private:
+    // Flat arrays of the atom positions and charges, sorted by cell
+    std::vector<double> m_x, m_y, m_z, m_charge;
+
+    // Atoms binned into cells, with the multipole moments of each cell
+    double m_cellSize;
+    Eigen::Vector3d m_cellMin;
+    Eigen::Vector3i m_cellDim;
+    std::vector<unsigned int> m_cellStart; // Offset of each cell in the arrays
+    std::vector<double> m_cellCharge;      // Total charge of each cell
+    std::vector<Eigen::Vector3d> m_cellCenter; // Geometric center of each cell
+    std::vector<Eigen::Vector3d> m_cellDipole; // Dipole about the center
+    bool m_farField;
+
+    QFuture<void> m_future;
+    QFutureWatcher<void> m_watcher;
+    QList<Mesh *> m_meshes;
+    QVector<std::vector<double> > m_potentials;
+    QVector<ESPBlock> m_blocks;
+
+    /// Re-entrant form of the calculation, processes a block of vertices
+    static void processBlock(ESPBlock &block);
+  };
+
+} // End namespace Avogadro
+
+#endif
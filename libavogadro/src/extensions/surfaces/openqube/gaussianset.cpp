@@ -24,6 +24,7 @@
 
 #include "cube.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include <QtCore/QtConcurrentMap>
@@ -43,13 +44,48 @@ struct GaussianShell
 {
   GaussianSet *set;  // A pointer to the GaussianSet, cannot write to member vars
   Cube *tCube;       // The target cube, used to initialise temp cubes too
-  unsigned int pos;  // The index ofposition of the point to calculate the MO for
+  unsigned int pos;  // The index of the first point in the row to calculate
   unsigned int state;// The MO number to calculate
 };
 
+/// Working storage for a row of points, allocated once and reused per point
+struct GaussianScratch
+{
+  GaussianScratch(const GaussianSet *set)
+    : deltas(set->m_numAtoms), dr2(set->m_numAtoms), values(set->m_numMOs)
+  {
+    indices.reserve(set->m_numMOs);
+  }
+  std::vector<Vector3d> deltas;       // Position relative to each atom
+  std::vector<double> dr2;            // Squared distance to each atom
+  std::vector<double> values;         // Value of each basis function
+  std::vector<unsigned int> indices;  // Basis functions that were evaluated,
+                                      // the others are zero in values
+};
+
 static const double BOHR_TO_ANGSTROM = 0.529177249;
 static const double ANGSTROM_TO_BOHR = 1.0 / BOHR_TO_ANGSTROM;
 
+// Shells whose magnitude is below this at a point are not evaluated there
+static const double BASIS_THRESHOLD = 1.0e-10;
+
+/// Number of basis functions calculated for a shell type, zero if unhandled
+static inline unsigned int componentCount(int type)
+{
+  switch (type) {
+  case S:
+    return 1;
+  case P:
+    return 3;
+  case D:
+    return 6;
+  case D5:
+    return 5;
+  default:
+    return 0;
+  }
+}
+
 GaussianSet::GaussianSet() : m_numMOs(0), m_numAtoms(0), m_init(false),
   m_cube(0), m_gaussianShells(0)
 {
@@ -174,13 +210,14 @@ bool GaussianSet::calculateCubeMO(Cube *cube, unsigned int state)
   // Must be called before calculations begin
   initCalculation();
 
-  // Set up the points we want to calculate the density at
-  m_gaussianShells = new QVector<GaussianShell>(cube->data()->size());
+  // Set up the rows of points we want to calculate the MO at
+  int rowSize = cube->dimensions().z();
+  m_gaussianShells = new QVector<GaussianShell>(cube->data()->size() / rowSize);
 
   for (int i = 0; i < m_gaussianShells->size(); ++i) {
     (*m_gaussianShells)[i].set = this;
     (*m_gaussianShells)[i].tCube = cube;
-    (*m_gaussianShells)[i].pos = i;
+    (*m_gaussianShells)[i].pos = i * rowSize;
     (*m_gaussianShells)[i].state = state;
   }
 
@@ -210,13 +247,14 @@ bool GaussianSet::calculateCubeDensity(Cube *cube)
   // Must be called before calculations begin
   initCalculation();
 
-  // Set up the points we want to calculate the density at
-  m_gaussianShells = new QVector<GaussianShell>(cube->data()->size());
+  // Set up the rows of points we want to calculate the density at
+  int rowSize = cube->dimensions().z();
+  m_gaussianShells = new QVector<GaussianShell>(cube->data()->size() / rowSize);
 
   for (int i = 0; i < m_gaussianShells->size(); ++i) {
     (*m_gaussianShells)[i].set = this;
     (*m_gaussianShells)[i].tCube = cube;
-    (*m_gaussianShells)[i].pos = i;
+    (*m_gaussianShells)[i].pos = i * rowSize;
   }
 
   // Lock the cube until we are done.
@@ -247,6 +285,7 @@ BasisSet * GaussianSet::clone()
   result->m_gtoCN = this->m_gtoCN;
   result->m_moMatrix = this->m_moMatrix;
   result->m_density = this->m_density;
+  result->m_cutoffs = this->m_cutoffs;
 
   result->m_numMOs = this->m_numMOs;
   result->m_numAtoms = this->m_numAtoms;
@@ -377,247 +416,179 @@ void GaussianSet::initCalculation()
       qDebug() << "Basis set not handled - results may be incorrect.";
     }
   }
+
+  // Find the distance beyond which each shell can be neglected. The sum of
+  // the normalized coefficients times r^l exp(-a r^2) for the most diffuse
+  // primitive bounds the magnitude of every component of the shell.
+  m_cutoffs.assign(m_symmetry.size(), 0.0);
+  for (unsigned int i = 0; i < m_symmetry.size() && i < m_cIndices.size();
+       ++i) {
+    unsigned int cEnd = i + 1 < m_cIndices.size() ? m_cIndices[i+1]
+                                                  : m_gtoCN.size();
+    double sumC = 0.0;
+    for (unsigned int j = m_cIndices[i]; j < cEnd; ++j)
+      sumC += fabs(m_gtoCN[j]);
+    double minA = 0.0;
+    for (unsigned int j = m_gtoIndices[i]; j < m_gtoIndices[i+1]; ++j)
+      if (j == m_gtoIndices[i] || m_gtoA[j] < minA)
+        minA = m_gtoA[j];
+    if (sumC <= BASIS_THRESHOLD || minA <= 0.0)
+      continue;
+
+    double l = 0.0;
+    if (m_symmetry[i] == P)
+      l = 1.0;
+    else if (m_symmetry[i] == D || m_symmetry[i] == D5)
+      l = 2.0;
+    // A few fixed point iterations account for the r^l prefactor
+    double r2 = log(sumC / BASIS_THRESHOLD) / minA;
+    for (int j = 0; j < 3; ++j)
+      r2 = (log(sumC / BASIS_THRESHOLD) + 0.5 * l * log(r2 > 1.0 ? r2 : 1.0))
+          / minA;
+    m_cutoffs[i] = r2;
+  }
   m_init = true;
 }
 
-/// This is the stuff we actually use right now - porting to new data structure
-void GaussianSet::processPoint(GaussianShell &shell)
+/// Work out which shells contribute at pos and evaluate their basis functions
+unsigned int GaussianSet::calculateBasis(GaussianSet *set, const Vector3d &pos,
+                                         GaussianScratch &scratch)
 {
-  GaussianSet *set = shell.set;
   unsigned int atomsSize = set->m_numAtoms;
   unsigned int basisSize = set->m_symmetry.size();
   std::vector<int> &basis = set->m_symmetry;
-  vector<Vector3d> deltas;
-  vector<double> dr2;
-  deltas.reserve(atomsSize);
-  dr2.reserve(atomsSize);
-
-  unsigned int indexMO = shell.state-1;
-
-  // Calculate our position
-  Vector3d pos = shell.tCube->position(shell.pos) * ANGSTROM_TO_BOHR;
+  double *values = &scratch.values[0];
 
   // Calculate the deltas for the position
   for (unsigned int i = 0; i < atomsSize; ++i) {
-    deltas.push_back(pos - set->m_molecule.atomPos(i));
-    dr2.push_back(deltas[i].squaredNorm());
+    scratch.deltas[i] = pos - set->m_molecule.atomPos(i);
+    scratch.dr2[i] = scratch.deltas[i].squaredNorm();
   }
 
-  // Now calculate the value at this point in space
-  double tmp = 0.0;
+  // Only the basis functions evaluated at the previous point can be non-zero
+  for (unsigned int i = 0; i < scratch.indices.size(); ++i)
+    values[scratch.indices[i]] = 0.0;
+  scratch.indices.clear();
+
+  // Evaluate each shell that is close enough to make a contribution
   for (unsigned int i = 0; i < basisSize; ++i) {
+    unsigned int cAtom = set->m_atomIndices[i];
+    if (scratch.dr2[cAtom] > set->m_cutoffs[i])
+      continue;
     switch(basis[i]) {
     case S:
-      tmp += pointS(shell.set, i,
-                    dr2[set->m_atomIndices[i]], indexMO);
+      pointS(set, scratch.dr2[cAtom], i, values);
       break;
     case P:
-      tmp += pointP(shell.set, i, deltas[set->m_atomIndices[i]],
-                    dr2[set->m_atomIndices[i]], indexMO);
+      pointP(set, scratch.deltas[cAtom], scratch.dr2[cAtom], i, values);
       break;
     case D:
-      tmp += pointD(shell.set, i, deltas[set->m_atomIndices[i]],
-                    dr2[set->m_atomIndices[i]], indexMO);
+      pointD(set, scratch.deltas[cAtom], scratch.dr2[cAtom], i, values);
       break;
     case D5:
-      tmp += pointD5(shell.set, i, deltas[set->m_atomIndices[i]],
-                     dr2[set->m_atomIndices[i]], indexMO);
+      pointD5(set, scratch.deltas[cAtom], scratch.dr2[cAtom], i, values);
       break;
     default:
       // Not handled - return a zero contribution
       ;
     }
+    unsigned int components = componentCount(basis[i]);
+    for (unsigned int j = 0; j < components; ++j)
+      scratch.indices.push_back(set->m_moIndices[i] + j);
   }
-  // Set the value
-  shell.tCube->setValue(shell.pos, tmp);
+  return scratch.indices.size();
 }
 
-void GaussianSet::processDensity(GaussianShell &shell)
+/// This is the stuff we actually use right now - porting to new data structure
+void GaussianSet::processPoint(GaussianShell &shell)
 {
   GaussianSet *set = shell.set;
-  unsigned int atomsSize = set->m_numAtoms;
-  unsigned int basisSize = set->m_symmetry.size();
-  unsigned int matrixSize = set->m_density.rows();
-  std::vector<int> &basis = set->m_symmetry;
-  vector<Vector3d> deltas;
-  vector<double> dr2;
-  deltas.reserve(atomsSize);
-  dr2.reserve(atomsSize);
-
-  // Calculate our position
-  Vector3d pos = shell.tCube->position(shell.pos) * ANGSTROM_TO_BOHR;
-  // Calculate the deltas for the position
-  for (unsigned int i = 0; i < atomsSize; ++i) {
-    deltas.push_back(pos - set->m_molecule.atomPos(i));
-    dr2.push_back(deltas[i].squaredNorm());
-  }
-
-  // Calculate the basis set values at this point
-  MatrixXd values(matrixSize, 1);
-  for (unsigned int i = 0; i < basisSize; ++i) {
-    unsigned int cAtom = set->m_atomIndices[i];
-    switch(basis[i]) {
-    case S:
-      pointS(shell.set, dr2[cAtom], i, values);
-      break;
-    case P:
-      pointP(shell.set, deltas[cAtom], dr2[cAtom], i, values);
-      break;
-    case D:
-      pointD(shell.set, deltas[cAtom], dr2[cAtom], i, values);
-      break;
-    case D5:
-      pointD5(shell.set, deltas[cAtom], dr2[cAtom], i, values);
-      break;
-    default:
-      // Not handled - return a zero contribution
-      ;
-    }
-  }
-
-  // Now calculate the value of the density at this point in space
-  double rho = 0.0;
-  for (unsigned int i = 0; i < matrixSize; ++i) {
-    // Calculate the off-diagonal parts of the matrix
-    for (unsigned int j = 0; j < i; ++j) {
-      rho += 2.0 * set->m_density.coeffRef(i, j)
-          * (values.coeffRef(i, 0) * values.coeffRef(j, 0));
+  unsigned int indexMO = shell.state-1;
+  GaussianScratch scratch(set);
+
+  // Each work item is a row of points along z, starting at shell.pos
+  Vector3d start = shell.tCube->position(shell.pos) * ANGSTROM_TO_BOHR;
+  double step = shell.tCube->spacing().z() * ANGSTROM_TO_BOHR;
+  int rowSize = shell.tCube->dimensions().z();
+
+  for (int k = 0; k < rowSize; ++k) {
+    Vector3d pos(start.x(), start.y(), start.z() + k * step);
+    unsigned int n = calculateBasis(set, pos, scratch);
+
+    // Contract the non-zero basis functions with the MO coefficients
+    double tmp = 0.0;
+    for (unsigned int i = 0; i < n; ++i) {
+      unsigned int index = scratch.indices[i];
+      tmp += set->m_moMatrix.coeffRef(index, indexMO) * scratch.values[index];
     }
-    // Now calculate the matrix diagonal
-    rho += set->m_density.coeffRef(i, i)
-        * (values.coeffRef(i, 0) * values.coeffRef(i, 0));
+    // Set the value
+    shell.tCube->setValue(shell.pos + k, tmp);
   }
-
-  // Set the value
-  shell.tCube->setValue(shell.pos, rho);
 }
 
-inline double GaussianSet::pointS(GaussianSet *set, unsigned int moIndex,
-                                  double dr2, unsigned int indexMO)
+void GaussianSet::processDensity(GaussianShell &shell)
 {
-  // If the MO coefficient is very small skip it
-  if (isSmall(set->m_moMatrix.coeffRef(set->m_moIndices[moIndex], indexMO))) {
-    return 0.0;
-  }
-
-  // S type orbitals - the simplest of the calculations with one component
-  double tmp = 0.0;
-  unsigned int cIndex = set->m_cIndices[moIndex];
-  for (unsigned int i = set->m_gtoIndices[moIndex];
-       i < set->m_gtoIndices[moIndex+1]; ++i) {
-    tmp += set->m_gtoCN[cIndex++] * exp(-set->m_gtoA[i] * dr2);
+  GaussianSet *set = shell.set;
+  unsigned int matrixSize = set->m_density.rows();
+  GaussianScratch scratch(set);
+
+  // Each work item is a row of points along z, starting at shell.pos
+  Vector3d start = shell.tCube->position(shell.pos) * ANGSTROM_TO_BOHR;
+  double step = shell.tCube->spacing().z() * ANGSTROM_TO_BOHR;
+  int rowSize = shell.tCube->dimensions().z();
+  double zEnd = start.z() + (rowSize - 1) * step;
+
+  // Find the basis functions that are not negligible somewhere along the row,
+  // using the closest approach of the row to each shell's atom
+  std::vector<unsigned int> active;
+  for (unsigned int i = 0; i < set->m_symmetry.size(); ++i) {
+    Vector3d atom = set->m_molecule.atomPos(set->m_atomIndices[i]);
+    double z = atom.z() < start.z() ? start.z()
+                                    : (atom.z() > zEnd ? zEnd : atom.z());
+    Vector3d closest(start.x(), start.y(), z);
+    if ((closest - atom).squaredNorm() > set->m_cutoffs[i])
+      continue;
+    unsigned int components = componentCount(set->m_symmetry[i]);
+    for (unsigned int j = 0; j < components; ++j)
+      if (set->m_moIndices[i] + j < matrixSize)
+        active.push_back(set->m_moIndices[i] + j);
   }
-  // There is one MO coefficient per S shell basis
-  return tmp * set->m_moMatrix.coeffRef(set->m_moIndices[moIndex], indexMO);
-}
+  unsigned int activeSize = active.size();
 
-inline double GaussianSet::pointP(GaussianSet *set, unsigned int moIndex,
-                                  const Vector3d &delta,
-                                  double dr2, unsigned int indexMO)
-{
-  // P type orbitals have three components and each component has a different
-  // independent MO weighting. Many things can be cached to save time though
-  unsigned int baseIndex = set->m_moIndices[moIndex];
-  double x = 0.0, y = 0.0, z = 0.0;
-
-  // Now iterate through the P type GTOs and sum their contributions
-  unsigned int cIndex = set->m_cIndices[moIndex];
-  for (unsigned int i = set->m_gtoIndices[moIndex];
-       i < set->m_gtoIndices[moIndex+1]; ++i) {
-    double tmpGTO = exp(-set->m_gtoA[i] * dr2);
-    x += set->m_gtoCN[cIndex++] * delta.x() * tmpGTO;
-    y += set->m_gtoCN[cIndex++] * delta.y() * tmpGTO;
-    z += set->m_gtoCN[cIndex++] * delta.z() * tmpGTO;
+  if (activeSize == 0) {
+    for (int k = 0; k < rowSize; ++k)
+      shell.tCube->setValue(shell.pos + k, 0.0);
+    return;
   }
 
-  // Calculate the prefactors for Px, Py and Pz
-  double Px = set->m_moMatrix.coeffRef(baseIndex  , indexMO);
-  double Py = set->m_moMatrix.coeffRef(baseIndex+1, indexMO);
-  double Pz = set->m_moMatrix.coeffRef(baseIndex+2, indexMO);
-
-  return Px*x + Py*y + Pz*z;
-}
-
-inline double GaussianSet::pointD(GaussianSet *set, unsigned int moIndex,
-                                  const Vector3d &delta,
-                                  double dr2, unsigned int indexMO)
-{
-  // D type orbitals have six components and each component has a different
-  // independent MO weighting. Many things can be cached to save time though
-  unsigned int baseIndex = set->m_moIndices[moIndex];
-  double xx = 0.0, yy = 0.0, zz = 0.0, xy = 0.0, xz = 0.0, yz = 0.0;
-
-  // Now iterate through the D type GTOs and sum their contributions
-  unsigned int cIndex = set->m_cIndices[moIndex];
-  for (unsigned int i = set->m_gtoIndices[moIndex];
-       i < set->m_gtoIndices[moIndex+1]; ++i) {
-    // Calculate the common factor
-    double tmpGTO = exp(-set->m_gtoA[i] * dr2);
-    xx += set->m_gtoCN[cIndex++] * tmpGTO; // Dxx
-    yy += set->m_gtoCN[cIndex++] * tmpGTO; // Dyy
-    zz += set->m_gtoCN[cIndex++] * tmpGTO; // Dzz
-    xy += set->m_gtoCN[cIndex++] * tmpGTO; // Dxy
-    xz += set->m_gtoCN[cIndex++] * tmpGTO; // Dxz
-    yz += set->m_gtoCN[cIndex++] * tmpGTO; // Dyz
+  // Gather the active basis function values for every point on the row
+  MatrixXd values(activeSize, rowSize);
+  for (int k = 0; k < rowSize; ++k) {
+    Vector3d pos(start.x(), start.y(), start.z() + k * step);
+    calculateBasis(set, pos, scratch);
+    for (unsigned int i = 0; i < activeSize; ++i)
+      values.coeffRef(i, k) = scratch.values[active[i]];
   }
 
-  // Calculate the prefactors
-  double Dxx = set->m_moMatrix.coeffRef(baseIndex  , indexMO) * delta.x()
-      * delta.x();
-  double Dyy = set->m_moMatrix.coeffRef(baseIndex+1, indexMO) * delta.y()
-      * delta.y();
-  double Dzz = set->m_moMatrix.coeffRef(baseIndex+2, indexMO) * delta.z()
-      * delta.z();
-  double Dxy = set->m_moMatrix.coeffRef(baseIndex+3, indexMO) * delta.x()
-      * delta.y();
-  double Dxz = set->m_moMatrix.coeffRef(baseIndex+4, indexMO) * delta.x()
-      * delta.z();
-  double Dyz = set->m_moMatrix.coeffRef(baseIndex+5, indexMO) * delta.y()
-      * delta.z();
-  return Dxx*xx + Dyy*yy + Dzz*zz + Dxy*xy + Dxz*xz + Dyz*yz;
-}
-
-inline double GaussianSet::pointD5(GaussianSet *set, unsigned int moIndex,
-                                   const Vector3d &delta,
-                                   double dr2, unsigned int indexMO)
-{
-  // D type orbitals have five components and each component has a different
-  // MO weighting. Many things can be cached to save time
-  unsigned int baseIndex = set->m_moIndices[moIndex];
-  double d0 = 0.0, d1p = 0.0, d1n = 0.0, d2p = 0.0, d2n = 0.0;
-
-  // Now iterate through the D type GTOs and sum their contributions
-  unsigned int cIndex = set->m_cIndices[moIndex];
-  for (unsigned int i = set->m_gtoIndices[moIndex];
-       i < set->m_gtoIndices[moIndex+1]; ++i) {
-    // Calculate the common factor
-    double tmpGTO = exp(-set->m_gtoA[i] * dr2);
-    d0  += set->m_gtoCN[cIndex++] * tmpGTO;
-    d1p += set->m_gtoCN[cIndex++] * tmpGTO;
-    d1n += set->m_gtoCN[cIndex++] * tmpGTO;
-    d2p += set->m_gtoCN[cIndex++] * tmpGTO;
-    d2n += set->m_gtoCN[cIndex++] * tmpGTO;
+  // Contract with the matching sub-block of the density matrix, as a single
+  // matrix product for the whole row. Only the lower triangle of the density
+  // matrix is read in, so the block is mirrored from it.
+  MatrixXd density(activeSize, activeSize);
+  for (unsigned int j = 0; j < activeSize; ++j)
+    for (unsigned int i = 0; i < activeSize; ++i)
+      density.coeffRef(i, j) =
+          set->m_density.coeffRef(std::max(active[i], active[j]),
+                                  std::min(active[i], active[j]));
+  MatrixXd product = density * values;
+
+  for (int k = 0; k < rowSize; ++k) {
+    // Set the value
+    shell.tCube->setValue(shell.pos + k, values.col(k).dot(product.col(k)));
   }
-
-  // Calculate the prefactors
-  double xx = delta.x() * delta.x();
-  double yy = delta.y() * delta.y();
-  double zz = delta.z() * delta.z();
-  double xy = delta.x() * delta.y();
-  double xz = delta.x() * delta.z();
-  double yz = delta.y() * delta.z();
-
-  double D0  = set->m_moMatrix.coeffRef(baseIndex  , indexMO) * (zz - dr2);
-  double D1p = set->m_moMatrix.coeffRef(baseIndex+1, indexMO) * xz;
-  double D1n = set->m_moMatrix.coeffRef(baseIndex+2, indexMO) * yz;
-  double D2p = set->m_moMatrix.coeffRef(baseIndex+3, indexMO) * (xx - yy);
-  double D2n = set->m_moMatrix.coeffRef(baseIndex+4, indexMO) * xy;
-
-  return D0*d0 + D1p*d1p + D1n*d1n + D2p*d2p + D2n*d2n;
 }
 
 inline void GaussianSet::pointS(GaussianSet *set, double dr2, int basis,
-                                Eigen::MatrixXd &out)
+                                double *out)
 {
   // S type orbitals - the simplest of the calculations with one component
   double tmp = 0.0;
@@ -626,12 +597,11 @@ inline void GaussianSet::pointS(GaussianSet *set, double dr2, int basis,
        i < set->m_gtoIndices[basis+1]; ++i) {
     tmp += set->m_gtoCN[cIndex++] * exp(-set->m_gtoA[i] * dr2);
   }
-  out.coeffRef(set->m_moIndices[basis], 0) = tmp;
+  out[set->m_moIndices[basis]] = tmp;
 }
 
 inline void GaussianSet::pointP(GaussianSet *set, const Vector3d &delta,
-                                double dr2, int basis,
-                                Eigen::MatrixXd &out)
+                                double dr2, int basis, double *out)
 {
   double x = 0.0, y = 0.0, z = 0.0;
 
@@ -645,16 +615,15 @@ inline void GaussianSet::pointP(GaussianSet *set, const Vector3d &delta,
     z += set->m_gtoCN[cIndex++] * tmpGTO;
   }
 
-  // Save values to the matrix
+  // Save values to the output
   int baseIndex = set->m_moIndices[basis];
-  out.coeffRef(baseIndex  , 0) = x * delta.x();
-  out.coeffRef(baseIndex+1, 0) = y * delta.y();
-  out.coeffRef(baseIndex+2, 0) = z * delta.z();
+  out[baseIndex  ] = x * delta.x();
+  out[baseIndex+1] = y * delta.y();
+  out[baseIndex+2] = z * delta.z();
 }
 
 inline void GaussianSet::pointD(GaussianSet *set, const Eigen::Vector3d &delta,
-                                double dr2, int basis,
-                                Eigen::MatrixXd &out)
+                                double dr2, int basis, double *out)
 {
   // D type orbitals have six components and each component has a different
   // independent MO weighting. Many things can be cached to save time though
@@ -674,22 +643,21 @@ inline void GaussianSet::pointD(GaussianSet *set, const Eigen::Vector3d &delta,
     yz += set->m_gtoCN[cIndex++] * tmpGTO; // Dyz
   }
 
-  // Save values to the matrix
+  // Save values to the output
   int baseIndex = set->m_moIndices[basis];
-  out.coeffRef(baseIndex  , 0) = delta.x() * delta.x() * xx;
-  out.coeffRef(baseIndex+1, 0) = delta.y() * delta.y() * yy;
-  out.coeffRef(baseIndex+2, 0) = delta.z() * delta.z() * zz;
-  out.coeffRef(baseIndex+3, 0) = delta.x() * delta.y() * xy;
-  out.coeffRef(baseIndex+4, 0) = delta.x() * delta.z() * xz;
-  out.coeffRef(baseIndex+5, 0) = delta.y() * delta.z() * yz;
+  out[baseIndex  ] = delta.x() * delta.x() * xx;
+  out[baseIndex+1] = delta.y() * delta.y() * yy;
+  out[baseIndex+2] = delta.z() * delta.z() * zz;
+  out[baseIndex+3] = delta.x() * delta.y() * xy;
+  out[baseIndex+4] = delta.x() * delta.z() * xz;
+  out[baseIndex+5] = delta.y() * delta.z() * yz;
 }
 
 inline void GaussianSet::pointD5(GaussianSet *set, const Eigen::Vector3d &delta,
-                                 double dr2, int basis,
-                                 Eigen::MatrixXd &out)
+                                 double dr2, int basis, double *out)
 {
-  // D type orbitals have six components and each component has a different
-  // independent MO weighting. Many things can be cached to save time though
+  // D type orbitals have five components and each component has a different
+  // MO weighting. Many things can be cached to save time
   double d0 = 0.0, d1p = 0.0, d1n = 0.0, d2p = 0.0, d2n = 0.0;
 
   // Now iterate through the D type GTOs and sum their contributions
@@ -713,13 +681,13 @@ inline void GaussianSet::pointD5(GaussianSet *set, const Eigen::Vector3d &delta,
   double xz = delta.x() * delta.z();
   double yz = delta.y() * delta.z();
 
-  // Save values to the matrix
+  // Save values to the output
   int baseIndex = set->m_moIndices[basis];
-  out.coeffRef(baseIndex  , 0) = (zz - dr2) * d0;
-  out.coeffRef(baseIndex+1, 0) = xz * d1p;
-  out.coeffRef(baseIndex+2, 0) = yz * d1n;
-  out.coeffRef(baseIndex+3, 0) = (xx - yy) * d2p;
-  out.coeffRef(baseIndex+4, 0) = xy * d2n;
+  out[baseIndex  ] = (zz - dr2) * d0;
+  out[baseIndex+1] = xz * d1p;
+  out[baseIndex+2] = yz * d1n;
+  out[baseIndex+3] = (xx - yy) * d2p;
+  out[baseIndex+4] = xy * d2n;
 }
 
 unsigned int GaussianSet::numMOs()
@@ -29,6 +29,7 @@ namespace OpenQube
 {
 
 struct GaussianShell;
+struct GaussianScratch;
 
 /**
  * Enumeration of the Gaussian type orbitals.
@@ -175,6 +176,7 @@ private:
   std::vector<double> m_gtoCN;             //! The GTO contraction coefficient (normalized)
   Eigen::MatrixXd m_moMatrix;              //! MO coefficient matrix
   Eigen::MatrixXd m_density;               //! Density matrix
+  std::vector<double> m_cutoffs;           //! Squared distance each shell reaches
 
   unsigned int m_numMOs;    //! The number of GTOs
   unsigned int m_numAtoms;  //! Total number of atoms in the basis set
@@ -188,29 +190,23 @@ private:
   static bool isSmall(double val);
 
   void initCalculation();  //! Perform initialisation before any calculations
-  /// Re-entrant single point forms of the calculations
+  /// Re-entrant forms of the calculations, each processes a row along z
   static void processPoint(GaussianShell &shell);
   static void processDensity(GaussianShell &shell);
-  static double pointS(GaussianSet *set, unsigned int moIndex,
-                       double dr2, unsigned int indexMO);
-  static double pointP(GaussianSet *set, unsigned int moIndex,
-                       const Eigen::Vector3d &delta,
-                       double dr2, unsigned int indexMO);
-  static double pointD(GaussianSet *set, unsigned int moIndex,
-                       const Eigen::Vector3d &delta,
-                       double dr2, unsigned int indexMO);
-  static double pointD5(GaussianSet *set, unsigned int moIndex,
-                        const Eigen::Vector3d &delta,
-                        double dr2, unsigned int indexMO);
-  /// Calculate the basis for the density
-  static void pointS(GaussianSet *set, double dr2, int basis,
-                     Eigen::MatrixXd &out);
+  /// Evaluate the basis functions of the shells within their cutoff of pos
+  static unsigned int calculateBasis(GaussianSet *set,
+                                     const Eigen::Vector3d &pos,
+                                     GaussianScratch &scratch);
+  /// Calculate the basis function values of a shell
+  static void pointS(GaussianSet *set, double dr2, int basis, double *out);
   static void pointP(GaussianSet *set, const Eigen::Vector3d &delta,
-                     double dr2, int basis, Eigen::MatrixXd &out);
+                     double dr2, int basis, double *out);
   static void pointD(GaussianSet *set, const Eigen::Vector3d &delta,
-                     double dr2, int basis, Eigen::MatrixXd &out);
+                     double dr2, int basis, double *out);
   static void pointD5(GaussianSet *set, const Eigen::Vector3d &delta,
-                      double dr2, int basis, Eigen::MatrixXd &out);
+                      double dr2, int basis, double *out);
+
+  friend struct GaussianScratch;
 };
 
 } // End namespace
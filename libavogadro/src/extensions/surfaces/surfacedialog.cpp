@@ -230,6 +230,8 @@ namespace Avogadro {
             this, SLOT(addCube(Primitive *)));
       connect(m_molecule, SIGNAL(primitiveRemoved(Primitive *)),
             this, SLOT(removeCube(Primitive *)));
+      connect(m_molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+            this, SLOT(cubesChanged(Avogadro::ChangeSet)));
     }
     updateCubes();
   }
@@ -299,6 +301,14 @@ namespace Avogadro {
     }
   }
 
+  void SurfaceDialog::cubesChanged(const ChangeSet &changes)
+  {
+    // Cubes added or removed inside a change set are not signalled one by one
+    if (changes.contains(Primitive::CubeType, ChangeSet::Added)
+        || changes.contains(Primitive::CubeType, ChangeSet::Removed))
+      updateCubes();
+  }
+
   void SurfaceDialog::engineAdded(Engine *engine)
   {
     // If this is an orbital engine then append it to the list
@@ -37,6 +37,7 @@
 namespace Avogadro
 {
   class GLWidget;
+  class ChangeSet;
   class Primitive;
   class Molecule;
   class Engine;
@@ -116,6 +117,7 @@ namespace Avogadro
     void setMolecule(const Molecule *mol);
     void addCube(Primitive *p);
     void removeCube(Primitive *p);
+    void cubesChanged(const Avogadro::ChangeSet &changes);
     void engineAdded(Engine *engine);
     void engineRemoved(Engine *engine);
 
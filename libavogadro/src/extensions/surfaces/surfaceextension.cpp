@@ -29,6 +29,7 @@
 #include <openqube/cube.h>
 
 #include "vdwsurface.h"
+#include "espsurface.h"
 #include "surfacedialog.h"
 
 #include <vector>
@@ -40,7 +41,6 @@
 #include <avogadro/color3f.h>
 #include <avogadro/meshgenerator.h>
 #include <avogadro/engine.h>
-#include <avogadro/neighborlist.h>
 #include <avogadro/glwidget.h>
 
 #include <Eigen/Core>
@@ -64,7 +64,7 @@ namespace Avogadro
   SurfaceExtension::SurfaceExtension(QObject* parent) : Extension(parent),
     m_glwidget(0), m_surfaceDialog(0), m_molecule(0), m_basis(0), m_progress(0),
     m_mesh1(0), m_mesh2(0), m_meshGen1(0), m_meshGen2(0), m_VdWsurface(0),
-    m_cube(0), m_qube(0), m_cubeColor(0)
+    m_ESPsurface(0), m_cube(0), m_qube(0), m_cubeColor(0)
   {
     QAction* action = new QAction(this);
     action->setText(tr("Create Surfaces..."));
@@ -81,6 +81,8 @@ namespace Avogadro
     m_meshGen2 = 0;
     delete m_VdWsurface;
     m_VdWsurface = 0;
+    delete m_ESPsurface;
+    m_ESPsurface = 0;
   }
 
   QList<QAction *> SurfaceExtension::actions() const
@@ -122,6 +124,8 @@ namespace Avogadro
     m_basis = 0;
     delete m_VdWsurface;
     m_VdWsurface = 0;
+    delete m_ESPsurface;
+    m_ESPsurface = 0;
     m_loadedFileName = QString();
     m_cubes.clear();
     m_cubes << FALSE_ID << FALSE_ID;
@@ -194,67 +198,45 @@ namespace Avogadro
     return false;
   }
 
-  void SurfaceExtension::calculateESP(Mesh *mesh)
+  void SurfaceExtension::calculateESP()
   {
-    // Calculate the ESP mapped onto the vertices of the Mesh supplied
-    if (!m_molecule)
+    // Calculate the ESP mapped onto the vertices of the meshes in the
+    // background, calculateDone() is called once the colors are set
+    if (!m_molecule || !m_mesh1)
       return;
 
-    // Check to see if molecule has hydrogens
-    bool hasHydrogens = false;
-    foreach (Atom *atom, m_molecule->atoms())
-      if (atom->atomicNumber() == 1) {
-        hasHydrogens = true;
-        break;
-      }
-
-    NeighborList *nbrList = new NeighborList(m_molecule, 7.0, false, 2);
-
-    std::vector<Color3f> colors;
-    for(unsigned int i=0; i < mesh->vertices().size(); ++i) {
-      const Vector3f *v = mesh->vertex(i);
-
-      double energy = 0.0;
+    if (!m_ESPsurface)
+      m_ESPsurface = new ESPSurface;
+    m_ESPsurface->setAtoms(m_molecule);
 
-      QList<Atom*> nbrAtoms = nbrList->nbrs(v);
-      // Include formal charges when there are hydrogens
-      if (hasHydrogens) {
-        foreach(Atom *a, nbrAtoms) {
-          Vector3f dist = a->pos()->cast<float>() - v->cast<float>();
-          energy += (a->formalCharge() + a->partialCharge()) / dist.squaredNorm();
-        }
-      } else {
-        foreach(Atom *a, nbrAtoms) {
-          Vector3f dist = a->pos()->cast<float>() - v->cast<float>();
-          energy += a->partialCharge() / dist.squaredNorm();
-        }
-      }
+    QList<Mesh *> meshes;
+    meshes << m_mesh1;
+    if (m_mesh2)
+      meshes << m_mesh2;
+    m_ESPsurface->calculateColors(meshes);
 
-      // Chemistry convention: red = negative, blue = positive
-      //
-      // Use HSV color model for smooth transitions
-      int red_hue = 0;
-      int blue_hue = 240;
-      int hue = 0; // meaningless if gray (i.e. low saturation)
-      int saturation = 0; // 0 = white, 0-40 = grayish, 40-255 colors from hue
-      int value = 255; // lightness or brightness (0 = black, 255 = white)
-
-      if (energy < 0.0) {
-        hue = red_hue;
-        saturation = -255 * 5 * energy;
-      } else if (energy > 0.0) {
-        hue = blue_hue;
-        saturation = 255 * 5 * energy;
-      }
+    // Set up a progress dialog
+    if (!m_progress) {
+      m_progress = new QProgressDialog(m_surfaceDialog);
+      m_progress->setCancelButtonText(tr("Abort Calculation"));
+      m_progress->setWindowModality(Qt::NonModal);
+    }
 
-      if (saturation > 255)
-        saturation = 255;
+    // Set up the progress bar
+    m_progress->setWindowTitle(tr("Calculating Electrostatic Potential"));
+    m_progress->setRange(m_ESPsurface->watcher().progressMinimum(),
+                         m_ESPsurface->watcher().progressMaximum());
+    m_progress->setValue(m_ESPsurface->watcher().progressValue());
+    m_progress->show();
 
-      QColor qcolor(QColor::fromHsv(hue, saturation, value));
-      Color3f color(qcolor.red(), qcolor.green(), qcolor.blue());
-      colors.push_back(color);
-    }
-    mesh->setColors(colors);
+    connect(&m_ESPsurface->watcher(), SIGNAL(progressValueChanged(int)),
+            m_progress, SLOT(setValue(int)));
+    connect(&m_ESPsurface->watcher(), SIGNAL(progressRangeChanged(int, int)),
+            m_progress, SLOT(setRange(int, int)));
+    connect(m_progress, SIGNAL(canceled()),
+            this, SLOT(calculateCanceled()));
+    connect(m_ESPsurface, SIGNAL(finished()),
+            this, SLOT(calculateDone()));
   }
 
   Cube * SurfaceExtension::newCube()
@@ -590,7 +572,8 @@ namespace Avogadro
   void SurfaceExtension::calculateDone()
   {
     // Figure out what to do based on the calculation phase
-    // 0 = main cube, 1 = color cube (optional) and 2 = mesh calculation
+    // 0 = main cube, 1 = color cube (optional), 2 = mesh calculation and
+    // 3 = ESP mapping (optional)
     switch (m_calculationPhase) {
       case 0: { // main cube was calculated - possibly kick off a color cube
         qDebug() << "Calculation phase 0 complete - now to phase 1...";
@@ -630,18 +613,28 @@ namespace Avogadro
         else // Still calculating one of the meshes
           return;
 
+        // If there is a color by and it is 1 then do ESP estimation
+        if (m_surfaceDialog->cubeColorType() == Cube::ESP) {
+          qDebug() << "Calculating approximate ESP mapping...";
+          m_calculationPhase = 3;
+          calculateESP();
+          return;
+        }
+      }
+      case 3: { // ESP mapped (if needed) - now display it in an engine
+        if (m_calculationPhase == 3) {
+          disconnect(m_ESPsurface, 0, this, 0);
+          disconnect(&m_ESPsurface->watcher(), 0, m_progress, 0);
+          disconnect(m_progress, 0, this, 0);
+          m_calculationPhase = -1;
+        }
+
         Engine *engine = m_surfaceDialog->currentEngine();
         if (engine) {
           QSettings settings;
           engine->writeSettings(settings);
-          // If there is a color by and it is 1 then do ESP estimation
-          if (m_surfaceDialog->cubeColorType() == Cube::ESP) {
-            qDebug() << "Calculating approximate ESP mapping...";
-            calculateESP(m_mesh1);
-            if (m_mesh2)
-              calculateESP(m_mesh2);
+          if (m_surfaceDialog->cubeColorType() == Cube::ESP)
             settings.setValue("colorMode", 1);
-          }
           else
             settings.setValue("colorMode", 0);
 
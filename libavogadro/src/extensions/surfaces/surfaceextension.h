@@ -46,6 +46,7 @@ namespace Avogadro
   class Mesh;
   class MeshGenerator;
   class VdWSurface;
+  class ESPSurface;
   class SurfaceDialog;
 
   class SurfaceExtension : public Extension
@@ -83,6 +84,7 @@ namespace Avogadro
     MeshGenerator *m_meshGen2;
 
     VdWSurface *m_VdWsurface;
+    ESPSurface *m_ESPsurface;
 
     Cube *m_cube;
     OpenQube::Cube *m_qube;
@@ -91,9 +93,9 @@ namespace Avogadro
     //! Load the appropriate basis set (if possible)
     bool loadBasis();
 
-    //! Calculate the ESP from the partial charges of the atoms on the supplied
-    //! Mesh object.
-    void calculateESP(Mesh *mesh);
+    //! Calculate the ESP from the partial charges of the atoms on the current
+    //! Mesh objects in the background.
+    void calculateESP();
 
     //! Convenience function - creates a new cube with the correct dimensions.
     Cube * newCube();
@@ -33,6 +33,7 @@
 
 #include <openbabel/mol.h>
 
+#include <algorithm>
 #include <cmath>
 
 #include <QtConcurrentMap>
@@ -49,13 +50,17 @@ namespace Avogadro
 {
   struct VdWStruct
   {
-    vector<Vector3d> *atomPos;
-    vector<double> *atomRadius;
-    Cube *cube;       // The target cube, used to initialise temp cubes too
-    unsigned int pos;  // The index ofposition of the point to calculate the MO for
+    VdWSurface *surface; // The surface with the binned atoms
+    Cube *cube;          // The target cube
+    unsigned int pos;    // The index of the first point of the row to calculate
   };
 
-  VdWSurface::VdWSurface()
+  // Values further than this outside of the VdW surface are not calculated
+  // exactly, they are clamped to this value. It is larger than the padding
+  // used around the molecule when setting the cube limits.
+  static const double VDW_CUTOFF = 3.0;
+
+  VdWSurface::VdWSurface() : m_maxRadius(0.0), m_cellSize(1.0), m_cube(0)
   {
   }
 
@@ -94,17 +99,68 @@ namespace Avogadro
     }
   }
 
+  void VdWSurface::binAtoms()
+  {
+    // Bin the atoms on a grid with cells as large as the search radius
+    m_maxRadius = 0.0;
+    for (unsigned int i = 0; i < m_atomRadius.size(); ++i)
+      if (m_atomRadius[i] > m_maxRadius)
+        m_maxRadius = m_atomRadius[i];
+    m_cellSize = m_maxRadius + VDW_CUTOFF;
+
+    Vector3d max = m_atomPos.size() ? m_atomPos[0] : Vector3d(0.0, 0.0, 0.0);
+    m_cellMin = max;
+    for (unsigned int i = 1; i < m_atomPos.size(); ++i) {
+      for (int j = 0; j < 3; ++j) {
+        if (m_atomPos[i][j] < m_cellMin[j])
+          m_cellMin[j] = m_atomPos[i][j];
+        if (m_atomPos[i][j] > max[j])
+          max[j] = m_atomPos[i][j];
+      }
+    }
+    for (int j = 0; j < 3; ++j)
+      m_cellDim[j] = static_cast<int>((max[j] - m_cellMin[j]) / m_cellSize) + 1;
+
+    // Store the atom indices sorted by cell, with the start of each cell
+    unsigned int numCells = m_cellDim.x() * m_cellDim.y() * m_cellDim.z();
+    vector<unsigned int> atomCell(m_atomPos.size());
+    m_cellStart.assign(numCells + 1, 0);
+    for (unsigned int i = 0; i < m_atomPos.size(); ++i) {
+      Vector3i c = cell(m_atomPos[i]);
+      atomCell[i] = (c.x() * m_cellDim.y() + c.y()) * m_cellDim.z() + c.z();
+      ++m_cellStart[atomCell[i] + 1];
+    }
+    for (unsigned int i = 0; i < numCells; ++i)
+      m_cellStart[i + 1] += m_cellStart[i];
+    m_cellAtoms.resize(m_atomPos.size());
+    vector<unsigned int> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (unsigned int i = 0; i < m_atomPos.size(); ++i)
+      m_cellAtoms[fill[atomCell[i]]++] = i;
+  }
+
+  inline Vector3i VdWSurface::cell(const Vector3d &pos) const
+  {
+    Vector3i c;
+    for (int j = 0; j < 3; ++j) {
+      int i = static_cast<int>(floor((pos[j] - m_cellMin[j]) / m_cellSize));
+      c[j] = i < 0 ? 0 : (i >= m_cellDim[j] ? m_cellDim[j] - 1 : i);
+    }
+    return c;
+  }
+
   void VdWSurface::calculateCube(Cube *cube)
   {
-    // Set up the calculation and ideally use the new QtConcurrent code to
-    m_VdWvector.resize(cube->data()->size());
+    binAtoms();
+
+    // Each point of the calculation is a row of the cube along z
+    int rowSize = cube->dimensions().z();
+    m_VdWvector.resize(rowSize ? cube->data()->size() / rowSize : 0);
     m_cube = cube;
 
     for (int i = 0; i < m_VdWvector.size(); ++i) {
-      m_VdWvector[i].atomPos = &m_atomPos;
-      m_VdWvector[i].atomRadius = &m_atomRadius;
+      m_VdWvector[i].surface = this;
       m_VdWvector[i].cube = cube;
-      m_VdWvector[i].pos = i;
+      m_VdWvector[i].pos = i * rowSize;
     }
 
     // Lock the cube until we are done.
@@ -128,20 +184,60 @@ namespace Avogadro
 
   void VdWSurface::processPoint(VdWStruct &vdw)
   {
-    unsigned int size = vdw.atomPos->size();
-    // Calculate our position
-    Vector3d pos = vdw.cube->position(vdw.pos);
-
-    // Now calculate the value at this point in space
-    double tmp = -1.0E+10;
-    for (unsigned int i = 0; i < size; ++i) {
-      double distance = std::abs((pos - (*vdw.atomPos)[i]).norm()) - (*vdw.atomRadius)[i];
-      if ((tmp < -1.0E+9) || (distance < tmp))
-        tmp = distance;
+    const VdWSurface *surface = vdw.surface;
+    const vector<Vector3d> &atomPos = surface->m_atomPos;
+    const vector<double> &atomRadius = surface->m_atomRadius;
+    double radius = surface->m_cellSize;
+    double radius2 = radius * radius;
+
+    // The row runs along z from start to end
+    Vector3d start = vdw.cube->position(vdw.pos);
+    int rowSize = vdw.cube->dimensions().z();
+    double step = vdw.cube->spacing().z();
+    Vector3d end(start.x(), start.y(), start.z() + (rowSize - 1) * step);
+
+    // Find the atoms within the search radius of the row, sorted along z
+    vector<std::pair<double, unsigned int> > candidates;
+    Vector3i lo = surface->cell(start - Vector3d(radius, radius, radius));
+    Vector3i hi = surface->cell(end + Vector3d(radius, radius, radius));
+    const Vector3i &dim = surface->m_cellDim;
+    for (int i = lo.x(); i <= hi.x(); ++i) {
+      for (int j = lo.y(); j <= hi.y(); ++j) {
+        for (int k = lo.z(); k <= hi.z(); ++k) {
+          unsigned int c = (i * dim.y() + j) * dim.z() + k;
+          for (unsigned int n = surface->m_cellStart[c];
+               n < surface->m_cellStart[c + 1]; ++n) {
+            unsigned int atom = surface->m_cellAtoms[n];
+            double dx = atomPos[atom].x() - start.x();
+            double dy = atomPos[atom].y() - start.y();
+            if (dx * dx + dy * dy <= radius2)
+              candidates.push_back(std::make_pair(atomPos[atom].z(), atom));
+          }
+        }
+      }
     }
+    std::sort(candidates.begin(), candidates.end());
+
+    // Slide a window of candidates within the search radius along the row
+    unsigned int first = 0;
+    for (int k = 0; k < rowSize; ++k) {
+      Vector3d pos(start.x(), start.y(), start.z() + k * step);
+      while (first < candidates.size()
+             && candidates[first].first < pos.z() - radius)
+        ++first;
+
+      // Atoms outside the search radius cannot be closer than the cutoff
+      double tmp = VDW_CUTOFF;
+      for (unsigned int n = first; n < candidates.size()
+           && candidates[n].first <= pos.z() + radius; ++n) {
+        unsigned int atom = candidates[n].second;
+        double distance = (pos - atomPos[atom]).norm() - atomRadius[atom];
+        if (distance < tmp)
+          tmp = distance;
+      }
 
-    vdw.cube->setValue(vdw.pos, tmp);
+      vdw.cube->setValue(vdw.pos + k, tmp);
+    }
   }
 
 }
-
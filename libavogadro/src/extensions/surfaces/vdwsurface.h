@@ -40,8 +40,9 @@
  *
  * This is a simple class that uses QtConcurrent::map to calculate a cube of the
  * given dimensions. It should use the number of cores available on the system.
- * Ideally some additional binning would be added to further increase speed
- * gains when calculating large cubes with large numbers of atoms.
+ * The atoms are binned on a grid so that each point of the cube only looks at
+ * the atoms nearby. Values more than a few Angstroms outside of the surface
+ * are clamped.
  */
 
 namespace Avogadro
@@ -97,12 +98,26 @@ namespace Avogadro
     std::vector<Eigen::Vector3d> m_atomPos;
     std::vector<double> m_atomRadius;
 
+    // Atoms binned on a grid with cells the size of the search radius
+    double m_maxRadius;
+    double m_cellSize;
+    Eigen::Vector3d m_cellMin;
+    Eigen::Vector3i m_cellDim;
+    std::vector<unsigned int> m_cellStart; // Offset of each cell in m_cellAtoms
+    std::vector<unsigned int> m_cellAtoms; // Atom indices sorted by cell
+
     QFuture<void> m_future;
     QFutureWatcher<void> m_watcher;
     Cube *m_cube; // Cube to put the results into
     QVector<VdWStruct> m_VdWvector;
 
-    /// Re-entrant single point forms of the calculations
+    /// Bin the atoms on a grid before calculating the cube
+    void binAtoms();
+
+    /// @return The grid cell containing pos, clamped to the grid
+    Eigen::Vector3i cell(const Eigen::Vector3d &pos) const;
+
+    /// Re-entrant form of the calculation, processes a row along z
     static void processPoint(VdWStruct &vdw);
   };
 
@@ -184,13 +184,15 @@ void AvoTubeGen::addTranslationalUnits(unsigned int num, double maxz)
 void AvoTubeGen::trimTube(double maxz)
 {
   QList<Avogadro::Atom*> atoms = m_molecule->atoms();
+  QList<Avogadro::Atom*> trimmed;
 
   for (QList<Avogadro::Atom*>::const_iterator it = atoms.constBegin(),
        it_end = atoms.constEnd(); it != it_end; ++it) {
     if ((*it)->pos()->z() > maxz) {
-      m_molecule->removeAtom(*it);
+      trimmed.append(*it);
     }
   }
+  m_molecule->removeAtoms(trimmed);
 }
 
 void AvoTubeGen::capTube()
@@ -27,10 +27,12 @@
 #include <QMessageBox>
 #include <QInputDialog>
 #include <QProgressDialog>
+#include <QCoreApplication>
+#include <QDir>
 #include <QFile>
-
-#include <fstream>
-#include <vector>
+#include <QProcess>
+#include <QTextStream>
+#include <QThread>
 
 namespace Avogadro {
 
@@ -61,56 +63,127 @@ namespace Avogadro {
       return;
     }
 
+    int numFrames = animation->numFrames();
+
+    // Frames rendered by an earlier, interrupted export are only written
+    // once POV-Ray finished them, so they can be reused
+    QDir dir(workDirectory);
+    QStringList previous;
+    for (int i = 0; i < numFrames; ++i)
+      if (dir.exists(QString::number(i) + ".png"))
+        previous.append(QString::number(i) + ".png");
+    if (!previous.isEmpty()) {
+      QMessageBox::StandardButton answer =
+        QMessageBox::question(NULL, QObject::tr("Avogadro"),
+                              QObject::tr("%1 of %2 frames were already rendered in %3.\n"
+                                          "Do you want to resume the previous export?")
+                              .arg(previous.size()).arg(numFrames).arg(workDirectory),
+                              QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel,
+                              QMessageBox::Yes);
+      if (answer == QMessageBox::Cancel)
+        return;
+      if (answer == QMessageBox::No) {
+        foreach (const QString &png, previous)
+          dir.remove(png);
+        previous.clear();
+      }
+    }
+
     double aspectRatio = getAspectRatio(widget);
     //start the progress dialog
     QProgressDialog progDialog(QObject::tr("Building video "),
-                               QObject::tr("Cancel"), 0,
-                               molecule->numConformers()*2);
+                               QObject::tr("Cancel"), 0, numFrames + 1);
     progDialog.setMinimumDuration(1);
-    progDialog.setValue(0);
+    progDialog.setValue(previous.size());
+
+    // The scene files are written here one frame at a time, as they need the
+    // widget, while up to one POV-Ray process per core renders them
+    int maxRenderers = qMax(1, QThread::idealThreadCount());
+    QList<QProcess *> renderers;
+    int rendered = previous.size();
+    bool failed = false;
 
     //list of pngfiles for mencoder
-    std::vector<QString> pngFiles;
+    QStringList pngFiles;
+
+    for (int i = 0; i <= numFrames && !failed; ++i) {
+      // Wait for a renderer to become free, or for all of them at the end
+      while (!renderers.isEmpty()
+             && (renderers.size() >= maxRenderers || i == numFrames)) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        renderers.first()->waitForFinished(50);
+        for (int j = renderers.size() - 1; j >= 0; --j) {
+          QProcess *povray = renderers[j];
+          if (povray->state() != QProcess::NotRunning)
+            continue;
+          QString partFileName = povray->property("partFileName").toString();
+          QString pngFileName = povray->property("pngFileName").toString();
+          if (povray->exitStatus() == QProcess::NormalExit
+              && povray->exitCode() == 0 && dir.rename(partFileName, pngFileName))
+            progDialog.setValue(++rendered);
+          else
+            failed = true;
+          renderers.removeAt(j);
+          delete povray;
+        }
+        if (progDialog.wasCanceled() || failed)
+          break;
+      }
+      if (progDialog.wasCanceled() || failed || i == numFrames)
+        break;
+
+      QString pngFileName = QString::number(i) + ".png";
+      pngFiles.append(pngFileName);
+      if (dir.exists(pngFileName))
+        continue;
 
-    for (int i = 0; i < animation->numFrames(); ++i) {
       QString povFileName = workDirectory + QString::number(i) + ".pov";
-      animation->setFrame(i);
+      animation->setFrame(i + 1); // Frame counting starts from 1
 
       // write the pov file
       // must be in own scope so object is destroyed and file is closed after
       // (a design flaw in POVPainterDevice?)
-      POVPainterDevice pd( povFileName, aspectRatio, widget );
-
-      progDialog.setValue(2*i);
+      {
+        POVPainterDevice pd( povFileName, aspectRatio, widget );
+      }
 
-      //make the png
-      if ( ! runPovRay(workDirectory, povFileName ) ) {
-        QMessageBox::warning( NULL, QObject::tr( "Avogadro" ), QObject::tr("Could not run povray."));
-        return;
+      QProcess *povray = startPovRay(workDirectory, povFileName, pngFileName);
+      if (!povray) {
+        failed = true;
+        break;
       }
-      progDialog.setValue(2*i+1);
+      renderers.append(povray);
+    }
 
-      QString pngFileName = workDirectory + QString::number(i) + ".png";
-      pngFiles.push_back(pngFileName);
+    // Anything still rendering was canceled, its partial image is removed so
+    // a later export renders the frame again
+    foreach (QProcess *povray, renderers) {
+      povray->kill();
+      povray->waitForFinished();
+      dir.remove(povray->property("partFileName").toString());
+      delete povray;
+    }
 
-      if (progDialog.wasCanceled()) {
-        //stop making
-        return;
-      }
+    if (failed) {
+      QMessageBox::warning( NULL, QObject::tr( "Avogadro" ), QObject::tr("Could not run povray."));
+      return;
     }
+    if (progDialog.wasCanceled())
+      return;
 
     //now run mencoder
-    runMencoder(workDirectory, videoFileName, pngFiles.begin(), pngFiles.end());
+    if (!runMencoder(workDirectory, videoFileName, pngFiles)) {
+      QMessageBox::warning( NULL, QObject::tr( "Avogadro" ), QObject::tr("Could not run mencoder."));
+      return;
+    }
 
     progDialog.setValue(progDialog.maximum());
 
     //tell user if successful
-    std::ifstream fin(QFile::encodeName(videoFileName));
-    if(!fin.fail()) {
-    fin.close();
-    QString successMessage = "Video file " + videoFileName + " written.";
-    QMessageBox::information( NULL, QObject::tr( "Avogadro" ),
-            successMessage);
+    if (QFile::exists(videoFileName)) {
+      QString successMessage = "Video file " + videoFileName + " written.";
+      QMessageBox::information( NULL, QObject::tr( "Avogadro" ),
+                                successMessage);
     }
     else {
       QString failedMessage = QObject::tr("Video file not written.");
@@ -118,42 +191,54 @@ namespace Avogadro {
     }
   }
 
-  bool TrajVideoMaker::runPovRay(QString directory, QString povFileName)
+  QProcess * TrajVideoMaker::startPovRay(const QString &directory,
+                                         const QString &povFileName,
+                                         const QString &pngFileName)
   {
-    //executable for povray.  -D suppresses the popup image.
-    const QString povrayexe = "povray -D ";
-
-    QString povRayCommand = "cd " +  directory +
-      " && " + povrayexe + ' ' + povFileName;
-    //QMessageBox::warning( NULL, QObject::tr( "Avogadro" ), povRayCommand);
-    int ret = system(povRayCommand.toStdString().c_str());
-    if (ret)
-      return false;
-    else
-      return true;
+    // Render to a temporary name, the image is only renamed to pngFileName
+    // once it is complete. -D suppresses the popup image.
+    QString partFileName = pngFileName + ".part.png";
+    QProcess *povray = new QProcess;
+    povray->setWorkingDirectory(directory);
+    povray->setProcessChannelMode(QProcess::ForwardedChannels);
+    povray->setProperty("partFileName", partFileName);
+    povray->setProperty("pngFileName", pngFileName);
+    povray->start("povray", QStringList() << "-D" << "+O" + partFileName
+                  << povFileName);
+    if (!povray->waitForStarted()) {
+      delete povray;
+      return 0;
+    }
+    return povray;
   }
 
-  template <class QStringIterator>
-  void TrajVideoMaker::runMencoder(QString pngFileDirectory, QString videoFileName,
-                                   QStringIterator startPngFiles, QStringIterator endPngFiles)
+  bool TrajVideoMaker::runMencoder(const QString &pngFileDirectory,
+                                   const QString &videoFileName,
+                                   const QStringList &pngFiles)
   {
-    //executable for mencoder
-    const QString mencoderexe = "mencoder -ovc lavc -lavcopts vcodec=mpeg4 -of avi -o ";
-
-    QString pngString;
-    for (QStringIterator pngIterator = startPngFiles;
-      pngIterator != endPngFiles; ++pngIterator) {
-      pngString += *pngIterator + ',';
+    // Pass the frames in a list file, a command line naming thousands of
+    // images is too long for some systems
+    QFile listFile(pngFileDirectory + "frames.txt");
+    if (!listFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+      return false;
+    QTextStream list(&listFile);
+    foreach (const QString &png, pngFiles)
+      list << png << '\n';
+    listFile.close();
+
+    QProcess mencoder;
+    mencoder.setWorkingDirectory(pngFileDirectory);
+    mencoder.start("mencoder", QStringList() << "-ovc" << "lavc"
+                   << "-lavcopts" << "vcodec=mpeg4" << "-of" << "avi"
+                   << "-o" << videoFileName << "mf://@frames.txt");
+    if (!mencoder.waitForStarted())
+      return false;
+    while (mencoder.state() != QProcess::NotRunning) {
+      mencoder.waitForFinished(100);
+      QCoreApplication::processEvents();
     }
-
-    //strip off last comma
-    pngString = pngString.left(pngString.length()-1);
-
-    QString mencoderCommand = "cd " + pngFileDirectory + " && " + mencoderexe + ' ' + videoFileName + " mf://" + pngString ;
-    //QMessageBox::warning( NULL, QObject::tr( "Avogadro" ), mencoderCommand);
-    int ret = system(mencoderCommand.toStdString().c_str());
-    if (ret)
-      QMessageBox::warning( NULL, QObject::tr( "Avogadro" ), QObject::tr("Could not run mencoder."));
+    return mencoder.exitStatus() == QProcess::NormalExit
+      && mencoder.exitCode() == 0;
   }
 
   double TrajVideoMaker::getAspectRatio(GLWidget* widget)
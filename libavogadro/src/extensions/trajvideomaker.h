@@ -24,6 +24,10 @@
 
 #include <avogadro/glwidget.h>
 
+#include <QStringList>
+
+class QProcess;
+
 namespace Avogadro {
 
 class Animation;
@@ -42,11 +46,12 @@ class Animation;
 
   private:
     static double getAspectRatio(GLWidget* widget);
-    static bool runPovRay(QString directory, QString povFileName);
-
-    template <class QStringIterator>
-    static void runMencoder(QString pngFileDirectory, QString videoFileName,
-               QStringIterator startPngFiles, QStringIterator endPngFiles);
+    static QProcess * startPovRay(const QString &directory,
+                                  const QString &povFileName,
+                                  const QString &pngFileName);
+    static bool runMencoder(const QString &pngFileDirectory,
+                            const QString &videoFileName,
+                            const QStringList &pngFiles);
 
   };
 }
@@ -42,9 +42,12 @@
 
 #include <QDebug>
 #include <QColor>
+#include <QHash>
 #include <QVarLengthArray>
 #include <Eigen/Geometry>
 
+#include <vector>
+
 #ifdef Q_WS_MAC
 # include <OpenGL/glu.h>
 #else
@@ -102,6 +105,28 @@ namespace Avogadro
   = static_cast<double> ( PAINTER_MAX_DETAIL_LEVEL - 1 )
     / ( PAINTER_CYLINDERS_SQRT_LIMIT_MAX_LEVEL - PAINTER_CYLINDERS_SQRT_LIMIT_MIN_LEVEL );
 //  const double   PAINTER_FRUSTUM_CULL_TRESHOLD = -0.8;
+  // Mesh buffers not drawn for this many frames are released
+  const unsigned int PAINTER_MESH_BUFFER_FRAMES = 100;
+
+  /**
+   * The GL objects holding the data of a Mesh, so it is only sent to the GPU
+   * again when Mesh::generation() changes.
+   */
+  struct MeshBuffers
+  {
+    MeshBuffers() : generation(0), lastUsed(0), vertexBuffer(0),
+                    normalBuffer(0), indexBuffer(0), colorList(0),
+                    colorListAlpha(-1.0f) {}
+
+    unsigned int generation;
+    unsigned int lastUsed;
+    GLuint vertexBuffer;
+    GLuint normalBuffer;
+    GLuint indexBuffer;
+    /** Display list of a color mesh, compiled with the alpha in colorListAlpha */
+    GLuint colorList;
+    float colorListAlpha;
+  };
 
   class GLPainterPrivate
   {
@@ -109,10 +134,15 @@ namespace Avogadro
     GLPainterPrivate() : widget ( 0 ), newQuality(-1), quality ( 0 ), overflow(0),
                          spheres ( 0 ), cylinders ( 0 ),
                          textRenderer ( new TextRenderer ), initialized ( false ), sharing ( 0 ),
-                         type(Primitive::OtherType), id ( -1 ), color(0)  {};
+                         type(Primitive::OtherType), id ( -1 ), color(0), frame(0),
+                         sphereProgram(0), cylinderProgram(0),
+                         impostorsCompiled(false) {};
     ~GLPainterPrivate()
     {
       deleteObjects();
+      foreach (MeshBuffers buffers, meshBuffers)
+        deleteMeshBuffers(buffers);
+      deleteImpostors();
       delete textRenderer;
     }
 
@@ -153,8 +183,378 @@ namespace Avogadro
     Primitive::Type type;
     int id;
     Color color;
+
+    /**
+     * Meshes uploaded to the GPU, and the number of the frame being drawn
+     * to find the ones that are no longer drawn.
+     */
+    QHash<const Mesh *, MeshBuffers> meshBuffers;
+    unsigned int frame;
+
+    /**
+     * @return The buffers of @p mesh, emptied if the mesh changed since
+     * they were filled.
+     */
+    MeshBuffers & buffers(const Mesh &mesh);
+    void deleteMeshBuffers(MeshBuffers &buffers);
+    void releaseUnusedMeshBuffers();
+
+    /**
+     * @return True if vertex buffer objects can be used, otherwise meshes
+     * are drawn from client side arrays.
+     */
+    inline bool hasBufferObjects() const;
+
+    /**
+     * Programs ray casting the spheres and cylinders of drawSpheres() and
+     * drawCylinders(), compiled the first time they are needed.
+     */
+    GLuint sphereProgram;
+    GLuint cylinderProgram;
+    bool impostorsCompiled;
+
+    /**
+     * Arrays the impostors are packed into, kept between frames to avoid
+     * allocating them again.
+     */
+    std::vector<GLfloat> impostorVertices;
+    std::vector<GLfloat> impostorCorners;
+    std::vector<GLfloat> impostorEnds;
+    std::vector<GLfloat> impostorColors;
+    std::vector<GLuint> impostorIndices;
+
+    void deleteImpostors();
+#ifdef ENABLE_GLSL
+    /**
+     * @return True if spheres and cylinders can be ray cast in the current
+     * GL state. Engine shaders, display lists and selection mode all need the
+     * fixed function geometry.
+     */
+    bool canUseImpostors();
+    void beginImpostors(GLuint program);
+    void endImpostors();
+    void drawSphereImpostors(const QVector<Eigen::Vector3d> &centers,
+                             const QVector<double> &radii,
+                             const QVector<Color3f> &colors, double alpha);
+    void drawCylinderImpostors(const QVector<Eigen::Vector3d> &ends1,
+                               const QVector<Eigen::Vector3d> &ends2,
+                               const QVector<double> &radii,
+                               const QVector<Color3f> &colors, double alpha);
+#endif
   };
 
+  inline bool GLPainterPrivate::hasBufferObjects() const
+  {
+#ifdef ENABLE_GLSL
+    return GLEW_VERSION_1_5 || GLEW_ARB_vertex_buffer_object;
+#else
+    return false;
+#endif
+  }
+
+  MeshBuffers & GLPainterPrivate::buffers(const Mesh &mesh)
+  {
+    MeshBuffers &buffers = meshBuffers[&mesh];
+    buffers.lastUsed = frame;
+    if (buffers.generation != mesh.generation()) {
+      deleteMeshBuffers(buffers);
+      buffers.generation = mesh.generation();
+    }
+    return buffers;
+  }
+
+  void GLPainterPrivate::deleteMeshBuffers(MeshBuffers &buffers)
+  {
+#ifdef ENABLE_GLSL
+    GLuint ids[] = { buffers.vertexBuffer, buffers.normalBuffer,
+                     buffers.indexBuffer };
+    for (int i = 0; i < 3; ++i)
+      if (ids[i])
+        glDeleteBuffers(1, &ids[i]);
+#endif
+    buffers.vertexBuffer = buffers.normalBuffer = buffers.indexBuffer = 0;
+    if (buffers.colorList)
+      glDeleteLists(buffers.colorList, 1);
+    buffers.colorList = 0;
+    buffers.colorListAlpha = -1.0f;
+  }
+
+  void GLPainterPrivate::releaseUnusedMeshBuffers()
+  {
+    QHash<const Mesh *, MeshBuffers>::iterator it = meshBuffers.begin();
+    while (it != meshBuffers.end()) {
+      if (frame - it->lastUsed > PAINTER_MESH_BUFFER_FRAMES) {
+        deleteMeshBuffers(*it);
+        it = meshBuffers.erase(it);
+      }
+      else
+        ++it;
+    }
+  }
+
+#ifdef ENABLE_GLSL
+  // Shared by both impostor fragment shaders: the fixed function lighting of
+  // GLWidget applied to the materials set by Color::applyAsMaterials().
+  static const char *impostorLightingSource =
+    "uniform bool light1;\n"
+    "uniform bool fog;\n"
+    "\n"
+    "void addLight(vec4 lightPosition, vec4 lightAmbient, vec4 lightDiffuse,\n"
+    "              vec4 lightSpecular, vec3 position, vec3 normal,\n"
+    "              vec3 ambient, vec3 specular,\n"
+    "              inout vec3 color, inout vec3 highlight)\n"
+    "{\n"
+    "  vec3 direction = lightPosition.w == 0.0 ? normalize(lightPosition.xyz)\n"
+    "    : normalize(lightPosition.xyz - position);\n"
+    "  float diffuse = max(dot(normal, direction), 0.0);\n"
+    "  color += lightAmbient.rgb * ambient + diffuse * lightDiffuse.rgb * gl_Color.rgb;\n"
+    "  if (diffuse > 0.0) {\n"
+    "    vec3 halfway = normalize(direction + vec3(0.0, 0.0, 1.0));\n"
+    "    highlight += pow(max(dot(normal, halfway), 0.0), 50.0)\n"
+    "      * lightSpecular.rgb * specular;\n"
+    "  }\n"
+    "}\n"
+    "\n"
+    "vec4 shade(vec3 position, vec3 normal)\n"
+    "{\n"
+    "  vec3 c = gl_Color.rgb;\n"
+    "  float s = (0.5 + abs(c.r - c.g) + abs(c.b - c.g) + abs(c.b - c.r)) / 4.0;\n"
+    "  vec3 specular = vec3(s) + (1.0 - s) * c;\n"
+    "  vec3 ambient = c / 3.0;\n"
+    "  vec3 color = gl_LightModel.ambient.rgb * ambient;\n"
+    "  vec3 highlight = vec3(0.0);\n"
+    "  addLight(gl_LightSource[0].position, gl_LightSource[0].ambient,\n"
+    "           gl_LightSource[0].diffuse, gl_LightSource[0].specular,\n"
+    "           position, normal, ambient, specular, color, highlight);\n"
+    "  if (light1)\n"
+    "    addLight(gl_LightSource[1].position, gl_LightSource[1].ambient,\n"
+    "             gl_LightSource[1].diffuse, gl_LightSource[1].specular,\n"
+    "             position, normal, ambient, specular, color, highlight);\n"
+    "  vec4 result = vec4(clamp(color, 0.0, 1.0) + highlight, gl_Color.a);\n"
+    "  if (fog) {\n"
+    "    float f = clamp((gl_Fog.end + position.z) * gl_Fog.scale, 0.0, 1.0);\n"
+    "    result.rgb = mix(gl_Fog.color.rgb, result.rgb, f);\n"
+    "  }\n"
+    "  return clamp(result, 0.0, 1.0);\n"
+    "}\n"
+    "\n"
+    "// Write the depth of the ray hit, discarding hits in front of the near plane\n"
+    "void writeDepth(vec3 position)\n"
+    "{\n"
+    "  vec4 clip = gl_ProjectionMatrix * vec4(position, 1.0);\n"
+    "  float depth = clip.z / clip.w;\n"
+    "  if (depth < -1.0)\n"
+    "    discard;\n"
+    "  gl_FragDepth = 0.5 * (gl_DepthRange.diff * depth\n"
+    "                        + gl_DepthRange.near + gl_DepthRange.far);\n"
+    "}\n"
+    "\n"
+    "// The eye ray through a point, along the view direction in orthographic mode\n"
+    "void eyeRay(vec3 position, out vec3 origin, out vec3 direction)\n"
+    "{\n"
+    "  if (gl_ProjectionMatrix[2][3] != 0.0) {\n"
+    "    origin = vec3(0.0);\n"
+    "    direction = normalize(position);\n"
+    "  }\n"
+    "  else {\n"
+    "    origin = vec3(position.xy, 0.0);\n"
+    "    direction = vec3(0.0, 0.0, -1.0);\n"
+    "  }\n"
+    "}\n";
+
+  // gl_Vertex is the center of the sphere, gl_MultiTexCoord0 the corner of
+  // the quad in xy and the radius in z. The quad is placed in front of the
+  // sphere and made large enough to cover it in perspective.
+  static const char *sphereVertexSource =
+    "varying vec3 center;\n"
+    "varying float radius;\n"
+    "varying vec3 position;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  center = (gl_ModelViewMatrix * gl_Vertex).xyz;\n"
+    "  radius = gl_MultiTexCoord0.z * length(gl_ModelViewMatrix[0].xyz);\n"
+    "  vec2 corner = gl_MultiTexCoord0.xy;\n"
+    "  float z = center.z + radius;\n"
+    "  float scale = 1.0;\n"
+    "  if (gl_ProjectionMatrix[2][3] != 0.0)\n"
+    "    scale = z / (center.z - radius);\n"
+    "  vec2 upper = center.xy + radius;\n"
+    "  vec2 lower = center.xy - radius;\n"
+    "  position.x = corner.x > 0.0 ? max(upper.x, scale * upper.x)\n"
+    "    : min(lower.x, scale * lower.x);\n"
+    "  position.y = corner.y > 0.0 ? max(upper.y, scale * upper.y)\n"
+    "    : min(lower.y, scale * lower.y);\n"
+    "  position.z = z;\n"
+    "  gl_FrontColor = gl_Color;\n"
+    "  gl_Position = gl_ProjectionMatrix * vec4(position, 1.0);\n"
+    "}\n";
+
+  static const char *sphereFragmentSource =
+    "varying vec3 center;\n"
+    "varying float radius;\n"
+    "varying vec3 position;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  vec3 origin, direction;\n"
+    "  eyeRay(position, origin, direction);\n"
+    "  vec3 m = origin - center;\n"
+    "  float b = dot(m, direction);\n"
+    "  float discriminant = b * b - dot(m, m) + radius * radius;\n"
+    "  if (discriminant < 0.0)\n"
+    "    discard;\n"
+    "  vec3 hit = origin + (-b - sqrt(discriminant)) * direction;\n"
+    "  writeDepth(hit);\n"
+    "  gl_FragColor = shade(hit, (hit - center) / radius);\n"
+    "}\n";
+
+  // gl_Vertex is the first end of the cylinder and gl_MultiTexCoord1 the
+  // second. gl_MultiTexCoord0 holds the corner of the bounding box: the end
+  // in x, the offsets across the axis in y and z, and the radius in w.
+  static const char *cylinderVertexSource =
+    "varying vec3 base;\n"
+    "varying vec3 axis;\n"
+    "varying float radius;\n"
+    "varying vec3 position;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  base = (gl_ModelViewMatrix * gl_Vertex).xyz;\n"
+    "  vec3 top = (gl_ModelViewMatrix * vec4(gl_MultiTexCoord1.xyz, 1.0)).xyz;\n"
+    "  axis = top - base;\n"
+    "  radius = gl_MultiTexCoord0.w * length(gl_ModelViewMatrix[0].xyz);\n"
+    "  vec3 direction = normalize(axis);\n"
+    "  vec3 u = normalize(cross(direction, abs(direction.x) < 0.9\n"
+    "                           ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0)));\n"
+    "  vec3 v = cross(direction, u);\n"
+    "  position = mix(base, top, gl_MultiTexCoord0.x)\n"
+    "    + radius * (gl_MultiTexCoord0.y * u + gl_MultiTexCoord0.z * v);\n"
+    "  gl_FrontColor = gl_Color;\n"
+    "  gl_Position = gl_ProjectionMatrix * vec4(position, 1.0);\n"
+    "}\n";
+
+  // The caps are not drawn, the cylinders end inside the atom spheres.
+  static const char *cylinderFragmentSource =
+    "varying vec3 base;\n"
+    "varying vec3 axis;\n"
+    "varying float radius;\n"
+    "varying vec3 position;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  vec3 origin, direction;\n"
+    "  eyeRay(position, origin, direction);\n"
+    "  float len = length(axis);\n"
+    "  vec3 a = axis / len;\n"
+    "  vec3 m = origin - base;\n"
+    "  vec3 d = direction - dot(direction, a) * a;\n"
+    "  vec3 n = m - dot(m, a) * a;\n"
+    "  float qa = dot(d, d);\n"
+    "  float qb = dot(d, n);\n"
+    "  float discriminant = qb * qb - qa * (dot(n, n) - radius * radius);\n"
+    "  if (qa < 1.0e-8 || discriminant < 0.0)\n"
+    "    discard;\n"
+    "  vec3 hit = origin + ((-qb - sqrt(discriminant)) / qa) * direction;\n"
+    "  float h = dot(hit - base, a);\n"
+    "  if (h < 0.0 || h > len)\n"
+    "    discard;\n"
+    "  writeDepth(hit);\n"
+    "  gl_FragColor = shade(hit, normalize(hit - base - h * a));\n"
+    "}\n";
+
+  // The outward facing quads of a box, the corners numbered by the bits of
+  // their offsets across the axis (1, 2) and their end (4).
+  static const GLuint boxQuads[24] = { 0, 4, 6, 2,  1, 3, 7, 5,  0, 1, 5, 4,
+                                       2, 6, 7, 3,  0, 2, 3, 1,  4, 5, 7, 6 };
+
+  static GLuint compileImpostorProgram(const char *vertexSource,
+                                       const char *fragmentSource)
+  {
+    const char *fragmentSources[] = { impostorLightingSource, fragmentSource };
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vertexSource, 0);
+    glCompileShader(vertexShader);
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 2, fragmentSources, 0);
+    glCompileShader(fragmentShader);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    // The shaders are deleted along with the program
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+      char log[1024];
+      glGetProgramInfoLog(program, sizeof(log), 0, log);
+      qDebug() << "Impostor shaders could not be linked, drawing meshes instead:"
+               << log;
+      glDeleteProgram(program);
+      return 0;
+    }
+    return program;
+  }
+
+  bool GLPainterPrivate::canUseImpostors()
+  {
+    if (!GLEW_VERSION_2_0)
+      return false;
+
+    GLint program = 0, list = 0, mode = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    glGetIntegerv(GL_LIST_INDEX, &list);
+    glGetIntegerv(GL_RENDER_MODE, &mode);
+    if (program || list || mode != GL_RENDER)
+      return false;
+
+    if (!impostorsCompiled) {
+      sphereProgram = compileImpostorProgram(sphereVertexSource,
+                                             sphereFragmentSource);
+      cylinderProgram = compileImpostorProgram(cylinderVertexSource,
+                                               cylinderFragmentSource);
+      impostorsCompiled = true;
+    }
+    return sphereProgram && cylinderProgram;
+  }
+
+  void GLPainterPrivate::beginImpostors(GLuint program)
+  {
+    glPushAttrib(GL_ENABLE_BIT | GL_POLYGON_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "light1"), glIsEnabled(GL_LIGHT1));
+    glUniform1i(glGetUniformLocation(program, "fog"), glIsEnabled(GL_FOG));
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, &impostorVertices[0]);
+    glColorPointer(4, GL_FLOAT, 0, &impostorColors[0]);
+  }
+
+  void GLPainterPrivate::endImpostors()
+  {
+    glUseProgram(0);
+    glPopClientAttrib();
+    glPopAttrib();
+  }
+#endif
+
+  void GLPainterPrivate::deleteImpostors()
+  {
+#ifdef ENABLE_GLSL
+    if (sphereProgram)
+      glDeleteProgram(sphereProgram);
+    if (cylinderProgram)
+      glDeleteProgram(cylinderProgram);
+#endif
+    sphereProgram = cylinderProgram = 0;
+    impostorsCompiled = false;
+  }
+
   inline bool GLPainterPrivate::isValid()
   {
     if(!widget)
@@ -413,6 +813,144 @@ namespace Avogadro
     popName();
   }
 
+  void GLPainter::drawSpheres(const QVector<Eigen::Vector3d> &centers,
+                              const QVector<double> &radii,
+                              const QVector<Color3f> &colors, double alpha)
+  {
+    if (!d->isValid())
+      return;
+
+    // The spheres are not named, they are picked through Engine::renderPick()
+    resetName();
+#ifdef ENABLE_GLSL
+    if (!centers.isEmpty() && d->canUseImpostors()) {
+      d->drawSphereImpostors(centers, radii, colors, alpha);
+      return;
+    }
+#endif
+    Painter::drawSpheres(centers, radii, colors, alpha);
+  }
+
+#ifdef ENABLE_GLSL
+  void GLPainterPrivate::drawSphereImpostors(const QVector<Eigen::Vector3d> &centers,
+                                             const QVector<double> &radii,
+                                             const QVector<Color3f> &colors,
+                                             double alpha)
+  {
+    // Four corners of a quad for each sphere
+    static const GLfloat quad[8] = { -1.0f, -1.0f,  1.0f, -1.0f,
+                                      1.0f,  1.0f, -1.0f,  1.0f };
+    const int n = centers.size();
+    impostorVertices.resize(12 * n);
+    impostorCorners.resize(12 * n);
+    impostorColors.resize(16 * n);
+    GLfloat *vertex = &impostorVertices[0];
+    GLfloat *corner = &impostorCorners[0];
+    GLfloat *color = &impostorColors[0];
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        *vertex++ = centers[i].x();
+        *vertex++ = centers[i].y();
+        *vertex++ = centers[i].z();
+        *corner++ = quad[2 * j];
+        *corner++ = quad[2 * j + 1];
+        *corner++ = radii[i];
+        *color++ = colors[i].red();
+        *color++ = colors[i].green();
+        *color++ = colors[i].blue();
+        *color++ = alpha;
+      }
+    }
+
+    beginImpostors(sphereProgram);
+    glDisable(GL_CULL_FACE);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(3, GL_FLOAT, 0, &impostorCorners[0]);
+    glDrawArrays(GL_QUADS, 0, 4 * n);
+    endImpostors();
+  }
+#endif
+
+  void GLPainter::drawCylinders(const QVector<Eigen::Vector3d> &ends1,
+                                const QVector<Eigen::Vector3d> &ends2,
+                                const QVector<double> &radii,
+                                const QVector<Color3f> &colors, double alpha)
+  {
+    if (!d->isValid())
+      return;
+
+    resetName();
+#ifdef ENABLE_GLSL
+    if (!ends1.isEmpty() && d->canUseImpostors()) {
+      d->drawCylinderImpostors(ends1, ends2, radii, colors, alpha);
+      return;
+    }
+#endif
+    Painter::drawCylinders(ends1, ends2, radii, colors, alpha);
+  }
+
+#ifdef ENABLE_GLSL
+  void GLPainterPrivate::drawCylinderImpostors(const QVector<Eigen::Vector3d> &ends1,
+                                               const QVector<Eigen::Vector3d> &ends2,
+                                               const QVector<double> &radii,
+                                               const QVector<Color3f> &colors,
+                                               double alpha)
+  {
+    // Eight corners of the bounding box for each cylinder
+    const int n = ends1.size();
+    impostorVertices.resize(24 * n);
+    impostorEnds.resize(24 * n);
+    impostorCorners.resize(32 * n);
+    impostorColors.resize(32 * n);
+    impostorIndices.resize(24 * n);
+    GLfloat *vertex = &impostorVertices[0];
+    GLfloat *end = &impostorEnds[0];
+    GLfloat *corner = &impostorCorners[0];
+    GLfloat *color = &impostorColors[0];
+    GLuint *index = &impostorIndices[0];
+    GLuint drawn = 0;
+    for (int i = 0; i < n; ++i) {
+      // A zero length cylinder has no axis to build the box around
+      if (ends1[i] == ends2[i])
+        continue;
+      for (int j = 0; j < 8; ++j) {
+        *vertex++ = ends1[i].x();
+        *vertex++ = ends1[i].y();
+        *vertex++ = ends1[i].z();
+        *end++ = ends2[i].x();
+        *end++ = ends2[i].y();
+        *end++ = ends2[i].z();
+        *corner++ = (j & 4) ? 1.0f : 0.0f;
+        *corner++ = (j & 1) ? 1.0f : -1.0f;
+        *corner++ = (j & 2) ? 1.0f : -1.0f;
+        *corner++ = radii[i];
+        *color++ = colors[i].red();
+        *color++ = colors[i].green();
+        *color++ = colors[i].blue();
+        *color++ = alpha;
+      }
+      for (int j = 0; j < 24; ++j)
+        *index++ = 8 * drawn + boxQuads[j];
+      ++drawn;
+    }
+    if (!drawn)
+      return;
+
+    // The back faces cover the box even when the camera is inside it
+    beginImpostors(cylinderProgram);
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_FRONT);
+    glClientActiveTexture(GL_TEXTURE1);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(3, GL_FLOAT, 0, &impostorEnds[0]);
+    glClientActiveTexture(GL_TEXTURE0);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(4, GL_FLOAT, 0, &impostorCorners[0]);
+    glDrawElements(GL_QUADS, 24 * drawn, GL_UNSIGNED_INT, &impostorIndices[0]);
+    endImpostors();
+  }
+#endif
+
   void GLPainter::drawCone(const Eigen::Vector3d &base,
                            const Eigen::Vector3d &cap,
                            double baseRadius,
@@ -989,6 +1527,10 @@ namespace Avogadro
 
   void GLPainter::drawMesh(const Mesh & mesh, int mode)
   {
+    // Nothing to draw, and no vertex array to point OpenGL at
+    if (mesh.vertices().empty())
+      return;
+
     // Now we draw the given mesh to the OpenGL widget
     switch (mode)
     {
@@ -1010,20 +1552,65 @@ namespace Avogadro
     d->color.applyAsMaterials();
 
     // Render the triangles of the mesh
-    std::vector<Eigen::Vector3f> v = mesh.vertices();
-    std::vector<Eigen::Vector3f> n = mesh.normals();
+    const std::vector<Eigen::Vector3f> &v = mesh.vertices();
+    const std::vector<Eigen::Vector3f> &n = mesh.normals();
+    const std::vector<unsigned int> &indices = mesh.indices();
 
     if (v.size() != n.size()) {
       qDebug() << "Vertices size does not equal normals size:" << v.size()
                << n.size();
       return;
     }
-
     glEnableClientState(GL_VERTEX_ARRAY);
     glEnableClientState(GL_NORMAL_ARRAY);
-    glVertexPointer(3, GL_FLOAT, 0, &(v[0]));
-    glNormalPointer(GL_FLOAT, 0, &(n[0]));
-    glDrawArrays(GL_TRIANGLES, 0, v.size());
+#ifdef ENABLE_GLSL
+    if (d->hasBufferObjects()) {
+      // The mesh is uploaded the first time it is drawn after a change, and
+      // drawn from GPU memory after that
+      MeshBuffers &buffers = d->buffers(mesh);
+      if (!buffers.vertexBuffer) {
+        glGenBuffers(1, &buffers.vertexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers.vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, v.size() * sizeof(Eigen::Vector3f),
+                     &(v[0]), GL_STATIC_DRAW);
+        glGenBuffers(1, &buffers.normalBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers.normalBuffer);
+        glBufferData(GL_ARRAY_BUFFER, n.size() * sizeof(Eigen::Vector3f),
+                     &(n[0]), GL_STATIC_DRAW);
+        if (!indices.empty()) {
+          glGenBuffers(1, &buffers.indexBuffer);
+          glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+          glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                       indices.size() * sizeof(unsigned int), &(indices[0]),
+                       GL_STATIC_DRAW);
+          glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        }
+      }
+      glBindBuffer(GL_ARRAY_BUFFER, buffers.vertexBuffer);
+      glVertexPointer(3, GL_FLOAT, 0, 0);
+      glBindBuffer(GL_ARRAY_BUFFER, buffers.normalBuffer);
+      glNormalPointer(GL_FLOAT, 0, 0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      if (indices.empty())
+        glDrawArrays(GL_TRIANGLES, 0, v.size());
+      else {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+      }
+    }
+    else
+#endif
+    {
+      // No buffer objects, e.g. software rendering, draw from the mesh
+      glVertexPointer(3, GL_FLOAT, 0, &(v[0]));
+      glNormalPointer(GL_FLOAT, 0, &(n[0]));
+      if (indices.empty())
+        glDrawArrays(GL_TRIANGLES, 0, v.size());
+      else
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT,
+                       &(indices[0]));
+    }
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_NORMAL_ARRAY);
 
@@ -1051,9 +1638,10 @@ namespace Avogadro
     }
 
     // Render the triangles of the mesh
-    std::vector<Eigen::Vector3f> v = mesh.vertices();
-    std::vector<Eigen::Vector3f> n = mesh.normals();
-    std::vector<Color3f> c = mesh.colors();
+    const std::vector<Eigen::Vector3f> &v = mesh.vertices();
+    const std::vector<Eigen::Vector3f> &n = mesh.normals();
+    const std::vector<Color3f> &c = mesh.colors();
+    const std::vector<unsigned int> &indices = mesh.indices();
 
     if (v.size() != n.size() || v.size() != c.size()) {
       qDebug() << "Vertices size does not equal normals size or color size:"
@@ -1080,14 +1668,46 @@ namespace Avogadro
 
     float alpha = d->color.alpha();
 
+    // Each vertex sets its own materials, which a color array cannot do, so
+    // the triangles are kept in a display list until the mesh changes. Not
+    // when the widget is already compiling a list, they cannot be nested.
+    GLint compiling = 0;
+    glGetIntegerv(GL_LIST_INDEX, &compiling);
+    MeshBuffers *buffers = compiling ? 0 : &d->buffers(mesh);
+    if (buffers && buffers->colorList && buffers->colorListAlpha == alpha) {
+      glCallList(buffers->colorList);
+      glPolygonMode(GL_FRONT, GL_FILL);
+      glEnable(GL_LIGHTING);
+      return;
+    }
+    if (buffers) {
+      if (!buffers->colorList)
+        buffers->colorList = glGenLists(1);
+      buffers->colorListAlpha = alpha;
+      glNewList(buffers->colorList, GL_COMPILE_AND_EXECUTE);
+    }
+
     glBegin(GL_TRIANGLES);
-    for(unsigned int i = 0; i < v.size(); ++i) {
-      applyAsMaterials(c[i], alpha);
-      glNormal3fv(n[i].data());
-      glVertex3fv(v[i].data());
+    if (indices.empty()) {
+      for(unsigned int i = 0; i < v.size(); ++i) {
+        applyAsMaterials(c[i], alpha);
+        glNormal3fv(n[i].data());
+        glVertex3fv(v[i].data());
+      }
+    }
+    else {
+      for(unsigned int i = 0; i < indices.size(); ++i) {
+        unsigned int index = indices[i];
+        applyAsMaterials(c[index], alpha);
+        glNormal3fv(n[index].data());
+        glVertex3fv(v[index].data());
+      }
     }
     glEnd();
 
+    if (buffers)
+      glEndList();
+
     glPolygonMode(GL_FRONT, GL_FILL);
     glEnable(GL_LIGHTING);
   }
@@ -1263,6 +1883,10 @@ namespace Avogadro
     d->overflow++;
     // Ensure that the painter is properly initialised
     d->isValid();
+
+    // A new frame, release meshes that were deleted or are not shown
+    if (d->overflow == 1 && ++d->frame % PAINTER_MESH_BUFFER_FRAMES == 0)
+      d->releaseUnusedMeshBuffers();
   }
 
   void GLPainter::end()
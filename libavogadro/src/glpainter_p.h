@@ -161,6 +161,25 @@ namespace Avogadro
     void drawMultiCylinder(const Eigen::Vector3d &end1, const Eigen::Vector3d &end2,
                            double radius, int order, double shift);
 
+    /**
+     * Draws many spheres in one call. When GLSL is available each sphere is
+     * ray cast on a screen aligned quad, otherwise the spheres are drawn one
+     * by one as in drawSphere().
+     */
+    void drawSpheres(const QVector<Eigen::Vector3d> &centers,
+                     const QVector<double> &radii,
+                     const QVector<Color3f> &colors, double alpha = 1.0);
+
+    /**
+     * Draws many cylinders in one call. When GLSL is available each cylinder
+     * is ray cast inside its bounding box, otherwise the cylinders are drawn
+     * one by one as in drawCylinder().
+     */
+    void drawCylinders(const QVector<Eigen::Vector3d> &ends1,
+                       const QVector<Eigen::Vector3d> &ends2,
+                       const QVector<double> &radii,
+                       const QVector<Color3f> &colors, double alpha = 1.0);
+
     /**
      * Draws a cone between the tip and the base with the base radius given.
      * @param base the position of the base of the cone.
@@ -32,6 +32,8 @@
 #include "camera.h"
 #include "glwidget.h"
 #include "glpainter_p.h"
+#include "pickpainter_p.h"
+#include "raypicker.h"
 #include "glhit.h"
 
 #include <QtGui/QMessageBox>
@@ -52,7 +54,9 @@
   #include "pythonextension_p.h"
 #endif
 
+#include <avogadro/changeset.h>
 #include <avogadro/painterdevice.h>
+#include <avogadro/primitiveculler.h>
 #include <avogadro/tool.h>
 #include <avogadro/toolgroup.h>
 #include <avogadro/extension.h>
@@ -145,6 +149,10 @@ namespace Avogadro {
     double radius( const Primitive *p ) const { return widget->radius(p); }
     const Molecule *molecule() const { return widget->molecule(); }
     Color *colorMap() const { return widget->colorMap(); }
+    const PrimitiveCuller *culler() const
+    {
+      return widget->culler()->isActive() ? widget->culler() : 0;
+    }
 
     int width() { return widget->width(); }
     int height() { return widget->height(); }
@@ -153,6 +161,29 @@ namespace Avogadro {
     GLWidget *widget;
   };
 
+  // Passed to Engine::renderPick() to record the pickable shapes
+  class PickPainterDevice : public PainterDevice
+  {
+  public:
+    PickPainterDevice(GLWidget *gl, PickPainter *pickPainter)
+      : widget(gl), m_painter(pickPainter) {}
+    ~PickPainterDevice() {}
+
+    Painter *painter() const { return m_painter; }
+    Camera *camera() const { return widget->camera(); }
+    bool isSelected( const Primitive *p ) const { return widget->isSelected(p); }
+    double radius( const Primitive *p ) const { return widget->radius(p); }
+    const Molecule *molecule() const { return widget->molecule(); }
+    Color *colorMap() const { return widget->colorMap(); }
+
+    int width() { return widget->width(); }
+    int height() { return widget->height(); }
+
+  private:
+    GLWidget *widget;
+    PickPainter *m_painter;
+  };
+
   class GLWidgetPrivate
   {
   public:
@@ -164,8 +195,10 @@ namespace Avogadro {
                         camera( new Camera ),
                         tool( 0 ),
                         toolGroup( 0 ),
-                        selectBuf( 0 ),
-                        selectBufSize( -1 ),
+                        picker( new RayPicker ),
+                        pickPainter( new PickPainter(picker) ),
+                        pickDevice( 0 ),
+                        pickDirty( true ),
                         undoStack(0),
 #ifdef ENABLE_THREADED_GL
                         thread( 0 ),
@@ -184,13 +217,16 @@ namespace Avogadro {
                         renderDebug(false),
                         renderModelViewDebug(false),
                         dlistQuick(0), dlistOpaque(0), dlistTransparent(0),
+                        frustumCulling(true),
                         pd(0)
     {
     }
 
     ~GLWidgetPrivate()
     {
-      if ( selectBuf ) delete[] selectBuf;
+      delete pickDevice;
+      delete pickPainter;
+      delete picker;
       delete camera;
 
       // free the display lists
@@ -232,8 +268,10 @@ namespace Avogadro {
     ToolGroup             *toolGroup;
     QList<Extension*>     extensions;
 
-    GLuint                *selectBuf;
-    int                    selectBufSize;
+    RayPicker             *picker;      // Pickable shapes, see GLWidget::hits()
+    PickPainter           *pickPainter; // Records the shapes into picker
+    PickPainterDevice     *pickDevice;
+    bool                   pickDirty;   // Shapes need recording again
 
     QList<QPair<QString, QPair<QList<unsigned int>, QList<unsigned int> > > > namedSelections;
     PrimitiveList          selectedPrimitives;
@@ -265,6 +303,9 @@ namespace Avogadro {
     GLuint                 dlistOpaque;
     GLuint                 dlistTransparent;
 
+    PrimitiveCuller        culler;      // Primitives in view, see render()
+    bool                   frustumCulling; // Should primitives out of view be skipped?
+
     QMutex                 textOverlayMutex; // Protects textOverlayLabels
     QList<QPointer<QLabel> > textOverlayLabels; // List of labels to render
     /**
@@ -433,6 +474,7 @@ namespace Avogadro {
 
     // New PainterDevice
     d->pd = new GLPainterDevice(this);
+    d->pickDevice = new PickPainterDevice(this, d->pickPainter);
     if(shareWidget && isSharing()) {
       // we are sharing contexts
       d->painter = static_cast<GLPainter *>(shareWidget->painter());
@@ -739,6 +781,22 @@ namespace Avogadro {
     return d->renderModelViewDebug;
   }
 
+  void GLWidget::setFrustumCulling(bool enabled)
+  {
+    d->frustumCulling = enabled;
+    update();
+  }
+
+  bool GLWidget::frustumCulling() const
+  {
+    return d->frustumCulling;
+  }
+
+  const PrimitiveCuller * GLWidget::culler() const
+  {
+    return &d->culler;
+  }
+
   void GLWidget::render()
   {
     if (!d->molecule) {
@@ -751,6 +809,8 @@ namespace Avogadro {
     }
 
     d->painter->begin(this);
+    // Anything rendered may have moved, record the pickable shapes again
+    d->pickDirty = true;
 
     if (d->painter->quality() >= 3) {
       glEnable(GL_LIGHT1);
@@ -796,6 +856,13 @@ namespace Avogadro {
       if (d->dlistTransparent == 0)
         d->dlistTransparent = glGenLists(1);
 
+      // Engines only get the primitives in view, but crystals are compiled
+      // into display lists drawn in every cell so they need all of them
+      if (d->frustumCulling && !hasUnitCell) {
+        d->culler.update(d->molecule, d->camera);
+        d->culler.setActive(true);
+      }
+
       // Opaque engine elements rendered first
       if (hasUnitCell) glNewList(d->dlistOpaque, GL_COMPILE);
       foreach(Engine *engine, d->engines)
@@ -854,6 +921,7 @@ namespace Avogadro {
         glEndList();
         renderCrystal(d->dlistTransparent);
       }
+      d->culler.setActive(false);
     }
     // Render all the inactive tools
     if ( d->toolGroup ) {
@@ -1750,6 +1818,13 @@ namespace Avogadro {
         // numBonds
         y += d->pd->painter()->drawText
           (x, y, tr("Bonds: %L1").arg(d->molecule->numBonds()));
+
+        // primitives skipped by the culling
+        if (d->frustumCulling) {
+          y += d->pd->painter()->drawText
+            (x, y, tr("Culled: %L1 atoms, %L2 bonds")
+             .arg(d->culler.culledAtoms()).arg(d->culler.culledBonds()));
+        }
       }
     } // end debug
 
@@ -1992,6 +2067,18 @@ namespace Avogadro {
             this, SLOT(unselectAtom(Atom*)));
     connect(d->molecule, SIGNAL(bondRemoved(Bond*)),
             this, SLOT(unselectBond(Bond*)));
+    connect(d->molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+            this, SLOT(unselectRemoved(Avogadro::ChangeSet)));
+
+    // Atoms that move may come into view
+    connect(d->molecule, SIGNAL(primitiveAdded(Primitive*)),
+            this, SLOT(invalidateCulling()));
+    connect(d->molecule, SIGNAL(primitiveUpdated(Primitive*)),
+            this, SLOT(invalidateCulling()));
+    connect(d->molecule, SIGNAL(primitiveRemoved(Primitive*)),
+            this, SLOT(invalidateCulling()));
+    connect(d->molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+            this, SLOT(invalidateCulling()));
 
     // setup the camera to have a nice viewpoint on the molecule
     d->camera->initializeViewPoint();
@@ -2018,6 +2105,34 @@ namespace Avogadro {
     unselectPrimitive(b);
   }
 
+  void GLWidget::unselectRemoved(const ChangeSet &changes)
+  {
+    if (!changes.contains(Primitive::AtomType, ChangeSet::Removed)
+        && !changes.contains(Primitive::BondType, ChangeSet::Removed)
+        && !changes.contains(Primitive::ResidueType, ChangeSet::Removed))
+      return;
+
+    // A removed primitive is no longer found by its id, or the id now
+    // belongs to a new one
+    PrimitiveList removed;
+    foreach (Primitive *p, d->selectedPrimitives.subList(Primitive::AtomType))
+      if (d->molecule->atomById(p->id()) != p)
+        removed.append(p);
+    foreach (Primitive *p, d->selectedPrimitives.subList(Primitive::BondType))
+      if (d->molecule->bondById(p->id()) != p)
+        removed.append(p);
+    foreach (Primitive *p, d->selectedPrimitives.subList(Primitive::ResidueType))
+      if (d->molecule->residueById(p->id()) != p)
+        removed.append(p);
+    if (removed.isEmpty())
+      return;
+
+    // Removed in one pass, unselectPrimitive() would scan the selection
+    // once per primitive
+    d->selectedPrimitives.removeAll(removed);
+    d->updateCache = true;
+  }
+
   const Molecule* GLWidget::molecule() const
   {
     return d->molecule;
@@ -2223,115 +2338,46 @@ namespace Avogadro {
 
   QList<GLHit> GLWidget::hits( int x, int y, int w, int h )
   {
-    QList<GLHit> hits;
-
-    if ( !molecule() ) return hits;
-
-    GLint viewport[4];
-    unsigned int hit_count;
-
-    int cx = w/2 + x;
-    int cy = h/2 + y;
-
-    // setup the selection buffer
-    int requiredSelectBufSize = (d->molecule->numAtoms() + d->molecule->numBonds()) * 8;
-    if ( requiredSelectBufSize > d->selectBufSize ) {
-      //resize selection buffer
-      if ( d->selectBuf ) delete[] d->selectBuf;
-      // add some margin so that resizing doesn't occur every time an atom is added
-      d->selectBufSize = requiredSelectBufSize + SEL_BUF_MARGIN;
-      if ( d->selectBufSize > SEL_BUF_MAX_SIZE ) {
-        d->selectBufSize = SEL_BUF_MAX_SIZE;
-      }
-      d->selectBuf = new GLuint[d->selectBufSize];
-    }
+    if ( !molecule() ) return QList<GLHit>();
 
+    if ( d->pickDirty ) {
+      // Record the shapes the engines render for picking. Only the shapes are
+      // needed, but some engines still issue OpenGL calls from renderPick()
+      // so make sure they cannot touch the buffers.
 #ifdef ENABLE_THREADED_GL
-    d->renderMutex.lock();
+      d->renderMutex.lock();
 #endif
-    makeCurrent();
-    //X   hits.clear();
-
-    glSelectBuffer( d->selectBufSize, d->selectBuf );
-    glRenderMode( GL_SELECT );
-    glInitNames();
-
-    // Setup a projection matrix for picking in the zone delimited by (x,y,w,h).
-    glGetIntegerv( GL_VIEWPORT, viewport );
-    glMatrixMode( GL_PROJECTION );
-    glPushMatrix();
-    glLoadIdentity();
-    gluPickMatrix( cx,viewport[3]-cy, w, h,viewport );
-
-    // now multiply that projection matrix with the perspective of the camera
-    d->camera->applyProjection();
-
-    // now load the modelview matrix from the camera
-    glMatrixMode( GL_MODELVIEW );
-    glPushMatrix();
-    glLoadIdentity();
-    d->camera->applyModelview();
+      makeCurrent();
+      glPushAttrib( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+      glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+      glDepthMask( GL_FALSE );
 
-    // now actually render using low quality, "pickrender"
-    d->painter->begin(this);
-#ifdef ENABLE_GLSL
-        if (m_glslEnabled) glUseProgramObjectARB(0);
-#endif
-    foreach(Engine *engine, d->engines) {
-      if(engine->isEnabled()) {
-        engine->renderPick(d->pd);
+      d->picker->begin();
+      foreach(Engine *engine, d->engines) {
+        if(engine->isEnabled()) {
+          engine->renderPick(d->pickDevice);
+        }
       }
-    }
-    d->painter->end();
-
-    // returning to normal rendering mode
-    hit_count = glRenderMode( GL_RENDER );
-
-    glMatrixMode( GL_PROJECTION );
-    glPopMatrix();
-    glMatrixMode( GL_MODELVIEW );
-    glPopMatrix();
+      d->picker->end();
 
+      glPopAttrib();
 #ifdef ENABLE_THREADED_GL
-    doneCurrent();
-    d->renderMutex.unlock();
+      doneCurrent();
+      d->renderMutex.unlock();
 #endif
+      d->pickDirty = false;
+    }
 
-    // if no error occurred and there are hits, process them
-    if ( hit_count > 0 ) {
-      unsigned int i, j;
-      GLuint names, type, *ptr;
-      GLuint minZ, maxZ;
-      long name;
-
-      //X   printf ("hits = %d\n", hits);
-      ptr = ( GLuint * ) d->selectBuf;
-      // for all hits and not past end of buffer
-      for (i = 0; i < hit_count && !(ptr > d->selectBuf + d->selectBufSize); ++i) {
-        names = *ptr++;
-        // make sure that we won't be passing the end of bufer
-        if ( ptr + names + 2 > d->selectBuf + d->selectBufSize ) {
-          break;
-        }
-        minZ = *ptr++;
-        maxZ = *ptr++;
-
-        // allow names of 0
-        name = -1;
-        for (j = 0; j < names/2; ++j) { /*  for each name */
-          type = *ptr++;
-          name = *ptr++;
-        }
-        if (name > -1) {
-          //            printf ("%ld(%d) ", name,type);
-          hits.append( GLHit( type,name,minZ,maxZ ) );
-        }
-      }
-      //      printf ("\n");
-      qSort( hits );
+    // The pick box (x, y, w, h) on the near and far clipping planes
+    const int px[4] = { x, x + w, x + w, x };
+    const int py[4] = { y, y, y + h, y + h };
+    Vector3d corners[8];
+    for (int i = 0; i < 4; ++i) {
+      corners[i] = d->camera->unProject( Vector3d( px[i], py[i], 0.0 ) );
+      corners[i + 4] = d->camera->unProject( Vector3d( px[i], py[i], 1.0 ) );
     }
 
-    return( hits );
+    return d->picker->hits( corners );
   }
 
   Primitive* GLWidget::computeClickedPrimitive(const QPoint& p)
@@ -2419,15 +2465,15 @@ namespace Avogadro {
 
   void GLWidget::setSelected(PrimitiveList primitives, bool select)
   {
-    foreach(Primitive *item, primitives) {
-      if (select && !d->selectedPrimitives.contains(item))
+    if (select) {
+      foreach(Primitive *item, primitives)
+        if (!d->selectedPrimitives.contains(item))
           d->selectedPrimitives.append( item );
-      else if (!select)
-        d->selectedPrimitives.removeAll( item );
-      // The engine caches must be invalidated
-      d->updateCache = true;
-      //      item->update();
     }
+    else
+      d->selectedPrimitives.removeAll( primitives );
+    // The engine caches must be invalidated
+    d->updateCache = true;
   }
 
   PrimitiveList GLWidget::selectedPrimitives() const
@@ -2437,13 +2483,16 @@ namespace Avogadro {
 
   void GLWidget::toggleSelected( PrimitiveList primitives )
   {
+    // Deselect in one pass so that toggling large sets stays linear
+    PrimitiveList deselect;
     foreach(Primitive *item, primitives)
     {
       if (d->selectedPrimitives.contains(item))
-        d->selectedPrimitives.removeAll( item );
+        deselect.append(item);
       else
         d->selectedPrimitives.append(item);
     }
+    d->selectedPrimitives.removeAll(deselect);
     // The engine caches must be invalidated
     d->updateCache = true;
   }
@@ -2452,22 +2501,12 @@ namespace Avogadro {
   {
     if (!d->molecule) return;
     // Currently handle atoms and bonds
-    foreach(Atom *a, d->molecule->atoms()) {
-      Primitive *p = static_cast<Primitive *>(a);
-      if (d->selectedPrimitives.contains(p))
-        d->selectedPrimitives.removeAll(p);
-      else
-        d->selectedPrimitives.append(p);
-    }
-    foreach(Bond *b, d->molecule->bonds()) {
-      Primitive *p = static_cast<Primitive *>(b);
-      if (d->selectedPrimitives.contains(p))
-        d->selectedPrimitives.removeAll(p);
-      else
-        d->selectedPrimitives.append(p);
-    }
-    // The engine caches must be invalidated
-    d->updateCache = true;
+    PrimitiveList primitives;
+    foreach(Atom *a, d->molecule->atoms())
+      primitives.append(a);
+    foreach(Bond *b, d->molecule->bonds())
+      primitives.append(b);
+    toggleSelected(primitives);
   }
 
   void GLWidget::clearSelected()
@@ -2838,6 +2877,13 @@ namespace Avogadro {
   {
     // Something changed and we need to invalidate the display lists
     d->updateCache = true;
+    d->pickDirty = true;
+    d->culler.invalidate();
+  }
+
+  void GLWidget::invalidateCulling()
+  {
+    d->culler.invalidate();
   }
 
 // Copied from current sources of Qt 4.7
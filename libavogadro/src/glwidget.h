@@ -46,6 +46,7 @@ class QUndoStack;
 namespace Avogadro {
 
   class Primitive;
+  class ChangeSet;
   class Atom;
   class Bond;
   class Molecule;
@@ -58,6 +59,7 @@ namespace Avogadro {
   class Engine;
   class Painter;
   class PrimitiveList;
+  class PrimitiveCuller;
 
   bool engineLessThan( const Engine* lhs, const Engine* rhs );
 
@@ -222,7 +224,10 @@ namespace Avogadro {
       QList<Engine *> engines() const;
 
       /**
-       * Get the hits for a region starting at (x, y) of size (w * h).
+       * Get the hits for a region starting at (x, y) of size (w * h), sorted
+       * front to back. The shapes the engines render in Engine::renderPick()
+       * are recorded in a RayPicker and intersected with the frustum of the
+       * region, rather than using OpenGL selection.
        */
       QList<GLHit> hits(int x, int y, int w, int h);
 
@@ -315,6 +320,23 @@ namespace Avogadro {
        */
       bool renderModelViewDebug() const;
 
+      /**
+       * Set whether the engines only draw the atoms and bonds inside the
+       * view. Enabled by default, crystals are always drawn whole.
+       */
+      void setFrustumCulling(bool enabled);
+
+      /**
+       * @return true if the atoms and bonds outside of the view are skipped.
+       */
+      bool frustumCulling() const;
+
+      /**
+       * @return The culler used for the last full render, giving the number
+       * of atoms and bonds that were skipped.
+       */
+      const PrimitiveCuller * culler() const;
+
       /**
        * Set the ToolGroup of the GLWidget.
        */
@@ -750,6 +772,12 @@ namespace Avogadro {
        */
       void unselectBond(Bond *);
 
+      /**
+       * A change set was committed, drop any removed primitives from the
+       * selection
+       */
+      void unselectRemoved(const Avogadro::ChangeSet &changes);
+
       /**
        * Add an engine to the GLWidget.
        * @param engine Engine to add to this widget.
@@ -777,6 +805,12 @@ namespace Avogadro {
        */
       void invalidateDLs();
 
+      /**
+       * Signal that atoms moved or primitives were added or removed, and the
+       * primitives in view must be found again.
+       */
+      void invalidateCulling();
+
       /**
        * update the Molecule geometry.
        */
@@ -25,6 +25,8 @@
 #include "idlist.h"
 #include "primitive.h"
 
+#include <QHash>
+
 namespace Avogadro {
 
   class IDListPrivate {
@@ -34,10 +36,14 @@ namespace Avogadro {
       int size;
 
       QVector< QList<unsigned long> > vector;
+      // Number of times each id of each type is in the list, for constant
+      // time lookups in contains()
+      QVector< QHash<unsigned long, int> > members;
   };
 
   IDList::IDList() : d(new IDListPrivate) {
     d->vector.resize(Primitive::LastType);
+    d->members.resize(Primitive::LastType);
   }
 
   IDList::IDList(const IDList &other) : d(new IDListPrivate)
@@ -45,11 +51,13 @@ namespace Avogadro {
     IDListPrivate *e = other.d;
     d->size = e->size;
     d->vector = e->vector;
+    d->members = e->members;
   }
 
   IDList::IDList(const QList<Primitive *> &other) : d(new IDListPrivate)
   {
     d->vector.resize(Primitive::LastType);
+    d->members.resize(Primitive::LastType);
     foreach(Primitive *primitive, other)
     {
       append(primitive);
@@ -59,6 +67,7 @@ namespace Avogadro {
   IDList::IDList(const PrimitiveList &other) : d(new IDListPrivate)
   {
     d->vector.resize(Primitive::LastType);
+    d->members.resize(Primitive::LastType);
     foreach(Primitive *primitive, other)
     {
       append(primitive);
@@ -70,6 +79,7 @@ namespace Avogadro {
     IDListPrivate *e = other.d;
     d->size = e->size;
     d->vector = e->vector;
+    d->members = e->members;
 
     return *this;
   }
@@ -113,17 +123,19 @@ namespace Avogadro {
   }
 
   bool IDList::contains(const Primitive *p) const {
-    return d->vector[p->type()].contains(p->id());
+    return d->members.at(p->type()).contains(p->id());
   }
 
   void IDList::append(Primitive *p) {
     d->vector[p->type()].append(p->id());
+    d->members[p->type()][p->id()]++;
     d->size++;
   }
 
   void IDList::removeAll(Primitive *p) {
-    d->vector[p->type()].removeAll(p->id());
-    d->size--;
+    if (!d->members[p->type()].remove(p->id()))
+      return;
+    d->size -= d->vector[p->type()].removeAll(p->id());
   }
 
   int IDList::size() const {
@@ -152,6 +164,7 @@ namespace Avogadro {
   void IDList::clear() {
     for( int i=0; i<d->vector.size(); i++ ) {
       d->vector[i].clear();
+      d->members[i].clear();
     }
     d->size = 0;
   }
@@ -75,7 +75,8 @@ namespace Avogadro
 
       /**
        * @param p the primitive to check if it is in any list
-       * @return true or false depending on whether p is in this list
+       * @return true or false depending on whether p is in this list, the
+       * lookup takes constant time
        */
       bool contains( const Primitive *p ) const;
 
@@ -26,6 +26,7 @@
 #include "color3f.h"
 
 #include <QReadWriteLock>
+#include <QAtomicInt>
 #include <QDebug>
 
 using Eigen::Vector3f;
@@ -33,9 +34,20 @@ using std::vector;
 
 namespace Avogadro {
 
+  namespace {
+    // Generations are unique across all meshes, so a cache keyed on the
+    // address of a deleted mesh never matches a new mesh at the same address
+    QAtomicInt meshGeneration(0);
+
+    inline unsigned int nextGeneration()
+    {
+      return meshGeneration.fetchAndAddRelaxed(1) + 1;
+    }
+  }
+
   Mesh::Mesh(QObject *parent) : Primitive(MeshType, parent), m_vertices(0),
-    m_normals(0), m_colors(0), m_stable(true), m_other(FALSE_ID), m_cube(0),
-    m_lock(new QReadWriteLock)
+    m_normals(0), m_colors(0), m_indices(0), m_stable(true), m_other(FALSE_ID), m_cube(0),
+    m_generation(nextGeneration()), m_lock(new QReadWriteLock)
   {
     m_vertices.reserve(100);
     m_normals.reserve(100);
@@ -84,6 +96,7 @@ namespace Avogadro {
   bool Mesh::setVertices(const vector<Vector3f> &values)
   {
     QWriteLocker lock(m_lock);
+    m_generation = nextGeneration();
     m_vertices.clear();
     m_vertices = values;
     return true;
@@ -92,6 +105,7 @@ namespace Avogadro {
   bool Mesh::addVertices(const vector<Vector3f> &values)
   {
     QWriteLocker lock(m_lock);
+    m_generation = nextGeneration();
     if (m_vertices.capacity() < m_vertices.size() + values.size()) {
       m_vertices.reserve(m_vertices.capacity()*2);
     }
@@ -122,6 +136,7 @@ namespace Avogadro {
   bool Mesh::setNormals(const vector<Vector3f> &values)
   {
     QWriteLocker lock(m_lock);
+    m_generation = nextGeneration();
     m_normals.clear();
     m_normals = values;
     return true;
@@ -130,6 +145,7 @@ namespace Avogadro {
   bool Mesh::addNormals(const vector<Vector3f> &values)
   {
     QWriteLocker lock(m_lock);
+    m_generation = nextGeneration();
     if (m_normals.capacity() < m_normals.size() + values.size()) {
       m_normals.reserve(m_normals.capacity()*2);
     }
@@ -145,6 +161,25 @@ namespace Avogadro {
     }
   }
 
+  const vector<unsigned int> & Mesh::indices() const
+  {
+    QReadLocker lock(m_lock);
+    return m_indices;
+  }
+
+  bool Mesh::setIndices(const vector<unsigned int> &values)
+  {
+    QWriteLocker lock(m_lock);
+    m_generation = nextGeneration();
+    if (values.size() % 3 != 0) {
+      qDebug() << "Error setting indices." << values.size();
+      return false;
+    }
+    m_indices.clear();
+    m_indices = values;
+    return true;
+  }
+
   const vector<Color3f> & Mesh::colors() const
   {
     QReadLocker lock(m_lock);
@@ -166,6 +201,7 @@ namespace Avogadro {
   bool Mesh::setColors(const vector<Color3f> &values)
   {
     QWriteLocker lock(m_lock);
+    m_generation = nextGeneration();
     m_colors.clear();
     m_colors = values;
     return true;
@@ -174,6 +210,7 @@ namespace Avogadro {
   bool Mesh::addColors(const vector<Color3f> &values)
   {
     QWriteLocker lock(m_lock);
+    m_generation = nextGeneration();
     if (m_colors.capacity() < m_colors.size() + values.size()) {
       m_colors.reserve(m_colors.capacity()*2);
     }
@@ -194,6 +231,11 @@ namespace Avogadro {
     QWriteLocker lock(m_lock);
     if (m_vertices.size() == m_normals.size()) {
       if (m_colors.size() == 1 || m_colors.size() == m_vertices.size()) {
+        // Every index must refer to an existing vertex
+        for (unsigned int i = 0; i < m_indices.size(); ++i) {
+          if (m_indices[i] >= m_vertices.size())
+            return false;
+        }
         return true;
       }
       else {
@@ -208,9 +250,11 @@ namespace Avogadro {
   bool Mesh::clear()
   {
     QWriteLocker lock(m_lock);
+    m_generation = nextGeneration();
     m_vertices.clear();
     m_normals.clear();
     m_colors.clear();
+    m_indices.clear();
     return true;
   }
 
@@ -218,9 +262,11 @@ namespace Avogadro {
   {
     QWriteLocker lock(m_lock);
     QReadLocker oLock(other.m_lock);
+    m_generation = nextGeneration();
     m_vertices = other.m_vertices;
-    m_normals = other.m_vertices;
+    m_normals = other.m_normals;
     m_colors = other.m_colors;
+    m_indices = other.m_indices;
     m_name = other.m_name;
     return *this;
   }
@@ -170,6 +170,29 @@ namespace Avogadro {
      */
     bool addNormals(const std::vector<Eigen::Vector3f> &values);
 
+    /**
+     * @return Vector containing the vertex indices of the triangles, three per
+     * triangle. Empty if every three vertices form an independent triangle.
+     */
+    const std::vector<unsigned int> & indices() const;
+
+    /**
+     * @return The number of indices.
+     */
+    unsigned int numIndices() const { return m_indices.size(); }
+
+    /**
+     * @return True if the triangles are defined by indices into shared
+     * vertices, normals and colors.
+     */
+    bool indexed() const { return !m_indices.empty(); }
+
+    /**
+     * Clear the indices vector and assign new values. Passing an empty vector
+     * makes every three vertices form an independent triangle again.
+     */
+    bool setIndices(const std::vector<unsigned int> &values);
+
     /**
      * @return Vector containing all of the colors in a one-dimensional array.
      */
@@ -209,6 +232,13 @@ namespace Avogadro {
      */
     Mesh& operator=(const Mesh& other);
 
+    /**
+     * @return A number that changes whenever the vertices, normals, colors
+     * or indices of the mesh change. Painters use it to keep the mesh in
+     * GPU memory until it is modified.
+     */
+    unsigned int generation() const { return m_generation; }
+
     /**
      * Set the name of the Mesh.
      */
@@ -230,11 +260,13 @@ namespace Avogadro {
     std::vector<Eigen::Vector3f> m_vertices;
     std::vector<Eigen::Vector3f> m_normals;
     std::vector<Color3f> m_colors;
+    std::vector<unsigned int> m_indices;
     QString m_name;
     bool m_stable;
     float m_isoValue;
     unsigned int m_other; // Unique id of the other mesh if this is part of a pair
     unsigned int m_cube; // Unique id of the cube this mesh was generated from
+    unsigned int m_generation; // Changed whenever the mesh data changes
     QReadWriteLock *m_lock;
     Q_DECLARE_PRIVATE(Mesh)
   };
@@ -29,8 +29,11 @@
 #include <avogadro/mesh.h>
 
 #include <QReadWriteLock>
+#include <QtConcurrentMap>
 #include <QDebug>
 
+#include <algorithm>
+
 using Eigen::Vector3f;
 using Eigen::Vector3i;
 
@@ -45,6 +48,7 @@ namespace Avogadro {
     m_stepSize(0.0),
     m_min(0.0, 0.0, 0.0),
     m_dim(0,0,0),
+    m_data(0),
     m_progmin(0),
     m_progmax(0)
   {
@@ -53,7 +57,7 @@ namespace Avogadro {
   MeshGenerator::MeshGenerator(const Cube *cube, Mesh *mesh,
     float iso, bool reverse, QObject *parent) : QThread(parent), m_iso(0.0),
     m_reverseWinding(reverse), m_cube(0), m_mesh(0), m_stepSize(0.0),
-    m_min(0.0, 0.0, 0.0), m_dim(0,0,0)
+    m_min(0.0, 0.0, 0.0), m_dim(0,0,0), m_data(0)
   {
     initialize(cube, mesh, iso);
   }
@@ -79,10 +83,28 @@ namespace Avogadro {
     m_min = m_cube->min().cast<float>();
     m_dim = m_cube->dimensions();
     m_progmax = m_dim.x();
+    m_data = m_cube->data();
     m_cube->lock()->unlock();
     return true;
   }
 
+  /**
+   * A slab of cells along x, marched on its own thread. Vertices are welded
+   * within the slab, and the vertex ids on the two bounding planes are kept
+   * so that the slabs can be welded together afterwards.
+   */
+  struct MeshSlab
+  {
+    MeshGenerator *generator;
+    int begin;  // First plane of cells in the slab
+    int end;    // One past the last plane of cells in the slab
+    std::vector<Vector3f> vertices;
+    std::vector<Vector3f> normals;
+    std::vector<unsigned int> indices;
+    std::vector<int> firstPlane; // Vertex ids of the y/z edges on plane begin
+    std::vector<int> lastPlane;  // Vertex ids of the y/z edges on plane end
+  };
+
   void MeshGenerator::run()
   {
     if (!m_cube || !m_mesh) {
@@ -93,37 +115,79 @@ namespace Avogadro {
     m_mesh->setStable(false);
     m_mesh->clear();
 
-    m_vertices.reserve(m_dim.x()*m_dim.y()*m_dim.z()*3);
-    m_normals.reserve(m_dim.x()*m_dim.y()*m_dim.z()*3);
-
     if (!m_cube->lock()->tryLockForRead()) {
       qDebug() << "Cannot get a read lock...";
     }
 
-    // Now to march the cube
-    for(int i = 0; i < m_dim.x()-1; ++i) {
-      for(int j = 0; j < m_dim.y()-1; ++j) {
-        for(int k = 0; k < m_dim.z()-1; ++k) {
-          marchingCube(Vector3i(i, j, k));
+    // Split the cells into slabs of planes along x, which is the slowest
+    // varying index of the cube data, and march the slabs in parallel
+    int cells = m_dim.x() - 1;
+    int numSlabs = qMin(cells, QThread::idealThreadCount() * 4);
+    std::vector<MeshSlab> slabs(numSlabs > 0 ? numSlabs : 0);
+    for (int i = 0; i < numSlabs; ++i) {
+      slabs[i].generator = this;
+      slabs[i].begin = cells * i / numSlabs;
+      slabs[i].end = cells * (i + 1) / numSlabs;
+    }
+    m_progress = 0;
+    QtConcurrent::blockingMap(slabs, MeshGenerator::processSlab);
+
+    m_cube->lock()->unlock();
+
+    // Weld the slabs together into one indexed mesh
+    unsigned int numVertices = 0, numIndices = 0;
+    for (int i = 0; i < numSlabs; ++i) {
+      numVertices += slabs[i].vertices.size();
+      numIndices += slabs[i].indices.size();
+    }
+    m_vertices.reserve(numVertices);
+    m_normals.reserve(numVertices);
+    m_indices.reserve(numIndices);
+
+    std::vector<int> previousPlane;
+    for (int i = 0; i < numSlabs; ++i) {
+      MeshSlab &slab = slabs[i];
+      std::vector<int> remap(slab.vertices.size(), -1);
+
+      // Vertices on the first plane were already added by the previous slab
+      if (!previousPlane.empty()) {
+        for (unsigned int j = 0; j < slab.firstPlane.size(); ++j) {
+          if (slab.firstPlane[j] >= 0 && previousPlane[j] >= 0)
+            remap[slab.firstPlane[j]] = previousPlane[j];
         }
       }
-      if (m_vertices.capacity() < m_vertices.size() + m_dim.y()*m_dim.x()*3) {
-        m_vertices.reserve(m_vertices.capacity()*2);
-        m_normals.reserve(m_normals.capacity()*2);
+      for (unsigned int j = 0; j < slab.vertices.size(); ++j) {
+        if (remap[j] < 0) {
+          remap[j] = m_vertices.size();
+          m_vertices.push_back(slab.vertices[j]);
+          m_normals.push_back(slab.normals[j]);
+        }
       }
-      emit progressValueChanged(i);
-    }
+      for (unsigned int j = 0; j < slab.indices.size(); ++j)
+        m_indices.push_back(remap[slab.indices[j]]);
 
-    m_cube->lock()->unlock();
+      previousPlane.assign(slab.lastPlane.size(), -1);
+      for (unsigned int j = 0; j < slab.lastPlane.size(); ++j) {
+        if (slab.lastPlane[j] >= 0)
+          previousPlane[j] = remap[slab.lastPlane[j]];
+      }
+
+      // Give the slab's memory back as soon as it has been merged
+      std::vector<Vector3f>().swap(slab.vertices);
+      std::vector<Vector3f>().swap(slab.normals);
+      std::vector<unsigned int>().swap(slab.indices);
+    }
 
     // Copy the data across
     m_mesh->setVertices(m_vertices);
     m_mesh->setNormals(m_normals);
+    m_mesh->setIndices(m_indices);
     m_mesh->setStable(true);
 
     // Now we are done give all that memory back
-    m_vertices.resize(0);
-    m_normals.resize(0);
+    std::vector<Vector3f>().swap(m_vertices);
+    std::vector<Vector3f>().swap(m_normals);
+    std::vector<unsigned int>().swap(m_indices);
   }
 
   void MeshGenerator::clear()
@@ -134,114 +198,160 @@ namespace Avogadro {
     m_stepSize = 0.0;
     m_min.setZero();
     m_dim.setZero();
+    m_data = 0;
     m_progmin = 0;
     m_progmax = 0;
   }
 
-  Vector3f MeshGenerator::normal(const Vector3f &pos)
+  void MeshGenerator::processSlab(MeshSlab &slab)
   {
-    Vector3f normal(m_cube->valuef(pos - Vector3f(0.01, 0.00, 0.00))
-                  - m_cube->valuef(pos + Vector3f(0.01, 0.00, 0.00)),
-                    m_cube->valuef(pos - Vector3f(0.00, 0.01, 0.00))
-                  - m_cube->valuef(pos + Vector3f(0.00, 0.01, 0.00)),
-                    m_cube->valuef(pos - Vector3f(0.00, 0.00, 0.01))
-                  - m_cube->valuef(pos + Vector3f(0.00, 0.00, 0.01)));
-    normal.normalize();
-    return normal;
+    slab.generator->marchSlab(slab);
   }
 
-  inline float MeshGenerator::offset(float val1, float val2)
+  void MeshGenerator::marchSlab(MeshSlab &slab)
   {
-    if (val2 - val1 < 1.0e-9f && val1 - val2 < 1.0e-9f)
-      return 0.5;
-    return (m_iso - val1) / (val2 - val1);
+    // Vertex ids are cached for every edge touched by the current plane of
+    // cells: the y and z edges on the planes either side and the x edges
+    // between them. Each surface crossing is then only calculated once.
+    const int planeSize = m_dim.y() * m_dim.z();
+    std::vector<int> lower(planeSize * 2, -1);
+    std::vector<int> upper(planeSize * 2, -1);
+    std::vector<int> across(planeSize, -1);
+
+    float values[8];
+    int edgeVertex[12];
+
+    for (int i = slab.begin; i < slab.end; ++i) {
+      std::fill(upper.begin(), upper.end(), -1);
+      std::fill(across.begin(), across.end(), -1);
+
+      for (int j = 0; j < m_dim.y() - 1; ++j) {
+        for (int k = 0; k < m_dim.z() - 1; ++k) {
+          // Make a local copy of the values at the cube's corners
+          for (int n = 0; n < 8; ++n) {
+            values[n] = value(i + a2iVertexOffset[n][0],
+                              j + a2iVertexOffset[n][1],
+                              k + a2iVertexOffset[n][2]);
+          }
+
+          // Find which vertices are inside of the surface and which are outside
+          long iFlagIndex = 0;
+          for (int n = 0; n < 8; ++n) {
+            if (values[n] <= m_iso)
+              iFlagIndex |= 1<<n;
+          }
+
+          // Find which edges are intersected by the surface
+          long iEdgeFlags = aiCubeEdgeFlags[iFlagIndex];
+
+          // No intersections if the cube is entirely inside or outside
+          if (iEdgeFlags == 0)
+            continue;
+
+          // Find (or calculate) the vertex on each intersected edge
+          for (int e = 0; e < 12; ++e) {
+            if (!(iEdgeFlags & (1<<e)))
+              continue;
+            // Always work from the lower corner of the edge, so that the
+            // neighboring cells calculate exactly the same vertex
+            int c0 = a2iEdgeConnection[e][0];
+            int c1 = a2iEdgeConnection[e][1];
+            int axis = a2fEdgeDirection[e][0] != 0.0f ? 0
+                     : (a2fEdgeDirection[e][1] != 0.0f ? 1 : 2);
+            if (a2fEdgeDirection[e][axis] < 0.0f)
+              qSwap(c0, c1);
+            Vector3i corner(i + a2iVertexOffset[c0][0],
+                            j + a2iVertexOffset[c0][1],
+                            k + a2iVertexOffset[c0][2]);
+
+            int *cached;
+            int planeIndex = corner.y() * m_dim.z() + corner.z();
+            if (axis == 0)
+              cached = &across[planeIndex];
+            else if (corner.x() == i)
+              cached = &lower[planeIndex * 2 + axis - 1];
+            else
+              cached = &upper[planeIndex * 2 + axis - 1];
+
+            if (*cached < 0) {
+              float fOffset = offset(values[c0], values[c1]);
+              Vector3i next = corner;
+              next[axis] += 1;
+
+              Vector3f pos(corner.x() * m_stepSize + m_min.x(),
+                           corner.y() * m_stepSize + m_min.y(),
+                           corner.z() * m_stepSize + m_min.z());
+              pos[axis] += fOffset * m_stepSize;
+
+              // Interpolate the gradient at the grid points to get the normal
+              Vector3f norm = gradient(corner) * (fOffset - 1.0f)
+                            - gradient(next) * fOffset;
+              norm.normalize();
+
+              *cached = slab.vertices.size();
+              slab.vertices.push_back(pos);
+              slab.normals.push_back(m_reverseWinding ? -norm : norm);
+            }
+            edgeVertex[e] = *cached;
+          }
+
+          // Store the triangles that were found, up to five per cube
+          for (int n = 0; n < 5; ++n) {
+            if (a2iTriangleConnectionTable[iFlagIndex][3*n] < 0)
+              break;
+            // Make sure we get the triangle winding the right way around!
+            if (!m_reverseWinding) {
+              for (int m = 0; m < 3; ++m) {
+                slab.indices.push_back(
+                  edgeVertex[a2iTriangleConnectionTable[iFlagIndex][3*n+m]]);
+              }
+            }
+            else {
+              for (int m = 2; m >= 0; --m) {
+                slab.indices.push_back(
+                  edgeVertex[a2iTriangleConnectionTable[iFlagIndex][3*n+m]]);
+              }
+            }
+          }
+        }
+      }
+
+      if (i == slab.begin)
+        slab.firstPlane = lower;
+      lower.swap(upper);
+      emit progressValueChanged(m_progress.fetchAndAddOrdered(1));
+    }
+    slab.lastPlane = lower;
   }
 
-  unsigned long MeshGenerator::duplicate(const Vector3i &, const Vector3f &)
+  inline float MeshGenerator::value(int i, int j, int k) const
   {
-    // FIXME Not implemented yet.
-    return 0;
+    return (*m_data)[(i * m_dim.y() + j) * m_dim.z() + k];
   }
 
-  bool MeshGenerator::marchingCube(const Vector3i &pos)
+  Vector3f MeshGenerator::gradient(const Vector3i &pos) const
   {
-    float afCubeValue[8];
-    Vector3f asEdgeVertex[12];
-    Vector3f asEdgeNorm[12];
-
-    // Calculate the position in the Cube
-    Vector3f fPos(pos.x() * m_stepSize + m_min.x(),
-                  pos.y() * m_stepSize + m_min.y(),
-                  pos.z() * m_stepSize + m_min.z());
-
-    //Make a local copy of the values at the cube's corners
-    for(int i = 0; i < 8; ++i) {
-      afCubeValue[i] = m_cube->value(Vector3i(pos + Vector3i(a2iVertexOffset[i])));
+    // Central differences on the grid, one sided at the edges of the cube
+    Vector3f grad;
+    for (int n = 0; n < 3; ++n) {
+      Vector3i lo = pos, hi = pos;
+      if (lo[n] > 0)
+        --lo[n];
+      if (hi[n] < m_dim[n] - 1)
+        ++hi[n];
+      int steps = hi[n] - lo[n];
+      grad[n] = steps ? (value(hi.x(), hi.y(), hi.z())
+                         - value(lo.x(), lo.y(), lo.z())) / steps
+                      : 0.0f;
     }
+    return grad;
+  }
 
-    //Find which vertices are inside of the surface and which are outside
-    long iFlagIndex = 0;
-    for(int i = 0; i < 8; ++i) {
-      if(afCubeValue[i] <= m_iso) {
-        iFlagIndex |= 1<<i;
-      }
-    }
-
-    //Find which edges are intersected by the surface
-    long iEdgeFlags = aiCubeEdgeFlags[iFlagIndex];
-
-    // No intersections if the cube is entirely inside or outside of the surface
-    if(iEdgeFlags == 0) {
-      return false;
-    }
-
-    //Find the point of intersection of the surface with each edge
-    //Then find the normal to the surface at those points
-    for(int i = 0; i < 12; ++i) {
-      //if there is an intersection on this edge
-      if(iEdgeFlags & (1<<i)) {
-        float fOffset = offset(afCubeValue[a2iEdgeConnection[i][0]],
-                               afCubeValue[a2iEdgeConnection[i][1]]);
-
-        asEdgeVertex[i] = Vector3f(
-          fPos.x() + (a2fVertexOffset[a2iEdgeConnection[i][0]][0]
-                      + fOffset * a2fEdgeDirection[i][0]) * m_stepSize,
-          fPos.y() + (a2fVertexOffset[a2iEdgeConnection[i][0]][1]
-                      + fOffset * a2fEdgeDirection[i][1]) * m_stepSize,
-          fPos.z() + (a2fVertexOffset[a2iEdgeConnection[i][0]][2]
-                      + fOffset * a2fEdgeDirection[i][2]) * m_stepSize);
-
-        /// FIXME Optimize this to only calculate normals when required
-        asEdgeNorm[i] = normal(asEdgeVertex[i]);
-      }
-    }
-
-    // Store the triangles that were found, there can be up to five per cube
-    for(int i = 0; i < 5; ++i) {
-      if(a2iTriangleConnectionTable[iFlagIndex][3*i] < 0)
-        break;
-      int iVertex = 0;
-      iEdgeFlags = a2iTriangleConnectionTable[iFlagIndex][3*i];
-      // Make sure we get the triangle winding the right way around!
-      if (!m_reverseWinding) {
-        for(int j = 0; j < 3; ++j) {
-          iVertex = a2iTriangleConnectionTable[iFlagIndex][3*i+j];
-          m_indices.push_back(m_vertices.size());
-          m_normals.push_back(asEdgeNorm[iVertex]);
-          m_vertices.push_back(asEdgeVertex[iVertex]);
-        }
-      }
-      else {
-        for(int j = 2; j >= 0; --j) {
-          iVertex = a2iTriangleConnectionTable[iFlagIndex][3*i+j];
-          m_indices.push_back(m_vertices.size());
-          m_normals.push_back(-asEdgeNorm[iVertex]);
-          m_vertices.push_back(asEdgeVertex[iVertex]);
-        }
-      }
-
-    }
-    return true;
+  inline float MeshGenerator::offset(float val1, float val2)
+  {
+    if (val2 - val1 < 1.0e-9f && val1 - val2 < 1.0e-9f)
+      return 0.5;
+    return (m_iso - val1) / (val2 - val1);
   }
 
   // Lists the positions, relative to vertex0, of the 8 vertices of a cube
@@ -30,6 +30,7 @@
 #include <Eigen/Core>
 
 #include <QThread>
+#include <QAtomicInt>
 
 #include <vector>
 
@@ -37,6 +38,7 @@
 
   class Cube;
   class Mesh;
+  struct MeshSlab;
 
   /**
    * @class MeshGenerator meshgenerator.h <avogadro/meshgenerator.h>
@@ -128,12 +130,17 @@
 
   protected:
     /**
-     * Get the normal to the supplied point. This operation is quite expensive
-     * and so should be avoided wherever possible.
-     * @param pos The position of the vertex whose normal is needed.
-     * @return The normal vector for the supplied point.
+     * @return The value of the Cube at the grid point i, j, k.
+     */
+    float value(int i, int j, int k) const;
+
+    /**
+     * Get the gradient at a grid point from central differences of the
+     * neighboring grid points.
+     * @param pos The grid point whose gradient is needed.
+     * @return The gradient vector at the supplied grid point.
      */
-    Eigen::Vector3f normal(const Eigen::Vector3f &pos);
+    Eigen::Vector3f gradient(const Eigen::Vector3i &pos) const;
 
     /**
      * Get the offset, i.e. the approximate point of intersection of the surface
@@ -143,13 +150,16 @@
      */
     float offset(float val1, float val2);
 
-    unsigned long duplicate(const Eigen::Vector3i &c,
-                            const Eigen::Vector3f &pos);
+    /**
+     * Perform the marching cubes algorithm on a slab of the cube, sharing
+     * the vertices between neighboring cells.
+     */
+    void marchSlab(MeshSlab &slab);
 
     /**
-     * Perform a marching cubes step on a single cube.
+     * Re-entrant entry point used to march the slabs in parallel.
      */
-    bool marchingCube(const Eigen::Vector3i &pos);
+    static void processSlab(MeshSlab &slab);
 
     float m_iso;           /** The value of the isosurface. */
     bool m_reverseWinding; /** Whether the winding and normals are reversed */
@@ -160,6 +170,8 @@
     Eigen::Vector3i m_dim; /** The dimensions of the cube. */
     std::vector<Eigen::Vector3f> m_vertices, m_normals;
     std::vector<unsigned int> m_indices;
+    const std::vector<double> *m_data; /** The values of the cube. */
+    QAtomicInt m_progress; /** Number of planes of cells completed. */
     int m_progmin;
     int m_progmax;
 
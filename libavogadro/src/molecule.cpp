@@ -33,11 +33,13 @@
 #include "obeigenconv.h"
 #include "primitivelist.h"
 #include "residue.h"
+#include "ringperceiver.h"
 #include "zmatrix.h"
 
 #include <Eigen/Geometry>
 #include <Eigen/LeastSquares>
 
+#include <map>
 #include <vector>
 
 #include <openbabel/mol.h>
@@ -48,8 +50,10 @@
 #include <openbabel/forcefield.h>
 #include <openbabel/obiter.h>
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QDir>
 #include <QtCore/QDebug>
+#include <QtCore/QMutexLocker>
 #include <QtCore/QVariant>
 #include <QtCore/QVector>
 
@@ -58,11 +62,45 @@ namespace Avogadro{
   using std::vector;
   using Eigen::Vector3d;
 
+  namespace {
+    // Versions are unique across all molecules, so a cache keyed on a
+    // version never matches a different molecule
+    QAtomicInt lastVersion(0);
+
+    inline unsigned int nextVersion()
+    {
+      return lastVersion.fetchAndAddRelaxed(1) + 1;
+    }
+
+    // Merge the last indices.size() items of list into the others so they
+    // end up at indices, which are sorted
+    template <typename T>
+    QList<T *> mergeAtIndices(const QList<T *> &list,
+                              const vector<unsigned long> &indices)
+    {
+      const int existing = list.size() - static_cast<int>(indices.size());
+      QList<T *> merged;
+      int e = 0;
+      unsigned int k = 0;
+      for (int i = 0; i < list.size(); ++i) {
+        if (k < indices.size() && (indices[k] <= static_cast<unsigned long>(i)
+                                   || e == existing))
+          merged.append(list[existing + k++]);
+        else
+          merged.append(list[e++]);
+      }
+      return merged;
+    }
+  }
+
   class MoleculePrivate {
     public:
       MoleculePrivate() : farthestAtom(0), invalidGeomInfo(true),
                           invalidRings(true), invalidGroupIndices(true),
-                          obmol(0), obunitcell(0),
+                          invalidAdjacency(true), changeSetDepth(0), obmol(0), invalidOBMol(0), obmolFlags(0),
+                          topologyVersion(nextVersion()),
+                          positionsVersion(nextVersion()),
+                          obunitcell(0),
                           obvibdata(0), obdosdata(0),
                           obelectronictransitiondata(0)
     {}
@@ -76,14 +114,29 @@ namespace Avogadro{
       mutable bool                  invalidGeomInfo;
       mutable bool                  invalidRings;
       mutable bool                  invalidGroupIndices;
+      mutable bool                  invalidAdjacency;
       mutable std::vector<double>   energies;
 
+      // Nesting depth of beginChangeSet() and the changes recorded so far
+      int                           changeSetDepth;
+      ChangeSet                     changeSet;
+      // Atoms removed in the open change set, their per atom data is only
+      // cleared once the change set was committed
+      std::vector<unsigned long>    removedAtomData;
+
+      // The bonded neighbors of each atom, see adjacencyOffsets()
+      mutable std::vector<unsigned int>  adjacencyOffsets;
+      mutable std::vector<unsigned long> adjacentAtoms;
+      mutable std::vector<unsigned long> adjacentBonds;
+
       // std::vector used over QVector due to index issues, QVector uses ints
       std::vector<Cube *>           cubes;
       std::vector<Mesh *>           meshes;
       std::vector<Residue *>        residues;
       std::vector<Fragment *>       rings;
       std::vector<ZMatrix *>        zMatrix;
+      // The rings of each ring system, keyed by its bonds, see rings()
+      std::map<std::vector<unsigned long>, QList<Fragment *> > ringSystems;
 
       // Used to store the index based list (not unique ids)
       QList<Cube *>                 cubeList;
@@ -92,8 +145,27 @@ namespace Avogadro{
       QList<Fragment *>             ringList;
       QList<ZMatrix *>              zMatrixList;
 
-      // Our OpenBabel OBMol object
-      OpenBabel::OBMol *            obmol;
+      // Our OpenBabel OBMol object, kept as a cache for OBMol()
+      mutable OpenBabel::OBMol *    obmol;
+      // The parts of obmol that are out of date, see Molecule::OBMolChange
+      mutable int                   invalidOBMol;
+      // The perception flags of obmol right after it was built
+      mutable int                   obmolFlags;
+      mutable QMutex                obmolMutex;
+      // Changed along with anything but the positions of obmol
+      mutable unsigned int          topologyVersion;
+      // Changed along with the positions of obmol
+      mutable unsigned int          positionsVersion;
+
+      // Mark part of obmol as out of date, see Molecule::invalidateOBMol()
+      void invalidateOBMol(int changes) const
+      {
+        invalidOBMol |= changes;
+        if (changes & (Molecule::OBMolTopology | Molecule::OBMolChemistry))
+          topologyVersion = nextVersion();
+        if (changes & Molecule::OBMolPositions)
+          positionsVersion = nextVersion();
+      }
       // Our OpenBabel OBUnitCell object (if any)
       OpenBabel::OBUnitCell *       obunitcell;
       // Our OpenBabel OBVibrationData object (if any)
@@ -115,6 +187,8 @@ namespace Avogadro{
                                         m_invalidAromaticity(true),
                                         m_lock(new QReadWriteLock)
   {
+    // Allow change sets to be queued and captured by QSignalSpy
+    qRegisterMetaType<ChangeSet>("Avogadro::ChangeSet");
     connect(this, SIGNAL(updated()), this, SLOT(updatePrimitive()));
     // Assign a default path and file name to new molecules.
     m_fileName = QDir::homePath() + '/' +
@@ -162,6 +236,8 @@ namespace Avogadro{
   {
     Q_D(const Molecule);
     d->invalidGeomInfo = true;
+    d->invalidAdjacency = true;
+    d->invalidateOBMol(OBMolTopology);
     Atom *atom = new Atom(this);
 
     if (!m_atomPos) {
@@ -175,16 +251,17 @@ namespace Avogadro{
       m_atoms.resize(id+1,0);
       m_atomPos->resize(id+1, Vector3d::Zero());
     }
+    resizeAtomData(id);
+    clearAtomData(id);
     m_atoms[id] = atom;
     // Does this still want to have the same index as before somehow?
     m_atomList.push_back(atom);
 
     atom->setId(id);
     atom->setIndex(m_atomList.size()-1);
-    // now that the id is correct, emit the signal
-    connect(atom, SIGNAL(updated()), this, SLOT(updateAtom()));
     d->invalidGroupIndices = true;
-    emit atomAdded(atom);
+    if (!recordChange(atom, ChangeSet::Added))
+      emit atomAdded(atom);
     return atom;
   }
 
@@ -194,7 +271,7 @@ namespace Avogadro{
     const unsigned long newId = m_atoms.size();
     Atom *newAtom = this->addAtom(newId);
 
-    newAtom->m_atomicNumber = atomicNum;
+    m_atomicNumbers[newId] = atomicNum;
     (*m_atomPos)[newId] = pos;
 
     return newAtom;
@@ -215,6 +292,7 @@ namespace Avogadro{
     if (id < m_atomPos->size()) {
       (*m_atomPos)[id] = vec;
       d->invalidGeomInfo = true;
+      d->invalidateOBMol(OBMolPositions);
     }
   }
 
@@ -226,30 +304,69 @@ namespace Avogadro{
 
   void Molecule::removeAtom(Atom *atom)
   {
-    Q_D(const Molecule);
-    if(atom && atom->parent() == this) {
+    if (atom)
+      removeAtoms(QList<Atom *>() << atom);
+  }
+
+  void Molecule::removeAtom(unsigned long id)
+  {
+    removeAtom(atomById(id));
+  }
+
+  void Molecule::removeAtoms(const QList<Atom *> &atoms)
+  {
+    Q_D(Molecule);
+    // Skip atoms of other molecules and repeated atoms
+    vector<bool> marked(m_atoms.size(), false);
+    QList<Atom *> removed;
+    QList<Bond *> bonds;
+    foreach (Atom *atom, atoms) {
+      if (!atom || atom->parent() != this || m_atoms[atom->id()] != atom
+          || marked[atom->id()])
+        continue;
+      marked[atom->id()] = true;
+      removed.append(atom);
       // When deleting an atom this also implicitly deletes any bonds to the atom
-      foreach (unsigned long bond, atom->bonds()) {
-        removeBond(bond);
-      }
+      foreach (unsigned long bond, atom->bonds())
+        bonds.append(bondById(bond));
+    }
+    if (removed.isEmpty())
+      return;
 
+    removeBonds(bonds);
+
+    foreach (Atom *atom, removed)
       m_atoms[atom->id()] = 0;
-      // 1 based arrays stored/shown to user
-      int index = atom->index();
-      m_atomList.removeAt(index);
-      for (int i = index; i < m_atomList.size(); ++i)
-        m_atomList[i]->setIndex(i);
-      atom->deleteLater();
 
-      disconnect(atom, SIGNAL(updated()), this, SLOT(updateAtom()));
-      d->invalidGroupIndices = true;
-      emit atomRemoved(atom);
+    // Close the gaps and renumber the remaining atoms in one pass
+    int index = removed.first()->index();
+    foreach (Atom *atom, removed)
+      index = qMin(index, static_cast<int>(atom->index()));
+    for (int i = index; i < m_atomList.size(); ++i) {
+      Atom *atom = m_atomList[i];
+      if (!marked[atom->id()]) {
+        atom->setIndex(index);
+        m_atomList[index++] = atom;
+      }
     }
-  }
+    m_atomList.erase(m_atomList.begin() + index, m_atomList.end());
 
-  void Molecule::removeAtom(unsigned long id)
-  {
-    removeAtom(atomById(id));
+    d->invalidGroupIndices = true;
+    d->invalidAdjacency = true;
+    d->invalidateOBMol(OBMolTopology);
+    foreach (Atom *atom, removed) {
+      atom->deleteLater();
+      if (!recordChange(atom, ChangeSet::Removed))
+        emit atomRemoved(atom);
+    }
+
+    // Clear the per atom data once the slots have seen the removed atoms
+    foreach (Atom *atom, removed) {
+      if (d->changeSetDepth)
+        d->removedAtomData.push_back(atom->id());
+      else
+        clearAtomData(atom->id());
+    }
   }
 
   Bond *Molecule::addBond()
@@ -263,8 +380,10 @@ namespace Avogadro{
     Bond *bond = new Bond(this);
 
     d->invalidRings = true;
+    d->invalidAdjacency = true;
     m_invalidPartialCharges = true;
     m_invalidAromaticity = true;
+    d->invalidateOBMol(OBMolTopology);
     if(id >= m_bonds.size())
       m_bonds.resize(id+1,0);
     m_bonds[id] = bond;
@@ -272,9 +391,8 @@ namespace Avogadro{
 
     bond->setId(id);
     bond->setIndex(m_bondList.size()-1);
-    // now that the id is correct, emit the signal
-    connect(bond, SIGNAL(updated()), this, SLOT(updateBond()));
-    emit bondAdded(bond);
+    if (!recordChange(bond, ChangeSet::Added))
+      emit bondAdded(bond);
     return(bond);
   }
 
@@ -297,42 +415,63 @@ namespace Avogadro{
 
   void Molecule::removeBond(Bond *bond)
   {
-    if(bond && bond->parent() == this) {
-      removeBond(bond->id());
-    }
+    if (bond)
+      removeBonds(QList<Bond *>() << bond);
   }
 
   void Molecule::removeBond(unsigned long id)
   {
-    if (id < m_bonds.size()) {
-      Q_D(Molecule);
-      if (m_bonds[id] == 0)
-        return;
-
-      d->invalidRings = true;
-      m_invalidPartialCharges = true;
-      m_invalidAromaticity = true;
-      Bond *bond = m_bonds[id];
-      m_bonds[id] = 0;
-      // Delete the bond from the list and reorder the remaining bonds
-      int index = bond->index();
-      m_bondList.removeAt(index);
-      for (int i = index; i < m_bondList.size(); ++i) {
-        m_bondList[i]->setIndex(i);
-      }
+    removeBond(bondById(id));
+  }
 
-      // Also delete the bond from the attached atoms
-      if (m_atoms.size() > bond->beginAtomId()) {
-        if (m_atoms[bond->beginAtomId()])
-          m_atoms[bond->beginAtomId()]->removeBond(id);
-      }
-      if (m_atoms.size() > bond->endAtomId()) {
-        if (m_atoms[bond->endAtomId()])
-          m_atoms[bond->endAtomId()]->removeBond(id);
+  void Molecule::removeBonds(const QList<Bond *> &bonds)
+  {
+    Q_D(Molecule);
+    // Skip bonds of other molecules and repeated bonds
+    vector<bool> marked(m_bonds.size(), false);
+    QList<Bond *> removed;
+    foreach (Bond *bond, bonds) {
+      if (!bond || bond->parent() != this || m_bonds[bond->id()] != bond
+          || marked[bond->id()])
+        continue;
+      marked[bond->id()] = true;
+      removed.append(bond);
+    }
+    if (removed.isEmpty())
+      return;
+
+    d->invalidRings = true;
+    d->invalidAdjacency = true;
+    m_invalidPartialCharges = true;
+    m_invalidAromaticity = true;
+    d->invalidateOBMol(OBMolTopology);
+
+    // Close the gaps and renumber the remaining bonds in one pass
+    int index = removed.first()->index();
+    foreach (Bond *bond, removed) {
+      m_bonds[bond->id()] = 0;
+      index = qMin(index, static_cast<int>(bond->index()));
+    }
+    for (int i = index; i < m_bondList.size(); ++i) {
+      Bond *bond = m_bondList[i];
+      if (!marked[bond->id()]) {
+        bond->setIndex(index);
+        m_bondList[index++] = bond;
       }
+    }
+    m_bondList.erase(m_bondList.begin() + index, m_bondList.end());
 
-      disconnect(bond, SIGNAL(updated()), this, SLOT(updateBond()));
-      emit bondRemoved(bond);
+    foreach (Bond *bond, removed) {
+      // Also delete the bond from the attached atoms
+      Atom *atom = atomById(bond->beginAtomId());
+      if (atom)
+        atom->removeBond(bond->id());
+      atom = atomById(bond->endAtomId());
+      if (atom)
+        atom->removeBond(bond->id());
+
+      if (!recordChange(bond, ChangeSet::Removed))
+        emit bondRemoved(bond);
       bond->deleteLater();
     }
   }
@@ -400,13 +539,15 @@ namespace Avogadro{
     d->cubes[id] = cube;
     // Does this still want to have the same index as before somehow?
     d->cubeList.push_back(cube);
+    d->invalidateOBMol(OBMolTopology);
 
     cube->setId(id);
     cube->setIndex(d->cubeList.size()-1);
 
     // now that the id is correct, emit the signal
     connect(cube, SIGNAL(updated()), this, SLOT(updatePrimitive()));
-    emit primitiveAdded(cube);
+    if (!recordChange(cube, ChangeSet::Added))
+      emit primitiveAdded(cube);
     return(cube);
   }
 
@@ -415,6 +556,7 @@ namespace Avogadro{
     Q_D(Molecule);
     if(cube && cube->parent() == this) {
       d->cubes[cube->id()] = 0;
+      d->invalidateOBMol(OBMolTopology);
       // 0 based arrays stored/shown to user
       int index = cube->index();
       d->cubeList.removeAt(index);
@@ -423,7 +565,8 @@ namespace Avogadro{
 
       cube->deleteLater();
       disconnect(cube, SIGNAL(updated()), this, SLOT(updatePrimitive()));
-      emit primitiveRemoved(cube);
+      if (!recordChange(cube, ChangeSet::Removed))
+        emit primitiveRemoved(cube);
     }
   }
 
@@ -456,7 +599,8 @@ namespace Avogadro{
 
     // now that the id is correct, emit the signal
     connect(mesh, SIGNAL(updated()), this, SLOT(updatePrimitive()));
-    emit primitiveAdded(mesh);
+    if (!recordChange(mesh, ChangeSet::Added))
+      emit primitiveAdded(mesh);
     return(mesh);
   }
 
@@ -473,7 +617,8 @@ namespace Avogadro{
 
       mesh->deleteLater();
       disconnect(mesh, SIGNAL(updated()), this, SLOT(updatePrimitive()));
-      emit primitiveRemoved(mesh);
+      if (!recordChange(mesh, ChangeSet::Removed))
+        emit primitiveRemoved(mesh);
     }
   }
 
@@ -518,13 +663,15 @@ namespace Avogadro{
       d->residues.resize(id+1,0);
     d->residues[id] = residue;
     d->residueList.push_back(residue);
+    d->invalidateOBMol(OBMolTopology);
 
     residue->setId(id);
     residue->setIndex(d->residueList.size()-1);
 
     // now that the id is correct, emit the signal
     connect(residue, SIGNAL(updated()), this, SLOT(updatePrimitive()));
-    emit primitiveAdded(residue);
+    if (!recordChange(residue, ChangeSet::Added))
+      emit primitiveAdded(residue);
     return(residue);
   }
 
@@ -533,6 +680,7 @@ namespace Avogadro{
     Q_D(Molecule);
     if(residue && residue->parent() == this) {
       d->residues[residue->id()] = 0;
+      d->invalidateOBMol(OBMolTopology);
       // 0 based arrays stored/shown to user
       int index = residue->index();
       d->residueList.removeAt(index);
@@ -542,7 +690,8 @@ namespace Avogadro{
 
       residue->deleteLater();
       disconnect(residue, SIGNAL(updated()), this, SLOT(updatePrimitive()));
-      emit primitiveRemoved(residue);
+      if (!recordChange(residue, ChangeSet::Removed))
+        emit primitiveRemoved(residue);
     }
   }
 
@@ -553,6 +702,36 @@ namespace Avogadro{
       removeResidue(d->residues[id]);
   }
 
+  void Molecule::moveToIndices(Primitive::Type type,
+                               const vector<unsigned long> &indices)
+  {
+    Q_D(Molecule);
+    if (indices.empty())
+      return;
+
+    if (type == Primitive::AtomType) {
+      m_atomList = mergeAtIndices(m_atomList, indices);
+      for (int i = 0; i < m_atomList.size(); ++i)
+        m_atomList[i]->setIndex(i);
+      d->invalidGroupIndices = true;
+      d->invalidAdjacency = true;
+    }
+    else if (type == Primitive::BondType) {
+      m_bondList = mergeAtIndices(m_bondList, indices);
+      for (int i = 0; i < m_bondList.size(); ++i)
+        m_bondList[i]->setIndex(i);
+      d->invalidAdjacency = true;
+    }
+    else if (type == Primitive::ResidueType) {
+      d->residueList = mergeAtIndices(d->residueList, indices);
+      for (int i = 0; i < d->residueList.size(); ++i)
+        d->residueList[i]->setIndex(i);
+    }
+    else
+      return;
+    d->invalidateOBMol(OBMolTopology);
+  }
+
   Fragment * Molecule::addRing()
   {
     Q_D(const Molecule);
@@ -733,13 +912,14 @@ namespace Avogadro{
     if (atom) {
       // Delete any connected hydrogen atoms
       QList<unsigned long> neighbors = atom->neighbors();
+      QList<Atom *> hydrogens;
 
       foreach (unsigned long a, neighbors) {
         Atom *nbrAtom = atomById(a);
         // we need to check if the atom still exists
         if (nbrAtom) {
           if (nbrAtom->isHydrogen()) {
-            removeAtom(a);
+            hydrogens.append(nbrAtom);
           }
         }
         else {
@@ -747,14 +927,17 @@ namespace Avogadro{
                    << a;
         }
       }
+      removeAtoms(hydrogens);
     }
     // Delete all of the hydrogens
     else {
+      QList<Atom *> hydrogens;
       foreach (Atom *atom, m_atomList) {
         if (atom->isHydrogen()) {
-          removeAtom(atom);
+          hydrogens.append(atom);
         }
       }
+      removeAtoms(hydrogens);
     }
   }
 
@@ -792,11 +975,16 @@ namespace Avogadro{
     if (numAtoms() < 1 || !m_invalidPartialCharges) {
       return;
     }
-    OpenBabel::OBMol obmol = OBMol();
+    Q_D(const Molecule);
+    QMutexLocker locker(&d->obmolMutex);
+    OpenBabel::OBMol *obmol = cachedOBMol();
     for (unsigned int i = 0; i < numAtoms(); ++i) {
       // Warning: OB off-by-one index
-      atom(i)->setPartialCharge(obmol.GetAtom(i+1)->GetPartialCharge());
+      m_partialCharges[m_atomList[i]->id()] =
+          obmol->GetAtom(i+1)->GetPartialCharge();
     }
+    // The cached OBMol already has these charges
+    d->invalidOBMol &= ~OBMolProperties;
     m_invalidPartialCharges = false;
   }
 
@@ -805,9 +993,11 @@ namespace Avogadro{
     if (numBonds() < 1 || !m_invalidAromaticity)
       return;
 
-    OpenBabel::OBMol obmol = OBMol();
-    for (unsigned int i = 0; i < obmol.NumBonds(); ++i) {
-      bond(i)->setAromaticity(obmol.GetBond(i)->IsAromatic());
+    Q_D(const Molecule);
+    QMutexLocker locker(&d->obmolMutex);
+    OpenBabel::OBMol *obmol = cachedOBMol();
+    for (unsigned int i = 0; i < obmol->NumBonds(); ++i) {
+      bond(i)->setAromaticity(obmol->GetBond(i)->IsAromatic());
     }
     m_invalidAromaticity = false;
   }
@@ -864,6 +1054,98 @@ namespace Avogadro{
     return m_atomList.size();
   }
 
+  void Molecule::reserve(unsigned int atoms, unsigned int bonds)
+  {
+    if (!m_atomPos) {
+      m_atomConformers.resize(1);
+      m_atomConformers[0] = new vector<Vector3d>;
+      m_atomPos = m_atomConformers[0];
+    }
+    m_atomPos->reserve(atoms);
+    m_atoms.reserve(atoms);
+    m_atomicNumbers.reserve(atoms);
+    m_formalCharges.reserve(atoms);
+    m_partialCharges.reserve(atoms);
+    m_atomFlags.reserve(atoms);
+    m_bonds.reserve(bonds);
+  }
+
+  void Molecule::resizeAtomData(unsigned long id)
+  {
+    if (id >= m_atomicNumbers.size()) {
+      m_atomicNumbers.resize(id+1, 0);
+      m_formalCharges.resize(id+1, 0);
+      m_partialCharges.resize(id+1, 0.0);
+      m_atomFlags.resize(id+1, 0);
+    }
+  }
+
+  void Molecule::clearAtomData(unsigned long id)
+  {
+    m_atomicNumbers[id] = 0;
+    m_formalCharges[id] = 0;
+    m_partialCharges[id] = 0.0;
+    m_atomFlags[id] = 0;
+  }
+
+  const std::vector<unsigned int> & Molecule::adjacencyOffsets() const
+  {
+    Q_D(const Molecule);
+    updateAdjacency();
+    return d->adjacencyOffsets;
+  }
+
+  const std::vector<unsigned long> & Molecule::adjacentAtoms() const
+  {
+    Q_D(const Molecule);
+    updateAdjacency();
+    return d->adjacentAtoms;
+  }
+
+  const std::vector<unsigned long> & Molecule::adjacentBonds() const
+  {
+    Q_D(const Molecule);
+    updateAdjacency();
+    return d->adjacentBonds;
+  }
+
+  void Molecule::updateAdjacency() const
+  {
+    Q_D(const Molecule);
+    if (!d->invalidAdjacency)
+      return;
+
+    // Count the neighbors of each atom, then fill in the rows
+    unsigned long size = m_atoms.size();
+    vector<unsigned int> &offsets = d->adjacencyOffsets;
+    offsets.assign(size + 1, 0);
+    foreach (const Bond *bond, m_bondList) {
+      unsigned long begin = bond->beginAtomId();
+      unsigned long end = bond->endAtomId();
+      if (begin >= size || end >= size)
+        continue;
+      ++offsets[begin + 1];
+      ++offsets[end + 1];
+    }
+    for (unsigned long i = 0; i < size; ++i)
+      offsets[i + 1] += offsets[i];
+
+    d->adjacentAtoms.resize(offsets[size]);
+    d->adjacentBonds.resize(offsets[size]);
+    vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+    foreach (const Bond *bond, m_bondList) {
+      unsigned long begin = bond->beginAtomId();
+      unsigned long end = bond->endAtomId();
+      if (begin >= size || end >= size)
+        continue;
+      d->adjacentAtoms[next[begin]] = end;
+      d->adjacentBonds[next[begin]++] = bond->id();
+      d->adjacentAtoms[next[end]] = begin;
+      d->adjacentBonds[next[end]++] = bond->id();
+    }
+    d->invalidAdjacency = false;
+  }
+
   unsigned int Molecule::numBonds() const
   {
     return m_bondList.size();
@@ -897,6 +1179,10 @@ namespace Avogadro{
   {
     Q_D(Molecule);
     d->invalidGeomInfo = true;
+    d->invalidateOBMol(OBMolProperties);
+    // commitChangeSet() sends these
+    if (d->changeSetDepth)
+      return;
     emit moleculeChanged();
     emit updated();
   }
@@ -906,27 +1192,89 @@ namespace Avogadro{
     Q_D(Molecule);
     Primitive *primitive = qobject_cast<Primitive *>(sender());
     d->invalidGeomInfo = true;
-    emit primitiveUpdated(primitive);
+    // Residues and cubes are only checked when rebuilding the OBMol
+    if (primitive && (primitive->type() == ResidueType
+                      || primitive->type() == CubeType))
+      d->invalidateOBMol(OBMolTopology);
+    else
+      d->invalidateOBMol(OBMolProperties);
+    if (!recordChange(primitive, ChangeSet::Updated))
+      emit primitiveUpdated(primitive);
   }
 
   void Molecule::updateAtom()
+  {
+    updateAtom(qobject_cast<Atom *>(sender()));
+  }
+
+  void Molecule::updateAtom(Atom *atom)
   {
     Q_D(Molecule);
-    Atom *atom = qobject_cast<Atom *>(sender());
     d->invalidGeomInfo = true;
     d->invalidGroupIndices = true;
-    emit atomUpdated(atom);
+    d->invalidateOBMol(OBMolProperties);
+    if (!recordChange(atom, ChangeSet::Updated))
+      emit atomUpdated(atom);
   }
 
   void Molecule::updateBond()
   {
-    Bond *bond = qobject_cast<Bond *>(sender());
-    emit bondUpdated(bond);
+    updateBond(qobject_cast<Bond *>(sender()));
+  }
+
+  void Molecule::updateBond(Bond *bond)
+  {
+    Q_D(Molecule);
+    d->invalidateOBMol(OBMolProperties);
+    if (!recordChange(bond, ChangeSet::Updated))
+      emit bondUpdated(bond);
   }
 
   void Molecule::update()
   {
-    emit updated();
+    Q_D(Molecule);
+    if (!d->changeSetDepth)
+      emit updated();
+  }
+
+  void Molecule::beginChangeSet()
+  {
+    Q_D(Molecule);
+    ++d->changeSetDepth;
+  }
+
+  void Molecule::commitChangeSet()
+  {
+    Q_D(Molecule);
+    if (d->changeSetDepth == 0 || --d->changeSetDepth > 0)
+      return;
+
+    if (!d->changeSet.isEmpty()) {
+      ChangeSet changes = d->changeSet;
+      d->changeSet.clear();
+      emit moleculeChanged(changes);
+    }
+
+    // The listeners have seen the removed atoms, ids added again since
+    // belong to new atoms
+    vector<unsigned long> removed;
+    removed.swap(d->removedAtomData);
+    for (unsigned int i = 0; i < removed.size(); ++i) {
+      unsigned long id = removed[i];
+      if (id < m_atomicNumbers.size() && (id >= m_atoms.size() || !m_atoms[id]))
+        clearAtomData(id);
+    }
+    updateMolecule();
+  }
+
+  bool Molecule::recordChange(Primitive *primitive, ChangeSet::Change change)
+  {
+    Q_D(Molecule);
+    if (!d->changeSetDepth)
+      return false;
+    if (primitive && primitive != this)
+      d->changeSet.append(primitive->type(), primitive->id(), change);
+    return true;
   }
 
   Bond* Molecule::bond(unsigned long id1, unsigned long id2)
@@ -969,6 +1317,8 @@ namespace Avogadro{
         m_atomConformers.push_back( new vector<Vector3d>(m_atomPos->size()) );
     }
     *m_atomConformers[index] = conformer;
+    if (index == m_currentConformer)
+      invalidateOBMol(OBMolPositions);
     return true;
   }
 
@@ -1016,6 +1366,7 @@ namespace Avogadro{
         m_atomPos->push_back(Eigen::Vector3d::Zero());
       // set the current conformer index
       m_currentConformer = index;
+      invalidateOBMol(OBMolPositions);
       return true;
     }
   }
@@ -1045,6 +1396,7 @@ namespace Avogadro{
 
     m_atomPos = m_atomConformers[0];
     m_currentConformer = 0;
+    invalidateOBMol(OBMolPositions);
     return true;
   }
 
@@ -1057,6 +1409,7 @@ namespace Avogadro{
       m_atomPos = m_atomConformers[0];
     }
     m_currentConformer = 0;
+    invalidateOBMol(OBMolPositions);
   }
 
   unsigned int Molecule::numConformers() const
@@ -1149,36 +1502,120 @@ namespace Avogadro{
     Q_D(Molecule);
     // Check is the rings need updating before returning the list
     if(d->invalidRings) {
-      // Now update the rings
-      foreach(Fragment *ring, d->ringList) {
-        removeRing(ring);
+      // Ring systems whose bonds are unchanged keep their rings, only the
+      // new ones are searched
+      std::map<std::vector<unsigned long>, QList<Fragment *> > systems;
+      QList< QList<unsigned long> > newSystems;
+      QList< std::vector<unsigned long> > newKeys;
+      foreach(const QList<unsigned long> &bonds,
+              RingPerceiver::ringSystems(this)) {
+        // The bonds and the atoms they join identify the ring system
+        std::vector<unsigned long> key;
+        key.reserve(3 * bonds.size());
+        foreach(unsigned long id, bonds) {
+          const Bond *b = bondById(id);
+          key.push_back(id);
+          key.push_back(b->beginAtomId());
+          key.push_back(b->endAtomId());
+        }
+        std::map<std::vector<unsigned long>, QList<Fragment *> >::iterator
+          it = d->ringSystems.find(key);
+        if (it != d->ringSystems.end()) {
+          systems[key] = it->second;
+          d->ringSystems.erase(it);
+        }
+        else {
+          newSystems.append(bonds);
+          newKeys.append(key);
+        }
       }
-      OpenBabel::OBMol obmol = OBMol();
-      std::vector<OpenBabel::OBRing *> rings;
-      rings = obmol.GetSSSR();
-      foreach(OpenBabel::OBRing *r, rings) {
-        Fragment *ring = addRing();
-        foreach(int index, r->_path) {
-          ring->addAtom(atom(index-1)->id());
+
+      // Whatever is left belongs to ring systems that were changed
+      std::map<std::vector<unsigned long>, QList<Fragment *> >::iterator it;
+      for (it = d->ringSystems.begin(); it != d->ringSystems.end(); ++it)
+        foreach(Fragment *ring, it->second)
+          removeRing(ring);
+
+      for (int i = 0; i < newSystems.size(); ++i) {
+        QList<Fragment *> &systemRings = systems[newKeys[i]];
+        foreach(const QList<unsigned long> &atomIds,
+                RingPerceiver::sssr(this, newSystems[i])) {
+          Fragment *ring = addRing();
+          foreach(unsigned long id, atomIds)
+            ring->addAtom(id);
+          systemRings.append(ring);
         }
       }
+      d->ringSystems.swap(systems);
       d->invalidRings = false;
     }
     return d->ringList;
   }
 
+  unsigned int Molecule::topologyVersion() const
+  {
+    Q_D(const Molecule);
+    return d->topologyVersion;
+  }
+
+  unsigned int Molecule::positionsVersion() const
+  {
+    Q_D(const Molecule);
+    return d->positionsVersion;
+  }
+
+  void Molecule::positionsChanged()
+  {
+    invalidateOBMol(OBMolPositions);
+  }
+
   OpenBabel::OBMol Molecule::OBMol() const
   {
     Q_D(const Molecule);
-    // Right now we make an OBMol each time
-    OpenBabel::OBMol obmol;
-    obmol.BeginModify();
+    QMutexLocker locker(&d->obmolMutex);
+    return *cachedOBMol();
+  }
 
-    foreach(Atom *atom, m_atomList) {
-      OpenBabel::OBAtom *a = obmol.NewAtom();
-      OpenBabel::OBAtom obatom = atom->OBAtom();
-      *a = obatom;
+  void Molecule::invalidateOBMol(int changes) const
+  {
+    Q_D(const Molecule);
+    d->invalidateOBMol(changes);
+    // Bonds call this when their atoms change
+    if (changes & OBMolTopology)
+      d->invalidAdjacency = true;
+  }
+
+  OpenBabel::OBMol * Molecule::cachedOBMol() const
+  {
+    Q_D(const Molecule);
+    if (!d->obmol || (d->invalidOBMol & OBMolTopology))
+      buildOBMol();
+    else if (d->invalidOBMol & (OBMolProperties | OBMolChemistry)) {
+      // Patch the atoms and bonds in place unless the connectivity changed
+      // without us being told
+      if (!updateOBMolProperties())
+        buildOBMol();
     }
+    else if (d->invalidOBMol & OBMolPositions)
+      updateOBMolPositions();
+    d->invalidOBMol = 0;
+
+    // The energy, unit cell and properties of the molecule can change
+    // without any notification, they are cheap enough to copy every time
+    updateOBMolData();
+    return d->obmol;
+  }
+
+  void Molecule::buildOBMol() const
+  {
+    Q_D(const Molecule);
+    delete d->obmol;
+    d->obmol = new OpenBabel::OBMol;
+    OpenBabel::OBMol &obmol = *d->obmol;
+    obmol.BeginModify();
+
+    foreach(Atom *atom, m_atomList)
+      atom->copyToOBAtom(obmol.NewAtom());
     // we are copying partial charges above
     obmol.SetPartialChargesPerceived();
     foreach(Bond *bond, m_bondList) {
@@ -1245,11 +1682,106 @@ namespace Avogadro{
     }
 
     obmol.EndModify();
+    d->obmolFlags = obmol.GetFlags();
+
+    // Copy vibrations, if needed
+    if (d->obvibdata != NULL) {
+      obmol.SetData(d->obvibdata->Clone(&obmol));
+    }
+
+    // Copy dos, if needed
+    if (d->obdosdata != NULL) {
+      obmol.SetData(d->obdosdata->Clone(&obmol));
+    }
+
+    // Copy excited states data, if needed
+    if (d->obelectronictransitiondata != NULL) {
+      obmol.SetData(d->obelectronictransitiondata->Clone(&obmol));
+    }
+  }
+
+  bool Molecule::updateOBMolProperties() const
+  {
+    Q_D(const Molecule);
+    OpenBabel::OBMol *obmol = d->obmol;
+
+    // Check the connectivity is still the same as in the cached OBMol
+    if (obmol->NumAtoms() != static_cast<unsigned int>(m_atomList.size())
+        || obmol->NumBonds() != static_cast<unsigned int>(m_bondList.size())
+        || obmol->NumResidues()
+           != static_cast<unsigned int>(d->residueList.size())
+        || obmol->GetAllData(OpenBabel::OBGenericDataType::GridData).size()
+           != static_cast<unsigned int>(d->cubeList.size()))
+      return false;
+    for (int i = 0; i < m_atomList.size(); ++i)
+      if (obmol->GetAtom(i + 1)->GetId() != m_atomList[i]->id())
+        return false;
+    for (int i = 0; i < m_bondList.size(); ++i) {
+      const Bond *bond = m_bondList[i];
+      const Atom *beginAtom = atomById(bond->beginAtomId());
+      const Atom *endAtom = atomById(bond->endAtomId());
+      const OpenBabel::OBBond *obbond = obmol->GetBond(i);
+      if (!beginAtom || !endAtom
+          || obbond->GetBeginAtomIdx()
+             != static_cast<unsigned int>(beginAtom->index() + 1)
+          || obbond->GetEndAtomIdx()
+             != static_cast<unsigned int>(endAtom->index() + 1))
+        return false;
+    }
+    for (int i = 0; i < d->residueList.size(); ++i)
+      if (obmol->GetResidue(i)->GetNumAtoms()
+          != static_cast<unsigned int>(d->residueList[i]->atoms().size()))
+        return false;
+
+    // Now copy everything else over
+    foreach(Atom *atom, m_atomList)
+      atom->copyToOBAtom(obmol->GetAtom(atom->index() + 1));
+    for (int i = 0; i < m_bondList.size(); ++i) {
+      OpenBabel::OBBond *obbond = obmol->GetBond(i);
+      obbond->SetBondOrder(m_bondList[i]->order());
+      obbond->DeleteData(OpenBabel::OBGenericDataType::PairData);
+      QString label = m_bondList[i]->customLabel();
+      if(!label.isEmpty()) {
+        OpenBabel::OBPairData *dp = new OpenBabel::OBPairData();
+        dp->SetAttribute("label");
+        dp->SetValue(label.toLatin1());
+        obbond->SetData(dp);
+      }
+    }
+    for (int i = 0; i < d->residueList.size(); ++i) {
+      OpenBabel::OBResidue *r = obmol->GetResidue(i);
+      r->SetNum(d->residueList[i]->number().toStdString());
+      r->SetChain(d->residueList[i]->chainID());
+      r->SetName(d->residueList[i]->name().toUpper().toStdString());
+    }
+
+    // Anything OpenBabel perceived may depend on what we just changed
+    obmol->SetFlags(d->obmolFlags);
+    return true;
+  }
+
+  void Molecule::updateOBMolPositions() const
+  {
+    Q_D(const Molecule);
+    foreach(Atom *atom, m_atomList) {
+      const Vector3d &pos = (*m_atomPos)[atom->id()];
+      d->obmol->GetAtom(atom->index() + 1)->SetVector(pos.x(), pos.y(),
+                                                      pos.z());
+    }
+    // Stereochemistry is perceived from the 3D coordinates
+    d->obmol->UnsetFlag(OB_CHIRALITY_MOL);
+  }
+
+  void Molecule::updateOBMolData() const
+  {
+    Q_D(const Molecule);
+    OpenBabel::OBMol &obmol = *d->obmol;
 
     // Copy energy
     obmol.SetEnergy(this->energy() / KCAL_TO_KJ);
 
     // Copy unit cells
+    obmol.DeleteData(OpenBabel::OBGenericDataType::UnitCell);
     if (d->obunitcell != NULL) {
       OpenBabel::OBUnitCell *obunitcell = new OpenBabel::OBUnitCell;
       *obunitcell = *d->obunitcell;
@@ -1257,6 +1789,7 @@ namespace Avogadro{
     }
 
     // Copy OBPairData, if needed
+    obmol.DeleteData(OpenBabel::OBGenericDataType::PairData);
     OpenBabel::OBPairData *obproperty;
     foreach(const QByteArray &propertyName, dynamicPropertyNames()) {
       obproperty = new OpenBabel::OBPairData;
@@ -1264,23 +1797,6 @@ namespace Avogadro{
       obproperty->SetValue(property(propertyName).toByteArray().data());
       obmol.SetData(obproperty);
     }
-
-    // Copy vibrations, if needed
-    if (d->obvibdata != NULL) {
-      obmol.SetData(d->obvibdata->Clone(&obmol));
-    }
-
-    // Copy dos, if needed
-    if (d->obdosdata != NULL) {
-      obmol.SetData(d->obdosdata->Clone(&obmol));
-    }
-
-    // Copy excited states data, if needed
-    if (d->obelectronictransitiondata != NULL) {
-      obmol.SetData(d->obelectronictransitiondata->Clone(&obmol));
-    }
-
-    return obmol;
   }
 
   bool Molecule::setOBMol(OpenBabel::OBMol *obmol)
@@ -1288,8 +1804,9 @@ namespace Avogadro{
     // Take an OBMol, copy everything we need and store this object
     Q_D(Molecule);
     clear();
-    // Copy all the parts of the OBMol to our Molecule
-    blockSignals(true);
+    // Copy all the parts of the OBMol to our Molecule, listeners get a single
+    // notification at the end
+    beginChangeSet();
 
     std::vector<OpenBabel::OBAtom*>::iterator i;
 
@@ -1325,6 +1842,7 @@ namespace Avogadro{
     }
 
     // Begin by copying all of the atoms
+    reserve(obmol->NumAtoms(), obmol->NumBonds());
     for (OpenBabel::OBAtom *obatom = obmol->BeginAtom(i); obatom; obatom = obmol->NextAtom(i)) {
       Atom *atom = addAtom();
       atom->setOBAtom(obatom);
@@ -1517,8 +2035,7 @@ namespace Avogadro{
     // we set the partial charges above
     m_invalidPartialCharges = false;
 
-    blockSignals(false);
-    emit update();
+    commitChangeSet();
     return true;
   }
 
@@ -1532,11 +2049,7 @@ namespace Avogadro{
   {
     Q_D(Molecule);
     d->obunitcell = obunitcell;
-    if (obunitcell == NULL) {
-      // delete it from our private obmol
-      if (d->obmol)
-        d->obmol->DeleteData(OpenBabel::OBGenericDataType::UnitCell);
-    }
+    // The unit cell is copied to the cached OBMol every time it is used
     return true;
   }
 
@@ -1575,9 +2088,11 @@ namespace Avogadro{
 
     Q_D(const Molecule);
     d->invalidGeomInfo = true;
+    d->invalidateOBMol(OBMolPositions);
     foreach (Atom *atom, m_atomList) {
       (*m_atomPos)[atom->id()] += offset;
-      emit atomUpdated(atom);
+      if (!recordChange(atom, ChangeSet::Updated))
+        emit atomUpdated(atom);
     }
   }
 
@@ -1587,9 +2102,23 @@ namespace Avogadro{
     m_atoms.clear();
     foreach (Atom *atom, m_atomList) {
       atom->deleteLater();
-      emit primitiveRemoved(atom);
+      if (!recordChange(atom, ChangeSet::Removed))
+        emit primitiveRemoved(atom);
+    }
+    // Inside a change set the per atom data is kept until the listeners
+    // have seen the removed atoms
+    if (d->changeSetDepth) {
+      foreach (Atom *atom, m_atomList)
+        d->removedAtomData.push_back(atom->id());
+    }
+    else {
+      m_atomicNumbers.clear();
+      m_formalCharges.clear();
+      m_partialCharges.clear();
+      m_atomFlags.clear();
     }
     m_atomList.clear();
+    d->invalidAdjacency = true;
     clearConformers();
     delete m_atomPos;
     m_atomPos = 0;
@@ -1597,39 +2126,50 @@ namespace Avogadro{
     m_dipoleMoment = 0;
     delete d->obunitcell;
     d->obunitcell = 0;
+    d->obmolMutex.lock();
+    delete d->obmol;
+    d->obmol = 0;
+    d->obmolMutex.unlock();
+    d->invalidateOBMol(OBMolTopology);
 
     m_bonds.clear();
     foreach (Bond *bond, m_bondList) {
       bond->deleteLater();
-      emit primitiveRemoved(bond);
+      if (!recordChange(bond, ChangeSet::Removed))
+        emit primitiveRemoved(bond);
     }
     m_bondList.clear();
 
     d->cubes.clear();
     foreach (Cube *cube, d->cubeList) {
       cube->deleteLater();
-      emit primitiveRemoved(cube);
+      if (!recordChange(cube, ChangeSet::Removed))
+        emit primitiveRemoved(cube);
     }
     d->cubeList.clear();
 
     d->meshes.clear();
     foreach (Mesh *mesh, d->meshList) {
       mesh->deleteLater();
-      emit primitiveRemoved(mesh);
+      if (!recordChange(mesh, ChangeSet::Removed))
+        emit primitiveRemoved(mesh);
     }
     d->meshList.clear();
 
     d->residues.clear();
     foreach (Residue *residue, d->residueList) {
       residue->deleteLater();
-      emit primitiveRemoved(residue);
+      if (!recordChange(residue, ChangeSet::Removed))
+        emit primitiveRemoved(residue);
     }
     d->residueList.clear();
 
     d->rings.clear();
+    d->ringSystems.clear();
     foreach (Fragment *ring, d->ringList) {
       ring->deleteLater();
-      emit primitiveRemoved(ring);
+      if (!recordChange(ring, ChangeSet::Removed))
+        emit primitiveRemoved(ring);
     }
     d->ringList.clear();
   }
@@ -1657,6 +2197,14 @@ namespace Avogadro{
 
     m_bonds.resize(other.m_bonds.size(), 0);
 
+    // The per atom arrays are copied as a whole, the atoms below only copy
+    // their custom data
+    m_atomicNumbers = other.m_atomicNumbers;
+    m_formalCharges = other.m_formalCharges;
+    m_partialCharges = other.m_partialCharges;
+    m_atomFlags = other.m_atomFlags;
+    m_invalidPartialCharges = other.m_invalidPartialCharges;
+
     // Copy the atoms and bonds over
     unsigned int size = other.m_atoms.size();
     for (unsigned int i = 0; i < size; ++i) {
@@ -1666,8 +2214,9 @@ namespace Avogadro{
         atom->setIndex(other.m_atoms[i]->index());
         m_atoms[i] = atom;
         m_atomList.push_back(atom);
-        *atom = *(other.m_atoms[i]);
-        emit primitiveAdded(atom);
+        atom->copyCustomData(*(other.m_atoms[i]));
+        if (!recordChange(atom, ChangeSet::Added))
+          emit primitiveAdded(atom);
       }
     }
 
@@ -1683,7 +2232,8 @@ namespace Avogadro{
         // Add the bond to it's atoms
         bond->beginAtom()->addBond(bond);
         bond->endAtom()->addBond(bond);
-        emit primitiveAdded(bond);
+        if (!recordChange(bond, ChangeSet::Added))
+          emit primitiveAdded(bond);
       }
     }
 
@@ -1700,8 +2250,11 @@ namespace Avogadro{
       residue->setAtomIds(r->atomIds());
     }
 
-    // Copy unit cells
+    // The atoms above were copied without invalidating the OBMol
     Q_D(Molecule);
+    d->invalidateOBMol(OBMolTopology);
+
+    // Copy unit cells
     if (other.OBUnitCell() != NULL) {
       d->obunitcell = new OpenBabel::OBUnitCell;
       *d->obunitcell = *(other.OBUnitCell()); // Copy the object not the pointer
@@ -1720,14 +2273,16 @@ namespace Avogadro{
       Atom *atom = addAtom();
       *atom = *a;
       map.push_back(atom->id());
-      emit primitiveAdded(atom);
+      if (!recordChange(atom, ChangeSet::Added))
+        emit primitiveAdded(atom);
     }
     foreach (Bond *b, other.m_bondList) {
       Bond *bond = addBond();
       *bond = *b;
       bond->setBegin(atomById(map.at(other.atomById(b->beginAtomId())->index())));
       bond->setEnd(atomById(map.at(other.atomById(b->endAtomId())->index())));
-      emit primitiveAdded(bond);
+      if (!recordChange(bond, ChangeSet::Added))
+        emit primitiveAdded(bond);
     }
     foreach (Residue *r, other.residues()) {
       Residue *residue = addResidue();
@@ -27,6 +27,7 @@
 #define MOLECULE_H
 
 #include <avogadro/primitive.h>
+#include <avogadro/changeset.h>
 
 // Used by the inline functions
 #include <QReadWriteLock>
@@ -88,9 +89,38 @@ namespace Avogadro {
 
     /**
      * Call to trigger an update signal, causing the molecule to be redrawn.
+     * Inside a change set the signal is left to commitChangeSet().
      */
     void update();
 
+    /** @name Change sets
+     * Group many changes into one notification.
+     * @{
+     */
+
+    /**
+     * Start recording changes. Until the matching commitChangeSet() no
+     * signals are emitted for added, updated or removed primitives, they are
+     * collected in a ChangeSet instead. Change sets can be nested, the
+     * notification is sent when the outermost one is committed.
+     @code
+     molecule->beginChangeSet();
+     foreach (...)
+       molecule->addAtom(...);
+     molecule->commitChangeSet(); // one moleculeChanged(ChangeSet) signal
+     @endcode
+     */
+    void beginChangeSet();
+
+    /**
+     * Finish the change set started by beginChangeSet(). When the outermost
+     * change set is committed, moleculeChanged(const ChangeSet &) is emitted
+     * with everything that changed, followed by moleculeChanged() and
+     * updated().
+     */
+    void commitChangeSet();
+    /** @} */
+
     /** @name Molecule parameters
      * These methods set and get Molecule parameters.
      * @{
@@ -156,6 +186,13 @@ namespace Avogadro {
      */
     void removeAtom(unsigned long id);
 
+    /**
+     * Remove all of the supplied atoms and their bonds. The remaining atoms
+     * are renumbered once, which is much faster than removing a large
+     * selection one atom at a time. atomRemoved() is emitted for each atom.
+     */
+    void removeAtoms(const QList<Atom *> &atoms);
+
     /**
      * @return The Atom at the supplied index.
      * @note Replaces GetAtom.
@@ -198,6 +235,41 @@ namespace Avogadro {
      */
     unsigned int numAtoms() const;
 
+    /**
+     * Reserve storage for @p atoms atoms and @p bonds bonds, avoiding
+     * reallocation when a large molecule is built one atom at a time.
+     */
+    void reserve(unsigned int atoms, unsigned int bonds);
+
+    /**
+     * The atomic numbers of all atoms in one contiguous array indexed by
+     * unique id (Atom::id()), like the conformers. Entries of ids that are
+     * not in use are zero.
+     */
+    const std::vector<int> & atomicNumbers() const { return m_atomicNumbers; }
+
+    /**
+     * The bonded neighbors of all atoms in compressed sparse row form. The
+     * neighbors of the atom with unique id @c id are the entries
+     * adjacencyOffsets()[id] up to, but not including,
+     * adjacencyOffsets()[id + 1] of adjacentAtoms() and adjacentBonds().
+     * The arrays are built on first use after the bonds have changed.
+     * @return The offsets into adjacentAtoms(), conformerSize() + 1 entries.
+     */
+    const std::vector<unsigned int> & adjacencyOffsets() const;
+
+    /**
+     * @return The unique ids of the bonded neighbors of each atom.
+     * @sa adjacencyOffsets
+     */
+    const std::vector<unsigned long> & adjacentAtoms() const;
+
+    /**
+     * @return The unique ids of the bonds to the neighbors in adjacentAtoms().
+     * @sa adjacencyOffsets
+     */
+    const std::vector<unsigned long> & adjacentBonds() const;
+
     /** @} */
 
 
@@ -255,6 +327,12 @@ namespace Avogadro {
      */
     void removeBond(unsigned long id);
 
+    /**
+     * Remove all of the supplied bonds, renumbering the remaining bonds
+     * once. bondRemoved() is emitted for each bond.
+     */
+    void removeBonds(const QList<Bond *> &bonds);
+
     /**
      * @return The Bond at the supplied index.
      * @note Replaces GetBond.
@@ -731,9 +809,34 @@ namespace Avogadro {
      * Get access to an OpenBabel::OBMol, this is a copy of the internal data
      * structure in OpenBabel form, you must call setOBMol in order to save
      * any changes you make to this object.
+     * @note The molecule keeps a cached OBMol that is patched as atoms move
+     * or change and only rebuilt when atoms, bonds, residues or cubes are
+     * added or removed, so repeated calls are cheap.
      */
     OpenBabel::OBMol OBMol() const;
 
+    /**
+     * @return A number that changes whenever atoms, bonds, residues or cubes
+     * are added or removed, or elements, charges, bond orders or custom
+     * colors change, but not when atoms move or are updated. Versions are
+     * never reused, even by other molecules, so results derived from the
+     * OBMol such as SMARTS matches can be cached against it.
+     */
+    unsigned int topologyVersion() const;
+
+    /**
+     * @return A number that changes whenever atoms move, like
+     * topologyVersion() does for other changes.
+     */
+    unsigned int positionsVersion() const;
+
+    /**
+     * Change positionsVersion() and mark the cached OBMol coordinates as out
+     * of date. Call this after writing atom positions directly into a
+     * conformer(), setAtomPos() and setConformer() already do.
+     */
+    void positionsChanged();
+
     /**
      * Copy as much data as possible from the supplied OpenBabel::OBMol to the
      * Avogadro Molecule object.
@@ -837,6 +940,11 @@ namespace Avogadro {
     MoleculePrivate * const d_ptr;
     QString m_fileName;
     std::vector<Eigen::Vector3d> *m_atomPos; // Atom position vector
+    // Per atom data indexed by unique id, Atom reads and writes these
+    std::vector<int>      m_atomicNumbers;
+    std::vector<int>      m_formalCharges;
+    mutable std::vector<double> m_partialCharges;
+    std::vector<unsigned char>  m_atomFlags;
     /** Vector containing pointers to various conformers. **/
     std::vector< std::vector<Eigen::Vector3d>* > m_atomConformers;
     mutable unsigned int m_currentConformer;
@@ -868,6 +976,90 @@ namespace Avogadro {
      */
     void computeGeomInfoFromUnitCell() const;
 
+    /**
+     * Flags stored for each atom in m_atomFlags.
+     */
+    enum AtomFlag {
+      AtomFormalChargeAssigned = 0x1 // set by Atom::setFormalCharge()
+    };
+
+    /**
+     * Grow the per atom arrays to hold the atom with unique id @p id.
+     */
+    void resizeAtomData(unsigned long id);
+
+    /**
+     * Reset the per atom data of the atom with unique id @p id.
+     */
+    void clearAtomData(unsigned long id);
+
+    /**
+     * Rebuild the adjacency arrays if the bonds changed since the last call.
+     */
+    void updateAdjacency() const;
+
+    /**
+     * Called by Atom::update() and Bond::update() in place of a signal
+     * connection for every atom and bond.
+     */
+    void updateAtom(Atom *atom);
+    void updateBond(Bond *bond);
+
+    /**
+     * Add a change to @p primitive to the open change set.
+     * @return False if no change set is open, the caller then emits the
+     * signal for the change itself.
+     */
+    bool recordChange(Primitive *primitive, ChangeSet::Change change);
+
+    /**
+     * Move the atoms, bonds or residues added last back to the sorted
+     * @p indices they had before they were removed, one per index.
+     * TopologyRecord uses this to keep the original order on undo.
+     */
+    void moveToIndices(Primitive::Type type,
+                       const std::vector<unsigned long> &indices);
+
+    /**
+     * The parts of the cached OpenBabel::OBMol that can be out of date.
+     */
+    enum OBMolChange {
+      OBMolPositions  = 0x1, // atom coordinates
+      OBMolProperties = 0x2, // labels, radii or anything after an update
+      OBMolTopology   = 0x4, // atoms, bonds, residues or cubes
+      OBMolChemistry  = 0x8  // elements, charges, bond orders, custom colors
+    };
+
+    /**
+     * Mark part of the cached OBMol as out of date, @p changes is a
+     * combination of OBMolChange flags. Atoms and bonds call this when they
+     * are changed without emitting a signal. Only OBMolTopology and
+     * OBMolChemistry change topologyVersion(), OBMolProperties is used by
+     * the update signals sent for every step of a drag or animation.
+     */
+    void invalidateOBMol(int changes) const;
+
+    /**
+     * Bring the cached OBMol up to date and return it. The caller must hold
+     * the OBMol mutex of the molecule while it uses the OBMol.
+     */
+    OpenBabel::OBMol * cachedOBMol() const;
+
+    /**
+     * Helper functions for cachedOBMol(). buildOBMol() makes the cached OBMol
+     * from scratch, updateOBMolProperties() patches the atoms and bonds in
+     * place and returns false if the connectivity no longer matches.
+     */
+    void buildOBMol() const;
+    bool updateOBMolProperties() const;
+    void updateOBMolPositions() const;
+    void updateOBMolData() const;
+
+    friend class Atom;
+    friend class Bond;
+    friend class TopologyRecord;
+    friend class TopologyRecordPrivate;
+
   public Q_SLOTS:
     /**
      * Signal that the molecule has been changed in some large way, emits the
@@ -911,6 +1103,14 @@ namespace Avogadro {
      */
     void moleculeChanged();
 
+    /**
+     * Emitted when a change set is committed, in place of the signals for
+     * each primitive.
+     * @param changes The primitives added, updated and removed.
+     * @sa beginChangeSet
+     */
+    void moleculeChanged(const Avogadro::ChangeSet &changes);
+
     /**
      * Emitted when a child primitive is added.
      * @param primitive pointer to the primitive that was added
@@ -33,6 +33,10 @@
 #include <QThread>
 #include <QDebug>
 #include <QPointer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QCache>
+#include <QAtomicInt>
 
 #include <openbabel/mol.h>
 #include <openbabel/obconversion.h>
@@ -40,6 +44,9 @@
 // Included in obconversion.h
 //#include <iostream>
 
+#include <cmath>
+#include <cstring>
+
 namespace Avogadro {
 
   using OpenBabel::OBConversion;
@@ -51,10 +58,18 @@ namespace Avogadro {
   using std::ifstream;
   using std::ofstream;
 
+  enum TrajectoryFormat {
+    NoTrajectory = 0,
+    XyzTrajectory,
+    PdbTrajectory
+  };
+
   class MoleculeFilePrivate
   {
     public:
-      MoleculeFilePrivate() : isConformerFile(false), ready(false), specialCaseOBMol(0) {}
+      MoleculeFilePrivate() : isConformerFile(false), ready(false), specialCaseOBMol(0),
+        trajectoryFormat(NoTrajectory), trajectoryFile(0), trajectoryData(0),
+        trajectorySize(0), trajectoryAtoms(0), indexThread(0), frameCache(16) {}
       QStringList titles;
       std::vector<std::streampos> streampos;
       bool isConformerFile;
@@ -64,8 +79,92 @@ namespace Avogadro {
       // OBMol in specialCaseOBMol. MoleculeFile::molecule will return this
       // OBMol object (if non 0) regardless of the index.
       OBMol *specialCaseOBMol;
+
+      // trajectory mode (see MoleculeFile::readTrajectory), the file stays
+      // mapped and frameOffsets is filled in by the ReadFileThread
+      TrajectoryFormat trajectoryFormat;
+      QFile *trajectoryFile;
+      const char *trajectoryData;
+      qint64 trajectorySize;
+      unsigned int trajectoryAtoms;
+      ReadFileThread *indexThread;
+      QAtomicInt abortIndexing;
+      // frameMutex guards frameOffsets, frameCache and indexErrors, and the
+      // titles and streampos the index thread fills in for the first frame
+      QMutex frameMutex;
+      std::vector<qint64> frameOffsets;
+      QCache<unsigned int, std::vector<Eigen::Vector3d> > frameCache;
+      // errors of the index thread, moved to m_error in the GUI thread
+      QString indexErrors;
   };
 
+  // Move the errors found by the index thread to errors
+  static void takeIndexErrors(MoleculeFilePrivate *d, QString &errors)
+  {
+    QMutexLocker locker(&d->frameMutex);
+    errors.append(d->indexErrors);
+    d->indexErrors.clear();
+  }
+
+  // Offset of the line after the one starting at pos
+  static inline qint64 nextLine(const char *data, qint64 size, qint64 pos)
+  {
+    const char *eol = static_cast<const char *>(memchr(data + pos, '\n', size - pos));
+    return eol ? eol - data + 1 : size;
+  }
+
+  // Check if the line at p starts with the record name
+  static inline bool isRecord(const char *p, const char *end, const char *record)
+  {
+    for (; *record; ++p, ++record)
+      if (p == end || *p != *record)
+        return false;
+    return true;
+  }
+
+  // Locale independent parsing of a number, skipping leading blanks. On
+  // success p is moved past the number.
+  static bool parseDouble(const char *&p, const char *end, double &value)
+  {
+    while (p != end && (*p == ' ' || *p == '\t'))
+      ++p;
+    const char *start = p;
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+'))
+      negative = *p++ == '-';
+    double mantissa = 0.0;
+    int exponent = 0;
+    bool digits = false;
+    for (; p != end && *p >= '0' && *p <= '9'; ++p, digits = true)
+      mantissa = 10.0 * mantissa + (*p - '0');
+    if (p != end && *p == '.')
+      for (++p; p != end && *p >= '0' && *p <= '9'; ++p, digits = true) {
+        mantissa = 10.0 * mantissa + (*p - '0');
+        --exponent;
+      }
+    if (!digits) {
+      p = start;
+      return false;
+    }
+    if (p != end && (*p == 'e' || *p == 'E' || *p == 'd' || *p == 'D')) {
+      const char *e = p + 1;
+      bool negativeExp = false;
+      if (e != end && (*e == '-' || *e == '+'))
+        negativeExp = *e++ == '-';
+      if (e != end && *e >= '0' && *e <= '9') {
+        int exp = 0;
+        for (; e != end && *e >= '0' && *e <= '9'; ++e)
+          exp = 10 * exp + (*e - '0');
+        exponent += negativeExp ? -exp : exp;
+        p = e;
+      }
+    }
+    value = exponent ? mantissa * pow(10.0, exponent) : mantissa;
+    if (negative)
+      value = -value;
+    return true;
+  }
+
   MoleculeFile::MoleculeFile(const QString &fileName, const QString &fileType,
       const QString &fileOptions) : QObject(), d(new MoleculeFilePrivate),
       m_fileName(fileName), m_fileType(fileType), m_fileOptions(fileOptions)
@@ -74,6 +173,16 @@ namespace Avogadro {
 
   MoleculeFile::~MoleculeFile()
   {
+    if (d->indexThread) {
+      // stop indexing before the file is unmapped
+      d->abortIndexing = 1;
+      d->indexThread->wait();
+      delete d->indexThread;
+    }
+    if (d->trajectoryFile) {
+      d->trajectoryFile->close(); // also unmaps the file
+      delete d->trajectoryFile;
+    }
     if (d->specialCaseOBMol)
       delete d->specialCaseOBMol;
     delete d;
@@ -95,6 +204,7 @@ namespace Avogadro {
       return 0;
     if (d->isConformerFile)
       return 1;
+    QMutexLocker locker(&d->frameMutex);
     return d->titles.size();
   }
 
@@ -102,6 +212,7 @@ namespace Avogadro {
   {
     if (!d->ready)
       return QStringList();
+    QMutexLocker locker(&d->frameMutex);
     return d->titles;
   }
 
@@ -127,7 +238,11 @@ namespace Avogadro {
     if (d->specialCaseOBMol)
       return (new OpenBabel::OBMol(*d->specialCaseOBMol));
 
-    if (i >= d->streampos.size()) {
+    d->frameMutex.lock();
+    bool inRange = i < d->streampos.size();
+    std::streampos start = inRange ? d->streampos[i] : std::streampos(0);
+    d->frameMutex.unlock();
+    if (!inRange) {
       m_error.append(tr("OBMol: index %1 out of reach.").arg(i));
       return 0;
     }
@@ -159,7 +274,7 @@ namespace Avogadro {
     // Now attempt to read the molecule in
     ifstream ifs;
     ifs.open(m_fileName.toLocal8Bit()); // This handles utf8 file names etc
-    ifs.seekg(d->streampos.at(i));
+    ifs.seekg(start);
 
     if (!ifs) // Should not happen, already checked file could be opened
       return 0;
@@ -276,6 +391,7 @@ namespace Avogadro {
 
   void MoleculeFile::threadFinished()
   {
+    takeIndexErrors(d, m_error);
     d->ready = true;
     emit ready();
   }
@@ -300,6 +416,210 @@ namespace Avogadro {
     return m_conformers;
   }
 
+  bool MoleculeFile::isTrajectory() const
+  {
+    return d->trajectoryFormat != NoTrajectory;
+  }
+
+  unsigned int MoleculeFile::numFrames() const
+  {
+    if (!isTrajectory())
+      return m_conformers.size();
+    QMutexLocker locker(&d->frameMutex);
+    return d->frameOffsets.size();
+  }
+
+  bool MoleculeFile::frame(unsigned int i, std::vector<Eigen::Vector3d> &coords)
+  {
+    if (!isTrajectory()) {
+      if (i >= m_conformers.size())
+        return false;
+      coords = *m_conformers[i];
+      return true;
+    }
+
+    QMutexLocker locker(&d->frameMutex);
+    // Pick up the errors of frames decoded by other threads
+    if (QThread::currentThread() == thread() && !d->indexErrors.isEmpty()) {
+      m_error.append(d->indexErrors);
+      d->indexErrors.clear();
+    }
+    if (i >= d->frameOffsets.size())
+      return false;
+
+    std::vector<Eigen::Vector3d> *cached = d->frameCache.object(i);
+    if (!cached) {
+      cached = new std::vector<Eigen::Vector3d>;
+      if (!decodeFrame(i, *cached)) {
+        delete cached;
+        // m_error belongs to the GUI thread, animations decode in workers
+        QString error = tr("Reading frame %1 from file '%2' failed.")
+                        .arg(i).arg(m_fileName);
+        if (QThread::currentThread() == thread())
+          m_error.append(error);
+        else
+          d->indexErrors.append(error);
+        return false;
+      }
+      d->frameCache.insert(i, cached);
+    }
+    coords = *cached;
+    return true;
+  }
+
+  void MoleculeFile::setFrameCacheSize(int frames)
+  {
+    QMutexLocker locker(&d->frameMutex);
+    d->frameCache.setMaxCost(frames);
+  }
+
+  bool MoleculeFile::decodeFrame(unsigned int i, std::vector<Eigen::Vector3d> &coords)
+  {
+    const char *data = d->trajectoryData;
+    const qint64 size = d->trajectorySize;
+    qint64 pos = d->frameOffsets[i];
+    coords.clear();
+    coords.reserve(d->trajectoryAtoms);
+
+    if (d->trajectoryFormat == XyzTrajectory) {
+      // skip the atom count and the comment line
+      pos = nextLine(data, size, nextLine(data, size, pos));
+      while (coords.size() < d->trajectoryAtoms && pos < size) {
+        qint64 eol = nextLine(data, size, pos);
+        const char *p = data + pos;
+        const char *end = data + eol;
+        // skip the element symbol or atomic number
+        while (p != end && (*p == ' ' || *p == '\t'))
+          ++p;
+        while (p != end && *p != ' ' && *p != '\t')
+          ++p;
+        Eigen::Vector3d r;
+        if (!parseDouble(p, end, r.x()) || !parseDouble(p, end, r.y())
+            || !parseDouble(p, end, r.z()))
+          return false;
+        coords.push_back(r);
+        pos = eol;
+      }
+    }
+    else {
+      while (coords.size() < d->trajectoryAtoms && pos < size) {
+        qint64 eol = nextLine(data, size, pos);
+        const char *p = data + pos;
+        const char *end = data + eol;
+        if (isRecord(p, end, "ATOM  ") || isRecord(p, end, "HETATM")) {
+          // coordinates are in the fixed columns 31-38, 39-46 and 47-54
+          Eigen::Vector3d r;
+          for (int j = 0; j < 3; ++j) {
+            const char *field = p + 30 + 8 * j;
+            if (field + 8 > end || !parseDouble(field, p + 38 + 8 * j, r[j]))
+              return false;
+          }
+          coords.push_back(r);
+        }
+        pos = eol;
+      }
+    }
+    return coords.size() == d->trajectoryAtoms;
+  }
+
+  void MoleculeFile::indexTrajectory()
+  {
+    const char *data = d->trajectoryData;
+    const qint64 size = d->trajectorySize;
+    std::vector<qint64> offsets; // frames not yet published to frameOffsets
+    QString errors; // m_error belongs to the GUI thread
+    unsigned int numFrames = 0;
+    qint64 pos = 0;
+
+    while (pos < size && !d->abortIndexing) {
+      qint64 frameStart = -1;
+      unsigned int numAtoms = 0;
+
+      if (d->trajectoryFormat == XyzTrajectory) {
+        // skip blank lines between frames
+        qint64 eol = nextLine(data, size, pos);
+        const char *p = data + pos;
+        const char *end = data + eol;
+        while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+          ++p;
+        if (p == end) {
+          pos = eol;
+          continue;
+        }
+        double count;
+        if (!parseDouble(p, end, count) || count < 1.0)
+          break;
+        // the atom count, the comment line and one line per atom
+        frameStart = pos;
+        numAtoms = static_cast<unsigned int>(count);
+        pos = eol;
+        for (unsigned int j = 0; j <= numAtoms; ++j) {
+          if (pos == size) {
+            frameStart = -1; // truncated frame
+            break;
+          }
+          pos = nextLine(data, size, pos);
+        }
+      }
+      else {
+        // a frame is a run of ATOM/HETATM records ended by MODEL, ENDMDL or END
+        while (pos < size) {
+          qint64 eol = nextLine(data, size, pos);
+          const char *p = data + pos;
+          const char *end = data + eol;
+          if (isRecord(p, end, "ATOM  ") || isRecord(p, end, "HETATM")) {
+            if (frameStart < 0)
+              frameStart = pos;
+            ++numAtoms;
+          }
+          else if (numAtoms && (isRecord(p, end, "END")
+                                || isRecord(p, end, "MODEL"))) {
+            break;
+          }
+          pos = eol;
+        }
+      }
+
+      if (frameStart < 0)
+        break;
+      if (!numFrames) {
+        d->trajectoryAtoms = numAtoms;
+      }
+      else if (numAtoms != d->trajectoryAtoms) {
+        errors.append(tr("Frame %1 of trajectory '%2' has %3 atoms, expected %4.")
+                      .arg(numFrames + 1).arg(m_fileName).arg(numAtoms)
+                      .arg(d->trajectoryAtoms));
+        break;
+      }
+      offsets.push_back(frameStart);
+      ++numFrames;
+
+      // publish the frames in batches to keep the locking cheap
+      if (numFrames == 1 || offsets.size() == 1024) {
+        d->frameMutex.lock();
+        d->frameOffsets.insert(d->frameOffsets.end(), offsets.begin(), offsets.end());
+        if (numFrames == 1) {
+          d->streampos.push_back(0);
+          d->titles.append(tr("Conformer %1").arg(1));
+        }
+        d->frameMutex.unlock();
+        offsets.clear();
+        if (numFrames == 1)
+          setFirstReady(true);
+        emit framesIndexed(numFrames);
+      }
+    }
+
+    if (!numFrames)
+      errors.append(tr("No frames could be read from trajectory '%1'.")
+                    .arg(m_fileName));
+    d->frameMutex.lock();
+    d->frameOffsets.insert(d->frameOffsets.end(), offsets.begin(), offsets.end());
+    d->indexErrors.append(errors);
+    d->frameMutex.unlock();
+    emit framesIndexed(numFrames);
+  }
+
   void MoleculeFile::setConformerFile(bool value)
   {
     d->isConformerFile = value;
@@ -649,4 +969,57 @@ namespace Avogadro {
     return moleculeFile;
   }
 
+  MoleculeFile* MoleculeFile::readTrajectory(const QString &fileName,
+      const QString &fileType, bool wait)
+  {
+    MoleculeFile *moleculeFile = new MoleculeFile(fileName, fileType, QString());
+
+    QString type = fileType.isEmpty() ? QFileInfo(fileName).suffix().toLower()
+                                      : fileType.toLower();
+    TrajectoryFormat format = NoTrajectory;
+    if (type == QLatin1String("xyz"))
+      format = XyzTrajectory;
+    else if (type == QLatin1String("pdb") || type == QLatin1String("ent"))
+      format = PdbTrajectory;
+
+    if (format == NoTrajectory) {
+      moleculeFile->m_error.append(
+          tr("File type '%1' is not supported for reading trajectories.").arg(type));
+      moleculeFile->threadFinished(); // set & emit ready
+      return moleculeFile;
+    }
+
+    // Map the whole file, the frames are decoded straight from the mapping
+    QFile *file = new QFile(fileName);
+    const char *data = 0;
+    if (file->open(QFile::ReadOnly) && file->size())
+      data = reinterpret_cast<const char *>(file->map(0, file->size()));
+    if (!data) {
+      moleculeFile->m_error.append(
+          tr("File %1 cannot be opened for reading.").arg(fileName));
+      delete file;
+      moleculeFile->threadFinished(); // set & emit ready
+      return moleculeFile;
+    }
+
+    moleculeFile->d->trajectoryFormat = format;
+    moleculeFile->d->trajectoryFile = file;
+    moleculeFile->d->trajectoryData = data;
+    moleculeFile->d->trajectorySize = file->size();
+    moleculeFile->setConformerFile(true);
+
+    ReadFileThread *thread = new ReadFileThread(moleculeFile);
+    moleculeFile->d->indexThread = thread;
+    QObject::connect(thread, SIGNAL(finished()), moleculeFile, SLOT(threadFinished()));
+    thread->start();
+
+    if (wait) {
+      thread->wait();
+      takeIndexErrors(moleculeFile->d, moleculeFile->m_error);
+      moleculeFile->setReady(true);
+    }
+
+    return moleculeFile;
+  }
+
 } // end namespace
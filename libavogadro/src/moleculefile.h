@@ -90,8 +90,37 @@ namespace Avogadro {
     /**
      * Get all the conformers from the file. This methods returns an empty 
      * vector if the opened file isn't a conformer file (see isConformerFile()).
+     * Trajectories opened with readTrajectory() are not decoded up front, use
+     * frame() to get their coordinates instead.
      */
     const std::vector<std::vector<Eigen::Vector3d>*>& conformers() const;
+    /**
+     * @return True if the file was opened using readTrajectory().
+     */
+    bool isTrajectory() const;
+    /**
+     * @return The number of frames available. While a trajectory is still
+     * being indexed this number grows, see framesIndexed(). For other files
+     * this is the number of conformers.
+     */
+    unsigned int numFrames() const;
+    /**
+     * Get the coordinates of the @p {i}th frame, in the order the atoms appear
+     * in the file. Trajectory frames are decoded from the memory mapped file
+     * when they are first requested, and the most recently used frames are
+     * cached (see setFrameCacheSize()). This function is thread safe.
+     *
+     * @param i The index of the frame (indexed from 0 to numFrames()-1).
+     * @param coords Set to the coordinates of the frame.
+     * @return True on success, false if the frame does not exist or could
+     * not be decoded.
+     */
+    bool frame(unsigned int i, std::vector<Eigen::Vector3d> &coords);
+    /**
+     * Set the number of decoded trajectory frames to keep in memory. The
+     * default is 16 frames.
+     */
+    void setFrameCacheSize(int frames);
     //@}
 
     //! @name Output (writing molecules)
@@ -255,6 +284,26 @@ namespace Avogadro {
                                   const QString &fileType = QString(),
                                   const QString &fileOptions = QString(),
                                   bool wait = true);
+
+    /**
+     * Open a trajectory with a constant number of atoms per frame, such as a
+     * multi-frame XYZ file or a multi-model PDB file. The file is memory
+     * mapped and only the offsets of the frames are indexed in a separate
+     * thread, the coordinates are decoded on demand using frame(). The
+     * topology is not read, use readMolecule() for the first frame.
+     *
+     * The firstMolReady() signal is emitted as soon as the first frame is
+     * indexed, framesIndexed() as more frames become available and ready()
+     * once the whole file has been indexed.
+     * @param fileName The full path to the trajectory file.
+     * @param fileType Optional file type parameter ("xyz" or "pdb") - override
+     * default file extension parsing.
+     * @param wait Wait for the whole file to be indexed before returning.
+     * @return MoleculeFile with (future) frames.
+     */
+    static MoleculeFile* readTrajectory(const QString &fileName,
+                                        const QString &fileType = QString(),
+                                        bool wait = false);
     //@}
 
   Q_SIGNALS:
@@ -268,6 +317,12 @@ namespace Avogadro {
      */
     void firstMolReady();
 
+    /**
+     * This signal is emitted periodically while a trajectory is indexed,
+     * with the number of frames available so far.
+     */
+    void framesIndexed(int numFrames);
+
     protected Q_SLOTS:
     void threadFinished();
   protected:
@@ -280,6 +335,8 @@ namespace Avogadro {
     void setConformerFile(bool value);
     void setReady(bool value);
     void setFirstReady(bool value); // used by ReadFileThread
+    void indexTrajectory(); // used by ReadFileThread
+    bool decodeFrame(unsigned int i, std::vector<Eigen::Vector3d> &coords);
 
     MoleculeFilePrivate * const d; 
     QString m_fileName, m_fileType, m_fileOptions;
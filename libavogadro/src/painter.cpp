@@ -26,6 +26,9 @@
  **********************************************************************/
 
 #include "painter.h"
+#include "color3f.h"
+
+#include <QVector>
 
 namespace Avogadro
 {
@@ -53,6 +56,27 @@ namespace Avogadro
     drawSphere(*center, radius);
   }
 
+  void Painter::drawSpheres(const QVector<Eigen::Vector3d> &centers,
+                            const QVector<double> &radii,
+                            const QVector<Color3f> &colors, double alpha)
+  {
+    for (int i = 0; i < centers.size(); ++i) {
+      setColor(colors[i].red(), colors[i].green(), colors[i].blue(), alpha);
+      drawSphere(centers[i], radii[i]);
+    }
+  }
+
+  void Painter::drawCylinders(const QVector<Eigen::Vector3d> &ends1,
+                              const QVector<Eigen::Vector3d> &ends2,
+                              const QVector<double> &radii,
+                              const QVector<Color3f> &colors, double alpha)
+  {
+    for (int i = 0; i < ends1.size(); ++i) {
+      setColor(colors[i].red(), colors[i].green(), colors[i].blue(), alpha);
+      drawCylinder(ends1[i], ends2[i], radii[i]);
+    }
+  }
+
   void Painter::drawQuadrilateral(const Eigen::Vector3d & p1,
                                   const Eigen::Vector3d & p2,
                                   const Eigen::Vector3d & p3,
@@ -49,6 +49,7 @@ namespace Avogadro
    * @sa GLPainter, POVPainter
    */
   class Color;
+  class Color3f;
   class Mesh;
   class A_EXPORT Painter
   {
@@ -176,6 +177,40 @@ namespace Avogadro
                                    const Eigen::Vector3d &end2,
                                    double radius, int order, double shift) = 0;
 
+    /**
+     * Draws many spheres in one call. Engines drawing a whole molecule should
+     * prefer this to calling drawSphere() for each atom, as painters can then
+     * send all of the spheres to the graphics card at once. The spheres are
+     * not named, engines should draw named spheres in renderPick().
+     * @param centers the positions of the centers of the spheres.
+     * @param radii the radius of each sphere.
+     * @param colors the color of each sphere.
+     * @param alpha the opacity of all of the spheres.
+     * @note The default implementation calls setColor() and drawSphere() for
+     * each sphere.
+     */
+    virtual void drawSpheres(const QVector<Eigen::Vector3d> &centers,
+                             const QVector<double> &radii,
+                             const QVector<Color3f> &colors,
+                             double alpha = 1.0);
+
+    /**
+     * Draws many cylinders in one call, the cylinder equivalent of
+     * drawSpheres(). The cylinders are not named.
+     * @param ends1 the positions of the first ends of the cylinders.
+     * @param ends2 the positions of the second ends of the cylinders.
+     * @param radii the radius of each cylinder.
+     * @param colors the color of each cylinder.
+     * @param alpha the opacity of all of the cylinders.
+     * @note The default implementation calls setColor() and drawCylinder() for
+     * each cylinder.
+     */
+    virtual void drawCylinders(const QVector<Eigen::Vector3d> &ends1,
+                               const QVector<Eigen::Vector3d> &ends2,
+                               const QVector<double> &radii,
+                               const QVector<Color3f> &colors,
+                               double alpha = 1.0);
+
     /**
      * Draws a cone between the tip and the base with the base radius given.
      * @param base the position of the base of the cone.
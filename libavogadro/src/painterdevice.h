@@ -34,6 +34,7 @@ namespace Avogadro {
   class Molecule;
   class Color;
   class PrimitiveList;
+  class PrimitiveCuller;
 
   class A_EXPORT PainterDevice
   {
@@ -49,6 +50,12 @@ namespace Avogadro {
     virtual Color* colorMap() const = 0;
     virtual PrimitiveList * primitives() const { return 0; }
 
+    /**
+     * @return The culler limiting the primitives the engines draw to those
+     * in view, or 0 if everything should be drawn.
+     */
+    virtual const PrimitiveCuller * culler() const { return 0; }
+
     virtual int width() = 0;
     virtual int height() = 0;
   };
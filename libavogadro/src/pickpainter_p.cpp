@@ -0,0 +1,84 @@
+/**********************************************************************
+  PickPainter - records the named shapes engines draw for picking
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include "pickpainter_p.h"
+#include "raypicker.h"
+
+#include <avogadro/atom.h>
+#include <avogadro/bond.h>
+
+namespace Avogadro
+{
+
+  PickPainter::PickPainter(RayPicker *picker) : m_picker(picker),
+    m_type(Primitive::OtherType), m_id(-1)
+  {
+  }
+
+  PickPainter::~PickPainter()
+  {
+  }
+
+  void PickPainter::setName(const Primitive *primitive)
+  {
+    m_type = primitive->type();
+    if (m_type == Primitive::AtomType)
+      m_id = static_cast<const Atom *>(primitive)->index();
+    else if (m_type == Primitive::BondType)
+      m_id = static_cast<const Bond *>(primitive)->index();
+  }
+
+  void PickPainter::setName(Primitive::Type type, int id)
+  {
+    m_type = type;
+    m_id = id;
+  }
+
+  void PickPainter::drawSphere(const Eigen::Vector3d &center, double radius)
+  {
+    if (m_id != -1)
+      m_picker->addSphere(m_type, m_id, center, radius);
+    // The name only applies to one shape, as in GLPainter::popName()
+    m_type = Primitive::OtherType;
+    m_id = -1;
+  }
+
+  void PickPainter::drawCylinder(const Eigen::Vector3d &end1,
+                                 const Eigen::Vector3d &end2, double radius)
+  {
+    if (m_id != -1)
+      m_picker->addCapsule(m_type, m_id, end1, end2, radius);
+    m_type = Primitive::OtherType;
+    m_id = -1;
+  }
+
+  void PickPainter::drawMultiCylinder(const Eigen::Vector3d &end1,
+                                      const Eigen::Vector3d &end2,
+                                      double radius, int order, double shift)
+  {
+    // The cylinders of a multiple bond are displaced by up to the shift
+    drawCylinder(end1, end2, order > 1 ? radius + shift : radius);
+  }
+
+} // End namespace Avogadro
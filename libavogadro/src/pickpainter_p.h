@@ -0,0 +1,109 @@
+/**********************************************************************
+  PickPainter - records the named shapes engines draw for picking
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#ifndef PICKPAINTER_P_H
+#define PICKPAINTER_P_H
+
+#include <avogadro/painter.h>
+
+namespace Avogadro
+{
+
+  class RayPicker;
+
+  /**
+   * @class PickPainter pickpainter_p.h
+   * @brief Painter that records pickable shapes in a RayPicker.
+   *
+   * Engines draw into this painter from Engine::renderPick(). As with the
+   * GLPainter only spheres and cylinders carry the name set by setName(),
+   * they are added to the RayPicker and everything else is ignored.
+   *
+   * @sa RayPicker, GLPainter
+   */
+  class PickPainter : public Painter
+  {
+  public:
+    PickPainter(RayPicker *picker);
+    ~PickPainter();
+
+    int quality() const { return 0; }
+
+    void setName(const Primitive *primitive);
+    void setName(Primitive::Type type, int id);
+
+    void setColor(const Color *) {}
+    void setColor(const QColor *) {}
+    void setColor(float, float, float, float = 1.0) {}
+    void setColor(QString) {}
+
+    void drawSphere(const Eigen::Vector3d &center, double radius);
+    void drawCylinder(const Eigen::Vector3d &end1, const Eigen::Vector3d &end2,
+                      double radius);
+    void drawMultiCylinder(const Eigen::Vector3d &end1,
+                           const Eigen::Vector3d &end2,
+                           double radius, int order, double shift);
+
+    void drawCone(const Eigen::Vector3d &, const Eigen::Vector3d &,
+                  double, double = 0.0) {}
+    void drawLine(const Eigen::Vector3d &, const Eigen::Vector3d &, double) {}
+    void drawMultiLine(const Eigen::Vector3d &, const Eigen::Vector3d &,
+                       double, int, short) {}
+    void drawTriangle(const Eigen::Vector3d &, const Eigen::Vector3d &,
+                      const Eigen::Vector3d &) {}
+    void drawTriangle(const Eigen::Vector3d &, const Eigen::Vector3d &,
+                      const Eigen::Vector3d &, const Eigen::Vector3d &) {}
+    void drawSpline(const QVector<Eigen::Vector3d> &, double) {}
+    void drawShadedSector(const Eigen::Vector3d &, const Eigen::Vector3d &,
+                          const Eigen::Vector3d &, double, bool = false) {}
+    void drawArc(const Eigen::Vector3d &, const Eigen::Vector3d &,
+                 const Eigen::Vector3d &, double, double, bool = false) {}
+    void drawShadedQuadrilateral(const Eigen::Vector3d &,
+                                 const Eigen::Vector3d &,
+                                 const Eigen::Vector3d &,
+                                 const Eigen::Vector3d &) {}
+    void drawQuadrilateral(const Eigen::Vector3d &, const Eigen::Vector3d &,
+                           const Eigen::Vector3d &, const Eigen::Vector3d &,
+                           double) {}
+    void drawLineLoop(const QList<Eigen::Vector3d> &, const double) {}
+    void drawMesh(const Mesh &, int = 0) {}
+    void drawColorMesh(const Mesh &, int = 0) {}
+    int drawText(int, int, const QString &) { return 0; }
+    int drawText(const QPoint &, const QString &) { return 0; }
+    int drawText(const Eigen::Vector3d &, const QString &) { return 0; }
+    int drawText(const Eigen::Vector3d &, const QString &, const QFont &)
+    { return 0; }
+    void drawBox(const Eigen::Vector3d &, const Eigen::Vector3d &) {}
+    void drawTorus(const Eigen::Vector3d &, double, double) {}
+    void drawEllipsoid(const Eigen::Vector3d &, const Eigen::Matrix3d &) {}
+
+  private:
+    RayPicker *m_picker;
+    Primitive::Type m_type;
+    int m_id;
+  };
+
+} // End namespace Avogadro
+
+#endif // PICKPAINTER_P_H
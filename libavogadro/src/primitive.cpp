@@ -34,13 +34,15 @@ namespace Avogadro {
       PrimitivePrivate() {}
   };
 
+  // PrimitivePrivate holds no data yet, do not allocate one for every atom
+  // and bond
   Primitive::Primitive(QObject *parent) : QObject(parent),
-    d_ptr(new PrimitivePrivate), m_type(Primitive::OtherType), m_id(FALSE_ID),
+    d_ptr(0), m_type(Primitive::OtherType), m_id(FALSE_ID),
     m_index(FALSE_ID)
   {}
 
   Primitive::Primitive(enum Type type, QObject *parent) : QObject(parent),
-    d_ptr(new PrimitivePrivate), m_type(type), m_id(FALSE_ID), m_index(FALSE_ID)
+    d_ptr(0), m_type(type), m_id(FALSE_ID), m_index(FALSE_ID)
   {}
 
   Primitive::Primitive(PrimitivePrivate &dd, QObject *parent) : QObject(parent),
@@ -123,8 +123,11 @@ namespace Avogadro {
      *
      * In the case of the Atom primitive, this should be called
      * when changes to coordinates have been made.
+     *
+     * Atom and Bond reimplement this to notify their Molecule directly, so
+     * the molecule does not need a signal connection per atom and bond.
      */
-    void update();
+    virtual void update();
 
     /**
      * @property Type
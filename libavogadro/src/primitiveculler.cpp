@@ -0,0 +1,297 @@
+/**********************************************************************
+  PrimitiveCuller - skip the atoms and bonds outside of the view
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include "primitiveculler.h"
+
+#include "atom.h"
+#include "bond.h"
+#include "camera.h"
+#include "molecule.h"
+
+#include <QtCore/QHash>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using Eigen::Vector3d;
+using Eigen::Vector4d;
+using std::vector;
+
+namespace Avogadro {
+
+  namespace {
+
+    // Edge of the grid cells the primitives are clustered in
+    const double cellSize = 8.0;
+    // Bounding radius of an atom, larger than any van der Waals radius
+    const double atomRadius = 3.0;
+    // Added to half the length of a bond for its bounding radius
+    const double bondRadius = 1.0;
+
+    enum Containment { Outside, Crossing, Inside };
+
+    Containment classify(const Vector4d *planes, const Vector3d &center,
+                         double radius)
+    {
+      Containment result = Inside;
+      for (int i = 0; i < 6; ++i) {
+        double distance = planes[i].x() * center.x() + planes[i].y() * center.y()
+          + planes[i].z() * center.z() + planes[i].w();
+        if (distance < -radius)
+          return Outside;
+        if (distance < radius)
+          result = Crossing;
+      }
+      return result;
+    }
+
+    struct Bound
+    {
+      Bound(unsigned long id_, const Vector3d &center_, double radius_)
+        : id(id_), center(center_), radius(radius_) {}
+
+      unsigned long id;
+      Vector3d center;
+      double radius;
+    };
+
+    struct Cluster
+    {
+      Vector3d center;
+      double radius;
+      vector<Bound> atoms;
+      vector<Bound> bonds;
+    };
+
+    quint64 cellKey(const Vector3d &position)
+    {
+      const quint64 mask = 0x1FFFFF;
+      quint64 x = static_cast<qint64>(std::floor(position.x() / cellSize)) & mask;
+      quint64 y = static_cast<qint64>(std::floor(position.y() / cellSize)) & mask;
+      quint64 z = static_cast<qint64>(std::floor(position.z() / cellSize)) & mask;
+      return (x << 42) | (y << 21) | z;
+    }
+
+  } // End anonymous namespace
+
+  class PrimitiveCullerPrivate
+  {
+  public:
+    PrimitiveCullerPrivate() : dirty(true), active(false), molecule(0),
+                               culledAtoms(0), culledBonds(0) {}
+
+    bool dirty;
+    bool active;
+    const Molecule *molecule;
+
+    vector<Cluster> clusters;
+    // Visibility indexed by primitive id
+    vector<bool> atomVisible;
+    vector<bool> bondVisible;
+
+    QList<Atom *> atoms;
+    QList<Bond *> bonds;
+    int culledAtoms;
+    int culledBonds;
+
+    void build(const Molecule *molecule);
+    Cluster & cluster(QHash<quint64, int> &cells, const Vector3d &position);
+  };
+
+  Cluster & PrimitiveCullerPrivate::cluster(QHash<quint64, int> &cells,
+                                            const Vector3d &position)
+  {
+    quint64 key = cellKey(position);
+    QHash<quint64, int>::const_iterator it = cells.constFind(key);
+    if (it != cells.constEnd())
+      return clusters[*it];
+
+    cells.insert(key, clusters.size());
+    clusters.push_back(Cluster());
+    Cluster &c = clusters.back();
+    c.center = Vector3d((std::floor(position.x() / cellSize) + 0.5) * cellSize,
+                        (std::floor(position.y() / cellSize) + 0.5) * cellSize,
+                        (std::floor(position.z() / cellSize) + 0.5) * cellSize);
+    c.radius = 0.0;
+    return c;
+  }
+
+  void PrimitiveCullerPrivate::build(const Molecule *mol)
+  {
+    molecule = mol;
+    dirty = false;
+    clusters.clear();
+    atomVisible.clear();
+    bondVisible.clear();
+    if (!molecule)
+      return;
+
+    QHash<quint64, int> cells;
+    foreach (Atom *atom, molecule->atoms()) {
+      const Vector3d &position = *atom->pos();
+      cluster(cells, position).atoms.push_back(Bound(atom->id(), position,
+                                                     atomRadius));
+      if (atom->id() >= atomVisible.size())
+        atomVisible.resize(atom->id() + 1, true);
+    }
+    foreach (Bond *bond, molecule->bonds()) {
+      const Atom *begin = molecule->atomById(bond->beginAtomId());
+      const Atom *end = molecule->atomById(bond->endAtomId());
+      if (!begin || !end)
+        continue;
+      Vector3d center = (*begin->pos() + *end->pos()) / 2.0;
+      double radius = (*end->pos() - *begin->pos()).norm() / 2.0 + bondRadius;
+      cluster(cells, center).bonds.push_back(Bound(bond->id(), center, radius));
+      if (bond->id() >= bondVisible.size())
+        bondVisible.resize(bond->id() + 1, true);
+    }
+
+    // Bounding spheres of the clusters around the cell centers
+    for (vector<Cluster>::iterator c = clusters.begin(); c != clusters.end(); ++c) {
+      for (vector<Bound>::const_iterator b = c->atoms.begin(); b != c->atoms.end(); ++b)
+        c->radius = std::max(c->radius, (b->center - c->center).norm() + b->radius);
+      for (vector<Bound>::const_iterator b = c->bonds.begin(); b != c->bonds.end(); ++b)
+        c->radius = std::max(c->radius, (b->center - c->center).norm() + b->radius);
+    }
+  }
+
+  PrimitiveCuller::PrimitiveCuller() : d(new PrimitiveCullerPrivate)
+  {
+  }
+
+  PrimitiveCuller::~PrimitiveCuller()
+  {
+    delete d;
+  }
+
+  void PrimitiveCuller::invalidate()
+  {
+    d->dirty = true;
+  }
+
+  void PrimitiveCuller::update(const Molecule *molecule, const Camera *camera)
+  {
+    Vector4d planes[6];
+    camera->frustumPlanes(planes);
+    update(molecule, planes);
+  }
+
+  void PrimitiveCuller::update(const Molecule *molecule, const Vector4d *planes)
+  {
+    if (d->dirty || molecule != d->molecule)
+      d->build(molecule);
+
+    std::fill(d->atomVisible.begin(), d->atomVisible.end(), false);
+    std::fill(d->bondVisible.begin(), d->bondVisible.end(), false);
+    for (vector<Cluster>::const_iterator c = d->clusters.begin();
+         c != d->clusters.end(); ++c) {
+      switch (classify(planes, c->center, c->radius)) {
+      case Outside:
+        break;
+      case Inside:
+        for (vector<Bound>::const_iterator b = c->atoms.begin(); b != c->atoms.end(); ++b)
+          d->atomVisible[b->id] = true;
+        for (vector<Bound>::const_iterator b = c->bonds.begin(); b != c->bonds.end(); ++b)
+          d->bondVisible[b->id] = true;
+        break;
+      case Crossing:
+        for (vector<Bound>::const_iterator b = c->atoms.begin(); b != c->atoms.end(); ++b)
+          d->atomVisible[b->id] = classify(planes, b->center, b->radius) != Outside;
+        for (vector<Bound>::const_iterator b = c->bonds.begin(); b != c->bonds.end(); ++b)
+          d->bondVisible[b->id] = classify(planes, b->center, b->radius) != Outside;
+        break;
+      }
+    }
+
+    d->atoms.clear();
+    d->bonds.clear();
+    d->culledAtoms = d->culledBonds = 0;
+    if (!molecule)
+      return;
+    d->atoms = visibleAtoms(molecule->atoms());
+    d->bonds = visibleBonds(molecule->bonds());
+    d->culledAtoms = molecule->numAtoms() - d->atoms.size();
+    d->culledBonds = molecule->numBonds() - d->bonds.size();
+  }
+
+  void PrimitiveCuller::setActive(bool active)
+  {
+    d->active = active;
+  }
+
+  bool PrimitiveCuller::isActive() const
+  {
+    return d->active;
+  }
+
+  bool PrimitiveCuller::isVisible(const Atom *atom) const
+  {
+    return atom->id() >= d->atomVisible.size() || d->atomVisible[atom->id()];
+  }
+
+  bool PrimitiveCuller::isVisible(const Bond *bond) const
+  {
+    return bond->id() >= d->bondVisible.size() || d->bondVisible[bond->id()];
+  }
+
+  const QList<Atom *> & PrimitiveCuller::visibleAtoms() const
+  {
+    return d->atoms;
+  }
+
+  const QList<Bond *> & PrimitiveCuller::visibleBonds() const
+  {
+    return d->bonds;
+  }
+
+  QList<Atom *> PrimitiveCuller::visibleAtoms(const QList<Atom *> &atoms) const
+  {
+    QList<Atom *> visible;
+    foreach (Atom *atom, atoms)
+      if (isVisible(atom))
+        visible.append(atom);
+    return visible;
+  }
+
+  QList<Bond *> PrimitiveCuller::visibleBonds(const QList<Bond *> &bonds) const
+  {
+    QList<Bond *> visible;
+    foreach (Bond *bond, bonds)
+      if (isVisible(bond))
+        visible.append(bond);
+    return visible;
+  }
+
+  int PrimitiveCuller::culledAtoms() const
+  {
+    return d->culledAtoms;
+  }
+
+  int PrimitiveCuller::culledBonds() const
+  {
+    return d->culledBonds;
+  }
+
+} // End namespace Avogadro
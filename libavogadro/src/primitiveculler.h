@@ -0,0 +1,148 @@
+/**********************************************************************
+  PrimitiveCuller - skip the atoms and bonds outside of the view
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#ifndef PRIMITIVECULLER_H
+#define PRIMITIVECULLER_H
+
+#include <avogadro/global.h>
+
+#include <Eigen/Core>
+
+#include <QtCore/QList>
+
+namespace Avogadro {
+
+  class Atom;
+  class Bond;
+  class Camera;
+  class Molecule;
+  class PrimitiveCullerPrivate;
+
+  /**
+   * @class PrimitiveCuller primitiveculler.h <avogadro/primitiveculler.h>
+   * @brief Finds the atoms and bonds inside the view frustum of a Camera.
+   *
+   * The atoms and bonds are sorted into clusters on a regular grid, each
+   * with a bounding sphere. A cluster entirely outside of one of the planes
+   * of the frustum is skipped without looking at its primitives, and one
+   * entirely inside is kept whole, so only the clusters crossing the edges
+   * of the view are tested primitive by primitive.
+   *
+   * Every primitive is given a bounding radius large enough for the
+   * largest van der Waals sphere, so engines drawing atoms with any of
+   * the usual radii are not clipped at the edges of the view.
+   *
+   * The clusters are built from the atom positions on the first update()
+   * after invalidate(), which must be called whenever atoms move or
+   * primitives are added or removed.
+   *
+   * While active, Engine::atoms() and Engine::bonds() only return the
+   * visible primitives.
+   */
+  class A_EXPORT PrimitiveCuller
+  {
+  public:
+    PrimitiveCuller();
+    ~PrimitiveCuller();
+
+    /**
+     * Rebuild the clusters on the next update().
+     */
+    void invalidate();
+
+    /**
+     * Find the primitives of @p molecule in the view of @p camera.
+     */
+    void update(const Molecule *molecule, const Camera *camera);
+
+    /**
+     * Find the primitives of @p molecule inside the six @p planes, which
+     * have their normals pointing inside as returned by
+     * Camera::frustumPlanes().
+     */
+    void update(const Molecule *molecule, const Eigen::Vector4d *planes);
+
+    /**
+     * Set whether the results of update() are used to filter the
+     * primitives of the engines. Inactive by default.
+     */
+    void setActive(bool active);
+
+    /**
+     * @return True if the engines should only draw the visible primitives.
+     */
+    bool isActive() const;
+
+    /**
+     * @return True if @p atom was inside the view on the last update().
+     * Atoms added since are always visible.
+     */
+    bool isVisible(const Atom *atom) const;
+
+    /**
+     * @return True if @p bond was inside the view on the last update().
+     * Bonds added since are always visible.
+     */
+    bool isVisible(const Bond *bond) const;
+
+    /**
+     * @return The atoms of the molecule that were visible on the last
+     * update().
+     */
+    const QList<Atom *> & visibleAtoms() const;
+
+    /**
+     * @return The bonds of the molecule that were visible on the last
+     * update().
+     */
+    const QList<Bond *> & visibleBonds() const;
+
+    /**
+     * @return The visible atoms out of @p atoms.
+     */
+    QList<Atom *> visibleAtoms(const QList<Atom *> &atoms) const;
+
+    /**
+     * @return The visible bonds out of @p bonds.
+     */
+    QList<Bond *> visibleBonds(const QList<Bond *> &bonds) const;
+
+    /**
+     * @return The number of atoms outside of the view on the last update().
+     */
+    int culledAtoms() const;
+
+    /**
+     * @return The number of bonds outside of the view on the last update().
+     */
+    int culledBonds() const;
+
+  private:
+    PrimitiveCullerPrivate * const d;
+    Q_DISABLE_COPY(PrimitiveCuller)
+  };
+
+} // End namespace Avogadro
+
+#endif // PRIMITIVECULLER_H
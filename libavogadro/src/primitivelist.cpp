@@ -24,6 +24,7 @@
 
 #include "primitivelist.h"
 
+#include <QHash>
 #include <QDebug>
 
 namespace Avogadro {
@@ -35,6 +36,9 @@ namespace Avogadro {
       int size;
 
       QVector< QList<Primitive *> > vector;
+      // Number of times each primitive is in the list, for constant time
+      // lookups in contains()
+      QHash<const Primitive *, int> members;
   };
 
   PrimitiveList::PrimitiveList() : d(new PrimitiveListPrivate) {
@@ -46,6 +50,7 @@ namespace Avogadro {
     PrimitiveListPrivate *e = other.d;
     d->size = e->size;
     d->vector = e->vector;
+    d->members = e->members;
   }
 
   PrimitiveList::PrimitiveList(const QList<Primitive *> &other) : d(new PrimitiveListPrivate)
@@ -62,6 +67,7 @@ namespace Avogadro {
     PrimitiveListPrivate *e = other.d;
     d->size = e->size;
     d->vector = e->vector;
+    d->members = e->members;
 
     return *this;
   }
@@ -103,21 +109,41 @@ namespace Avogadro {
   }
 
   bool PrimitiveList::contains(const Primitive *p) const {
-    // this is really bad, but it's a compiler workaround
-    Primitive *cp = const_cast<Primitive *>(p);
-    return d->vector[p->type()].contains(cp);
+    return d->members.contains(p);
   }
 
   void PrimitiveList::append(Primitive *p) {
     if (!p || p->type() < Primitive::FirstType || p->type() >= Primitive::LastType)
       return;
     d->vector[p->type()].append(p);
+    d->members[p]++;
     d->size++;
   }
 
   void PrimitiveList::removeAll(Primitive *p) {
-    d->vector[p->type()].removeAll(p);
-    d->size--;
+    if (!p || !d->members.remove(p))
+      return;
+    d->size -= d->vector[p->type()].removeAll(p);
+  }
+
+  void PrimitiveList::removeAll(const PrimitiveList &other) {
+    // Drop the primitives from the lookup, then filter each list in one pass
+    int removed = 0;
+    foreach(Primitive *primitive, other)
+      removed += d->members.remove(primitive);
+    if (!removed)
+      return;
+
+    for (int i = 0; i < d->vector.size(); ++i) {
+      QList<Primitive *> &typeList = d->vector[i];
+      QList<Primitive *> kept;
+      kept.reserve(typeList.size());
+      foreach(Primitive *primitive, typeList)
+        if (d->members.contains(primitive))
+          kept.append(primitive);
+      d->size -= typeList.size() - kept.size();
+      typeList = kept;
+    }
   }
 
   int PrimitiveList::size() const {
@@ -147,6 +173,7 @@ namespace Avogadro {
     for( int i=0; i<d->vector.size(); i++ ) {
       d->vector[i].clear();
     }
+    d->members.clear();
     d->size = 0;
   }
 
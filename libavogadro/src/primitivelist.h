@@ -79,7 +79,8 @@ namespace Avogadro
 
       /**
        * @param p the primitive to check if it is in any list
-       * @return true or false depending on whether p is in this list
+       * @return true or false depending on whether p is in this list, the
+       * lookup takes constant time
        */
       bool contains( const Primitive *p ) const;
 
@@ -98,6 +99,15 @@ namespace Avogadro
        */
       void removeAll( Primitive *p );
 
+      /**
+       * Remove every primitive in @p other from the queue. This takes time
+       * linear in the size of both lists, rather than removing the primitives
+       * one by one.
+       *
+       * @param other primitives to remove
+       */
+      void removeAll( const PrimitiveList &other );
+
       /**
        * @return The total number of primitives in this queue.
        */
@@ -75,6 +75,16 @@ void export_Mesh()
         &Mesh::setNormals, 
         "List containing all of the normals in a one-dimensional array.")
 
+    .add_property("indices", 
+        make_function(&Mesh::indices, return_value_policy<return_by_value>()),
+        &Mesh::setIndices,
+        "List containing the vertex indices of the triangles, empty if every "
+        "three vertices form an independent triangle.")
+
+    .add_property("numIndices", 
+        &Mesh::numIndices, 
+        "The number of indices.")
+
     .add_property("colors", 
         make_function(&Mesh::colors, return_value_policy<return_by_value>()),
         &Mesh::setColors)
@@ -63,6 +63,14 @@ void export_FileIO()
         &MoleculeFile::numMolecules,
         "The number of molecules in the file.")
 
+    .add_property("isTrajectory", 
+        &MoleculeFile::isTrajectory,
+        "True if the file was opened using readTrajectory().")
+
+    .add_property("numFrames", 
+        &MoleculeFile::numFrames,
+        "The number of frames indexed so far.")
+
     .add_property("titles", 
         &MoleculeFile::titles,
         "Te titles for the molecules.")
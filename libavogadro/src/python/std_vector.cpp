@@ -192,6 +192,7 @@ void export_std_vector()
   export_std_vector< std::vector<Eigen::Vector3f> >(); // for Mesh
   export_std_vector< std::vector<Eigen::Vector3d> >(); // for Mesh
   export_std_vector< std::vector<QColor> >(); // for Mesh
+  export_std_vector< std::vector<unsigned int> >(); // for Mesh
   
   to_python_converter<std::vector<double>*, std_vector_double_ptr_to_python_list >();
 
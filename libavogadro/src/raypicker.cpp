@@ -0,0 +1,475 @@
+/**********************************************************************
+  RayPicker - bounding volume hierarchy for picking without OpenGL
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include "raypicker.h"
+
+#include <Eigen/Geometry>
+
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using Eigen::Vector3d;
+
+namespace Avogadro {
+
+  // Maximum number of shapes in a leaf of the hierarchy
+  static const int PICK_LEAF_SIZE = 4;
+
+  struct PickShape
+  {
+    Vector3d end1, end2; // end1 == end2 for spheres
+    double radius;
+    Primitive::Type type;
+    int name;
+  };
+
+  struct PickNode
+  {
+    Vector3d min, max;
+    int first, count; // shapes of a leaf, count is 0 for inner nodes
+    int right;        // right child of an inner node, the left is the next node
+  };
+
+  // Plane with a unit normal pointing into the frustum
+  struct PickPlane
+  {
+    Vector3d normal;
+    double offset;
+    double distance(const Vector3d &p) const { return normal.dot(p) + offset; }
+  };
+
+  class RayPickerPrivate
+  {
+  public:
+    RayPickerPrivate() : recorded(0), rebuild(true) {}
+
+    std::vector<PickShape> shapes;
+    std::vector<int> order; // shape indices, sorted into the leaves
+    std::vector<PickNode> nodes;
+    int recorded; // shapes recorded since begin()
+    bool rebuild; // shapes changed, not just moved
+
+    void add(Primitive::Type type, int name, const Vector3d &end1,
+             const Vector3d &end2, double radius);
+    void shapeBounds(const PickShape &shape, Vector3d &min, Vector3d &max) const;
+    int build(int first, int count);
+    void refit();
+  };
+
+  void RayPickerPrivate::add(Primitive::Type type, int name,
+                             const Vector3d &end1, const Vector3d &end2,
+                             double radius)
+  {
+    if (recorded < static_cast<int>(shapes.size())) {
+      PickShape &shape = shapes[recorded];
+      if (shape.type != type || shape.name != name)
+        rebuild = true;
+      shape.end1 = end1;
+      shape.end2 = end2;
+      shape.radius = radius;
+      shape.type = type;
+      shape.name = name;
+    }
+    else {
+      PickShape shape;
+      shape.end1 = end1;
+      shape.end2 = end2;
+      shape.radius = radius;
+      shape.type = type;
+      shape.name = name;
+      shapes.push_back(shape);
+      rebuild = true;
+    }
+    ++recorded;
+  }
+
+  void RayPickerPrivate::shapeBounds(const PickShape &shape, Vector3d &min,
+                                     Vector3d &max) const
+  {
+    for (int j = 0; j < 3; ++j) {
+      min[j] = std::min(shape.end1[j], shape.end2[j]) - shape.radius;
+      max[j] = std::max(shape.end1[j], shape.end2[j]) + shape.radius;
+    }
+  }
+
+  // Orders shape indices by the center of the shapes along one axis
+  struct PickCenterLess
+  {
+    PickCenterLess(const std::vector<PickShape> &s, int a) : shapes(s), axis(a) {}
+    bool operator()(int i, int j) const
+    {
+      return shapes[i].end1[axis] + shapes[i].end2[axis]
+          < shapes[j].end1[axis] + shapes[j].end2[axis];
+    }
+    const std::vector<PickShape> &shapes;
+    int axis;
+  };
+
+  int RayPickerPrivate::build(int first, int count)
+  {
+    int index = nodes.size();
+    nodes.push_back(PickNode());
+    nodes[index].first = first;
+    nodes[index].count = count;
+    nodes[index].right = -1;
+    if (count <= PICK_LEAF_SIZE)
+      return index;
+
+    // Split at the median center along the longest axis of the centers
+    Vector3d min = shapes[order[first]].end1 + shapes[order[first]].end2;
+    Vector3d max = min;
+    for (int i = first + 1; i < first + count; ++i) {
+      Vector3d center = shapes[order[i]].end1 + shapes[order[i]].end2;
+      for (int j = 0; j < 3; ++j) {
+        min[j] = std::min(min[j], center[j]);
+        max[j] = std::max(max[j], center[j]);
+      }
+    }
+    int axis = 0;
+    for (int j = 1; j < 3; ++j)
+      if (max[j] - min[j] > max[axis] - min[axis])
+        axis = j;
+
+    int half = count / 2;
+    std::nth_element(order.begin() + first, order.begin() + first + half,
+                     order.begin() + first + count,
+                     PickCenterLess(shapes, axis));
+
+    nodes[index].count = 0;
+    build(first, half);
+    int right = build(first + half, count - half);
+    nodes[index].right = right;
+    return index;
+  }
+
+  void RayPickerPrivate::refit()
+  {
+    // Children always follow their parent, so update the nodes in reverse
+    for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; --i) {
+      PickNode &node = nodes[i];
+      if (node.count) {
+        shapeBounds(shapes[order[node.first]], node.min, node.max);
+        for (int k = node.first + 1; k < node.first + node.count; ++k) {
+          Vector3d min, max;
+          shapeBounds(shapes[order[k]], min, max);
+          for (int j = 0; j < 3; ++j) {
+            node.min[j] = std::min(node.min[j], min[j]);
+            node.max[j] = std::max(node.max[j], max[j]);
+          }
+        }
+      }
+      else {
+        const PickNode &left = nodes[i + 1];
+        const PickNode &right = nodes[node.right];
+        for (int j = 0; j < 3; ++j) {
+          node.min[j] = std::min(left.min[j], right.min[j]);
+          node.max[j] = std::max(left.max[j], right.max[j]);
+        }
+      }
+    }
+  }
+
+  // Scale a depth in the range [0, 1] to a GLHit depth
+  static GLuint pickDepth(double depth)
+  {
+    if (depth <= 0.0)
+      return 0;
+    if (depth >= 1.0)
+      return std::numeric_limits<GLuint>::max();
+    return static_cast<GLuint>(depth * std::numeric_limits<GLuint>::max());
+  }
+
+  // Intersect the line origin + t * direction with a shape, the direction is
+  // a unit vector. Returns false if the line misses the shape.
+  static bool intersect(const PickShape &shape, const Vector3d &origin,
+                        const Vector3d &direction, double &entry, double &exit)
+  {
+    const double r2 = shape.radius * shape.radius;
+    entry = std::numeric_limits<double>::max();
+    exit = -std::numeric_limits<double>::max();
+
+    // The spherical caps (or the sphere)
+    for (int k = 0; k < 2; ++k) {
+      Vector3d m = origin - (k ? shape.end2 : shape.end1);
+      double b = m.dot(direction);
+      double disc = b * b - (m.squaredNorm() - r2);
+      if (disc >= 0.0) {
+        double root = std::sqrt(disc);
+        entry = std::min(entry, -b - root);
+        exit = std::max(exit, -b + root);
+      }
+    }
+
+    // The cylinder, clipped to the slab between the two ends
+    Vector3d axis = shape.end2 - shape.end1;
+    double aa = axis.squaredNorm();
+    if (aa > 0.0) {
+      Vector3d m = origin - shape.end1;
+      double md = m.dot(axis), nd = direction.dot(axis);
+      double a = aa - nd * nd;
+      double b = aa * m.dot(direction) - nd * md;
+      double c = aa * (m.squaredNorm() - r2) - md * md;
+      double t0 = -std::numeric_limits<double>::max();
+      double t1 = std::numeric_limits<double>::max();
+      bool hit = true;
+      if (a > 1e-12 * aa) {
+        double disc = b * b - a * c;
+        if (disc < 0.0) {
+          hit = false;
+        }
+        else {
+          double root = std::sqrt(disc);
+          t0 = (-b - root) / a;
+          t1 = (-b + root) / a;
+        }
+      }
+      else if (c > 0.0) {
+        hit = false; // parallel to the axis and outside the cylinder
+      }
+      if (hit) {
+        if (std::fabs(nd) > 0.0) {
+          double s0 = -md / nd, s1 = (aa - md) / nd;
+          if (s0 > s1)
+            std::swap(s0, s1);
+          t0 = std::max(t0, s0);
+          t1 = std::min(t1, s1);
+        }
+        else if (md < 0.0 || md > aa) {
+          hit = false;
+        }
+      }
+      if (hit && t0 <= t1) {
+        entry = std::min(entry, t0);
+        exit = std::max(exit, t1);
+      }
+    }
+
+    return entry <= exit;
+  }
+
+  RayPicker::RayPicker() : d(new RayPickerPrivate)
+  {
+  }
+
+  RayPicker::~RayPicker()
+  {
+    delete d;
+  }
+
+  void RayPicker::begin()
+  {
+    d->recorded = 0;
+  }
+
+  void RayPicker::addSphere(Primitive::Type type, int name,
+                            const Vector3d &center, double radius)
+  {
+    d->add(type, name, center, center, radius);
+  }
+
+  void RayPicker::addCapsule(Primitive::Type type, int name,
+                             const Vector3d &end1, const Vector3d &end2,
+                             double radius)
+  {
+    d->add(type, name, end1, end2, radius);
+  }
+
+  void RayPicker::end()
+  {
+    if (d->recorded != static_cast<int>(d->shapes.size())) {
+      d->shapes.resize(d->recorded);
+      d->rebuild = true;
+    }
+
+    if (d->rebuild) {
+      d->nodes.clear();
+      d->order.resize(d->shapes.size());
+      for (unsigned int i = 0; i < d->order.size(); ++i)
+        d->order[i] = i;
+      if (!d->shapes.empty())
+        d->build(0, d->shapes.size());
+      d->rebuild = false;
+    }
+    d->refit();
+  }
+
+  void RayPicker::clear()
+  {
+    d->shapes.clear();
+    d->order.clear();
+    d->nodes.clear();
+    d->recorded = 0;
+    d->rebuild = true;
+  }
+
+  int RayPicker::size() const
+  {
+    return d->shapes.size();
+  }
+
+  QList<GLHit> RayPicker::hits(const Vector3d &origin,
+                               const Vector3d &direction, double length) const
+  {
+    QList<GLHit> hits;
+    if (d->nodes.empty() || length <= 0.0)
+      return hits;
+
+    const Vector3d dir = direction.normalized();
+    std::vector<int> stack(1, 0);
+    while (!stack.empty()) {
+      const PickNode &node = d->nodes[stack.back()];
+      int index = stack.back();
+      stack.pop_back();
+
+      // Slab test of the ray against the bounding box
+      double t0 = 0.0, t1 = length;
+      for (int j = 0; j < 3 && t0 <= t1; ++j) {
+        if (std::fabs(dir[j]) < 1e-12) {
+          if (origin[j] < node.min[j] || origin[j] > node.max[j])
+            t0 = t1 + 1.0;
+          continue;
+        }
+        double s0 = (node.min[j] - origin[j]) / dir[j];
+        double s1 = (node.max[j] - origin[j]) / dir[j];
+        if (s0 > s1)
+          std::swap(s0, s1);
+        t0 = std::max(t0, s0);
+        t1 = std::min(t1, s1);
+      }
+      if (t0 > t1)
+        continue;
+
+      if (!node.count) {
+        stack.push_back(index + 1);
+        stack.push_back(node.right);
+        continue;
+      }
+
+      for (int k = node.first; k < node.first + node.count; ++k) {
+        const PickShape &shape = d->shapes[d->order[k]];
+        double entry, exit;
+        if (!intersect(shape, origin, dir, entry, exit)
+            || exit < 0.0 || entry > length)
+          continue;
+        hits.append(GLHit(shape.type, shape.name, pickDepth(entry / length),
+                          pickDepth(exit / length)));
+      }
+    }
+
+    qSort(hits);
+    return hits;
+  }
+
+  QList<GLHit> RayPicker::hits(const Vector3d *corners) const
+  {
+    QList<GLHit> hits;
+    if (d->nodes.empty())
+      return hits;
+
+    // The six planes of the frustum, facing inwards
+    static const int faces[6][3] = { {0, 1, 2}, {4, 5, 6}, {0, 3, 4},
+                                     {1, 2, 5}, {0, 1, 4}, {2, 3, 6} };
+    Vector3d nearCenter = 0.25 * (corners[0] + corners[1] + corners[2] + corners[3]);
+    Vector3d farCenter = 0.25 * (corners[4] + corners[5] + corners[6] + corners[7]);
+    Vector3d center = 0.5 * (nearCenter + farCenter);
+    PickPlane planes[6];
+    for (int i = 0; i < 6; ++i) {
+      const Vector3d &p = corners[faces[i][0]];
+      Vector3d normal = (corners[faces[i][1]] - p).cross(corners[faces[i][2]] - p);
+      if (normal.squaredNorm() == 0.0)
+        return hits; // degenerate pick box
+      normal.normalize();
+      if (normal.dot(center - p) < 0.0)
+        normal = -normal;
+      planes[i].normal = normal;
+      planes[i].offset = -normal.dot(p);
+    }
+
+    // Depths are measured along the view direction
+    Vector3d view = farCenter - nearCenter;
+    const double depthRange = view.norm();
+    if (depthRange == 0.0)
+      return hits;
+    view /= depthRange;
+
+    std::vector<int> stack(1, 0);
+    while (!stack.empty()) {
+      int index = stack.back();
+      const PickNode &node = d->nodes[index];
+      stack.pop_back();
+
+      // The box is outside if its corner furthest along a normal is outside
+      bool outside = false;
+      for (int i = 0; i < 6 && !outside; ++i) {
+        Vector3d p;
+        for (int j = 0; j < 3; ++j)
+          p[j] = planes[i].normal[j] > 0.0 ? node.max[j] : node.min[j];
+        outside = planes[i].distance(p) < 0.0;
+      }
+      if (outside)
+        continue;
+
+      if (!node.count) {
+        stack.push_back(index + 1);
+        stack.push_back(node.right);
+        continue;
+      }
+
+      for (int k = node.first; k < node.first + node.count; ++k) {
+        const PickShape &shape = d->shapes[d->order[k]];
+        // Clip the axis of the shape to the frustum grown by the radius
+        double t0 = 0.0, t1 = 1.0;
+        for (int i = 0; i < 6 && t0 <= t1; ++i) {
+          double f0 = planes[i].distance(shape.end1) + shape.radius;
+          double f1 = planes[i].distance(shape.end2) + shape.radius;
+          if (f0 < 0.0 && f1 < 0.0)
+            t0 = t1 + 1.0;
+          else if (f0 < 0.0)
+            t0 = std::max(t0, f0 / (f0 - f1));
+          else if (f1 < 0.0)
+            t1 = std::min(t1, f0 / (f0 - f1));
+        }
+        if (t0 > t1)
+          continue;
+
+        Vector3d axis = shape.end2 - shape.end1;
+        double d0 = view.dot(shape.end1 + t0 * axis - nearCenter);
+        double d1 = view.dot(shape.end1 + t1 * axis - nearCenter);
+        if (d0 > d1)
+          std::swap(d0, d1);
+        hits.append(GLHit(shape.type, shape.name,
+                          pickDepth((d0 - shape.radius) / depthRange),
+                          pickDepth((d1 + shape.radius) / depthRange)));
+      }
+    }
+
+    qSort(hits);
+    return hits;
+  }
+
+} // End namespace Avogadro
@@ -0,0 +1,124 @@
+/**********************************************************************
+  RayPicker - bounding volume hierarchy for picking without OpenGL
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#ifndef RAYPICKER_H
+#define RAYPICKER_H
+
+#include <avogadro/global.h>
+#include <avogadro/primitive.h>
+#include <avogadro/glhit.h>
+
+#include <Eigen/Core>
+
+#include <QList>
+
+namespace Avogadro {
+
+  /**
+   * @class RayPicker raypicker.h <avogadro/raypicker.h>
+   * @brief Analytic picking of spheres and capsules.
+   *
+   * The RayPicker stores the named shapes an engine draws when picking (atom
+   * spheres and bond capsules) in a bounding volume hierarchy, and intersects
+   * them with rays or with the frustum of a pick box. It does not use OpenGL,
+   * the results are returned as GLHit lists sorted front to back.
+   *
+   * The shapes are recorded between begin() and end(). When the same shapes
+   * are recorded again in the same order, only their positions and sizes
+   * have changed and the hierarchy is refit rather than rebuilt.
+   */
+  class RayPickerPrivate;
+  class A_EXPORT RayPicker
+  {
+  public:
+    /**
+     * Constructor.
+     */
+    RayPicker();
+
+    /**
+     * Destructor.
+     */
+    ~RayPicker();
+
+    /**
+     * Start recording the shapes, replacing the current ones.
+     */
+    void begin();
+
+    /**
+     * Add a sphere.
+     * @param type The Primitive::Type reported for hits on the sphere.
+     * @param name The name (index) reported for hits on the sphere.
+     */
+    void addSphere(Primitive::Type type, int name,
+                   const Eigen::Vector3d &center, double radius);
+
+    /**
+     * Add a capsule, a cylinder from @p end1 to @p end2 with rounded caps.
+     * @param type The Primitive::Type reported for hits on the capsule.
+     * @param name The name (index) reported for hits on the capsule.
+     */
+    void addCapsule(Primitive::Type type, int name,
+                    const Eigen::Vector3d &end1, const Eigen::Vector3d &end2,
+                    double radius);
+
+    /**
+     * Finish recording, refitting or rebuilding the hierarchy.
+     */
+    void end();
+
+    /**
+     * Remove all shapes.
+     */
+    void clear();
+
+    /**
+     * @return The number of shapes.
+     */
+    int size() const;
+
+    /**
+     * @return The shapes intersected by the ray from @p origin along
+     * @p direction, up to @p length. The depths of the hits are scaled from
+     * 0 at the origin to the maximum GLuint at @p length.
+     */
+    QList<GLHit> hits(const Eigen::Vector3d &origin,
+                      const Eigen::Vector3d &direction, double length) const;
+
+    /**
+     * @return The shapes intersecting the frustum with the eight @p corners.
+     * The first four corners are on the near plane and the last four on the
+     * far plane, in the same order. The depths of the hits are scaled from 0
+     * at the near plane to the maximum GLuint at the far plane.
+     */
+    QList<GLHit> hits(const Eigen::Vector3d *corners) const;
+
+  private:
+    RayPickerPrivate * const d;
+  };
+
+} // End namespace Avogadro
+
+#endif // RAYPICKER_H
@@ -110,6 +110,12 @@ void ReadFileThread::detectConformers(unsigned int c,
 
 void ReadFileThread::run()
 {
+  // Trajectories are only indexed, the frames are decoded on demand
+  if (m_moleculeFile->isTrajectory()) {
+    m_moleculeFile->indexTrajectory();
+    return;
+  }
+
   // Check that the file can be read from disk
   if (!MoleculeFile::canOpen(m_moleculeFile->m_fileName, QFile::ReadOnly | QFile::Text)) {
     // Cannot read the file
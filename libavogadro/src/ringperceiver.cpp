@@ -0,0 +1,383 @@
+/**********************************************************************
+  RingPerceiver - smallest set of smallest rings from the bond graph
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include "ringperceiver.h"
+
+#include "atom.h"
+#include "bond.h"
+#include "molecule.h"
+
+#include <QtCore/QHash>
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <vector>
+
+using std::vector;
+
+namespace Avogadro {
+
+  namespace {
+
+    // One end of a bond in an adjacency list
+    struct Neighbor
+    {
+      int atom;
+      int edge;
+    };
+
+    // A bond between two vertices of the graph
+    struct Edge
+    {
+      int begin;
+      int end;
+      unsigned long id;
+    };
+
+    // A candidate ring: the shortest paths from root to both ends of edge
+    struct Candidate
+    {
+      int length;
+      int root;
+      int edge;
+      bool operator<(const Candidate &other) const
+      {
+        if (length != other.length)
+          return length < other.length;
+        if (root != other.root)
+          return root < other.root;
+        return edge < other.edge;
+      }
+    };
+
+    // The bonds of a molecule or ring system as an undirected graph
+    class Graph
+    {
+    public:
+      void addEdge(int begin, int end, unsigned long id)
+      {
+        Edge edge = { begin, end, id };
+        Neighbor n1 = { end, static_cast<int>(edges.size()) };
+        Neighbor n2 = { begin, static_cast<int>(edges.size()) };
+        adjacency[begin].push_back(n1);
+        adjacency[end].push_back(n2);
+        edges.push_back(edge);
+      }
+
+      vector< vector<Neighbor> > adjacency;
+      vector<Edge> edges;
+    };
+
+    // Depth first search state of one atom in ringSystems()
+    struct Frame
+    {
+      int atom;
+      int parentEdge;
+      unsigned int next;
+    };
+
+    // Breadth first search tree from one root, through the atoms ordered
+    // below it. branch is the child of the root each atom descends from.
+    struct PathTree
+    {
+      vector<int> distance;
+      vector<int> parentEdge;
+      vector<int> branch;
+    };
+
+    void buildPathTree(const Graph &graph, const vector<int> &order, int root,
+                       PathTree &tree)
+    {
+      int numAtoms = graph.adjacency.size();
+      tree.distance.assign(numAtoms, -1);
+      tree.parentEdge.assign(numAtoms, -1);
+      tree.branch.assign(numAtoms, -1);
+      vector<int> queue;
+      queue.reserve(numAtoms);
+      queue.push_back(root);
+      tree.distance[root] = 0;
+      for (unsigned int i = 0; i < queue.size(); ++i) {
+        int atom = queue[i];
+        const vector<Neighbor> &neighbors = graph.adjacency[atom];
+        for (unsigned int j = 0; j < neighbors.size(); ++j) {
+          int next = neighbors[j].atom;
+          if (tree.distance[next] < 0 && order[next] < order[root]) {
+            tree.distance[next] = tree.distance[atom] + 1;
+            tree.parentEdge[next] = neighbors[j].edge;
+            tree.branch[next] = atom == root ? next : tree.branch[atom];
+            queue.push_back(next);
+          }
+        }
+      }
+    }
+
+    inline int parentAtom(const Graph &graph, const PathTree &tree, int atom)
+    {
+      const Edge &edge = graph.edges[tree.parentEdge[atom]];
+      return edge.begin == atom ? edge.end : edge.begin;
+    }
+
+    // The set of edges of a cycle as a bit vector, for Gaussian elimination
+    // over GF(2)
+    typedef vector<quint32> EdgeSet;
+
+    inline void setBit(EdgeSet &set, int bit)
+    {
+      set[bit / 32] |= 1u << (bit % 32);
+    }
+
+    int lowestBit(const EdgeSet &set)
+    {
+      for (unsigned int i = 0; i < set.size(); ++i) {
+        if (set[i]) {
+          for (int bit = 0; bit < 32; ++bit)
+            if (set[i] & (1u << bit))
+              return i * 32 + bit;
+        }
+      }
+      return -1;
+    }
+
+  } // End anonymous namespace
+
+  QList< QList<unsigned long> > RingPerceiver::ringSystems(const Molecule *molecule)
+  {
+    QList< QList<unsigned long> > systems;
+
+    // Build the graph on atom indices from the rows of the molecule's
+    // adjacency arrays, each bond is added from its lower index end and
+    // repeated bonds to the same neighbor are skipped
+    Graph graph;
+    int numAtoms = molecule->numAtoms();
+    graph.adjacency.resize(numAtoms);
+    const vector<unsigned int> &offsets = molecule->adjacencyOffsets();
+    const vector<unsigned long> &neighbors = molecule->adjacentAtoms();
+    const vector<unsigned long> &bonds = molecule->adjacentBonds();
+    vector<int> lastSeen(numAtoms, -1);
+    QList<Atom *> atoms = molecule->atoms();
+    for (int begin = 0; begin < numAtoms; ++begin) {
+      unsigned long id = atoms[begin]->id();
+      for (unsigned int i = offsets[id]; i < offsets[id + 1]; ++i) {
+        int end = molecule->atomById(neighbors[i])->index();
+        if (end <= begin || lastSeen[end] == begin)
+          continue;
+        lastSeen[end] = begin;
+        graph.addEdge(begin, end, bonds[i]);
+      }
+    }
+
+    // Tarjan's algorithm for biconnected components, without recursion so
+    // long chains cannot overflow the stack
+    vector<int> discovered(numAtoms, -1);
+    vector<int> low(numAtoms, 0);
+    vector<Frame> frames;
+    vector<int> edgeStack;
+    int time = 0;
+
+    for (int root = 0; root < numAtoms; ++root) {
+      if (discovered[root] >= 0)
+        continue;
+      discovered[root] = low[root] = time++;
+      Frame rootFrame = { root, -1, 0 };
+      frames.push_back(rootFrame);
+
+      while (!frames.empty()) {
+        Frame &frame = frames.back();
+        const vector<Neighbor> &neighbors = graph.adjacency[frame.atom];
+        if (frame.next < neighbors.size()) {
+          const Neighbor &n = neighbors[frame.next++];
+          if (n.edge == frame.parentEdge)
+            continue;
+          if (discovered[n.atom] < 0) {
+            edgeStack.push_back(n.edge);
+            discovered[n.atom] = low[n.atom] = time++;
+            Frame child = { n.atom, n.edge, 0 };
+            frames.push_back(child); // invalidates frame
+          }
+          else if (discovered[n.atom] < discovered[frame.atom]) {
+            edgeStack.push_back(n.edge);
+            low[frame.atom] = qMin(low[frame.atom], discovered[n.atom]);
+          }
+          continue;
+        }
+
+        Frame done = frame;
+        frames.pop_back();
+        if (frames.empty())
+          break;
+        int parent = frames.back().atom;
+        low[parent] = qMin(low[parent], low[done.atom]);
+        if (low[done.atom] >= discovered[parent]) {
+          // parent is an articulation point, the edges down to done form a
+          // component. A single edge is a bond outside any ring.
+          QList<unsigned long> system;
+          int edge;
+          do {
+            edge = edgeStack.back();
+            edgeStack.pop_back();
+            system.append(graph.edges[edge].id);
+          } while (edge != done.parentEdge);
+          if (system.size() > 1) {
+            qSort(system);
+            systems.append(system);
+          }
+        }
+      }
+    }
+
+    return systems;
+  }
+
+  QList< QList<unsigned long> > RingPerceiver::sssr(const Molecule *molecule,
+                                                   const QList<unsigned long> &bonds)
+  {
+    QList< QList<unsigned long> > rings;
+
+    // Build the graph of the ring system on local vertex numbers
+    Graph graph;
+    QHash<unsigned long, int> vertices;
+    vector<unsigned long> atomIds;
+    foreach (unsigned long id, bonds) {
+      const Bond *bond = molecule->bondById(id);
+      if (!bond)
+        continue;
+      int ends[2];
+      unsigned long endIds[2] = { bond->beginAtomId(), bond->endAtomId() };
+      for (int i = 0; i < 2; ++i) {
+        QHash<unsigned long, int>::const_iterator it = vertices.constFind(endIds[i]);
+        if (it == vertices.constEnd()) {
+          ends[i] = atomIds.size();
+          vertices.insert(endIds[i], ends[i]);
+          atomIds.push_back(endIds[i]);
+          graph.adjacency.push_back(vector<Neighbor>());
+        }
+        else
+          ends[i] = it.value();
+      }
+      if (ends[0] != ends[1])
+        graph.addEdge(ends[0], ends[1], id);
+    }
+
+    int numAtoms = graph.adjacency.size();
+    int numEdges = graph.edges.size();
+    int numRings = numEdges - numAtoms + 1;
+    if (numRings < 1)
+      return rings;
+
+    // Order the atoms with the unbranched ones first. Each ring is found
+    // once, from its highest atom, using only the atoms below it (Vismara).
+    // When the system has more than one ring every ring has a branching
+    // atom, so only those need to be used as roots.
+    vector<int> order(numAtoms);
+    vector<int> roots;
+    int next = 0;
+    for (int i = 0; i < numAtoms; ++i)
+      if (graph.adjacency[i].size() <= 2)
+        order[i] = next++;
+    for (int i = 0; i < numAtoms; ++i) {
+      if (graph.adjacency[i].size() > 2) {
+        order[i] = next++;
+        roots.push_back(i);
+      }
+    }
+    if (roots.empty())
+      roots.push_back(numAtoms - 1);
+
+    // Horton's candidates: the path from a root to each end of an edge, when
+    // the two paths only meet at the root, i.e. leave it on different
+    // branches of the tree
+    vector<PathTree> trees(roots.size());
+    vector<Candidate> candidates;
+    for (unsigned int r = 0; r < roots.size(); ++r) {
+      PathTree &tree = trees[r];
+      buildPathTree(graph, order, roots[r], tree);
+      for (int e = 0; e < numEdges; ++e) {
+        const Edge &edge = graph.edges[e];
+        if (tree.distance[edge.begin] < 0 || tree.distance[edge.end] < 0
+            || tree.parentEdge[edge.begin] == e
+            || tree.parentEdge[edge.end] == e)
+          continue;
+        if (edge.begin != roots[r] && edge.end != roots[r]
+            && tree.branch[edge.begin] == tree.branch[edge.end])
+          continue;
+
+        Candidate candidate = { tree.distance[edge.begin]
+                                + tree.distance[edge.end] + 1,
+                                static_cast<int>(r), e };
+        candidates.push_back(candidate);
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    // Keep the shortest linearly independent candidates, the basis is kept
+    // in echelon form indexed by the lowest edge of each cycle
+    int words = (numEdges + 31) / 32;
+    vector<EdgeSet> basis(numEdges);
+    int rank = 0;
+    for (unsigned int c = 0; c < candidates.size() && rank < numRings; ++c) {
+      const Candidate &candidate = candidates[c];
+      const PathTree &tree = trees[candidate.root];
+      const Edge &edge = graph.edges[candidate.edge];
+      int root = roots[candidate.root];
+
+      EdgeSet cycle(words, 0);
+      setBit(cycle, candidate.edge);
+      for (int atom = edge.begin; atom != root;
+           atom = parentAtom(graph, tree, atom))
+        setBit(cycle, tree.parentEdge[atom]);
+      for (int atom = edge.end; atom != root;
+           atom = parentAtom(graph, tree, atom))
+        setBit(cycle, tree.parentEdge[atom]);
+
+      EdgeSet reduced = cycle;
+      int pivot = lowestBit(reduced);
+      while (pivot >= 0 && !basis[pivot].empty()) {
+        const EdgeSet &row = basis[pivot];
+        for (int w = 0; w < words; ++w)
+          reduced[w] ^= row[w];
+        pivot = lowestBit(reduced);
+      }
+      if (pivot < 0)
+        continue; // a combination of shorter rings
+
+      basis[pivot].swap(reduced);
+      ++rank;
+
+      // Walk the ring: root to the beginning of the edge, then back from the
+      // end of the edge
+      QList<unsigned long> ring;
+      for (int atom = edge.begin; atom != root;
+           atom = parentAtom(graph, tree, atom))
+        ring.prepend(atomIds[atom]);
+      ring.prepend(atomIds[root]);
+      for (int atom = edge.end; atom != root;
+           atom = parentAtom(graph, tree, atom))
+        ring.append(atomIds[atom]);
+      rings.append(ring);
+    }
+
+    return rings;
+  }
+
+} // End namespace Avogadro
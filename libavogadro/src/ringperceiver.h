@@ -0,0 +1,76 @@
+/**********************************************************************
+  RingPerceiver - smallest set of smallest rings from the bond graph
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#ifndef RINGPERCEIVER_H
+#define RINGPERCEIVER_H
+
+#include <avogadro/global.h>
+
+#include <QList>
+
+namespace Avogadro {
+
+  class Molecule;
+
+  /**
+   * @class RingPerceiver ringperceiver.h <avogadro/ringperceiver.h>
+   * @brief Ring perception on the atoms and bonds of a Molecule.
+   *
+   * The bonds of a molecule are first split into ring systems, the
+   * biconnected components of the bond graph that contain a ring. Every
+   * ring lies entirely within one ring system, so the smallest set of
+   * smallest rings (SSSR) of the molecule is the union of the SSSRs of its
+   * ring systems, and a system whose bonds did not change keeps its rings.
+   * Molecule::rings() uses this to only search the ring systems touched by
+   * an edit.
+   *
+   * The rings of a system are found with Horton's algorithm: candidate
+   * cycles are built from shortest paths and the shortest linearly
+   * independent ones are kept.
+   */
+  class A_EXPORT RingPerceiver
+  {
+  public:
+    /**
+     * Split the bonds of @p molecule into ring systems. Bonds that are not
+     * part of any ring are left out.
+     * @return The ring systems, each a list of bond ids in ascending order.
+     */
+    static QList< QList<unsigned long> > ringSystems(const Molecule *molecule);
+
+    /**
+     * Find the smallest set of smallest rings of a ring system.
+     * @param molecule The molecule the bonds belong to.
+     * @param bonds The bond ids of one ring system, as returned by
+     * ringSystems().
+     * @return The rings from smallest to largest, each a list of atom ids
+     * in the order they are bonded around the ring.
+     */
+    static QList< QList<unsigned long> > sssr(const Molecule *molecule,
+                                              const QList<unsigned long> &bonds);
+  };
+
+} // End namespace Avogadro
+
+#endif // RINGPERCEIVER_H
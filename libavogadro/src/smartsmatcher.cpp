@@ -0,0 +1,143 @@
+/**********************************************************************
+  SmartsMatcher - cached SMARTS pattern matching of molecules
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include "smartsmatcher.h"
+
+#include <avogadro/molecule.h>
+
+#include <openbabel/mol.h>
+#include <openbabel/parsmart.h>
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QPair>
+#include <QtCore/QQueue>
+#include <QtCore/QtConcurrentRun>
+
+#include <vector>
+
+namespace Avogadro {
+
+  namespace {
+    // A pattern and the topology version of the molecule it was matched to
+    typedef QPair<QString, unsigned int> MatchKey;
+
+    // The number of results kept, the oldest is dropped first
+    const int maxCachedMatches = 16;
+
+    QMutex cacheMutex;
+    QHash<MatchKey, QBitArray> cache;
+    QQueue<MatchKey> cacheOrder;
+
+    void storeMatch(const MatchKey &key, const QBitArray &matches)
+    {
+      QMutexLocker locker(&cacheMutex);
+      if (cache.contains(key))
+        return;
+      cache.insert(key, matches);
+      cacheOrder.enqueue(key);
+      while (cacheOrder.size() > maxCachedMatches)
+        cache.remove(cacheOrder.dequeue());
+    }
+
+    QBitArray matchOBMol(OpenBabel::OBMol &obmol, const QString &pattern)
+    {
+      QBitArray matches(obmol.NumAtoms());
+      OpenBabel::OBSmartsPattern smarts;
+      if (!smarts.Init(pattern.toStdString()) || !smarts.Match(obmol))
+        return matches;
+
+      // OpenBabel atom indices start from 1, Avogadro indices from 0
+      const std::vector<std::vector<int> > &mapList = smarts.GetUMapList();
+      std::vector<std::vector<int> >::const_iterator i;
+      std::vector<int>::const_iterator j;
+      for (i = mapList.begin(); i != mapList.end(); ++i)
+        for (j = i->begin(); j != i->end(); ++j)
+          matches.setBit(*j - 1);
+      return matches;
+    }
+
+    // Run by matchInBackground(), takes ownership of obmol
+    QBitArray matchAndStore(OpenBabel::OBMol *obmol, const QString &pattern,
+                            unsigned int version)
+    {
+      QBitArray matches = matchOBMol(*obmol, pattern);
+      delete obmol;
+      storeMatch(MatchKey(pattern, version), matches);
+      return matches;
+    }
+  }
+
+  bool SmartsMatcher::isValid(const QString &pattern)
+  {
+    if (pattern.isEmpty())
+      return false;
+    OpenBabel::OBSmartsPattern smarts;
+    return smarts.Init(pattern.toStdString());
+  }
+
+  bool SmartsMatcher::cachedMatch(const Molecule *molecule,
+                                  const QString &pattern, QBitArray *matches)
+  {
+    if (!molecule)
+      return false;
+    QMutexLocker locker(&cacheMutex);
+    QHash<MatchKey, QBitArray>::const_iterator it =
+        cache.constFind(MatchKey(pattern, molecule->topologyVersion()));
+    if (it == cache.constEnd())
+      return false;
+    if (matches)
+      *matches = it.value();
+    return true;
+  }
+
+  QBitArray SmartsMatcher::match(const Molecule *molecule,
+                                 const QString &pattern)
+  {
+    if (!molecule)
+      return QBitArray();
+
+    QBitArray matches;
+    if (cachedMatch(molecule, pattern, &matches))
+      return matches;
+
+    OpenBabel::OBMol obmol = molecule->OBMol();
+    matches = matchOBMol(obmol, pattern);
+    storeMatch(MatchKey(pattern, molecule->topologyVersion()), matches);
+    return matches;
+  }
+
+  QFuture<QBitArray> SmartsMatcher::matchInBackground(const Molecule *molecule,
+                                                      const QString &pattern)
+  {
+    // The molecule may only be read from the thread it lives in, so the
+    // copy is made here and handed over to the worker thread.
+    OpenBabel::OBMol *obmol = molecule ? new OpenBabel::OBMol(molecule->OBMol())
+                                       : new OpenBabel::OBMol;
+    unsigned int version = molecule ? molecule->topologyVersion() : 0;
+    return QtConcurrent::run(matchAndStore, obmol, pattern, version);
+  }
+
+} // End namespace Avogadro
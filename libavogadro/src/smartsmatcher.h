@@ -0,0 +1,92 @@
+/**********************************************************************
+  SmartsMatcher - cached SMARTS pattern matching of molecules
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#ifndef SMARTSMATCHER_H
+#define SMARTSMATCHER_H
+
+#include <avogadro/global.h>
+
+#include <QtCore/QBitArray>
+#include <QtCore/QFuture>
+#include <QtCore/QString>
+
+namespace Avogadro {
+
+  class Molecule;
+
+  /**
+   * @class SmartsMatcher smartsmatcher.h <avogadro/smartsmatcher.h>
+   * @brief SMARTS pattern matching with a cache shared by all plugins.
+   *
+   * The atoms matched by a pattern are returned as a bit array indexed by
+   * Atom::index(), so testing whether an atom matched is constant time.
+   * Results are cached against the pattern and Molecule::topologyVersion(),
+   * which means a pattern is only matched again after the atoms, bonds or
+   * elements of the molecule change, not when atoms move.
+   *
+   * The cache is shared and may be used from any thread. Matching large
+   * molecules can take a while, matchInBackground() does the matching on a
+   * worker thread and stores the result in the cache when it is done.
+   */
+  class A_EXPORT SmartsMatcher
+  {
+  public:
+    /**
+     * Molecules with at least this many atoms should be matched using
+     * matchInBackground() by interactive code.
+     */
+    static const unsigned int BackgroundAtomCount = 5000;
+
+    /**
+     * @return True if @p pattern is a valid SMARTS pattern.
+     */
+    static bool isValid(const QString &pattern);
+
+    /**
+     * Look up the atoms of @p molecule matching @p pattern in the cache.
+     * @param matches Set to the matched atoms if they were in the cache.
+     * @return True if the matches were in the cache.
+     */
+    static bool cachedMatch(const Molecule *molecule, const QString &pattern,
+                            QBitArray *matches);
+
+    /**
+     * @return The atoms of @p molecule matching @p pattern, with one bit per
+     * atom index. The bits are all cleared if the pattern is invalid.
+     */
+    static QBitArray match(const Molecule *molecule, const QString &pattern);
+
+    /**
+     * Match @p pattern against @p molecule on a worker thread. The molecule
+     * is copied before this returns, so it may be changed or deleted while
+     * the matching is running.
+     * @return A future holding the matched atoms as returned by match().
+     */
+    static QFuture<QBitArray> matchInBackground(const Molecule *molecule,
+                                                const QString &pattern);
+  };
+
+} // End namespace Avogadro
+
+#endif
@@ -358,6 +358,8 @@ namespace Avogadro {
 
     if(!m_running) {
       connect(m_glwidget->molecule(), SIGNAL(destroyed()), this, SLOT(abort()));
+      // Start a fresh optimization session
+      m_thread->invalidateSetup();
       m_thread->setup(m_glwidget->molecule(), m_forceField,
                       m_comboAlgorithm->currentIndex(),
                       m_stepsSpinBox->value());
@@ -427,28 +429,26 @@ namespace Avogadro {
   void AutoOptTool::finished(bool calculated)
   {
     if (m_running && calculated) {
-      QList<Atom*> atoms = m_glwidget->molecule()->atoms();
-
-      OBMol mol = m_glwidget->molecule()->OBMol();
-      m_forceField->GetCoordinates( mol );
-      // forces
-      if (mol.HasData(OBGenericDataType::ConformerData)) {
-        OBConformerData *cd = (OBConformerData*) mol.GetData(OBGenericDataType::ConformerData);
-        const vector<vector<vector3> > &allForces = cd->GetForces();
-        if (allForces.size()) {
-          const vector<vector3> &forces = allForces[0];
-          if (forces.size() == mol.NumAtoms()) {
-            foreach(Atom* atom, atoms) {
-              atom->setForceVector(Eigen::Vector3d(forces[atom->index()].AsArray()));
-            }
+      Molecule *molecule = m_glwidget->molecule();
+      QList<Atom*> atoms = molecule->atoms();
+      const vector<double> &coordinates = m_thread->coordinates();
+      const vector<double> &forces = m_thread->forces();
+
+      if (coordinates.size() == 3 * static_cast<size_t>(atoms.size())) {
+        // forces
+        if (forces.size() == coordinates.size()) {
+          const double *forcePtr = &forces[0];
+          foreach(Atom* atom, atoms) {
+            atom->setForceVector(Eigen::Vector3d(forcePtr));
+            forcePtr += 3;
           }
         }
-      }
-      // coordinates
-      double *coordPtr = mol.GetCoordinates();
-      foreach(Atom* atom, atoms) {
-        atom->setPos(Eigen::Vector3d(coordPtr));
-        coordPtr += 3;
+        // coordinates
+        const double *coordPtr = &coordinates[0];
+        foreach(Atom* atom, atoms) {
+          molecule->setAtomPos(atom->id(), Eigen::Vector3d(coordPtr));
+          coordPtr += 3;
+        }
       }
 
       if(m_clickedAtom && m_leftButtonPressed) {
@@ -480,7 +480,9 @@ namespace Avogadro {
     m_setupFailed = false;
   }
 
-  AutoOptThread::AutoOptThread(QObject*)
+  AutoOptThread::AutoOptThread(QObject*) : m_molecule(0), m_forceField(0),
+    m_setupForceField(0), m_setupNeeded(true), m_topologyVersion(0),
+    m_numConstraints(0)
   {
     m_stop = false;
     m_velocities = false;
@@ -491,6 +493,8 @@ namespace Avogadro {
                             int algorithm, int steps)
   {
     m_mutex.lock();
+    if (molecule != m_molecule)
+      m_setupNeeded = true;
     m_molecule = molecule;
     m_forceField = forceField;
     m_algorithm = algorithm;
@@ -507,10 +511,44 @@ namespace Avogadro {
     exec();
   }
 
+  void AutoOptThread::invalidateSetup()
+  {
+    m_setupNeeded = true;
+  }
+
+  bool AutoOptThread::setupForceField()
+  {
+    m_obmol = m_molecule->OBMol();
+    m_topologyVersion = m_molecule->topologyVersion();
+
+    // The constraints were changed by the user since the last setup
+    if (m_forceField != m_setupForceField
+        || m_forceField->GetConstraints().Size() != m_numConstraints)
+      m_constraints = m_forceField->GetConstraints();
+
+    // Ignore all atoms with atomic # less than 1, starting from the user's
+    // constraints so the ignores of earlier setups do not pile up
+    OpenBabel::OBFFConstraints constraints = m_constraints;
+    foreach(const Atom *atom, m_molecule->atoms()) {
+      if (atom->atomicNumber() < 1)
+        constraints.AddIgnore(atom->index() + 1);
+    }
+    m_forceField->SetConstraints(constraints);
+
+    if (!m_forceField->Setup(m_obmol))
+      return false;
+    m_forceField->SetConformers(m_obmol);
+
+    m_setupForceField = m_forceField;
+    m_numConstraints = m_forceField->GetConstraints().Size();
+    m_setupNeeded = false;
+    return true;
+  }
+
   void AutoOptThread::update()
   {
     // If the force field is false we have nothing and so should return
-    if (!m_forceField)
+    if (!m_forceField || !m_molecule)
       return;
 
     m_mutex.lock();
@@ -518,25 +556,41 @@ namespace Avogadro {
     m_forceField->SetLogFile(NULL);
     m_forceField->SetLogLevel(OBFF_LOGLVL_NONE);
 
-    OBMol mol = m_molecule->OBMol();
-
-    // Ignore all atoms with atomic # less than 1
-    foreach(const Atom *atom, m_molecule->atoms()) {
-      if (atom->atomicNumber() < 1)
-        m_forceField->GetConstraints().AddIgnore(atom->index() + 1);
+    QList<Atom*> atoms = m_molecule->atoms();
+    const unsigned int numCoordinates = 3 * atoms.size();
+
+    // A full setup is only needed when the topology, the force field or the
+    // constraints changed, otherwise only the coordinates are exchanged.
+    // Dragging atoms does not change the topology version.
+    if (m_setupNeeded || m_forceField != m_setupForceField
+        || m_molecule->topologyVersion() != m_topologyVersion
+        || m_obmol.NumAtoms() != static_cast<unsigned int>(atoms.size())
+        || m_forceField->GetConstraints().Size() != m_numConstraints) {
+      if (!setupForceField()) {
+        m_setupNeeded = true;
+        m_stop = true;
+        emit setupFailed();
+        emit finished(false);
+        m_mutex.unlock();
+        return;
+      }
+      else
+        emit setupSucces();
     }
-
-    if (!m_forceField->Setup(mol)) {
-      m_stop = true;
-      emit setupFailed();
-      emit finished(false);
-      m_mutex.unlock();
-      return;
+    else {
+      // Atoms might have been dragged since the last step
+      m_coordinates.resize(numCoordinates);
+      double *coordPtr = &m_coordinates[0];
+      foreach(const Atom *atom, atoms) {
+        const Eigen::Vector3d *pos = atom->pos();
+        coordPtr[0] = pos->x();
+        coordPtr[1] = pos->y();
+        coordPtr[2] = pos->z();
+        coordPtr += 3;
+      }
+      m_obmol.SetCoordinates(&m_coordinates[0]);
+      m_forceField->SetCoordinates(m_obmol);
     }
-    else
-      emit setupSucces();
-
-    m_forceField->SetConformers(mol);
 
     switch(m_algorithm) {
       case 0:
@@ -556,6 +610,26 @@ namespace Avogadro {
         break;
     }
 
+    // Copy the results into flat buffers for the tool
+    m_forceField->GetCoordinates(m_obmol);
+    m_coordinates.assign(m_obmol.GetCoordinates(),
+                         m_obmol.GetCoordinates() + numCoordinates);
+    m_forces.clear();
+    if (m_obmol.HasData(OBGenericDataType::ConformerData)) {
+      OBConformerData *cd = static_cast<OBConformerData*>(
+            m_obmol.GetData(OBGenericDataType::ConformerData));
+      const vector<vector<vector3> > &allForces = cd->GetForces();
+      if (allForces.size() && allForces[0].size() == m_obmol.NumAtoms()) {
+        const vector<vector3> &forces = allForces[0];
+        m_forces.reserve(numCoordinates);
+        for (unsigned int i = 0; i < forces.size(); ++i) {
+          m_forces.push_back(forces[i].x());
+          m_forces.push_back(forces[i].y());
+          m_forces.push_back(forces[i].z());
+        }
+      }
+    }
+
     m_mutex.unlock();
 
     emit finished(m_stop ? false : true);
@@ -568,25 +642,32 @@ namespace Avogadro {
 
   AutoOptCommand::AutoOptCommand(Molecule *molecule, AutoOptTool *tool,
                                  QUndoCommand *parent)
-    : QUndoCommand(parent), m_molecule(0)
+    : QUndoCommand(parent), m_molecule(0), undone(false)
   {
-    // Store the original molecule before any modifications are made
+    // Store the original coordinates before any modifications are made
     setText(QObject::tr("AutoOpt Molecule"));
-    m_moleculeCopy = *molecule;
+    m_coordinates.store(molecule);
     m_molecule = molecule;
     m_tool = tool;
   }
 
   void AutoOptCommand::redo()
   {
-    m_moleculeCopy = *m_molecule;
+    // Put back the optimized coordinates
+    if (undone) {
+      m_coordinates.swap(m_molecule);
+      m_molecule->updateMolecule();
+      undone = false;
+    }
   }
 
   void AutoOptCommand::undo()
   {
     if(m_tool)
       m_tool->disable();
-    *m_molecule = m_moleculeCopy;
+    m_coordinates.swap(m_molecule);
+    m_molecule->updateMolecule();
+    undone = true;
   }
 
   bool AutoOptCommand::mergeWith (const QUndoCommand *)
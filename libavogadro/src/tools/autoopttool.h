@@ -28,11 +28,13 @@
 #include <avogadro/glwidget.h>
 #include <avogadro/tool.h>
 #include <avogadro/molecule.h>
+#include <avogadro/coordinaterecord.h>
 
 #include <openbabel/mol.h>
 #include <openbabel/forcefield.h>
 
 #include <QtCore/QMutex>
+#include <QtCore/QPointer>
 #include <QtCore/QThread>
 #include <QtGui/QAction>
 #include <QtGui/QPushButton>
@@ -56,6 +58,18 @@ namespace Avogadro {
       void run();
       void update();
 
+      /**
+       * @return The optimized coordinates of the last update(), three doubles
+       * per atom in Molecule::atoms() order.
+       */
+      const std::vector<double> & coordinates() const { return m_coordinates; }
+
+      /**
+       * @return The forces of the last update(), three doubles per atom in
+       * Molecule::atoms() order, or an empty vector if not available.
+       */
+      const std::vector<double> & forces() const { return m_forces; }
+
     Q_SIGNALS:
       void finished(bool calculated);
       void setupDone();
@@ -65,9 +79,31 @@ namespace Avogadro {
     public Q_SLOTS:
       void stop();
 
+      /**
+       * Force a full force field setup (atom typing, interaction lists) on the
+       * next update(). Changes to Molecule::topologyVersion() do this too.
+       */
+      void invalidateSetup();
+
     private:
-      Molecule *m_molecule;
+      /**
+       * Set up the force field for the current molecule, only called when the
+       * topology, force field or constraints changed.
+       */
+      bool setupForceField();
+
+      QPointer<Molecule> m_molecule;
       OpenBabel::OBForceField * m_forceField;
+      // Long lived optimization session, reused while the topology is unchanged
+      OpenBabel::OBMol m_obmol;
+      OpenBabel::OBForceField * m_setupForceField;
+      bool m_setupNeeded;
+      unsigned int m_topologyVersion;
+      // The constraints set by the user, without the ignored dummy atoms
+      OpenBabel::OBFFConstraints m_constraints;
+      unsigned int m_numConstraints;
+      std::vector<double> m_coordinates;
+      std::vector<double> m_forces;
       bool m_velocities;
       int m_algorithm;
       //double m_convergence;
@@ -182,7 +218,7 @@ namespace Avogadro {
       int id() const;
 
     private:
-      Molecule m_moleculeCopy;
+      CoordinateRecord m_coordinates;
       Molecule *m_molecule;
       AutoOptTool *m_tool;
       bool undone;
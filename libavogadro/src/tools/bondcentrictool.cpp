@@ -145,6 +145,8 @@ namespace Avogadro {
       m_molecule = molecule;
       connect(molecule, SIGNAL(primitiveRemoved(Primitive*)), this,
           SLOT(primitiveRemoved(Primitive*)));
+      connect(molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)), this,
+          SLOT(primitivesRemoved(Avogadro::ChangeSet)));
     }
 
     clearData();
@@ -160,6 +162,21 @@ namespace Avogadro {
     }
   }
 
+  // ##########  primitivesRemoved  ##########
+
+  void BondCentricTool::primitivesRemoved(const ChangeSet &changes)
+  {
+    if (!changes.contains(Primitive::AtomType, ChangeSet::Removed)
+        && !changes.contains(Primitive::BondType, ChangeSet::Removed))
+      return;
+
+    // The ids of removed primitives are gone or taken by new ones
+    if ((m_clickedAtom && m_molecule->atomById(m_clickedAtom->id()) != m_clickedAtom)
+        || (m_clickedBond && m_molecule->bondById(m_clickedBond->id()) != m_clickedBond)
+        || (m_selectedBond && m_molecule->bondById(m_selectedBond->id()) != m_selectedBond))
+      clearData();
+  }
+
   // ##########  toolChanged  ##########
 
   void BondCentricTool::toolChanged(bool checked)
@@ -1656,7 +1673,7 @@ namespace Avogadro {
   {
     // Store the molecule - this call won't actually move an atom
     setText(QObject::tr("Bond Centric Manipulation"));
-    m_moleculeCopy = *molecule;
+    m_coordinates.store(molecule);
     m_molecule = molecule;
     m_atomIndex = 0;
     undone = false;
@@ -1671,7 +1688,7 @@ namespace Avogadro {
   {
     // Store the original molecule before any modifications are made
     setText(QObject::tr("Bond Centric Manipulation"));
-    m_moleculeCopy = *molecule;
+    m_coordinates.store(molecule);
     m_molecule = molecule;
     m_atomIndex = atom->index();
     m_pos = pos;
@@ -1684,9 +1701,8 @@ namespace Avogadro {
   {
     // Move the specified atom to the location given
     if (undone) {
-      Molecule newMolecule = *m_molecule;
-      *m_molecule = m_moleculeCopy;
-      m_moleculeCopy = newMolecule;
+      m_coordinates.swap(m_molecule);
+      m_molecule->updateMolecule();
     }
     else if (m_atomIndex) {
       Atom *atom = m_molecule->atom(m_atomIndex);
@@ -1700,10 +1716,9 @@ namespace Avogadro {
 
   void BondCentricMoveCommand::undo()
   {
-    // Restore our original molecule
-    Molecule newMolecule = *m_molecule;
-    *m_molecule = m_moleculeCopy;
-    m_moleculeCopy = newMolecule;
+    // Restore our original coordinates
+    m_coordinates.swap(m_molecule);
+    m_molecule->updateMolecule();
     undone = true;
   }
 
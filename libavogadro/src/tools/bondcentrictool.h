@@ -37,6 +37,7 @@
 #include <Eigen/Core>
 
 #include <avogadro/molecule.h>
+#include <avogadro/coordinaterecord.h>
 
 #include <QGLWidget>
 #include <QImage>
@@ -336,6 +337,14 @@ namespace Avogadro {
        */
       void primitiveRemoved(Primitive* primitive);
 
+      /**
+       * Function to be called when primitives are removed inside a change
+       * set, which does not signal them one by one.
+       *
+       * @param changes The changes made to the molecule.
+       */
+      void primitivesRemoved(const Avogadro::ChangeSet &changes);
+
       /**
        * Function to be called when the settings widget is destroyed.
        */
@@ -405,7 +414,7 @@ namespace Avogadro {
       int id() const;
 
     private:
-      Molecule m_moleculeCopy;
+      CoordinateRecord m_coordinates;
       Molecule *m_molecule;
       int m_atomIndex;
       Eigen::Vector3d m_pos;
@@ -32,7 +32,7 @@ namespace Avogadro {
   {
     // Store the molecule - this call won't actually move an atom
     setText(QObject::tr("Manipulate Atom"));
-    m_moleculeCopy = *molecule;
+    m_coordinates.store(molecule);
     m_molecule = molecule;
     undone = false;
   }
@@ -41,7 +41,7 @@ namespace Avogadro {
   {
     // Store the original molecule before any modifications are made
     setText(QObject::tr("Manipulate Atom"));
-    m_moleculeCopy = *molecule;
+    m_coordinates.store(molecule);
     m_molecule = molecule;
     m_type = type;
     undone = false;
@@ -52,9 +52,7 @@ namespace Avogadro {
     // Move the specified atom to the location given
     if (undone)
     {
-      Molecule newMolecule = *m_molecule;
-      *m_molecule = m_moleculeCopy;
-      m_moleculeCopy = newMolecule;
+      m_coordinates.swap(m_molecule);
       m_molecule->updateMolecule();
     }
     QUndoCommand::redo();
@@ -62,10 +60,8 @@ namespace Avogadro {
 
   void MoveAtomCommand::undo()
   {
-    // Restore our original molecule
-    Molecule newMolecule = *m_molecule;
-    *m_molecule = m_moleculeCopy;
-    m_moleculeCopy = newMolecule;
+    // Restore our original coordinates
+    m_coordinates.swap(m_molecule);
     undone = true;
     m_molecule->updateMolecule();
   }
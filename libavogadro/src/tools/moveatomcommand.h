@@ -29,6 +29,7 @@
 
 #include <QUndoCommand>
 #include <avogadro/molecule.h>
+#include <avogadro/coordinaterecord.h>
 
 namespace Avogadro {
 
@@ -44,7 +45,7 @@ namespace Avogadro {
       int id() const;
 
     private:
-      Molecule m_moleculeCopy;
+      CoordinateRecord m_coordinates;
       Molecule *m_molecule;
       int m_type;
       bool undone;
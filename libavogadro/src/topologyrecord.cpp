@@ -0,0 +1,356 @@
+/**********************************************************************
+  TopologyRecord - compact undo record for removed atoms and bonds
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include "topologyrecord.h"
+
+#include "atom.h"
+#include "bond.h"
+#include "idlist.h"
+#include "molecule.h"
+#include "residue.h"
+
+#include <openbabel/generic.h>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QSet>
+#include <QtCore/QVariant>
+
+#include <vector>
+
+using std::vector;
+using Eigen::Vector3d;
+
+namespace Avogadro {
+
+  struct AtomRecord
+  {
+    unsigned long id;
+    unsigned long index;
+    int atomicNumber;
+    int formalCharge;
+    // Unassigned charges are guessed and must stay unassigned
+    bool formalChargeAssigned;
+    double customRadius;
+    QString customLabel;
+    QString customColorName;
+    Vector3d forceVector;
+    unsigned long residue;
+    // Dynamic properties set on the atom with QObject::setProperty()
+    QList<QByteArray> propertyNames;
+    QList<QVariant> propertyValues;
+  };
+
+  struct BondRecord
+  {
+    unsigned long id;
+    unsigned long index;
+    unsigned long beginAtom;
+    unsigned long endAtom;
+    short order;
+    QString customLabel;
+  };
+
+  struct ResidueRecord
+  {
+    unsigned long id;
+    unsigned long index;
+    QString name;
+    QString number;
+    unsigned int chainNumber;
+    char chainID;
+    QList<unsigned long> atoms;
+    QList<QString> atomIds;
+  };
+
+  class TopologyRecordPrivate
+  {
+  public:
+    TopologyRecordPrivate() : all(false), numConformers(0),
+      currentConformer(0), unitCell(0) {}
+    ~TopologyRecordPrivate() { delete unitCell; }
+
+    void clear();
+    void recordAtoms(const Molecule *molecule, const QList<Atom *> &atoms);
+    void recordBond(const Bond *bond);
+    void recordResidue(Residue *residue);
+
+    // True if the whole molecule was cleared
+    bool all;
+    vector<AtomRecord> atoms;
+    // The positions of the atoms in each conformer, atom by atom
+    vector<Vector3d> positions;
+    unsigned int numConformers;
+    unsigned int currentConformer;
+    vector<BondRecord> bonds;
+    vector<ResidueRecord> residues;
+    OpenBabel::OBUnitCell *unitCell;
+  };
+
+  void TopologyRecordPrivate::clear()
+  {
+    all = false;
+    atoms.clear();
+    positions.clear();
+    numConformers = 0;
+    currentConformer = 0;
+    bonds.clear();
+    residues.clear();
+    delete unitCell;
+    unitCell = 0;
+  }
+
+  void TopologyRecordPrivate::recordAtoms(const Molecule *molecule,
+                                          const QList<Atom *> &atomList)
+  {
+    const vector<vector<Vector3d> *> &conformers = molecule->conformers();
+    numConformers = conformers.size();
+    currentConformer = molecule->currentConformer();
+    atoms.reserve(atomList.size());
+    positions.reserve(atomList.size() * numConformers);
+    foreach (Atom *atom, atomList) {
+      AtomRecord record;
+      record.id = atom->id();
+      record.index = atom->index();
+      record.atomicNumber = atom->atomicNumber();
+      record.formalCharge = atom->formalCharge();
+      record.formalChargeAssigned = molecule->m_atomFlags[record.id]
+        & Molecule::AtomFormalChargeAssigned;
+      record.customRadius = atom->customRadius();
+      record.customLabel = atom->customLabel();
+      record.customColorName = atom->customColorName();
+      record.forceVector = atom->forceVector();
+      record.residue = atom->residueId();
+      foreach (const QByteArray &name, atom->dynamicPropertyNames()) {
+        record.propertyNames.append(name);
+        record.propertyValues.append(atom->property(name.constData()));
+      }
+      atoms.push_back(record);
+      for (unsigned int c = 0; c < numConformers; ++c) {
+        const vector<Vector3d> &conformer = *conformers[c];
+        positions.push_back(record.id < conformer.size() ?
+                            conformer[record.id] : Vector3d::Zero());
+      }
+    }
+  }
+
+  void TopologyRecordPrivate::recordBond(const Bond *bond)
+  {
+    BondRecord record;
+    record.id = bond->id();
+    record.index = bond->index();
+    record.beginAtom = bond->beginAtomId();
+    record.endAtom = bond->endAtomId();
+    record.order = bond->order();
+    record.customLabel = bond->customLabel();
+    bonds.push_back(record);
+  }
+
+  void TopologyRecordPrivate::recordResidue(Residue *residue)
+  {
+    ResidueRecord record;
+    record.id = residue->id();
+    record.index = residue->index();
+    record.name = residue->name();
+    record.number = residue->number();
+    record.chainNumber = residue->chainNumber();
+    record.chainID = residue->chainID();
+    record.atoms = residue->atoms();
+    record.atomIds = residue->atomIds();
+    residues.push_back(record);
+  }
+
+  static bool indexLessThan(const Primitive *a, const Primitive *b)
+  {
+    return a->index() < b->index();
+  }
+
+  TopologyRecord::TopologyRecord() : d(new TopologyRecordPrivate)
+  {
+  }
+
+  TopologyRecord::~TopologyRecord()
+  {
+    delete d;
+  }
+
+  void TopologyRecord::remove(Molecule *molecule, const IDList &primitives)
+  {
+    d->clear();
+
+    // Record the atoms and all their bonds in the order of the molecule
+    QList<Atom *> atoms;
+    foreach (unsigned long id, primitives.subList(Primitive::AtomType)) {
+      Atom *atom = molecule->atomById(id);
+      if (atom)
+        atoms.append(atom);
+    }
+    qSort(atoms.begin(), atoms.end(), indexLessThan);
+    d->recordAtoms(molecule, atoms);
+
+    QSet<Bond *> bondSet;
+    foreach (Atom *atom, atoms)
+      foreach (unsigned long id, atom->bonds())
+        if (Bond *bond = molecule->bondById(id))
+          bondSet.insert(bond);
+    foreach (unsigned long id, primitives.subList(Primitive::BondType))
+      if (Bond *bond = molecule->bondById(id))
+        bondSet.insert(bond);
+    QList<Bond *> bonds = bondSet.toList();
+    qSort(bonds.begin(), bonds.end(), indexLessThan);
+    d->bonds.reserve(bonds.size());
+    foreach (Bond *bond, bonds)
+      d->recordBond(bond);
+
+    QList<Residue *> residues;
+    foreach (unsigned long id, primitives.subList(Primitive::ResidueType)) {
+      Residue *residue = molecule->residueById(id);
+      if (residue)
+        residues.append(residue);
+    }
+    qSort(residues.begin(), residues.end(), indexLessThan);
+    foreach (Residue *residue, residues)
+      d->recordResidue(residue);
+
+    // The bonds include all those of the atoms
+    molecule->removeBonds(bonds);
+    molecule->removeAtoms(atoms);
+    foreach (Residue *residue, residues)
+      molecule->removeResidue(residue);
+  }
+
+  void TopologyRecord::removeAll(Molecule *molecule)
+  {
+    d->clear();
+    d->all = true;
+
+    d->recordAtoms(molecule, molecule->atoms());
+    QList<Bond *> bonds = molecule->bonds();
+    d->bonds.reserve(bonds.size());
+    foreach (Bond *bond, bonds)
+      d->recordBond(bond);
+    foreach (Residue *residue, molecule->residues())
+      d->recordResidue(residue);
+    if (molecule->OBUnitCell())
+      d->unitCell = new OpenBabel::OBUnitCell(*molecule->OBUnitCell());
+
+    molecule->clear();
+  }
+
+  void TopologyRecord::restore(Molecule *molecule)
+  {
+    // The records are sorted by index, the primitives are added at the end
+    // and then moved back to their old indices in one pass
+    vector<unsigned long> indices;
+    indices.reserve(d->atoms.size());
+    for (unsigned int i = 0; i < d->atoms.size(); ++i) {
+      const AtomRecord &record = d->atoms[i];
+      Atom *atom = molecule->addAtom(record.id);
+      atom->setAtomicNumber(record.atomicNumber);
+      if (record.formalChargeAssigned)
+        atom->setFormalCharge(record.formalCharge);
+      atom->setCustomRadius(record.customRadius);
+      atom->setCustomLabel(record.customLabel);
+      atom->setCustomColorName(record.customColorName);
+      atom->setForceVector(record.forceVector);
+      for (int j = 0; j < record.propertyNames.size(); ++j)
+        atom->setProperty(record.propertyNames[j].constData(),
+                          record.propertyValues[j]);
+      indices.push_back(record.index);
+    }
+    molecule->moveToIndices(Primitive::AtomType, indices);
+
+    // A cleared molecule lost its conformers, add them back once every atom
+    // is there so they have the right size
+    if (d->all && d->numConformers) {
+      molecule->addConformer(d->numConformers - 1);
+      molecule->setConformer(d->currentConformer);
+    }
+    const vector<vector<Vector3d> *> &conformers = molecule->conformers();
+    for (unsigned int c = 0; c < d->numConformers && c < conformers.size();
+         ++c) {
+      vector<Vector3d> &conformer = *conformers[c];
+      for (unsigned int i = 0; i < d->atoms.size(); ++i)
+        if (d->atoms[i].id < conformer.size())
+          conformer[d->atoms[i].id] = d->positions[i * d->numConformers + c];
+    }
+
+    indices.clear();
+    foreach (const BondRecord &record, d->bonds) {
+      Bond *bond = molecule->addBond(record.id);
+      bond->setAtoms(record.beginAtom, record.endAtom, record.order);
+      bond->setCustomLabel(record.customLabel);
+      indices.push_back(record.index);
+    }
+    molecule->moveToIndices(Primitive::BondType, indices);
+
+    indices.clear();
+    QSet<unsigned long> restoredResidues;
+    foreach (const ResidueRecord &record, d->residues) {
+      restoredResidues.insert(record.id);
+      Residue *residue = molecule->addResidue(record.id);
+      residue->setName(record.name);
+      residue->setNumber(record.number);
+      residue->setChainNumber(record.chainNumber);
+      residue->setChainID(record.chainID);
+      foreach (unsigned long id, record.atoms)
+        residue->addAtom(id);
+      residue->setAtomIds(record.atomIds);
+      indices.push_back(record.index);
+    }
+    molecule->moveToIndices(Primitive::ResidueType, indices);
+
+    // Put the atoms back into residues that were not removed, the restored
+    // residues already have theirs
+    for (unsigned int i = 0; i < d->atoms.size(); ++i) {
+      if (restoredResidues.contains(d->atoms[i].residue))
+        continue;
+      Residue *residue = molecule->residueById(d->atoms[i].residue);
+      if (residue)
+        residue->addAtom(d->atoms[i].id);
+    }
+
+    if (d->unitCell) {
+      molecule->setOBUnitCell(d->unitCell);
+      d->unitCell = 0;
+    }
+
+    d->clear();
+  }
+
+  bool TopologyRecord::isEmpty() const
+  {
+    return d->atoms.empty() && d->bonds.empty() && d->residues.empty()
+        && !d->unitCell;
+  }
+
+  unsigned long TopologyRecord::memoryUsage() const
+  {
+    return sizeof(TopologyRecordPrivate)
+        + d->atoms.capacity() * sizeof(AtomRecord)
+        + d->positions.capacity() * sizeof(Vector3d)
+        + d->bonds.capacity() * sizeof(BondRecord)
+        + d->residues.capacity() * sizeof(ResidueRecord);
+  }
+
+} // End namespace Avogadro
@@ -0,0 +1,92 @@
+/**********************************************************************
+  TopologyRecord - compact undo record for removed atoms and bonds
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#ifndef TOPOLOGYRECORD_H
+#define TOPOLOGYRECORD_H
+
+#include <avogadro/global.h>
+
+namespace Avogadro {
+
+  class Molecule;
+  class IDList;
+
+  /**
+   * @class TopologyRecord topologyrecord.h <avogadro/topologyrecord.h>
+   * @brief Removes atoms, bonds and residues so they can be restored later.
+   *
+   * Undo commands that delete part of a molecule (cut, clear) or add to it
+   * (paste) use a TopologyRecord instead of a copy of the whole Molecule.
+   * remove() records only the primitives it deletes, and restore() adds them
+   * back with their original ids, so later commands on the undo stack that
+   * refer to them by id keep working.
+   *
+   * Restored atoms, bonds and residues are put back at their original
+   * indices, so the file output order and the frames of a trajectory still
+   * line up with the atoms after an undo.
+   */
+  class TopologyRecordPrivate;
+  class A_EXPORT TopologyRecord
+  {
+  public:
+    TopologyRecord();
+    ~TopologyRecord();
+
+    /**
+     * Record and remove the atoms, bonds and residues in @p primitives from
+     * @p molecule. The bonds to the removed atoms are recorded and removed
+     * too. Anything recorded before is discarded.
+     */
+    void remove(Molecule *molecule, const IDList &primitives);
+
+    /**
+     * Record every atom, bond and residue and the unit cell of @p molecule,
+     * then clear it.
+     */
+    void removeAll(Molecule *molecule);
+
+    /**
+     * Add the recorded primitives back to @p molecule and empty the record.
+     * Call Molecule::update() afterwards to redraw the molecule.
+     */
+    void restore(Molecule *molecule);
+
+    /**
+     * @return True if nothing is recorded.
+     */
+    bool isEmpty() const;
+
+    /**
+     * @return The approximate number of bytes used by the record.
+     */
+    unsigned long memoryUsage() const;
+
+  private:
+    TopologyRecordPrivate * const d;
+    Q_DISABLE_COPY(TopologyRecord)
+  };
+
+} // End namespace Avogadro
+
+#endif // TOPOLOGYRECORD_H
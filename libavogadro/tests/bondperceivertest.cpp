@@ -0,0 +1,114 @@
+/**********************************************************************
+  BondPerceiverTest - unit tests for distance based bond perception
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include <QtTest>
+#include <avogadro/molecule.h>
+#include <avogadro/atom.h>
+#include <avogadro/bond.h>
+#include <avogadro/bondperceiver.h>
+
+#include <Eigen/Core>
+
+#include <vector>
+
+using Avogadro::Molecule;
+using Avogadro::Atom;
+using Avogadro::Bond;
+using Avogadro::BondPerceiver;
+
+using Eigen::Vector3d;
+
+class BondPerceiverTest : public QObject
+{
+  Q_OBJECT
+
+  private slots:
+    void chain();
+    void bruteForce();
+    void setBonds();
+};
+
+void BondPerceiverTest::chain()
+{
+  // Carbons 1.5 A apart are bonded to their neighbors only
+  Molecule molecule;
+  for (int i = 0; i < 100; ++i)
+    molecule.addAtom(6, Vector3d(1.5 * i, 0.0, 0.0));
+  std::vector<BondPerceiver::AtomPair> bonds =
+    BondPerceiver::perceive(BondPerceiver::covalentRadii(&molecule),
+                            *molecule.conformer(0));
+  QCOMPARE(bonds.size(), static_cast<size_t>(99));
+  for (unsigned long i = 0; i < 99; ++i)
+    QVERIFY(bonds[i] == BondPerceiver::AtomPair(i, i + 1));
+}
+
+void BondPerceiverTest::bruteForce()
+{
+  // Random coordinates give the same bonds as comparing every pair
+  std::vector<double> radii(500);
+  std::vector<Vector3d> positions(500);
+  qsrand(42);
+  for (int i = 0; i < 500; ++i) {
+    radii[i] = i % 10 == 0 ? -1.0 : 0.3 + (qrand() % 100) / 100.0;
+    positions[i] = Vector3d(qrand() % 1500, qrand() % 1500, qrand() % 1500) / 100.0;
+  }
+  std::vector<BondPerceiver::AtomPair> expected;
+  for (unsigned long i = 0; i < 500; ++i) {
+    for (unsigned long j = i + 1; j < 500; ++j) {
+      if (radii[i] < 0.0 || radii[j] < 0.0)
+        continue;
+      double cutoff = radii[i] + radii[j] + 0.45;
+      double d2 = (positions[i] - positions[j]).squaredNorm();
+      if (d2 >= 0.16 && d2 <= cutoff * cutoff)
+        expected.push_back(BondPerceiver::AtomPair(i, j));
+    }
+  }
+  QVERIFY(BondPerceiver::perceive(radii, positions) == expected);
+}
+
+void BondPerceiverTest::setBonds()
+{
+  Molecule molecule;
+  for (int i = 0; i < 4; ++i)
+    molecule.addAtom(6, Vector3d(1.5 * i, 0.0, 0.0));
+  Bond *kept = molecule.addBond(0, 1, 2);
+  molecule.addBond(0, 3, 1);
+
+  std::vector<BondPerceiver::AtomPair> bonds;
+  bonds.push_back(BondPerceiver::AtomPair(0, 1));
+  bonds.push_back(BondPerceiver::AtomPair(1, 2));
+  bonds.push_back(BondPerceiver::AtomPair(2, 3));
+  BondPerceiver::setBonds(&molecule, bonds);
+
+  // The unchanged bond is the same object with its order
+  QCOMPARE(molecule.numBonds(), 3U);
+  QCOMPARE(molecule.bond(molecule.atomById(0), molecule.atomById(1)), kept);
+  QCOMPARE(static_cast<int>(kept->order()), 2);
+  QVERIFY(!molecule.bond(molecule.atomById(0), molecule.atomById(3)));
+  QVERIFY(molecule.bond(molecule.atomById(2), molecule.atomById(3)));
+}
+
+QTEST_MAIN(BondPerceiverTest)
+
+#include "moc_bondperceivertest.cxx"
@@ -0,0 +1,248 @@
+/**********************************************************************
+  ColorTest - unit tests for the colors of all atoms evaluated at once
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include <QtTest>
+#include <avogadro/molecule.h>
+#include <avogadro/atom.h>
+#include <avogadro/coordinaterecord.h>
+
+#include <distancecolor.h>
+#include <elementcolor.h>
+
+#include <Eigen/Core>
+
+using Avogadro::Molecule;
+using Avogadro::Atom;
+using Avogadro::Color;
+using Avogadro::CoordinateRecord;
+using Avogadro::DistanceColor;
+using Avogadro::ElementColor;
+
+using Eigen::Vector3d;
+
+// Counts how often the colors of all atoms are evaluated
+template <class T>
+class CountedColor : public T
+{
+  public:
+    CountedColor() : evaluations(0) {}
+
+    void emitChanged() { emit T::changed(); }
+
+    int evaluations;
+
+  protected:
+    void evaluateAtomColors(const Molecule *molecule, QVector<float> &colors)
+    {
+      ++evaluations;
+      T::evaluateAtomColors(molecule, colors);
+    }
+};
+
+class ColorTest : public QObject
+{
+  Q_OBJECT
+
+  private:
+    Molecule *m_molecule;
+
+    /**
+     * Compare the colors of all atoms against those set for each atom by
+     * @p reference.
+     */
+    void verifyColors(const QVector<float> &colors, Color *reference);
+
+  private slots:
+    /**
+     * Called before each test function.
+     */
+    void init();
+
+    /**
+     * Called after each test function.
+     */
+    void cleanup();
+
+    /**
+     * Tests the colors match those of setFromPrimitive().
+     */
+    void matchPrimitives();
+
+    /**
+     * Tests moving atoms only evaluates colors depending on positions.
+     */
+    void movedAtoms();
+
+    /**
+     * Tests writing conformer coordinates evaluates the distance colors.
+     */
+    void conformerWrites();
+
+    /**
+     * Tests changed() and topology changes evaluate the colors again.
+     */
+    void invalidate();
+
+    /**
+     * Tests the color components are left as they were.
+     */
+    void channels();
+};
+
+void ColorTest::verifyColors(const QVector<float> &colors, Color *reference)
+{
+  QCOMPARE(colors.size(), 4 * static_cast<int>(m_molecule->numAtoms()));
+  foreach (Atom *atom, m_molecule->atoms()) {
+    reference->setFromPrimitive(atom);
+    const float *rgba = colors.constData() + 4 * atom->index();
+    QCOMPARE(rgba[0], reference->red());
+    QCOMPARE(rgba[1], reference->green());
+    QCOMPARE(rgba[2], reference->blue());
+    QCOMPARE(rgba[3], reference->alpha());
+  }
+}
+
+void ColorTest::init()
+{
+  // Repeated elements and one without an element
+  const int elements[] = { 6, 8, 7, 6, 1, 1, 0, 8 };
+  m_molecule = new Molecule;
+  for (int i = 0; i < 8; ++i)
+    m_molecule->addAtom(elements[i], Vector3d(1.2 * i, 0.3 * i * i, 0.0));
+}
+
+void ColorTest::cleanup()
+{
+  delete m_molecule;
+  m_molecule = 0;
+}
+
+void ColorTest::matchPrimitives()
+{
+  ElementColor elementColor, elementReference;
+  verifyColors(elementColor.atomColors(m_molecule), &elementReference);
+
+  DistanceColor distanceColor, distanceReference;
+  verifyColors(distanceColor.atomColors(m_molecule), &distanceReference);
+
+  // Atoms are looked up by index, not id
+  m_molecule->removeAtom(m_molecule->atom(2));
+  verifyColors(elementColor.atomColors(m_molecule), &elementReference);
+}
+
+void ColorTest::movedAtoms()
+{
+  CountedColor<ElementColor> elementColor;
+  CountedColor<DistanceColor> distanceColor;
+  elementColor.atomColors(m_molecule);
+  distanceColor.atomColors(m_molecule);
+  elementColor.atomColors(m_molecule);
+  distanceColor.atomColors(m_molecule);
+  QCOMPARE(elementColor.evaluations, 1);
+  QCOMPARE(distanceColor.evaluations, 1);
+
+  // Moved the way interactive code does it
+  Atom *atom = m_molecule->atom(5);
+  atom->setPos(*atom->pos() + Vector3d(0.0, 0.0, 4.0));
+  atom->update();
+
+  elementColor.atomColors(m_molecule);
+  QCOMPARE(elementColor.evaluations, 1);
+  DistanceColor reference;
+  verifyColors(distanceColor.atomColors(m_molecule), &reference);
+  QCOMPARE(distanceColor.evaluations, 2);
+}
+
+void ColorTest::conformerWrites()
+{
+  CountedColor<DistanceColor> distanceColor;
+  DistanceColor reference;
+  distanceColor.atomColors(m_molecule);
+
+  // Written the way trajectory playback does it
+  std::vector<Vector3d> *pos =
+    m_molecule->conformer(m_molecule->currentConformer());
+  (*pos)[m_molecule->atom(0)->id()] = Vector3d(0.0, 6.0, 0.0);
+  m_molecule->positionsChanged();
+  m_molecule->update();
+  verifyColors(distanceColor.atomColors(m_molecule), &reference);
+  QCOMPARE(distanceColor.evaluations, 2);
+
+  // Undoing and redoing a move swaps the stored coordinates back in
+  CoordinateRecord record;
+  record.store(m_molecule);
+  m_molecule->setAtomPos(m_molecule->atom(0)->id(), Vector3d(0.0, 0.0, 0.0));
+  distanceColor.atomColors(m_molecule);
+  QCOMPARE(distanceColor.evaluations, 3);
+  record.swap(m_molecule);
+  verifyColors(distanceColor.atomColors(m_molecule), &reference);
+  QCOMPARE(distanceColor.evaluations, 4);
+  record.swap(m_molecule);
+  verifyColors(distanceColor.atomColors(m_molecule), &reference);
+  QCOMPARE(distanceColor.evaluations, 5);
+}
+
+void ColorTest::invalidate()
+{
+  CountedColor<ElementColor> elementColor;
+  elementColor.atomColors(m_molecule);
+  elementColor.emitChanged();
+  elementColor.atomColors(m_molecule);
+  QCOMPARE(elementColor.evaluations, 2);
+
+  m_molecule->atom(0)->setAtomicNumber(16);
+  ElementColor reference;
+  verifyColors(elementColor.atomColors(m_molecule), &reference);
+  QCOMPARE(elementColor.evaluations, 3);
+
+  m_molecule->addAtom(9, Vector3d(0.0, 0.0, 1.0));
+  verifyColors(elementColor.atomColors(m_molecule), &reference);
+  QCOMPARE(elementColor.evaluations, 4);
+}
+
+void ColorTest::channels()
+{
+  CountedColor<ElementColor> elementColor;
+  elementColor.setFromRgba(0.1f, 0.2f, 0.3f, 0.4f);
+  elementColor.atomColors(m_molecule);
+  QCOMPARE(elementColor.evaluations, 1);
+  QCOMPARE(elementColor.red(), 0.1f);
+  QCOMPARE(elementColor.green(), 0.2f);
+  QCOMPARE(elementColor.blue(), 0.3f);
+  QCOMPARE(elementColor.alpha(), 0.4f);
+
+  // The default evaluation goes through setFromPrimitive() too
+  CountedColor<DistanceColor> distanceColor;
+  distanceColor.setFromRgba(0.5f, 0.6f, 0.7f, 0.8f);
+  distanceColor.atomColors(m_molecule);
+  QCOMPARE(distanceColor.evaluations, 1);
+  QCOMPARE(distanceColor.red(), 0.5f);
+  QCOMPARE(distanceColor.green(), 0.6f);
+  QCOMPARE(distanceColor.blue(), 0.7f);
+  QCOMPARE(distanceColor.alpha(), 0.8f);
+}
+
+QTEST_MAIN(ColorTest)
+
+#include "moc_colortest.cxx"
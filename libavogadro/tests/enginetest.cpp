@@ -0,0 +1,158 @@
+/**********************************************************************
+  EngineTest - unit tests for the primitives an engine renders
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include <QtTest>
+#include <avogadro/molecule.h>
+#include <avogadro/atom.h>
+#include <avogadro/bond.h>
+#include <avogadro/engine.h>
+
+#include <Eigen/Core>
+
+using Avogadro::Molecule;
+using Avogadro::Atom;
+using Avogadro::Bond;
+using Avogadro::Engine;
+using Avogadro::PainterDevice;
+
+using Eigen::Vector3d;
+
+// The smallest engine, only the primitives it is given are of interest
+class CustomEngine : public Engine
+{
+  public:
+    QString identifier() const { return "Custom"; }
+    QString name() const { return "Custom"; }
+    bool renderOpaque(PainterDevice *) { return true; }
+    Engine *clone() const { return new CustomEngine; }
+};
+
+class EngineTest : public QObject
+{
+  Q_OBJECT
+
+  private:
+    Molecule *m_molecule;
+    CustomEngine *m_engine;
+
+    /**
+     * Check the engine's primitives are exactly those of the molecule.
+     */
+    void verifyPrimitives();
+
+  private slots:
+    /**
+     * Called before each test function.
+     */
+    void init();
+
+    /**
+     * Called after each test function.
+     */
+    void cleanup();
+
+    /**
+     * Tests the primitives follow changes made one at a time.
+     */
+    void singleChanges();
+
+    /**
+     * Tests the primitives follow the changes recorded in a change set.
+     */
+    void changeSet();
+};
+
+void EngineTest::verifyPrimitives()
+{
+  QList<Atom *> atoms = m_engine->allAtoms();
+  QCOMPARE(atoms.size(), m_molecule->atoms().size());
+  foreach (Atom *atom, m_molecule->atoms())
+    QVERIFY(atoms.contains(atom));
+
+  QList<Bond *> bonds = m_engine->allBonds();
+  QCOMPARE(bonds.size(), m_molecule->bonds().size());
+  foreach (Bond *bond, m_molecule->bonds())
+    QVERIFY(bonds.contains(bond));
+}
+
+void EngineTest::init()
+{
+  m_molecule = new Molecule;
+  for (int i = 0; i < 6; ++i)
+    m_molecule->addAtom(6, Vector3d(1.5 * i, 0.0, 0.0));
+  for (unsigned long i = 0; i < 5; ++i)
+    m_molecule->addBond(i, i+1, 1);
+
+  m_engine = new CustomEngine;
+  m_engine->setMolecule(m_molecule);
+  m_engine->useCustomPrimitives();
+}
+
+void EngineTest::cleanup()
+{
+  delete m_engine;
+  m_engine = 0;
+  delete m_molecule;
+  m_molecule = 0;
+}
+
+void EngineTest::singleChanges()
+{
+  m_molecule->removeAtom(m_molecule->atom(2));
+  Atom *atom = m_molecule->addAtom(8, Vector3d(0.0, 1.5, 0.0));
+  m_molecule->addBond(m_molecule->atom(0), atom, 1);
+  verifyPrimitives();
+}
+
+void EngineTest::changeSet()
+{
+  QSignalSpy spy(m_engine, SIGNAL(changed()));
+  Bond *bond = m_molecule->bond(4);
+
+  m_molecule->beginChangeSet();
+  m_molecule->removeAtom(m_molecule->atom(2));
+  m_molecule->removeBond(bond);
+  Atom *atom = m_molecule->addAtom(8, Vector3d(0.0, 1.5, 0.0));
+  m_molecule->addBond(m_molecule->atom(0), atom, 1);
+  // Added and removed again, never seen by the engine
+  m_molecule->removeAtom(m_molecule->addAtom(1, Vector3d(0.0, 3.0, 0.0)));
+
+  // Nothing is signalled before the change set is committed
+  QCOMPARE(spy.count(), 0);
+  QCOMPARE(m_engine->allAtoms().size(), 6);
+  m_molecule->commitChangeSet();
+
+  QCOMPARE(spy.count(), 1);
+  verifyPrimitives();
+
+  // Updates do not change the primitives
+  m_molecule->beginChangeSet();
+  m_molecule->setAtomPos(atom->id(), Vector3d(0.0, 2.0, 0.0));
+  m_molecule->commitChangeSet();
+  verifyPrimitives();
+}
+
+QTEST_MAIN(EngineTest)
+
+#include "moc_enginetest.cxx"
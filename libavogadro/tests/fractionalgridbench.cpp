@@ -0,0 +1,138 @@
+/**********************************************************************
+  FractionalGridBench - benchmarking for the crystallography extension's
+                        fractional coordinate duplicate detection
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include <QtTest>
+
+#include <libavogadro/src/extensions/crystallography/fractionalgrid.h>
+
+#include <Eigen/Core>
+
+using Avogadro::FractionalGrid;
+
+using Eigen::Vector3d;
+
+class FractionalGridBench : public QObject
+{
+  Q_OBJECT
+
+private:
+  /// Synthetic 50,000 atom cell, every site is present twice
+  QList<Vector3d> m_fcoords;
+  int m_numSites;
+
+private slots:
+  /**
+   * Called before the first test function is executed.
+   */
+  void initTestCase();
+
+  /**
+   * Remove the duplicates from the synthetic cell using the grid hash, as
+   * done by CrystallographyExtension::fillUnitCell().
+   */
+  void fillUnitCell();
+
+  /**
+   * Mark duplicates in the synthetic cell against a prebuilt grid hash, as
+   * done by CrystallographyExtension::reduceToAsymmetricUnit().
+   */
+  void reduceToAsymmetricUnit();
+
+  /**
+   * Duplicates across the cell boundary must be detected.
+   */
+  void periodicDuplicates();
+};
+
+void FractionalGridBench::initTestCase()
+{
+  // 25,000 sites on a jittered 30x30x30 lattice, each followed by an image
+  // that only differs by floating point noise.
+  qsrand(42);
+  m_numSites = 25000;
+  const int n = 30;
+  for (int i = 0; i < m_numSites; ++i) {
+    Vector3d site((i % n + 0.25 * qrand() / RAND_MAX) / n,
+                  ((i / n) % n + 0.25 * qrand() / RAND_MAX) / n,
+                  (i / (n * n) + 0.25 * qrand() / RAND_MAX) / n);
+    m_fcoords.append(site);
+    m_fcoords.append(site + Vector3d(1e-7, -1e-7, 1e-7));
+  }
+}
+
+void FractionalGridBench::fillUnitCell()
+{
+  int numAccepted = 0;
+  QBENCHMARK_ONCE {
+    FractionalGrid grid(1e-5, m_fcoords.size());
+    numAccepted = 0;
+    foreach (const Vector3d &fcoord, m_fcoords) {
+      if (grid.contains(fcoord))
+        continue;
+      grid.insert(fcoord, numAccepted++);
+    }
+  }
+  QCOMPARE(numAccepted, m_numSites);
+}
+
+void FractionalGridBench::reduceToAsymmetricUnit()
+{
+  FractionalGrid grid(1e-5, m_fcoords.size());
+  for (int i = 0; i < m_fcoords.size(); ++i)
+    grid.insert(m_fcoords[i], i);
+
+  int numRemoved = 0;
+  QBENCHMARK_ONCE {
+    QVector<bool> removed(m_fcoords.size(), false);
+    numRemoved = 0;
+    for (int i = 0; i < m_fcoords.size(); ++i) {
+      if (removed[i])
+        continue;
+      foreach (int j, grid.duplicates(m_fcoords[i])) {
+        if (j > i && !removed[j]) {
+          removed[j] = true;
+          ++numRemoved;
+        }
+      }
+    }
+  }
+  QCOMPARE(numRemoved, m_numSites);
+}
+
+void FractionalGridBench::periodicDuplicates()
+{
+  FractionalGrid grid(1e-5, 10);
+  grid.insert(Vector3d(0.0, 0.5, 0.5), 0);
+  QVERIFY(grid.contains(Vector3d(1.0 - 1e-7, 0.5, 0.5)));
+  QVERIFY(!grid.contains(Vector3d(0.5, 0.5, 0.5)));
+
+  Vector3d fcoord(-0.25, 1.5, 1.0 - 1e-8);
+  FractionalGrid::wrap(fcoord);
+  QVERIFY(fcoord.isApprox(Vector3d(0.75, 0.5, 0.0)));
+}
+
+QTEST_MAIN(FractionalGridBench)
+
+#include "moc_fractionalgridbench.cxx"
@@ -0,0 +1,99 @@
+/**********************************************************************
+  GaussianSetTest - unit tests for Gaussian basis set cube calculations
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include <QtTest>
+
+#include <openqube/basisset.h>
+#include <openqube/basissetloader.h>
+#include <openqube/cube.h>
+
+#include <cmath>
+#include <vector>
+
+using OpenQube::BasisSet;
+using OpenQube::BasisSetLoader;
+using OpenQube::Cube;
+
+class GaussianSetTest : public QObject
+{
+  Q_OBJECT
+
+  private:
+    /**
+     * Run a blocking calculation into a new cube and let the basis set
+     * release the cube afterwards.
+     */
+    std::vector<double> calculate(BasisSet *basis, int mo);
+
+  private slots:
+    /**
+     * Tests the density from the density matrix of a closed shell SCF
+     * calculation matches twice the sum of the squared occupied MOs.
+     */
+    void densityMatchesMOs();
+};
+
+std::vector<double> GaussianSetTest::calculate(BasisSet *basis, int mo)
+{
+  Cube cube;
+  cube.setLimits(basis->moleculeRef(), 0.3, 2.0);
+  if (mo > 0)
+    basis->blockingCalculateCubeMO(&cube, mo);
+  else
+    basis->blockingCalculateCubeDensity(&cube);
+  // Unlocks the cube
+  QCoreApplication::processEvents();
+  return *cube.data();
+}
+
+void GaussianSetTest::densityMatchesMOs()
+{
+  BasisSet *basis = BasisSetLoader::LoadBasisSet(TESTDATADIR "co.fchk");
+  QVERIFY(basis);
+  QCOMPARE(basis->numElectrons(), 14U);
+
+  // The density is contracted from blocks of the density matrix, the MOs
+  // are not, so this compares against the full matrix.
+  std::vector<double> density = calculate(basis, 0);
+  std::vector<double> reference(density.size(), 0.0);
+  for (unsigned int mo = 1; mo <= basis->numElectrons() / 2; ++mo) {
+    std::vector<double> values = calculate(basis, mo);
+    QCOMPARE(values.size(), density.size());
+    for (unsigned int i = 0; i < values.size(); ++i)
+      reference[i] += 2.0 * values[i] * values[i];
+  }
+
+  for (unsigned int i = 0; i < density.size(); ++i) {
+    double tolerance = 1.0e-6 * (1.0 + fabs(reference[i]));
+    if (fabs(density[i] - reference[i]) > tolerance)
+      QFAIL(qPrintable(QString("Density %1 at point %2, expected %3")
+                       .arg(density[i]).arg(i).arg(reference[i])));
+  }
+
+  delete basis;
+}
+
+QTEST_MAIN(GaussianSetTest)
+
+#include "moc_gaussiansettest.cxx"
@@ -27,8 +27,10 @@
 
 #include <avogadro/atom.h>
 #include <avogadro/bond.h>
+#include <avogadro/bondperceiver.h>
 #include <avogadro/molecule.h>
 #include <avogadro/primitivelist.h>
+#include <avogadro/ringperceiver.h>
 
 #include <Eigen/Core>
 
@@ -37,6 +39,8 @@
 using Avogadro::Molecule;
 using Avogadro::Atom;
 using Avogadro::Bond;
+using Avogadro::BondPerceiver;
+using Avogadro::RingPerceiver;
 
 using Eigen::Vector3d;
 
@@ -168,6 +172,16 @@ private slots:
    */
   void deleteLater();
 
+  /**
+   * Ring systems of a ladder of 25,000 atoms, read from the adjacency arrays
+   */
+  void ringSystems();
+
+  /**
+   * Bonds of a ladder of 25,000 atoms set again, only one of them changed
+   */
+  void setBonds();
+
 };
 
 void MoleculeBench::initTestCase()
@@ -430,6 +444,38 @@ void MoleculeBench::deleteLater()
   }
 }
 
+void MoleculeBench::ringSystems()
+{
+  // Two chains joined at every atom, a single ring system
+  for (int i = 0; i < 25000; ++i)
+    m_molecule->addAtom(6, Vector3d(1.5 * (i / 2), 1.5 * (i % 2), 0.0));
+  for (unsigned long i = 0; i + 2 < 25000; ++i)
+    m_molecule->addBond(i, i + 2, 1);
+  for (unsigned long i = 0; i < 25000; i += 2)
+    m_molecule->addBond(i, i + 1, 1);
+
+  QBENCHMARK_ONCE {
+    QCOMPARE(RingPerceiver::ringSystems(m_molecule).size(), 1);
+  }
+}
+
+void MoleculeBench::setBonds()
+{
+  for (int i = 0; i < 25000; ++i)
+    m_molecule->addAtom(6, Vector3d(1.5 * (i / 2), 1.5 * (i % 2), 0.0));
+  std::vector<BondPerceiver::AtomPair> bonds =
+    BondPerceiver::perceive(BondPerceiver::covalentRadii(m_molecule),
+      *m_molecule->conformer(m_molecule->currentConformer()));
+  BondPerceiver::setBonds(m_molecule, bonds);
+  unsigned int numBonds = m_molecule->numBonds();
+  bonds.pop_back();
+
+  QBENCHMARK_ONCE {
+    BondPerceiver::setBonds(m_molecule, bonds);
+  }
+  QCOMPARE(m_molecule->numBonds(), numBonds - 1);
+}
+
 QTEST_MAIN(MoleculeBench)
 
 #include "moc_moleculebench.cxx"
@@ -75,6 +75,7 @@ class MoleculeFileTest : public QObject
     void readWriteConformers();
     void replaceMolecule();
     void appendMolecule();
+    void readTrajectory();
 
 };
 
@@ -298,6 +299,62 @@ void MoleculeFileTest::appendMolecule()
   QCOMPARE( moleculeFile->numMolecules(), static_cast<unsigned int>(3) );
 }
 
+void MoleculeFileTest::readTrajectory()
+{
+  // 100 frames of a two atom xyz trajectory, separated by blank lines
+  QString filename = "moleculefiletest_tmp.xyz";
+  std::ofstream ofs(filename.toAscii().data());
+  for (int i = 0; i < 100; ++i) {
+    ofs << "2\nframe " << i << "\n";
+    ofs << "C  " << 0.5 * i << "  0.0  -1.25e-1\n";
+    ofs << "O  0.0  " << -0.5 * i << "  1.125\n\n";
+  }
+  ofs.close();
+
+  MoleculeFile *moleculeFile = MoleculeFile::readTrajectory(filename, QString(), true);
+  QVERIFY( moleculeFile );
+  QVERIFY( moleculeFile->errors().isEmpty() );
+  QVERIFY( moleculeFile->isTrajectory() );
+  QCOMPARE( moleculeFile->numFrames(), static_cast<unsigned int>(100) );
+  QCOMPARE( moleculeFile->conformers().size(),
+      static_cast<std::vector<int>::size_type>(0) );
+
+  // decode frames out of order, more than fit in the cache
+  moleculeFile->setFrameCacheSize(4);
+  std::vector<Vector3d> coords;
+  for (int i = 99; i >= 0; i -= 3) {
+    QVERIFY( moleculeFile->frame(i, coords) );
+    QCOMPARE( coords.size(), static_cast<std::vector<int>::size_type>(2) );
+    QVERIFY( coords[0].isApprox(Vector3d(0.5 * i, 0.0, -0.125)) );
+    QVERIFY( coords[1].isApprox(Vector3d(0.0, -0.5 * i, 1.125)) );
+  }
+  QVERIFY( !moleculeFile->frame(100, coords) );
+  delete moleculeFile;
+
+  // multi-model pdb, the last model has a different number of atoms
+  filename = "moleculefiletest_tmp.pdb";
+  ofs.open(filename.toAscii().data());
+  for (int i = 0; i < 3; ++i) {
+    ofs << "MODEL        " << i + 1 << "\n";
+    ofs << "ATOM      1  N   ALA A   1      11.104   6.134  -6.504  1.00  0.00           N\n";
+    ofs << "HETATM    2  O   HOH     2       " << i << ".000   0.000   0.000  1.00  0.00           O\n";
+    if (i == 2)
+      ofs << "HETATM    3  O   HOH     3       0.000   0.000   0.000  1.00  0.00           O\n";
+    ofs << "ENDMDL\n";
+  }
+  ofs << "END\n";
+  ofs.close();
+
+  moleculeFile = MoleculeFile::readTrajectory(filename, QString(), true);
+  QVERIFY( moleculeFile );
+  QVERIFY( !moleculeFile->errors().isEmpty() );
+  QCOMPARE( moleculeFile->numFrames(), static_cast<unsigned int>(2) );
+  QVERIFY( moleculeFile->frame(1, coords) );
+  QVERIFY( coords[0].isApprox(Vector3d(11.104, 6.134, -6.504)) );
+  QVERIFY( coords[1].isApprox(Vector3d(1.0, 0.0, 0.0)) );
+  delete moleculeFile;
+}
+
 QTEST_MAIN(MoleculeFileTest)
 
 #include "moc_moleculefiletest.cxx"
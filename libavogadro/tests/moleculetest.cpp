@@ -26,15 +26,44 @@
 #include <avogadro/molecule.h>
 #include <avogadro/atom.h>
 #include <avogadro/bond.h>
+#include <avogadro/changeset.h>
+#include <avogadro/smartsmatcher.h>
 
 #include <Eigen/Core>
 
+#include <openbabel/mol.h>
+
 using Avogadro::Molecule;
 using Avogadro::Atom;
 using Avogadro::Bond;
+using Avogadro::ChangeSet;
+using Avogadro::Primitive;
 
 using Eigen::Vector3d;
 
+// Reads the data of the atoms removed in a change set as listeners do
+class RemovedAtomReader : public QObject
+{
+  Q_OBJECT
+
+public:
+  QHash<unsigned long, Atom *> atoms;
+  QList<int> atomicNumbers;
+  QList<int> formalCharges;
+
+public slots:
+  void moleculeChanged(const Avogadro::ChangeSet &changes)
+  {
+    foreach (unsigned long id, changes.ids(Primitive::AtomType,
+                                           ChangeSet::Removed)) {
+      if (!atoms.contains(id))
+        continue;
+      atomicNumbers.append(atoms.value(id)->atomicNumber());
+      formalCharges.append(atoms.value(id)->formalCharge());
+    }
+  }
+};
+
 class MoleculeTest : public QObject
 {
   Q_OBJECT
@@ -142,6 +171,39 @@ private slots:
    * Tests conformer support.
    */ 
   void conformers();
+
+  /**
+   * Tests the cached OBMol follows changes to the molecule.
+   */
+  void obmolCache();
+
+  /**
+   * Tests SMARTS matches are cached until the topology changes.
+   */
+  void smartsMatches();
+
+  /**
+   * Tests the per atom arrays and adjacency kept by the molecule.
+   */
+  void atomArrays();
+
+  /**
+   * Tests removing many atoms and bonds at once keeps ids and indices
+   * consistent.
+   */
+  void removeAtoms();
+  void removeBonds();
+
+  /**
+   * Tests edits inside a change set are reported in one signal.
+   */
+  void changeSet();
+
+  /**
+   * Tests the data of atoms removed in a change set can be read until it
+   * was committed.
+   */
+  void changeSetRemovedData();
 };
 
 void MoleculeTest::prepareMolecule()
@@ -386,6 +448,261 @@ void MoleculeTest::conformers()
 
 }
 
+void MoleculeTest::obmolCache()
+{
+  Molecule molecule;
+  Atom *a1 = molecule.addAtom(6, Vector3d(0.0, 0.0, 0.0));
+  Atom *a2 = molecule.addAtom(6, Vector3d(1.5, 0.0, 0.0));
+  Atom *a3 = molecule.addAtom(8, Vector3d(1.5, 1.5, 0.0));
+  molecule.addBond(a1, a2, 1);
+  Bond *b2 = molecule.addBond(a2, a3, 1);
+
+  OpenBabel::OBMol obmol = molecule.OBMol();
+  QCOMPARE(obmol.NumAtoms(), 3U);
+  QCOMPARE(obmol.NumBonds(), 2U);
+
+  // Positions are patched in place
+  a3->setPos(Vector3d(2.0, 2.0, 0.0));
+  obmol = molecule.OBMol();
+  QCOMPARE(obmol.GetAtom(3)->GetX(), 2.0);
+
+  // So are elements, charges and bond orders
+  a3->setAtomicNumber(7);
+  a3->setFormalCharge(1);
+  b2->setOrder(2);
+  obmol = molecule.OBMol();
+  QCOMPARE(obmol.GetAtom(3)->GetAtomicNum(), 7U);
+  QCOMPARE(obmol.GetAtom(3)->GetFormalCharge(), 1);
+  QCOMPARE(obmol.GetBond(1)->GetBondOrder(), 2U);
+
+  // Removing atoms rebuilds it
+  molecule.removeAtom(a1);
+  obmol = molecule.OBMol();
+  QCOMPARE(obmol.NumAtoms(), 2U);
+  QCOMPARE(obmol.NumBonds(), 1U);
+  QCOMPARE(obmol.GetAtom(1)->GetX(), 1.5);
+}
+
+void MoleculeTest::smartsMatches()
+{
+  Molecule molecule;
+  Atom *a1 = molecule.addAtom(6, Vector3d(0.0, 0.0, 0.0));
+  Atom *a2 = molecule.addAtom(8, Vector3d(1.2, 0.0, 0.0));
+  molecule.addBond(a1, a2, 2);
+
+  QBitArray matches = SmartsMatcher::match(&molecule, "C=O");
+  QCOMPARE(matches.size(), 2);
+  QVERIFY(matches.testBit(0) && matches.testBit(1));
+  QVERIFY(SmartsMatcher::cachedMatch(&molecule, "C=O", 0));
+
+  // Moving atoms keeps the topology and the cached match, as do the update
+  // signals sent for each step of a drag or animation
+  unsigned int version = molecule.topologyVersion();
+  a2->setPos(Vector3d(1.3, 0.0, 0.0));
+  a2->update();
+  molecule.update();
+  molecule.updateMolecule();
+  QCOMPARE(molecule.topologyVersion(), version);
+  QVERIFY(SmartsMatcher::cachedMatch(&molecule, "C=O", 0));
+
+  // So does setting the same element again
+  a2->setAtomicNumber(8);
+  QCOMPARE(molecule.topologyVersion(), version);
+
+  // Changing an element does not
+  a2->setAtomicNumber(7);
+  QVERIFY(molecule.topologyVersion() != version);
+  QVERIFY(!SmartsMatcher::cachedMatch(&molecule, "C=O", 0));
+  QCOMPARE(SmartsMatcher::match(&molecule, "C=O").count(true), 0);
+
+  // Background matches end up in the cache too
+  QFuture<QBitArray> future = SmartsMatcher::matchInBackground(&molecule,
+                                                               "C=N");
+  future.waitForFinished();
+  QCOMPARE(future.result().count(true), 2);
+  QVERIFY(SmartsMatcher::cachedMatch(&molecule, "C=N", 0));
+
+  QVERIFY(!SmartsMatcher::isValid("C(("));
+}
+
+void MoleculeTest::atomArrays()
+{
+  Molecule molecule;
+  Atom *a1 = molecule.addAtom(6, Vector3d(0.0, 0.0, 0.0));
+  Atom *a2 = molecule.addAtom(8, Vector3d(1.5, 0.0, 0.0));
+  Atom *a3 = molecule.addAtom(1, Vector3d(0.0, 1.5, 0.0));
+  molecule.addBond(a1, a2, 1);
+  molecule.addBond(a1, a3, 1);
+
+  QCOMPARE(molecule.atomicNumbers().size(), size_t(3));
+  QCOMPARE(molecule.atomicNumbers()[a2->id()], 8);
+  a2->setAtomicNumber(7);
+  QCOMPARE(molecule.atomicNumbers()[a2->id()], 7);
+  QCOMPARE(a2->atomicNumber(), 7);
+  QVERIFY(a3->isHydrogen());
+
+  a3->setFormalCharge(-1);
+  QCOMPARE(a3->formalCharge(), -1);
+
+  // a1 has two neighbors, a2 and a3 one each
+  const std::vector<unsigned int> &offsets = molecule.adjacencyOffsets();
+  QCOMPARE(offsets.size(), size_t(4));
+  QCOMPARE(offsets[a1->id() + 1] - offsets[a1->id()], 2U);
+  QCOMPARE(offsets[a2->id() + 1] - offsets[a2->id()], 1U);
+  QCOMPARE(molecule.adjacentAtoms()[offsets[a2->id()]], a1->id());
+
+  // Removing an atom updates the adjacency and clears its data
+  unsigned long id = a3->id();
+  molecule.removeAtom(a3);
+  QCOMPARE(molecule.atomicNumbers()[id], 0);
+  QCOMPARE(molecule.adjacencyOffsets()[a1->id() + 1]
+           - molecule.adjacencyOffsets()[a1->id()], 1U);
+
+  // Copies get the same data
+  Molecule copy;
+  copy = molecule;
+  QCOMPARE(copy.atomById(a2->id())->atomicNumber(), 7);
+  QCOMPARE(copy.adjacentAtoms().size(), size_t(2));
+}
+
+void MoleculeTest::removeAtoms()
+{
+  // A chain of 100 atoms, remove every third one
+  Molecule molecule;
+  for (int i = 0; i < 100; ++i)
+    molecule.addAtom(6, Vector3d(1.5 * i, 0.0, 0.0));
+  for (unsigned long i = 0; i < 99; ++i)
+    molecule.addBond(i, i + 1, 1);
+
+  QList<Atom *> atoms;
+  for (unsigned long i = 0; i < 100; i += 3)
+    atoms.append(molecule.atomById(i));
+  // Repeated atoms are only removed once
+  atoms.append(molecule.atomById(0));
+  molecule.removeAtoms(atoms);
+
+  QCOMPARE(molecule.numAtoms(), 66U);
+  // Every bond touched a removed atom except 1-2, 4-5, ...
+  QCOMPARE(molecule.numBonds(), 33U);
+  for (unsigned int i = 0; i < molecule.numAtoms(); ++i) {
+    Atom *atom = molecule.atom(i);
+    QCOMPARE(atom->index(), static_cast<unsigned long>(i));
+    QVERIFY(atom->id() % 3 != 0);
+    QCOMPARE(molecule.atomById(atom->id()), atom);
+    QCOMPARE(atom->bonds().size(), 1);
+  }
+  for (unsigned long i = 0; i < 100; i += 3)
+    QVERIFY(!molecule.atomById(i));
+  for (unsigned int i = 0; i < molecule.numBonds(); ++i) {
+    Bond *bond = molecule.bond(i);
+    QCOMPARE(bond->index(), static_cast<unsigned long>(i));
+    QCOMPARE(molecule.bondById(bond->id()), bond);
+    QVERIFY(molecule.atomById(bond->beginAtomId()));
+    QVERIFY(molecule.atomById(bond->endAtomId()));
+  }
+}
+
+void MoleculeTest::removeBonds()
+{
+  Molecule molecule;
+  for (int i = 0; i < 10; ++i)
+    molecule.addAtom(6, Vector3d(1.5 * i, 0.0, 0.0));
+  for (unsigned long i = 0; i < 9; ++i)
+    molecule.addBond(i, i + 1, 1);
+
+  QList<Bond *> bonds;
+  bonds << molecule.bondById(8) << molecule.bondById(0)
+        << molecule.bondById(4);
+  molecule.removeBonds(bonds);
+
+  QCOMPARE(molecule.numBonds(), 6U);
+  for (unsigned int i = 0; i < molecule.numBonds(); ++i) {
+    Bond *bond = molecule.bond(i);
+    QCOMPARE(bond->index(), static_cast<unsigned long>(i));
+    QCOMPARE(molecule.bondById(bond->id()), bond);
+  }
+  QVERIFY(!molecule.bond(molecule.atomById(0), molecule.atomById(1)));
+  QVERIFY(molecule.atomById(0)->bonds().isEmpty());
+  QCOMPARE(molecule.atomById(4)->bonds().size(), 1);
+}
+
+void MoleculeTest::changeSet()
+{
+  Molecule molecule;
+  for (int i = 0; i < 4; ++i)
+    molecule.addAtom(6, Vector3d(1.5 * i, 0.0, 0.0));
+
+  QSignalSpy changed(&molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)));
+  QSignalSpy added(&molecule, SIGNAL(atomAdded(Atom*)));
+  QSignalSpy removed(&molecule, SIGNAL(atomRemoved(Atom*)));
+
+  molecule.beginChangeSet();
+  molecule.beginChangeSet();
+  Atom *atom = molecule.addAtom(8, Vector3d(0.0, 1.0, 0.0));
+  Atom *shortLived = molecule.addAtom(1, Vector3d(0.0, 2.0, 0.0));
+  molecule.addBond(0, atom->id(), 1);
+  molecule.atomById(1)->setAtomicNumber(7);
+  molecule.removeAtom(shortLived);
+  molecule.removeAtom(3);
+  molecule.commitChangeSet();
+  QCOMPARE(changed.count(), 0);
+  molecule.commitChangeSet();
+
+  QCOMPARE(changed.count(), 1);
+  QCOMPARE(added.count(), 0);
+  QCOMPARE(removed.count(), 0);
+  ChangeSet changes = qvariant_cast<ChangeSet>(changed.at(0).at(0));
+  QCOMPARE(changes.ids(Primitive::AtomType, ChangeSet::Added),
+           QList<unsigned long>() << atom->id());
+  QCOMPARE(changes.ids(Primitive::AtomType, ChangeSet::Updated),
+           QList<unsigned long>() << 1);
+  QCOMPARE(changes.ids(Primitive::AtomType, ChangeSet::Removed),
+           QList<unsigned long>() << 3);
+  QVERIFY(changes.contains(Primitive::BondType, ChangeSet::Added));
+
+  // Outside of a change set the old signals are emitted
+  molecule.addAtom(6, Vector3d(0.0, 3.0, 0.0));
+  QCOMPARE(added.count(), 1);
+  QCOMPARE(changed.count(), 1);
+}
+
+void MoleculeTest::changeSetRemovedData()
+{
+  Molecule molecule;
+  for (int i = 0; i < 4; ++i)
+    molecule.addAtom(6 + i, Vector3d(1.5 * i, 0.0, 0.0));
+  molecule.atomById(1)->setFormalCharge(1);
+
+  RemovedAtomReader reader;
+  reader.atoms.insert(1, molecule.atomById(1));
+  connect(&molecule, SIGNAL(moleculeChanged(Avogadro::ChangeSet)),
+          &reader, SLOT(moleculeChanged(Avogadro::ChangeSet)));
+
+  molecule.beginChangeSet();
+  molecule.removeAtom(1);
+  molecule.removeAtom(2);
+  // A reused id belongs to the new atom
+  Atom *atom = molecule.addAtom(2);
+  atom->setAtomicNumber(16);
+  molecule.commitChangeSet();
+
+  QCOMPARE(reader.atomicNumbers, QList<int>() << 7);
+  QCOMPARE(reader.formalCharges, QList<int>() << 1);
+  QCOMPARE(molecule.atomById(2)->atomicNumber(), 16);
+
+  // Removed atoms keep their data until the change set is committed, even
+  // when the molecule is cleared
+  reader.atomicNumbers.clear();
+  reader.atoms.clear();
+  foreach (Atom *a, molecule.atoms())
+    reader.atoms.insert(a->id(), a);
+  molecule.beginChangeSet();
+  molecule.clear();
+  molecule.commitChangeSet();
+  qSort(reader.atomicNumbers);
+  QCOMPARE(reader.atomicNumbers, QList<int>() << 6 << 9 << 16);
+}
+
 QTEST_MAIN(MoleculeTest)
 
 #include "moc_moleculetest.cxx"
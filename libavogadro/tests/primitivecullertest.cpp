@@ -0,0 +1,125 @@
+/**********************************************************************
+  PrimitiveCullerTest - unit tests for skipping primitives out of view
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include <QtTest>
+#include <avogadro/molecule.h>
+#include <avogadro/atom.h>
+#include <avogadro/bond.h>
+#include <avogadro/primitiveculler.h>
+
+#include <Eigen/Core>
+
+using Avogadro::Molecule;
+using Avogadro::Atom;
+using Avogadro::Bond;
+using Avogadro::PrimitiveCuller;
+
+using Eigen::Vector3d;
+using Eigen::Vector4d;
+
+class PrimitiveCullerTest : public QObject
+{
+  Q_OBJECT
+
+  private slots:
+    void initTestCase();
+    void chain();
+    void invalidate();
+
+  private:
+    // The cube from -10 to 10 on each axis
+    Vector4d m_planes[6];
+};
+
+void PrimitiveCullerTest::initTestCase()
+{
+  for (int i = 0; i < 3; ++i) {
+    m_planes[2 * i] = Vector4d::Zero();
+    m_planes[2 * i][i] = 1.0;
+    m_planes[2 * i][3] = 10.0;
+    m_planes[2 * i + 1] = Vector4d::Zero();
+    m_planes[2 * i + 1][i] = -1.0;
+    m_planes[2 * i + 1][3] = 10.0;
+  }
+}
+
+void PrimitiveCullerTest::chain()
+{
+  // Atoms 1 A apart along x, only those within the atom radius of the
+  // cube are kept
+  Molecule molecule;
+  for (int i = -100; i <= 100; ++i) {
+    molecule.addAtom(6, Vector3d(i, 0.0, 0.0));
+    if (i > -100)
+      molecule.addBond(i + 99, i + 100);
+  }
+
+  PrimitiveCuller culler;
+  culler.update(&molecule, m_planes);
+  foreach (Atom *atom, molecule.atoms())
+    QCOMPARE(culler.isVisible(atom), qAbs(atom->pos()->x()) <= 13.0);
+  QCOMPARE(culler.visibleAtoms().size(), 27);
+  QCOMPARE(culler.culledAtoms(), 201 - 27);
+
+  // Bonds are kept when half their length and one Angstrom reach the cube
+  foreach (Bond *bond, molecule.bonds()) {
+    double x = (molecule.atomById(bond->beginAtomId())->pos()->x()
+                + molecule.atomById(bond->endAtomId())->pos()->x()) / 2.0;
+    QCOMPARE(culler.isVisible(bond), qAbs(x) <= 11.5);
+  }
+  QCOMPARE(culler.visibleBonds().size() + culler.culledBonds(), 200);
+
+  // Custom lists are filtered the same way
+  QList<Atom *> atoms;
+  atoms << molecule.atomById(0) << molecule.atomById(100);
+  QCOMPARE(culler.visibleAtoms(atoms).size(), 1);
+  QCOMPARE(culler.visibleAtoms(atoms).first(), molecule.atomById(100));
+}
+
+void PrimitiveCullerTest::invalidate()
+{
+  Molecule molecule;
+  Atom *atom = molecule.addAtom(6, Vector3d(50.0, 0.0, 0.0));
+  PrimitiveCuller culler;
+  culler.update(&molecule, m_planes);
+  QVERIFY(!culler.isVisible(atom));
+
+  // Atoms added since the last update are drawn
+  Atom *added = molecule.addAtom(6, Vector3d(60.0, 0.0, 0.0));
+  QVERIFY(culler.isVisible(added));
+
+  // Moved atoms are found once the clusters are rebuilt
+  atom->setPos(Vector3d(0.0, 0.0, 0.0));
+  culler.update(&molecule, m_planes);
+  QVERIFY(!culler.isVisible(atom));
+  culler.invalidate();
+  culler.update(&molecule, m_planes);
+  QVERIFY(culler.isVisible(atom));
+  QVERIFY(!culler.isVisible(added));
+  QCOMPARE(culler.culledAtoms(), 1);
+}
+
+QTEST_MAIN(PrimitiveCullerTest)
+
+#include "moc_primitivecullertest.cxx"
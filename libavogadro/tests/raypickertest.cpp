@@ -0,0 +1,173 @@
+/**********************************************************************
+  RayPickerTest - unit testing for the RayPicker class
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include <QtTest>
+#include <avogadro/raypicker.h>
+
+#include <Eigen/Core>
+
+using Avogadro::RayPicker;
+using Avogadro::Primitive;
+using Avogadro::GLHit;
+
+using Eigen::Vector3d;
+
+class RayPickerTest : public QObject
+{
+  Q_OBJECT
+
+  private:
+    RayPicker *m_picker;
+
+    // A row of atoms along the x axis joined by bonds, shifted by z
+    void record(double z);
+
+  private slots:
+    /**
+     * Called before the first test function is executed.
+     */
+    void initTestCase();
+
+    /**
+     * Called after the last test function is executed.
+     */
+    void cleanupTestCase();
+
+    void rayHits();
+    void frustumHits();
+    void refit();
+};
+
+void RayPickerTest::record(double z)
+{
+  m_picker->begin();
+  for (int i = 0; i < 10; ++i) {
+    m_picker->addSphere(Primitive::AtomType, i,
+                        Vector3d(2.0 * i, 0.0, z), 0.5);
+    if (i)
+      m_picker->addCapsule(Primitive::BondType, i - 1,
+                           Vector3d(2.0 * (i - 1), 0.0, z),
+                           Vector3d(2.0 * i, 0.0, z), 0.1);
+  }
+  m_picker->end();
+}
+
+void RayPickerTest::initTestCase()
+{
+  m_picker = new RayPicker;
+  record(0.0);
+}
+
+void RayPickerTest::cleanupTestCase()
+{
+  delete m_picker;
+  m_picker = 0;
+}
+
+void RayPickerTest::rayHits()
+{
+  QCOMPARE(m_picker->size(), 19);
+
+  // Straight down onto atom 3, clear of its bonds
+  QList<GLHit> hits = m_picker->hits(Vector3d(6.0, 0.3, 10.0),
+                                     Vector3d(0.0, 0.0, -1.0), 20.0);
+  QCOMPARE(hits.size(), 1);
+  QCOMPARE(hits[0].type(), static_cast<GLuint>(Primitive::AtomType));
+  QCOMPARE(hits[0].name(), static_cast<GLuint>(3));
+
+  // Between atoms 3 and 4 only the bond is hit
+  hits = m_picker->hits(Vector3d(7.0, 0.0, 10.0),
+                        Vector3d(0.0, 0.0, -1.0), 20.0);
+  QCOMPARE(hits.size(), 1);
+  QCOMPARE(hits[0].type(), static_cast<GLuint>(Primitive::BondType));
+  QCOMPARE(hits[0].name(), static_cast<GLuint>(3));
+
+  // Along the row every primitive is hit, sorted front to back
+  hits = m_picker->hits(Vector3d(-5.0, 0.0, 0.0),
+                        Vector3d(1.0, 0.0, 0.0), 30.0);
+  QCOMPARE(hits.size(), 19);
+  QCOMPARE(hits.first().name(), static_cast<GLuint>(0));
+  QCOMPARE(hits.first().type(), static_cast<GLuint>(Primitive::AtomType));
+  for (int i = 1; i < hits.size(); ++i)
+    QVERIFY(hits[i - 1].minZ() <= hits[i].minZ());
+
+  // Too short to reach the row
+  hits = m_picker->hits(Vector3d(6.0, 0.3, 10.0),
+                        Vector3d(0.0, 0.0, -1.0), 5.0);
+  QVERIFY(hits.isEmpty());
+}
+
+void RayPickerTest::frustumHits()
+{
+  // A box looking down the z axis around atoms 2 and 3
+  Vector3d corners[8] = {
+    Vector3d(3.0, -1.0, 10.0), Vector3d(6.5, -1.0, 10.0),
+    Vector3d(6.5, 1.0, 10.0), Vector3d(3.0, 1.0, 10.0),
+    Vector3d(3.0, -1.0, -10.0), Vector3d(6.5, -1.0, -10.0),
+    Vector3d(6.5, 1.0, -10.0), Vector3d(3.0, 1.0, -10.0)
+  };
+  QList<GLHit> hits = m_picker->hits(corners);
+  // Atoms 2 and 3, and the bonds 1, 2 and 3 reaching into the box
+  int atoms = 0, bonds = 0;
+  foreach (const GLHit &hit, hits) {
+    if (hit.type() == static_cast<GLuint>(Primitive::AtomType)) {
+      QVERIFY(hit.name() >= 2 && hit.name() <= 3);
+      ++atoms;
+    }
+    else {
+      QVERIFY(hit.name() >= 1 && hit.name() <= 3);
+      ++bonds;
+    }
+  }
+  QCOMPARE(atoms, 2);
+  QCOMPARE(bonds, 3);
+
+  // A box off to the side of the row
+  for (int i = 0; i < 8; ++i)
+    corners[i].y() += 5.0;
+  QVERIFY(m_picker->hits(corners).isEmpty());
+}
+
+void RayPickerTest::refit()
+{
+  // Moving the row refits the hierarchy in place
+  record(-20.0);
+  QCOMPARE(m_picker->size(), 19);
+  QList<GLHit> hits = m_picker->hits(Vector3d(6.0, 0.3, 10.0),
+                                     Vector3d(0.0, 0.0, -1.0), 20.0);
+  QVERIFY(hits.isEmpty());
+  hits = m_picker->hits(Vector3d(6.0, 0.3, 10.0),
+                        Vector3d(0.0, 0.0, -1.0), 40.0);
+  QCOMPARE(hits.size(), 1);
+  QCOMPARE(hits[0].name(), static_cast<GLuint>(3));
+
+  m_picker->clear();
+  QCOMPARE(m_picker->size(), 0);
+  QVERIFY(m_picker->hits(Vector3d(6.0, 0.3, 10.0),
+                         Vector3d(0.0, 0.0, -1.0), 40.0).isEmpty());
+}
+
+QTEST_MAIN(RayPickerTest)
+
+#include "moc_raypickertest.cxx"
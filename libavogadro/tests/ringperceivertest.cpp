@@ -0,0 +1,183 @@
+/**********************************************************************
+  RingPerceiverTest - unit tests for native ring perception
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include <QtTest>
+#include <avogadro/molecule.h>
+#include <avogadro/atom.h>
+#include <avogadro/bond.h>
+#include <avogadro/fragment.h>
+#include <avogadro/ringperceiver.h>
+
+#include <Eigen/Core>
+
+using Avogadro::Molecule;
+using Avogadro::Atom;
+using Avogadro::Bond;
+using Avogadro::Fragment;
+using Avogadro::RingPerceiver;
+
+using Eigen::Vector3d;
+
+class RingPerceiverTest : public QObject
+{
+  Q_OBJECT
+
+  private:
+    // Add n atoms to the molecule, returning the id of the first
+    unsigned long addAtoms(Molecule *molecule, int n);
+
+    // The sizes of the SSSR of every ring system of the molecule, sorted
+    QList<int> ringSizes(const Molecule *molecule);
+
+  private slots:
+    void chain();
+    void naphthalene();
+    void cubane();
+    void spiro();
+    void stableRings();
+};
+
+unsigned long RingPerceiverTest::addAtoms(Molecule *molecule, int n)
+{
+  unsigned long first = molecule->numAtoms();
+  for (int i = 0; i < n; ++i)
+    molecule->addAtom(6, Vector3d(i, 0.0, 0.0));
+  return first;
+}
+
+QList<int> RingPerceiverTest::ringSizes(const Molecule *molecule)
+{
+  QList<int> sizes;
+  foreach (const QList<unsigned long> &system,
+           RingPerceiver::ringSystems(molecule))
+    foreach (const QList<unsigned long> &ring,
+             RingPerceiver::sssr(molecule, system))
+      sizes.append(ring.size());
+  qSort(sizes);
+  return sizes;
+}
+
+void RingPerceiverTest::chain()
+{
+  Molecule molecule;
+  addAtoms(&molecule, 100);
+  for (unsigned long i = 0; i < 99; ++i)
+    molecule.addBond(i, i + 1, 1);
+  QVERIFY(RingPerceiver::ringSystems(&molecule).isEmpty());
+}
+
+void RingPerceiverTest::naphthalene()
+{
+  Molecule molecule;
+  addAtoms(&molecule, 10);
+  for (unsigned long i = 0; i < 6; ++i)
+    molecule.addBond(i, (i + 1) % 6, 1);
+  molecule.addBond(5, 6, 1);
+  for (unsigned long i = 6; i < 9; ++i)
+    molecule.addBond(i, i + 1, 1);
+  molecule.addBond(9, 4, 1);
+
+  QCOMPARE(RingPerceiver::ringSystems(&molecule).size(), 1);
+  QCOMPARE(ringSizes(&molecule), QList<int>() << 6 << 6);
+
+  // Consecutive atoms of a ring are bonded
+  QList<unsigned long> system = RingPerceiver::ringSystems(&molecule).at(0);
+  foreach (const QList<unsigned long> &ring,
+           RingPerceiver::sssr(&molecule, system))
+    for (int i = 0; i < ring.size(); ++i)
+      QVERIFY(molecule.bond(ring[i], ring[(i + 1) % ring.size()]));
+}
+
+void RingPerceiverTest::cubane()
+{
+  Molecule molecule;
+  addAtoms(&molecule, 8);
+  for (unsigned long i = 0; i < 4; ++i) {
+    molecule.addBond(i, (i + 1) % 4, 1);
+    molecule.addBond(i + 4, (i + 1) % 4 + 4, 1);
+    molecule.addBond(i, i + 4, 1);
+  }
+  QCOMPARE(ringSizes(&molecule), QList<int>() << 4 << 4 << 4 << 4 << 4);
+}
+
+void RingPerceiverTest::spiro()
+{
+  // Two rings sharing one atom are separate ring systems
+  Molecule molecule;
+  addAtoms(&molecule, 9);
+  for (unsigned long i = 0; i < 5; ++i)
+    molecule.addBond(i, (i + 1) % 5, 1);
+  molecule.addBond(0, 5, 1);
+  for (unsigned long i = 5; i < 8; ++i)
+    molecule.addBond(i, i + 1, 1);
+  molecule.addBond(8, 0, 1);
+  QCOMPARE(RingPerceiver::ringSystems(&molecule).size(), 2);
+  QCOMPARE(ringSizes(&molecule), QList<int>() << 5 << 5);
+}
+
+void RingPerceiverTest::stableRings()
+{
+  // Two benzene rings, the first with a chain on it
+  Molecule molecule;
+  unsigned long first = addAtoms(&molecule, 6);
+  for (unsigned long i = 0; i < 6; ++i)
+    molecule.addBond(first + i, first + (i + 1) % 6, 1);
+  unsigned long second = addAtoms(&molecule, 6);
+  for (unsigned long i = 0; i < 6; ++i)
+    molecule.addBond(second + i, second + (i + 1) % 6, 1);
+  unsigned long chain = addAtoms(&molecule, 3);
+  molecule.addBond(first, chain, 1);
+  molecule.addBond(chain, chain + 1, 1);
+  molecule.addBond(chain + 1, chain + 2, 1);
+
+  QList<Fragment *> rings = molecule.rings();
+  QCOMPARE(rings.size(), 2);
+
+  // Closing a ring on the chain leaves the benzene rings alone
+  molecule.addBond(chain + 2, first, 1);
+  QList<Fragment *> newRings = molecule.rings();
+  QCOMPARE(newRings.size(), 3);
+  QVERIFY(newRings.contains(rings[0]));
+  QVERIFY(newRings.contains(rings[1]));
+
+  // Fusing the second ring to it only replaces the rings involved
+  Fragment *benzene1 = 0, *benzene2 = 0;
+  foreach (Fragment *ring, newRings) {
+    if (ring->atoms().size() == 6 && ring->atoms().contains(first))
+      benzene1 = ring;
+    else if (ring->atoms().contains(second))
+      benzene2 = ring;
+  }
+  QVERIFY(benzene1 && benzene2);
+  molecule.addBond(second, chain + 1, 1);
+  molecule.addBond(second + 1, chain + 2, 1);
+  rings = molecule.rings();
+  QCOMPARE(rings.size(), 4);
+  QVERIFY(rings.contains(benzene1));
+  QVERIFY(!rings.contains(benzene2));
+}
+
+QTEST_MAIN(RingPerceiverTest)
+
+#include "moc_ringperceivertest.cxx"
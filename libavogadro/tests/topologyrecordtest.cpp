@@ -0,0 +1,233 @@
+/**********************************************************************
+  TopologyRecordTest - unit tests for undoing removed atoms and bonds
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include <QtTest>
+#include <avogadro/molecule.h>
+#include <avogadro/atom.h>
+#include <avogadro/bond.h>
+#include <avogadro/idlist.h>
+#include <avogadro/residue.h>
+#include <avogadro/topologyrecord.h>
+
+#include <Eigen/Core>
+
+using Avogadro::Molecule;
+using Avogadro::Atom;
+using Avogadro::Bond;
+using Avogadro::IDList;
+using Avogadro::Residue;
+using Avogadro::TopologyRecord;
+
+using Eigen::Vector3d;
+
+// Exposes how many slots are connected to the signals of an atom
+class AtomReceivers : public Atom
+{
+  public:
+    static int updated(Atom *atom)
+    {
+      return static_cast<AtomReceivers *>(atom)->receivers(SIGNAL(updated()));
+    }
+};
+
+class TopologyRecordTest : public QObject
+{
+  Q_OBJECT
+
+  private:
+    Molecule *m_molecule;
+
+    /**
+     * Check the atoms and bonds are in the order they were added.
+     */
+    void verifyOrder();
+
+  private slots:
+    /**
+     * Called before each test function.
+     */
+    void init();
+
+    /**
+     * Called after each test function.
+     */
+    void cleanup();
+
+    /**
+     * Removes atoms from the middle and restores them.
+     */
+    void restoreOrder();
+
+    /**
+     * Clears the molecule and restores it.
+     */
+    void restoreAll();
+
+    /**
+     * Tests the data set on the atoms is restored.
+     */
+    void restoreAtomData();
+
+    /**
+     * Tests charges that were guessed are guessed again after a restore.
+     */
+    void restoreGuessedCharges();
+
+    /**
+     * Tests restored residues get their atoms back only once.
+     */
+    void restoreResidues();
+};
+
+void TopologyRecordTest::verifyOrder()
+{
+  QCOMPARE(m_molecule->numAtoms(), 10U);
+  QCOMPARE(m_molecule->numBonds(), 9U);
+  for (unsigned int i = 0; i < 10; ++i) {
+    QCOMPARE(m_molecule->atom(i)->id(), static_cast<unsigned long>(i));
+    QCOMPARE(m_molecule->atom(i)->index(), static_cast<unsigned long>(i));
+  }
+  for (unsigned int i = 0; i < 9; ++i) {
+    QCOMPARE(m_molecule->bond(i)->id(), static_cast<unsigned long>(i));
+    QCOMPARE(m_molecule->bond(i)->index(), static_cast<unsigned long>(i));
+  }
+}
+
+void TopologyRecordTest::init()
+{
+  m_molecule = new Molecule;
+  for (int i = 0; i < 10; ++i)
+    m_molecule->addAtom(6, Vector3d(1.5 * i, 0.0, 0.0));
+  for (unsigned long i = 0; i < 9; ++i)
+    m_molecule->addBond(i, i+1, 1);
+}
+
+void TopologyRecordTest::cleanup()
+{
+  delete m_molecule;
+  m_molecule = 0;
+}
+
+void TopologyRecordTest::restoreOrder()
+{
+  // The first, a middle and the last atom, along with their bonds
+  IDList selection;
+  selection.append(m_molecule->atom(0));
+  selection.append(m_molecule->atom(4));
+  selection.append(m_molecule->atom(5));
+  selection.append(m_molecule->atom(9));
+
+  TopologyRecord record;
+  record.remove(m_molecule, selection);
+  QCOMPARE(m_molecule->numAtoms(), 6U);
+  QCOMPARE(m_molecule->numBonds(), 4U);
+  QCOMPARE(m_molecule->atom(0)->id(), 1UL);
+
+  record.restore(m_molecule);
+  verifyOrder();
+  QVERIFY(m_molecule->atom(5)->pos()->isApprox(Vector3d(7.5, 0.0, 0.0)));
+  QVERIFY(m_molecule->bond(4, 5));
+  QVERIFY(record.isEmpty());
+}
+
+void TopologyRecordTest::restoreAll()
+{
+  TopologyRecord record;
+  record.removeAll(m_molecule);
+  QCOMPARE(m_molecule->numAtoms(), 0U);
+
+  record.restore(m_molecule);
+  verifyOrder();
+  QVERIFY(m_molecule->atom(9)->pos()->isApprox(Vector3d(13.5, 0.0, 0.0)));
+}
+
+void TopologyRecordTest::restoreAtomData()
+{
+  Atom *atom = m_molecule->atom(3);
+  atom->setAtomicNumber(8);
+  atom->setFormalCharge(-1);
+  atom->setCustomLabel("O3");
+  atom->setForceVector(Vector3d(0.0, 1.0, 2.0));
+  atom->setProperty("charge group", 2);
+
+  IDList selection;
+  selection.append(atom);
+  TopologyRecord record;
+  record.remove(m_molecule, selection);
+  record.restore(m_molecule);
+
+  atom = m_molecule->atom(3);
+  QCOMPARE(atom->id(), 3UL);
+  QCOMPARE(atom->atomicNumber(), 8);
+  QCOMPARE(atom->formalCharge(), -1);
+  QCOMPARE(atom->customLabel(), QString("O3"));
+  QVERIFY(atom->forceVector().isApprox(Vector3d(0.0, 1.0, 2.0)));
+  QCOMPARE(atom->property("charge group").toInt(), 2);
+}
+
+void TopologyRecordTest::restoreGuessedCharges()
+{
+  IDList selection;
+  selection.append(m_molecule->atom(3));
+  TopologyRecord record;
+  record.remove(m_molecule, selection);
+  record.restore(m_molecule);
+
+  // Atom 6 has the same bonds and was never removed
+  Atom *restored = m_molecule->atom(3);
+  Atom *kept = m_molecule->atom(6);
+  restored->setAtomicNumber(7);
+  kept->setAtomicNumber(7);
+  QCOMPARE(restored->formalCharge(), kept->formalCharge());
+  m_molecule->bond(3)->setOrder(2);
+  m_molecule->bond(6)->setOrder(2);
+  QCOMPARE(restored->formalCharge(), kept->formalCharge());
+}
+
+void TopologyRecordTest::restoreResidues()
+{
+  Residue *residue = m_molecule->addResidue();
+  for (unsigned long i = 2; i < 5; ++i)
+    residue->addAtom(i);
+  unsigned long residueId = residue->id();
+  int receivers = AtomReceivers::updated(m_molecule->atom(3));
+
+  IDList selection;
+  selection.append(m_molecule->atom(3));
+  selection.append(residue);
+  TopologyRecord record;
+  record.remove(m_molecule, selection);
+  record.restore(m_molecule);
+
+  residue = m_molecule->residueById(residueId);
+  QVERIFY(residue);
+  QCOMPARE(residue->atoms().size(), 3);
+  Atom *atom = m_molecule->atom(3);
+  QCOMPARE(atom->residueId(), residueId);
+  QCOMPARE(AtomReceivers::updated(atom), receivers);
+}
+
+QTEST_MAIN(TopologyRecordTest)
+
+#include "moc_topologyrecordtest.cxx"
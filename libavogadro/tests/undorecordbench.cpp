@@ -0,0 +1,190 @@
+/**********************************************************************
+  UndoRecordBench - compare undo records with molecule snapshots
+
+  Copyright (C) 2012 by the Avogadro developers
+
+  This file is part of the Avogadro molecular editor project.
+  For more information, see <http://avogadro.cc/>
+
+  Avogadro is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  Avogadro is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+  02110-1301, USA.
+ **********************************************************************/
+
+#include <QtTest>
+
+#include <avogadro/atom.h>
+#include <avogadro/bond.h>
+#include <avogadro/molecule.h>
+#include <avogadro/idlist.h>
+#include <avogadro/coordinaterecord.h>
+#include <avogadro/topologyrecord.h>
+
+#include <Eigen/Core>
+
+using Avogadro::Molecule;
+using Avogadro::Atom;
+using Avogadro::Bond;
+using Avogadro::IDList;
+using Avogadro::CoordinateRecord;
+using Avogadro::TopologyRecord;
+
+using Eigen::Vector3d;
+
+class UndoRecordBench : public QObject
+{
+  Q_OBJECT
+
+private:
+  Molecule *m_molecule; /// Molecule object for use by the test class.
+
+  /**
+   * Move the first @p n atoms of the molecule.
+   */
+  void moveAtoms(int n);
+
+  /**
+   * Bytes used by the atoms, bonds and coordinates of a snapshot. This is a
+   * lower bound, the private data and QObject overhead are not included.
+   */
+  unsigned long snapshotMemory() const;
+
+private slots:
+  /**
+   * Called before each test function.
+   */
+  void init();
+
+  /**
+   * Called after each test function.
+   */
+  void cleanup();
+
+  /**
+   * Undo and redo moving 100 of 25,000 atoms by copying the molecule.
+   */
+  void snapshotMove();
+
+  /**
+   * Undo and redo moving 100 of 25,000 atoms with a CoordinateRecord.
+   */
+  void recordMove();
+
+  /**
+   * Undo cutting 1,000 of 25,000 atoms by copying the molecule.
+   */
+  void snapshotCut();
+
+  /**
+   * Undo and redo cutting 1,000 of 25,000 atoms with a TopologyRecord.
+   */
+  void recordCut();
+};
+
+void UndoRecordBench::moveAtoms(int n)
+{
+  for (int i = 0; i < n; ++i)
+    m_molecule->atom(i)->setPos(*m_molecule->atom(i)->pos()
+                                + Vector3d(0.5, 0.0, 0.0));
+}
+
+unsigned long UndoRecordBench::snapshotMemory() const
+{
+  return m_molecule->numAtoms() * (sizeof(Atom) + sizeof(Vector3d))
+      + m_molecule->numBonds() * sizeof(Bond);
+}
+
+void UndoRecordBench::init()
+{
+  m_molecule = new Molecule;
+  for (int i = 0; i < 25000; ++i)
+    m_molecule->addAtom(6, Vector3d(1.5 * i, 0.0, 0.0));
+  for (unsigned long i = 0; i < 24999; ++i)
+    m_molecule->addBond(i, i+1, 1);
+}
+
+void UndoRecordBench::cleanup()
+{
+  delete m_molecule;
+  m_molecule = 0;
+}
+
+void UndoRecordBench::snapshotMove()
+{
+  QBENCHMARK_ONCE {
+    Molecule copy;
+    copy = *m_molecule;
+    moveAtoms(100);
+    // undo, then redo
+    Molecule newMolecule;
+    newMolecule = *m_molecule;
+    *m_molecule = copy;
+    *m_molecule = newMolecule;
+  }
+  qDebug() << "Snapshot bytes (lower bound):" << snapshotMemory();
+}
+
+void UndoRecordBench::recordMove()
+{
+  CoordinateRecord record;
+  QBENCHMARK_ONCE {
+    record.store(m_molecule);
+    moveAtoms(100);
+    // undo, then redo
+    record.swap(m_molecule);
+    record.swap(m_molecule);
+  }
+  QVERIFY(m_molecule->atom(0)->pos()->isApprox(Vector3d(0.5, 0.0, 0.0)));
+  record.swap(m_molecule);
+  QVERIFY(m_molecule->atom(0)->pos()->isApprox(Vector3d(0.0, 0.0, 0.0)));
+  QVERIFY(m_molecule->atom(100)->pos()->isApprox(Vector3d(150.0, 0.0, 0.0)));
+  qDebug() << "Record bytes:" << record.memoryUsage();
+}
+
+void UndoRecordBench::snapshotCut()
+{
+  QBENCHMARK_ONCE {
+    Molecule copy;
+    copy = *m_molecule;
+    for (int i = 0; i < 1000; ++i)
+      m_molecule->removeAtom(static_cast<unsigned long>(2 * i));
+    *m_molecule = copy;
+  }
+  QCOMPARE(m_molecule->numAtoms(), 25000U);
+  qDebug() << "Snapshot bytes (lower bound):" << snapshotMemory();
+}
+
+void UndoRecordBench::recordCut()
+{
+  IDList selection;
+  for (int i = 0; i < 1000; ++i)
+    selection.append(m_molecule->atom(2 * i));
+
+  TopologyRecord record;
+  unsigned long bytes = 0;
+  QBENCHMARK_ONCE {
+    record.remove(m_molecule, selection);
+    bytes = record.memoryUsage();
+    record.restore(m_molecule);
+  }
+  QCOMPARE(m_molecule->numAtoms(), 25000U);
+  QCOMPARE(m_molecule->numBonds(), 24999U);
+  QVERIFY(m_molecule->atomById(2)->pos()->isApprox(Vector3d(3.0, 0.0, 0.0)));
+  QVERIFY(m_molecule->bond(1, 2));
+  qDebug() << "Record bytes:" << bytes;
+}
+
+QTEST_MAIN(UndoRecordBench)
+
+#include "moc_undorecordbench.cxx"